@@ -0,0 +1,89 @@
+#include "Bc7Decoder.h"
+#include "MappedFile.h"
+#include "WorkStealingPool.h"
+#include "BenchCommon.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+// Пропускная способность Bc7Decoder на 16 тайлах Terrain/001/Weathering (BC7 512x512, мип 0):
+// каждый уровень SIMD в одном потоке и на пуле, RGBA и только R канал.
+// MB/s считаются по выходу (RGBA8 или байт канала) и по входным блокам BC7.
+
+int main(int argc, char** argv)
+{
+    const bool quick = IsQuickRun(argc, argv);
+    const int repeats = quick ? 1 : 25;
+
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::vector<DdsLayout> layouts;
+    uint64_t inputBytes = 0;
+    uint64_t pixels = 0;
+    for (int y = 0; y < TestWorld::TilesY; y++)
+    {
+        for (int x = 0; x < TestWorld::TilesX; x++)
+        {
+            std::string path = "Terrain/001/Weathering/Weathering_Out_y" + std::to_string(y) + "_x" + std::to_string(x) + ".dds";
+            auto file = std::make_unique<MappedFile>();
+            DdsLayout layout;
+            if (!file->Open(path) || !ParseDdsLayout(file->GetData(), file->GetSize(), layout) || !IsBc7Format(layout.DxgiFormat))
+            {
+                std::printf("cannot load %s\n", path.c_str());
+                return 1;
+            }
+            inputBytes += layout.Mips[0].Size;
+            pixels += (uint64_t)layout.Width * layout.Height;
+            files.push_back(std::move(file));
+            layouts.push_back(layout);
+        }
+    }
+
+    WorkStealingPool pool;
+    std::printf("%zu tiles, %.1f MB of BC7 blocks, supported SIMD level %d, pool of %u threads\n",
+                files.size(), inputBytes / 1048576.0, (int)GetSupportedSimdLevel(), pool.GetThreadCount());
+    std::printf("level    threads  output      ms/set   MB/s out   MB/s in\n");
+
+    const char* levelNames[] = { "scalar", "SSE4.1", "AVX2" };
+    std::vector<uint8_t> output;
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2 })
+    {
+        Bc7Decoder decoder(level);
+        if (decoder.GetSimdLevel() != level)
+        {
+            std::printf("%-8s not supported on this CPU\n", levelNames[(int)level]);
+            continue;
+        }
+
+        for (bool channel : { false, true })
+        {
+            for (WorkStealingPool* decodePool : { (WorkStealingPool*)nullptr, &pool })
+            {
+                if (decodePool != nullptr && pool.GetThreadCount() == 1)
+                {
+                    continue;
+                }
+                double ms = BestOfMs(repeats, [&]()
+                {
+                    for (size_t i = 0; i < files.size(); i++)
+                    {
+                        if (channel)
+                        {
+                            decoder.DecodeMipChannel(layouts[i], files[i]->GetData(), 0, 0, output, decodePool);
+                        }
+                        else
+                        {
+                            decoder.DecodeMip(layouts[i], files[i]->GetData(), 0, output, decodePool);
+                        }
+                        KeepResult(output[0]);
+                    }
+                });
+                double outputMb = pixels * (channel ? 1.0 : 4.0) / 1048576.0;
+                std::printf("%-8s %7u  %-8s %9.2f %10.0f %9.0f\n", levelNames[(int)level],
+                            decodePool ? pool.GetThreadCount() : 1u, channel ? "R only" : "RGBA8",
+                            ms, outputMb / (ms / 1000.0), inputBytes / 1048576.0 / (ms / 1000.0));
+            }
+        }
+    }
+    return 0;
+}
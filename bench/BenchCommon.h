@@ -0,0 +1,46 @@
+#pragma once
+
+#include "TestCommon.h"
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// Помощники бенчмарков: замер лучшего из нескольких прогонов и разбор --quick.
+// Бенчмарки не проверяют результаты (это делают tests/), но печатают контрольные
+// суммы, чтобы сравниваемые пути заведомо считали одно и то же.
+
+// Время одного вызова fn в миллисекундах, лучшее из repeats прогонов
+template <typename Fn>
+double BestOfMs(int repeats, Fn&& fn)
+{
+    double best = 1e30;
+    for (int i = 0; i < repeats; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+// --quick - короткий прогон для проверки, что бенчмарк вообще работает (ctest -L bench)
+inline bool IsQuickRun(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--quick") == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Не даёт компилятору выбросить вычисления, результат которых не используется
+inline void KeepResult(uint64_t value)
+{
+    static volatile uint64_t sink;
+    sink = sink + value;
+}
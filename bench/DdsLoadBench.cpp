@@ -0,0 +1,178 @@
+#include "DdsFile.h"
+#include "MappedFile.h"
+#include "BenchCommon.h"
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+// Загрузка 16 тайлов Terrain/001 в staging память с выравниванием D3D12 (шаг строки 256 байт,
+// мип с границы 512 байт), как в TerrainApp::CreateTextureFromDds:
+//   - прежний путь DDSTextureLoader (LoadTextureDataFromFile): весь файл в буфер в куче,
+//     проверка заголовка, построчное копирование мипов. Сам LoadTextureDataFromFile использует
+//     CreateFile2/ReadFile, здесь - тот же порядок действий через std::ifstream;
+//   - MappedFile + ParseDdsLayout + копирование из отображения (потоковые тайлы);
+//   - ReadDdsLayout + ReadDdsMips прямо в staging (карта высот).
+// Полная цепочка мипов и только хвост до 64x64, который первым грузит TextureStreamer.
+// Файлы в страничном кэше после первого прохода - замеряется копирование, а не диск.
+
+namespace
+{
+    struct Staging
+    {
+        std::vector<DdsStagingFootprint> Footprints;
+        std::vector<uint8_t> Memory;
+    };
+
+    void PrepareStaging(const DdsLayout& layout, uint32_t firstMip, Staging& staging)
+    {
+        uint32_t mipCount = (uint32_t)layout.Mips.size() - firstMip;
+        staging.Footprints.resize(mipCount);
+        uint64_t offset = 0;
+        for (uint32_t i = 0; i < mipCount; i++)
+        {
+            const DdsMipInfo& info = layout.Mips[firstMip + i];
+            staging.Footprints[i].Offset = offset;
+            staging.Footprints[i].RowPitch = (info.RowPitch + 255) & ~255u;
+            offset = (offset + (uint64_t)staging.Footprints[i].RowPitch * info.RowCount + 511) & ~511ull;
+        }
+        if (staging.Memory.size() < offset)
+        {
+            staging.Memory.resize((size_t)offset);
+        }
+    }
+
+    void CopyMips(const DdsLayout& layout, const uint8_t* fileData, uint32_t firstMip, Staging& staging)
+    {
+        for (uint32_t i = 0; i + firstMip < layout.Mips.size(); i++)
+        {
+            DdsSubresource source = GetDdsSubresource(layout, fileData, firstMip + i);
+            uint8_t* destination = staging.Memory.data() + staging.Footprints[i].Offset;
+            for (uint32_t row = 0; row < source.RowCount; row++)
+            {
+                std::memcpy(destination + (size_t)row * staging.Footprints[i].RowPitch,
+                            source.Data + (size_t)row * source.RowPitch, source.RowPitch);
+            }
+        }
+    }
+
+    bool LoadWholeFile(const std::string& path, uint32_t resolution, Staging& staging)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            return false;
+        }
+        size_t size = (size_t)file.tellg();
+        std::unique_ptr<uint8_t[]> data(new uint8_t[size]);
+        file.seekg(0);
+        DdsLayout layout;
+        if (!file.read(reinterpret_cast<char*>(data.get()), (std::streamsize)size) ||
+            !ParseDdsLayout(data.get(), size, layout))
+        {
+            return false;
+        }
+        uint32_t firstMip = SelectDdsFirstMip(layout, resolution);
+        PrepareStaging(layout, firstMip, staging);
+        CopyMips(layout, data.get(), firstMip, staging);
+        return true;
+    }
+
+    bool LoadMapped(const std::string& path, uint32_t resolution, Staging& staging)
+    {
+        MappedFile file;
+        DdsLayout layout;
+        if (!file.Open(path) || !ParseDdsLayout(file.GetData(), file.GetSize(), layout))
+        {
+            return false;
+        }
+        uint32_t firstMip = SelectDdsFirstMip(layout, resolution);
+        PrepareStaging(layout, firstMip, staging);
+        CopyMips(layout, file.GetData(), firstMip, staging);
+        return true;
+    }
+
+    bool LoadToStaging(const std::string& path, uint32_t resolution, Staging& staging)
+    {
+        DdsLayout layout;
+        if (!ReadDdsLayout(path, layout))
+        {
+            return false;
+        }
+        uint32_t firstMip = SelectDdsFirstMip(layout, resolution);
+        PrepareStaging(layout, firstMip, staging);
+        return ReadDdsMips(path, layout, firstMip, (uint32_t)layout.Mips.size() - firstMip,
+                           staging.Footprints.data(), staging.Memory.data());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = IsQuickRun(argc, argv);
+    const int repeats = quick ? 2 : 200;
+
+    std::vector<std::string> paths;
+    uint64_t fileBytes = 0;
+    uint64_t fullBytes = 0;
+    uint64_t tailBytes = 0;
+    for (int y = 0; y < TestWorld::TilesY; y++)
+    {
+        for (int x = 0; x < TestWorld::TilesX; x++)
+        {
+            std::string path = "Terrain/001/Weathering/Weathering_Out_y" + std::to_string(y) + "_x" + std::to_string(x) + ".dds";
+            MappedFile file;
+            DdsLayout layout;
+            if (!file.Open(path) || !ParseDdsLayout(file.GetData(), file.GetSize(), layout))
+            {
+                std::printf("cannot load %s\n", path.c_str());
+                return 1;
+            }
+            paths.push_back(path);
+            fileBytes += file.GetSize();
+            fullBytes += GetDdsMipChainSize(layout, 0);
+            tailBytes += GetDdsMipChainSize(layout, SelectDdsFirstMip(layout, 64));
+        }
+    }
+
+    std::printf("%zu tiles, %.2f MB on disk, best of %d runs per tile set\n", paths.size(), fileBytes / 1048576.0, repeats);
+    std::printf("path                           mips          ms/set    MB/s of mips\n");
+
+    Staging staging;
+    struct Path
+    {
+        const char* Name;
+        bool (*Load)(const std::string&, uint32_t, Staging&);
+    };
+    const Path loaders[] =
+    {
+        { "heap buffer + copy (old path)", LoadWholeFile },
+        { "mmap + copy (streamed tiles) ", LoadMapped },
+        { "read to staging (heightmap)  ", LoadToStaging },
+    };
+
+    for (uint32_t resolution : { 4096u, 64u })
+    {
+        uint64_t bytes = resolution == 64 ? tailBytes : fullBytes;
+        for (const Path& loader : loaders)
+        {
+            bool ok = true;
+            double ms = BestOfMs(repeats, [&]()
+            {
+                for (const std::string& path : paths)
+                {
+                    ok = loader.Load(path, resolution, staging) && ok;
+                }
+            });
+            if (!ok)
+            {
+                std::printf("%s failed\n", loader.Name);
+                return 1;
+            }
+            std::printf("%s  %-12s %8.3f %12.0f\n", loader.Name, resolution == 64 ? "tail (64)" : "full chain",
+                        ms, bytes / 1048576.0 / (ms / 1000.0));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "FrustumCulling.h"
+#include "BenchCommon.h"
+#include <vector>
+#include <cstdio>
+
+using namespace DirectX;
+
+// Стоимость классификации AABB пирамидой: BoundingFrustum::Contains (плоскости строятся
+// на каждый вызов), скалярный ClassifyBox и ClassifyBoxes4 по четыре бокса с плоскостями,
+// построенными один раз. Боксы - сёстры узлов квадродерева вдоль облёта, как в QuadTree::Update.
+
+int main(int argc, char** argv)
+{
+    const bool quick = IsQuickRun(argc, argv);
+    const uint32_t frames = quick ? 8 : 64;
+    const int repeats = quick ? 1 : 5;
+
+    // Все узлы дерева глубины 6 над террейном 2048x2048, сёстры по четыре (SoA)
+    const int depth = 6;
+    std::vector<float> cx, cy, cz, ex, ey, ez;
+    for (int level = 1; level <= depth; level++)
+    {
+        int count = 1 << level;
+        float size = TestWorld::TerrainSize / count;
+        for (int z = 0; z < count; z += 2)
+        {
+            for (int x = 0; x < count; x += 2)
+            {
+                for (int child = 0; child < 4; child++)
+                {
+                    cx.push_back((x + (child & 1) + 0.5f) * size);
+                    cz.push_back((z + (child >> 1) + 0.5f) * size);
+                    cy.push_back(250.0f);
+                    ex.push_back(size * 0.5f);
+                    ey.push_back(250.0f);
+                    ez.push_back(size * 0.5f);
+                }
+            }
+        }
+    }
+    const size_t boxCount = cx.size();
+    const size_t groupCount = boxCount / 4;
+
+    std::vector<BoundingFrustum> frusta;
+    for (uint32_t f = 0; f < frames; f++)
+    {
+        frusta.push_back(MakeTestCamera(FlightPathPose(f, frames)).GetFrustum());
+    }
+
+    uint64_t checksum[3] = { 0, 0, 0 };
+    std::vector<BoundingBox> boxes(boxCount);
+    for (size_t i = 0; i < boxCount; i++)
+    {
+        boxes[i] = BoundingBox(XMFLOAT3(cx[i], cy[i], cz[i]), XMFLOAT3(ex[i], ey[i], ez[i]));
+    }
+
+    double containsMs = BestOfMs(repeats, [&]()
+    {
+        checksum[0] = 0;
+        for (const BoundingFrustum& frustum : frusta)
+        {
+            for (const BoundingBox& box : boxes)
+            {
+                checksum[0] += frustum.Contains(box);
+            }
+        }
+    });
+
+    double scalarMs = BestOfMs(repeats, [&]()
+    {
+        checksum[1] = 0;
+        for (const BoundingFrustum& frustum : frusta)
+        {
+            FrustumPlanes planes;
+            planes.Build(frustum);
+            for (size_t i = 0; i < boxCount; i++)
+            {
+                ContainmentType containment;
+                uint8_t straddle, reject = 0;
+                float margin, insideMargin;
+                ClassifyBox(planes, FrustumPlanes::AllPlanesMask, cx[i], cy[i], cz[i], ex[i], ey[i], ez[i],
+                            containment, straddle, reject, margin, insideMargin);
+                checksum[1] += containment;
+            }
+        }
+    });
+
+    double simdMs = BestOfMs(repeats, [&]()
+    {
+        checksum[2] = 0;
+        const uint8_t hint[4] = { 0, 0, 0, 0 };
+        for (const BoundingFrustum& frustum : frusta)
+        {
+            FrustumPlanes planes;
+            planes.Build(frustum);
+            for (size_t g = 0; g < groupCount; g++)
+            {
+                BoxCullResult4 result;
+                size_t i = g * 4;
+                ClassifyBoxes4(planes, FrustumPlanes::AllPlanesMask, hint,
+                               &cx[i], &cy[i], &cz[i], &ex[i], &ey[i], &ez[i], result);
+                checksum[2] += result.Containment[0] + result.Containment[1] +
+                               result.Containment[2] + result.Containment[3];
+            }
+        }
+    });
+
+    double tests = (double)boxCount * frames;
+    std::printf("%zu boxes x %u frames\n", boxCount, frames);
+    std::printf("  BoundingFrustum::Contains  %8.2f ms  %6.2f ns/box  checksum %llu\n",
+                containsMs, containsMs * 1e6 / tests, (unsigned long long)checksum[0]);
+    std::printf("  ClassifyBox (scalar)       %8.2f ms  %6.2f ns/box  checksum %llu  x%.2f\n",
+                scalarMs, scalarMs * 1e6 / tests, (unsigned long long)checksum[1], containsMs / scalarMs);
+    std::printf("  ClassifyBoxes4 (SIMD)      %8.2f ms  %6.2f ns/box  checksum %llu  x%.2f\n",
+                simdMs, simdMs * 1e6 / tests, (unsigned long long)checksum[2], containsMs / simdMs);
+    return 0;
+}
@@ -0,0 +1,200 @@
+#include "Heightfield.h"
+#include "TiffReader.h"
+#include "BenchCommon.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+// Запросы высоты Heightfield (тайлы 8x8 в порядке Мортона) против той же билинейной
+// выборки из построчной карты. Два набора точек по 1M:
+//   - случайные по всей карте - каждый запрос промах кэша при любой раскладке;
+//   - когерентные - отрезки по 16 точек с шагом 0.5 единицы в случайном направлении,
+//     как лучи пикинга или опорные точки физики; здесь и проявляется раскладка.
+// Карты: Terrain/003/Height_Out.tif (512x512, влезает в L2) и 2048x2048 из 16 тайлов
+// Terrain/001/Height (16 МБ, больше L2/L3 на большинстве машин).
+
+namespace
+{
+    // Построчная карта с той же арифметикой, что у Heightfield
+    struct RowMajorHeights
+    {
+        std::vector<float> Values;
+        uint32_t Width;
+        uint32_t Height;
+        float ScaleX, OffsetX, ScaleZ, OffsetZ, HeightScale;
+
+        void Build(const std::vector<float>& values, uint32_t width, uint32_t height,
+                   float sizeX, float sizeZ, float heightScale)
+        {
+            Values = values;
+            Width = width;
+            Height = height;
+            ScaleX = width / sizeX;
+            OffsetX = -0.5f;
+            ScaleZ = -(height / sizeZ);
+            OffsetZ = height - 0.5f;
+            HeightScale = heightScale;
+        }
+
+        float Sample(float x, float z) const
+        {
+            float tx = std::min(std::max(x * ScaleX + OffsetX, -1.0f), (float)Width);
+            float ty = std::min(std::max(z * ScaleZ + OffsetZ, -1.0f), (float)Height);
+            float floorX = std::floor(tx);
+            float floorY = std::floor(ty);
+            float fx = tx - floorX;
+            float fy = ty - floorY;
+            int x0 = std::max(0, std::min((int)floorX, (int)Width - 1));
+            int x1 = std::max(0, std::min((int)floorX + 1, (int)Width - 1));
+            int y0 = std::max(0, std::min((int)floorY, (int)Height - 1));
+            int y1 = std::max(0, std::min((int)floorY + 1, (int)Height - 1));
+            float h00 = Values[(size_t)y0 * Width + x0];
+            float h01 = Values[(size_t)y0 * Width + x1];
+            float h10 = Values[(size_t)y1 * Width + x0];
+            float h11 = Values[(size_t)y1 * Width + x1];
+            float top = h00 + (h01 - h00) * fx;
+            float bottom = h10 + (h11 - h10) * fx;
+            return (top + (bottom - top) * fy) * HeightScale;
+        }
+    };
+
+    // Тайлы Terrain/001/Height, сшитые в одну карту
+    bool LoadTiledHeights(std::vector<float>& values, uint32_t& width, uint32_t& height)
+    {
+        const uint32_t tileSize = TestWorld::TileSize;
+        width = tileSize * TestWorld::TilesX;
+        height = tileSize * TestWorld::TilesY;
+        values.resize((size_t)width * height);
+        std::vector<uint16_t> samples((size_t)tileSize * tileSize);
+        for (int ty = 0; ty < TestWorld::TilesY; ty++)
+        {
+            for (int tx = 0; tx < TestWorld::TilesX; tx++)
+            {
+                std::string path = "Terrain/001/Height/Height_Out_y" + std::to_string(ty) + "_x" + std::to_string(tx) + ".tif";
+                TiffStripReader reader;
+                if (!reader.Open(path) || reader.GetWidth() != tileSize || reader.GetHeight() != tileSize ||
+                    !reader.ReadRows(0, tileSize, samples.data()))
+                {
+                    std::printf("cannot load %s\n", path.c_str());
+                    return false;
+                }
+                for (uint32_t y = 0; y < tileSize; y++)
+                {
+                    float* row = &values[(size_t)(ty * tileSize + y) * width + tx * tileSize];
+                    for (uint32_t x = 0; x < tileSize; x++)
+                    {
+                        row[x] = samples[y * tileSize + x] / 65535.0f;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = IsQuickRun(argc, argv);
+    const size_t count = quick ? 16384 : 1u << 20;
+    const int repeats = quick ? 1 : 5;
+    const size_t batch = 16;
+
+    struct Map
+    {
+        const char* Name;
+        std::vector<float> Values;
+        uint32_t Width, Height;
+    };
+    Map maps[2] = { { "512x512", {}, 0, 0 }, { "2048x2048", {}, 0, 0 } };
+    if (!LoadTestHeights(maps[0].Values, maps[0].Width, maps[0].Height))
+    {
+        std::printf("cannot load Terrain/003/Height_Out.tif\n");
+        return 1;
+    }
+    if (!LoadTiledHeights(maps[1].Values, maps[1].Width, maps[1].Height))
+    {
+        return 1;
+    }
+
+    const float size = TestWorld::TerrainSize;
+    TestRandom random(7);
+    std::vector<float> randomX(count), randomZ(count), coherentX(count), coherentZ(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        randomX[i] = random.Uniform(0.0f, size);
+        randomZ[i] = random.Uniform(0.0f, size);
+    }
+    for (size_t i = 0; i < count; i += batch)
+    {
+        float x = random.Uniform(0.0f, size);
+        float z = random.Uniform(0.0f, size);
+        float angle = random.Uniform(0.0f, 6.2831853f);
+        for (size_t k = 0; k < batch; k++)
+        {
+            coherentX[i + k] = x + k * 0.5f * std::cos(angle);
+            coherentZ[i + k] = z + k * 0.5f * std::sin(angle);
+        }
+    }
+
+    std::printf("%zu queries per set, best of %d runs, batches of %zu for SIMD paths\n", count, repeats, batch);
+    std::printf("map        points    layout     path      ns/query  matches row-major\n");
+
+    std::vector<float> expected(count), heights(count);
+    for (Map& map : maps)
+    {
+        RowMajorHeights rowMajor;
+        rowMajor.Build(map.Values, map.Width, map.Height, size, size, TestWorld::HeightScale);
+        Heightfield heightfield;
+        heightfield.Build(map.Values, map.Width, map.Height, size, size, TestWorld::HeightScale);
+
+        for (int coherent = 0; coherent < 2; coherent++)
+        {
+            const float* x = coherent ? coherentX.data() : randomX.data();
+            const float* z = coherent ? coherentZ.data() : randomZ.data();
+            const char* points = coherent ? "coherent" : "random";
+
+            double ms = BestOfMs(repeats, [&]()
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    expected[i] = rowMajor.Sample(x[i], z[i]);
+                }
+            });
+            std::printf("%-10s %-9s row-major  scalar %11.2f\n", map.Name, points, ms * 1e6 / count);
+
+            heightfield.SetSimdLevel(SimdLevel::Scalar);
+            ms = BestOfMs(repeats, [&]()
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    heights[i] = heightfield.SampleHeight(x[i], z[i]);
+                }
+            });
+            bool same = std::memcmp(heights.data(), expected.data(), count * sizeof(float)) == 0;
+            std::printf("%-10s %-9s morton     scalar %11.2f  %s\n", map.Name, points, ms * 1e6 / count, same ? "yes" : "NO");
+
+            for (SimdLevel level : { SimdLevel::Sse41, SimdLevel::Avx2 })
+            {
+                heightfield.SetSimdLevel(level);
+                if (heightfield.GetSimdLevel() != level)
+                {
+                    continue;
+                }
+                ms = BestOfMs(repeats, [&]()
+                {
+                    for (size_t i = 0; i < count; i += batch)
+                    {
+                        heightfield.SampleHeights(x + i, z + i, heights.data() + i, batch);
+                    }
+                });
+                same = std::memcmp(heights.data(), expected.data(), count * sizeof(float)) == 0;
+                std::printf("%-10s %-9s morton     %-6s %11.2f  %s\n", map.Name, points,
+                            level == SimdLevel::Sse41 ? "sse41" : "avx2", ms * 1e6 / count, same ? "yes" : "NO");
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include "HeightfieldFile.h"
+#include "TiffReader.h"
+#include "Bc7Decoder.h"
+#include "DdsFile.h"
+#include "MappedFile.h"
+#include "BenchCommon.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+// Загрузка карты высот, как в TerrainApp::LoadHeightData, на Terrain/003/Height_Out:
+//   - декодирование канала R из BC7 DDS (путь без TIFF, 8 бит) в одном потоке;
+//   - чтение 16-битного TIFF полосами целиком (TiffStripReader);
+//   - конвертация TIFF -> .hfd (ConvertTiffToHeightfield), разовая цена кэша;
+//   - открытие .hfd (одно отображение) и открытие с первым проходом по всем значениям.
+// Затем конвертация 16 тайлов экспорта Gaea Terrain/001/Height во временный каталог.
+// Файлы в страничном кэше после первого прохода - замеряется разбор и копирование, а не диск.
+
+namespace
+{
+    uint64_t SumSamples(const uint16_t* samples, size_t count)
+    {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            sum += samples[i];
+        }
+        return sum;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = IsQuickRun(argc, argv);
+    const int repeats = quick ? 1 : 10;
+
+    const std::filesystem::path temp = std::filesystem::temp_directory_path() / "HeightfieldFileBench";
+    std::filesystem::create_directories(temp);
+    const std::string tiffPath = "Terrain/003/Height_Out.tif";
+    const std::string hfdPath = (temp / "Height_Out.hfd").string();
+
+    TiffStripReader reader;
+    if (!reader.Open(tiffPath))
+    {
+        std::printf("cannot open %s\n", tiffPath.c_str());
+        return 1;
+    }
+    const uint32_t width = reader.GetWidth();
+    const uint32_t height = reader.GetHeight();
+    const double megabytes = (double)width * height * sizeof(uint16_t) / (1024.0 * 1024.0);
+    std::vector<uint16_t> samples((size_t)width * height);
+    reader.Close();
+
+    std::printf("%s: %ux%u, %.2f MB of samples\n", tiffPath.c_str(), width, height, megabytes);
+    std::printf("path                          ms      MB/s   checksum\n");
+    auto report = [&](const char* name, double ms, uint64_t checksum)
+    {
+        std::printf("%-26s %8.3f %9.0f %10llu\n", name, ms, megabytes / (ms / 1000.0), (unsigned long long)checksum);
+    };
+
+    MappedFile dds;
+    DdsLayout layout;
+    if (dds.Open("Terrain/003/Height_Out.dds") && ParseDdsLayout(dds.GetData(), dds.GetSize(), layout))
+    {
+        Bc7Decoder decoder;
+        std::vector<uint8_t> channel;
+        double ms = BestOfMs(repeats, [&]() { decoder.DecodeMipChannel(layout, dds.GetData(), 0, 0, channel); });
+        uint64_t sum = 0;
+        for (uint8_t value : channel)
+        {
+            sum += value;
+        }
+        report("BC7 DDS, R channel", ms, sum);
+    }
+
+    double ms = BestOfMs(repeats, [&]()
+    {
+        reader.Open(tiffPath);
+        reader.ReadRows(0, height, samples.data());
+        reader.Close();
+    });
+    report("TIFF strips", ms, SumSamples(samples.data(), samples.size()));
+
+    bool converted = true;
+    ms = BestOfMs(repeats, [&]() { converted &= ConvertTiffToHeightfield(tiffPath, hfdPath, -1, -1, 500.0f); });
+    report("TIFF -> .hfd", ms, converted ? std::filesystem::file_size(hfdPath) : 0);
+
+    HeightfieldFile file;
+    ms = BestOfMs(repeats, [&]() { file.Open(hfdPath); file.Close(); });
+    report(".hfd open", ms, 0);
+
+    uint64_t sum = 0;
+    ms = BestOfMs(repeats, [&]()
+    {
+        file.Open(hfdPath);
+        sum = file.IsOpen() ? SumSamples(file.GetSamples(), (size_t)file.GetWidth() * file.GetHeight()) : 0;
+        file.Close();
+    });
+    report(".hfd open + read all", ms, sum);
+
+    // Тайлы Gaea: те же имена, что ищет ConvertGaeaHeightTiles, но вывод - во временный каталог
+    uint32_t tiles = 0;
+    uint64_t tileBytes = 0;
+    ms = BestOfMs(repeats, [&]()
+    {
+        tiles = 0;
+        tileBytes = 0;
+        for (int y = 0; y < TestWorld::TilesY; y++)
+        {
+            for (int x = 0; x < TestWorld::TilesX; x++)
+            {
+                std::string name = "Height_Out_y" + std::to_string(y) + "_x" + std::to_string(x);
+                std::string output = (temp / (name + ".hfd")).string();
+                if (ConvertTiffToHeightfield("Terrain/001/Height/" + name + ".tif", output, x, y, 500.0f))
+                {
+                    tiles++;
+                    tileBytes += std::filesystem::file_size(output);
+                }
+            }
+        }
+    });
+    std::printf("\nTerrain/001/Height: %u tiles -> .hfd in %.2f ms (%.0f MB/s)\n",
+                tiles, ms, tileBytes / (1024.0 * 1024.0) / (ms / 1000.0));
+
+    std::error_code error;
+    std::filesystem::remove_all(temp, error);
+    return converted && tiles > 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+#include "HeightfieldRaycast.h"
+#include "Heightfield.h"
+#include "WorkStealingPool.h"
+#include "RaycastReference.h"
+#include "BenchCommon.h"
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+// HeightfieldRaycaster (иерархия максимумов) против наивного DDA по всем ячейкам луча
+// (tests/RaycastReference.h, во float) и DDA с пропуском ячейки по максимуму её углов.
+// Наборы: лучи пикинга сверху и прямая видимость между точками в 2 единицах над землёй -
+// последние идут у самой поверхности и для иерархии самые дорогие.
+
+int main(int argc, char** argv)
+{
+    const bool quick = IsQuickRun(argc, argv);
+    const size_t count = quick ? 2000 : 100000;
+    const int repeats = quick ? 1 : 3;
+
+    std::vector<float> values;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    if (!LoadTestHeights(values, width, height))
+    {
+        std::printf("cannot load Terrain/003/Height_Out.tif\n");
+        return 1;
+    }
+    Heightfield heightfield;
+    heightfield.Build(values, width, height, TestWorld::TerrainSize, TestWorld::TerrainSize, TestWorld::HeightScale);
+
+    HeightfieldRaycaster raycaster;
+    double buildMs = BestOfMs(repeats, [&]() { raycaster.Build(heightfield); });
+    std::printf("%ux%u map, hierarchy build %.2f ms, %zu rays per set, hardware_concurrency %u\n",
+                width, height, buildMs, count, std::thread::hardware_concurrency());
+    std::printf("rays           method               ns/ray     hits\n");
+
+    std::unique_ptr<WorkStealingPool> pool;
+    if (std::thread::hardware_concurrency() > 1)
+    {
+        pool = std::make_unique<WorkStealingPool>();
+    }
+
+    struct RaySet
+    {
+        const char* Name;
+        std::vector<TerrainRay> Rays;
+    };
+    RaySet sets[] =
+    {
+        { "picking", MakePickingRays(heightfield, count, 11) },
+        { "line of sight", MakeSightRays(heightfield, count, 13) },
+    };
+
+    std::vector<float> distances(count);
+    for (const RaySet& set : sets)
+    {
+        auto countHits = [&]()
+        {
+            size_t hits = 0;
+            for (float d : distances)
+            {
+                hits += d >= 0.0f;
+            }
+            return hits;
+        };
+
+        double ms = BestOfMs(repeats, [&]() { raycaster.RaycastBatch(set.Rays.data(), distances.data(), count); });
+        std::printf("%-14s %-20s %7.0f %8zu\n", set.Name, "hierarchy", ms * 1e6 / count, countHits());
+
+        if (pool)
+        {
+            ms = BestOfMs(repeats, [&]() { raycaster.RaycastBatch(set.Rays.data(), distances.data(), count, pool.get()); });
+            std::printf("%-14s hierarchy, %2u threads %7.0f %8zu\n", set.Name, pool->GetThreadCount(), ms * 1e6 / count, countHits());
+        }
+
+        for (bool cellBounds : { false, true })
+        {
+            ms = BestOfMs(repeats, [&]()
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    float distance;
+                    distances[i] = DdaRaycast<float>(heightfield, set.Rays[i], distance, cellBounds) ? distance : -1.0f;
+                }
+            });
+            std::printf("%-14s %-20s %7.0f %8zu\n", set.Name, cellBounds ? "DDA + cell max" : "DDA",
+                        ms * 1e6 / count, countHits());
+        }
+    }
+    return 0;
+}
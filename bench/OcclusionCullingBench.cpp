@@ -0,0 +1,135 @@
+#include "QuadTree.h"
+#include "HeightPyramid.h"
+#include "Heightfield.h"
+#include "WorkStealingPool.h"
+#include "BenchCommon.h"
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+using namespace DirectX;
+
+// Доля узлов, снятых отсечением перекрытых, и цена QuadTree::Update на кадр вдоль трёх
+// записанных путей: проход по долине в 10 единицах над землёй, низкий полёт в 60 и облёт на
+// высоте 450 с камерой на центр. Четыре дерева на кадр: только пирамида видимости, плюс горизонт
+// (SetOcclusionCulling), плюс буфер глубины (SetDepthOcclusion), плюс оба. Буфер глубины
+// растеризуется на пуле из hardware_concurrency потоков.
+
+namespace
+{
+    const float RadiansToDegrees = 57.29578f;
+
+    struct Path
+    {
+        std::string Name;
+        std::vector<TestCameraPose> Poses;
+    };
+
+    std::vector<Path> MakePaths(const Heightfield& heightfield, uint32_t frameCount)
+    {
+        std::vector<Path> paths(3);
+        paths[0].Name = "valley walk (+10)";
+        paths[1].Name = "low flight (+60)";
+        paths[2].Name = "orbit (y = 450)";
+        for (uint32_t i = 0; i < frameCount; i++)
+        {
+            float t = (float)i / (frameCount - 1);
+
+            float x = 150.0f + t * 1750.0f;
+            float z = 300.0f + 600.0f * std::sin(t * 6.28f) + t * 900.0f;
+            float yaw = std::atan2(1750.0f, 600.0f * 6.28f * std::cos(t * 6.28f) + 900.0f) * RadiansToDegrees;
+            paths[0].Poses.push_back({ x, heightfield.SampleHeight(x, z) + 10.0f, z, 5.0f, yaw });
+
+            x = 1900.0f - t * 1700.0f;
+            z = 200.0f + t * 1600.0f + 150.0f * std::sin(t * 12.0f);
+            yaw = std::atan2(-1700.0f, 1600.0f + 1800.0f * std::cos(t * 12.0f)) * RadiansToDegrees;
+            paths[1].Poses.push_back({ x, heightfield.SampleHeight(x, z) + 60.0f, z, 12.0f, yaw });
+
+            float angle = t * 6.2831853f;
+            x = 1024.0f + 900.0f * std::sin(angle);
+            z = 1024.0f - 900.0f * std::cos(angle);
+            yaw = std::atan2(1024.0f - x, 1024.0f - z) * RadiansToDegrees;
+            paths[2].Poses.push_back({ x, 450.0f, z, 18.0f, yaw });
+        }
+        return paths;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = IsQuickRun(argc, argv);
+    const uint32_t frameCount = quick ? 10 : 300;
+
+    std::vector<float> values;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    if (!LoadTestHeights(values, width, height))
+    {
+        std::printf("cannot load Terrain/003/Height_Out.tif\n");
+        return 1;
+    }
+    Heightfield heightfield;
+    heightfield.Build(values, width, height, TestWorld::TerrainSize, TestWorld::TerrainSize, TestWorld::HeightScale);
+    for (float& value : values)
+    {
+        value *= TestWorld::HeightScale;
+    }
+    HeightPyramid pyramid;
+    pyramid.Build(values, width, height);
+
+    WorkStealingPool pool;
+    const std::vector<Path> paths = MakePaths(heightfield, frameCount);
+    std::printf("%u frames per path, pool of %u threads\n", frameCount, pool.GetThreadCount());
+    std::printf("depth  path               nodes   removed: horizon  depth  both   occluder tris"
+                "   us/frame: frustum  horizon   depth    both\n");
+
+    std::vector<int> depths = { 4, 6 };
+    if (quick)
+    {
+        depths = { 4 };
+    }
+    for (int depth : depths)
+    {
+        // 0 - только пирамида, 1 - горизонт, 2 - буфер глубины, 3 - оба
+        QuadTree trees[4];
+        for (int i = 0; i < 4; i++)
+        {
+            trees[i].Initialize(TestWorld::TerrainSize, depth, { 200.0f, 500.0f, 1000.0f });
+            trees[i].RefitHeights(pyramid, TestWorld::HeightBoundsMargin);
+            trees[i].SetScreenSpaceErrorParams(TestWorld::CameraFovDegrees * 3.14159265f / 180.0f,
+                                               TestWorld::ViewportHeight, TestWorld::LodPixelTolerance);
+            trees[i].ComputeGeometricErrors(pyramid, TestWorld::LodErrorGridResolution);
+            trees[i].SetSelectionMode(LODSelectionMode::ScreenSpaceError);
+            trees[i].SetOcclusionCulling((i & 1) != 0);
+            trees[i].SetDepthOcclusion((i & 2) != 0);
+            trees[i].SetParallelUpdate(&pool);
+        }
+
+        for (const Path& path : paths)
+        {
+            uint64_t nodes[4] = { 0, 0, 0, 0 };
+            double ms[4] = { 0.0, 0.0, 0.0, 0.0 };
+            uint64_t triangles = 0;
+            for (const TestCameraPose& pose : path.Poses)
+            {
+                Camera camera = MakeTestCamera(pose);
+                XMFLOAT3 position = camera.GetPosition();
+                BoundingFrustum frustum = camera.GetFrustum();
+                for (int i = 0; i < 4; i++)
+                {
+                    ms[i] += BestOfMs(1, [&]() { trees[i].Update(position, frustum); });
+                    nodes[i] += trees[i].GetVisibleNodes().size();
+                }
+                triangles += trees[2].GetCullStats().OccluderTriangles;
+            }
+
+            auto removed = [&](int i) { return nodes[0] ? 100.0 * (nodes[0] - nodes[i]) / nodes[0] : 0.0; };
+            std::printf("%5d  %-18s %6.1f %14.1f%% %5.1f%% %5.1f%% %15.0f %19.1f %8.1f %7.1f %7.1f\n",
+                        depth, path.Name.c_str(), (double)nodes[0] / frameCount, removed(1), removed(2), removed(3),
+                        (double)triangles / frameCount, ms[0] * 1000.0 / frameCount, ms[1] * 1000.0 / frameCount,
+                        ms[2] * 1000.0 / frameCount, ms[3] * 1000.0 / frameCount);
+        }
+    }
+    return 0;
+}
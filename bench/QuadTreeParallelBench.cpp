@@ -0,0 +1,116 @@
+#include "QuadTree.h"
+#include "WorkStealingPool.h"
+#include "BenchCommon.h"
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+using namespace DirectX;
+
+// Масштабирование параллельного обхода QuadTree::Update по числу потоков пула (1 - последовательный
+// обход без пула). Каждый прогон сверяет список видимых узлов с последовательным по кадрам.
+// Числа имеют смысл только на машине с соответствующим числом ядер - печатается hardware_concurrency.
+
+namespace
+{
+    struct Frame
+    {
+        XMFLOAT3 Position;
+        BoundingFrustum Frustum;
+    };
+
+    bool SameNodes(const std::vector<QuadTreeRenderNode>& a, const std::vector<QuadTreeRenderNode>& b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (a[i].NodeIndex != b[i].NodeIndex || a[i].LOD != b[i].LOD)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = IsQuickRun(argc, argv);
+    const uint32_t frameCount = quick ? 8 : 128;
+    const int repeats = quick ? 1 : 3;
+    const std::vector<float> lodDistances = { 200.0f, 500.0f, 1000.0f };
+
+    std::vector<Frame> frames;
+    for (uint32_t f = 0; f < frameCount; f++)
+    {
+        Camera camera = MakeTestCamera(FlightPathPose(f, frameCount));
+        frames.push_back({ camera.GetPosition(), camera.GetFrustum() });
+    }
+
+    std::printf("%u frames of the flight path, hardware_concurrency %u\n",
+                frameCount, std::thread::hardware_concurrency());
+    std::printf("depth  threads  us/frame  speedup  visible/frame  matches serial\n");
+
+    std::vector<int> depths = { 8, 10 };
+    std::vector<uint32_t> threadCounts = { 1, 2, 4, 8, 16 };
+    if (quick)
+    {
+        depths = { QuadTree::ParallelMinDepth };
+        threadCounts = { 1, 2 };
+    }
+
+    for (int depth : depths)
+    {
+        QuadTree tree;
+        tree.Initialize(TestWorld::TerrainSize, depth, lodDistances);
+
+        // Эталон - последовательный обход
+        std::vector<std::vector<QuadTreeRenderNode>> serial;
+        for (const Frame& frame : frames)
+        {
+            tree.Update(frame.Position, frame.Frustum);
+            serial.push_back(tree.GetVisibleNodes());
+        }
+
+        double serialMs = 0.0;
+        for (uint32_t threads : threadCounts)
+        {
+            std::unique_ptr<WorkStealingPool> pool;
+            if (threads > 1)
+            {
+                pool = std::make_unique<WorkStealingPool>(threads);
+            }
+            tree.SetParallelUpdate(pool.get());
+
+            bool matches = true;
+            uint64_t visible = 0;
+            double ms = BestOfMs(repeats, [&]()
+            {
+                visible = 0;
+                for (size_t f = 0; f < frames.size(); f++)
+                {
+                    tree.Update(frames[f].Position, frames[f].Frustum);
+                    visible += tree.GetVisibleNodes().size();
+                    matches = matches && SameNodes(tree.GetVisibleNodes(), serial[f]);
+                }
+            });
+            tree.SetParallelUpdate(nullptr);
+
+            if (threads == 1)
+            {
+                serialMs = ms;
+            }
+            std::printf("%5d %8u %9.1f %8.2f %14.1f  %s\n", depth, threads, ms * 1000.0 / frameCount,
+                        serialMs / ms, (double)visible / frameCount, matches ? "yes" : "NO");
+            if (!matches)
+            {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "QuadTree.h"
+#include "PointerQuadTree.h"
+#include "BenchCommon.h"
+#include <vector>
+#include <cstdio>
+
+using namespace DirectX;
+
+// Обход прежнего дерева на указателях (рекурсия, BoundingFrustum::Contains на узел) против
+// пула узлов с явным стеком и SoA проверкой четырёх детей, на одном и том же облёте.
+// Режимы дерева по умолчанию: LOD по расстоянию, без инкрементального и параллельного обхода.
+
+namespace
+{
+    struct Frame
+    {
+        XMFLOAT3 Position;
+        BoundingFrustum Frustum;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = IsQuickRun(argc, argv);
+    const uint32_t frameCount = quick ? 16 : 256;
+    const int repeats = quick ? 1 : 5;
+    const std::vector<float> lodDistances = { 200.0f, 500.0f, 1000.0f };
+
+    std::vector<Frame> frames;
+    for (uint32_t f = 0; f < frameCount; f++)
+    {
+        Camera camera = MakeTestCamera(FlightPathPose(f, frameCount));
+        frames.push_back({ camera.GetPosition(), camera.GetFrustum() });
+    }
+
+    std::printf("%u frames of the flight path\n", frameCount);
+    std::printf("depth      nodes  pointer tree          node pool             speedup  visible\n");
+    for (int depth : { 4, 6, 8 })
+    {
+        if (quick && depth > 6)
+        {
+            break;
+        }
+
+        PointerQuadTree pointerTree;
+        pointerTree.Initialize(TestWorld::TerrainSize, depth, lodDistances);
+        QuadTree tree;
+        tree.Initialize(TestWorld::TerrainSize, depth, lodDistances);
+
+        uint64_t pointerVisible = 0;
+        double pointerMs = BestOfMs(repeats, [&]()
+        {
+            pointerVisible = 0;
+            for (const Frame& frame : frames)
+            {
+                pointerTree.Update(frame.Position, frame.Frustum);
+                pointerVisible += pointerTree.GetVisibleNodes().size();
+            }
+        });
+
+        uint64_t poolVisible = 0;
+        double poolMs = BestOfMs(repeats, [&]()
+        {
+            poolVisible = 0;
+            for (const Frame& frame : frames)
+            {
+                tree.Update(frame.Position, frame.Frustum);
+                poolVisible += tree.GetVisibleNodes().size();
+            }
+        });
+
+        std::printf("%5d %10u  %8.2f us/frame     %8.2f us/frame     x%5.2f  %llu/%llu\n",
+                    depth, tree.GetNodeCount(),
+                    pointerMs * 1000.0 / frameCount, poolMs * 1000.0 / frameCount, pointerMs / poolMs,
+                    (unsigned long long)poolVisible, (unsigned long long)pointerVisible);
+    }
+
+    std::printf("memory per node: pointer tree %zu bytes, node pool %zu bytes (hot %zu + cold %zu)\n",
+                sizeof(PointerQuadTree::Node), sizeof(QuadTreeNodeBlock) / 4 + sizeof(QuadTreeNodeData),
+                sizeof(QuadTreeNodeBlock) / 4, sizeof(QuadTreeNodeData));
+    return 0;
+}
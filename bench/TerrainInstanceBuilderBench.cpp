@@ -0,0 +1,61 @@
+#include "TerrainInstanceBuilder.h"
+#include "QuadTree.h"
+#include "BenchCommon.h"
+#include <vector>
+#include <cstdio>
+
+using namespace DirectX;
+
+// Стоимость TerrainInstanceBuilder::Build на кадр облёта: списки видимых узлов собираются
+// заранее, замеряется только построение и группировка экземпляров.
+
+int main(int argc, char** argv)
+{
+    const bool quick = IsQuickRun(argc, argv);
+    const uint32_t frameCount = quick ? 16 : 256;
+    const int repeats = quick ? 1 : 5;
+    const std::vector<float> lodDistances = { 200.0f, 500.0f, 1000.0f };
+
+    std::printf("%u frames of the flight path\n", frameCount);
+    std::printf("depth   nodes/frame  instances/frame  build us/frame  ns/instance\n");
+    for (int depth : { 4, 6, 8 })
+    {
+        if (quick && depth > 6)
+        {
+            break;
+        }
+
+        QuadTree tree;
+        tree.Initialize(TestWorld::TerrainSize, depth, lodDistances);
+        std::vector<std::vector<QuadTreeRenderNode>> frames;
+        for (uint32_t f = 0; f < frameCount; f++)
+        {
+            Camera camera = MakeTestCamera(FlightPathPose(f, frameCount));
+            tree.Update(camera.GetPosition(), camera.GetFrustum());
+            frames.push_back(tree.GetVisibleNodes());
+        }
+
+        TerrainInstanceBuilder builder;
+        builder.Configure((float)TestWorld::TileSize, TestWorld::TilesX, TestWorld::TilesY, TestWorld::PatchesPerTile);
+
+        uint64_t nodes = 0;
+        uint64_t instances = 0;
+        double buildMs = BestOfMs(repeats, [&]()
+        {
+            nodes = 0;
+            instances = 0;
+            for (const auto& frame : frames)
+            {
+                builder.Build(tree, frame);
+                nodes += frame.size();
+                instances += builder.GetInstances().size();
+                KeepResult(builder.GetPatchCount());
+            }
+        });
+
+        std::printf("%5d %13.1f %16.1f %15.2f %12.2f\n", depth,
+                    (double)nodes / frameCount, (double)instances / frameCount,
+                    buildMs * 1000.0 / frameCount, instances ? buildMs * 1e6 / instances : 0.0);
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "TerrainTessellation.h"
+#include "TerrainInstanceBuilder.h"
+#include "QuadTree.h"
+#include "HeightPyramid.h"
+#include "WorkStealingPool.h"
+#include "TessellationReference.h"
+#include "BenchCommon.h"
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+using namespace DirectX;
+
+// TerrainTrianglePredictor (4 патча за раз на SSE) против скалярных ComputePatchTessFactors +
+// CountPatchTriangles по тем же экземплярам: эталонные камеры и 200 кадров облёта, дерево
+// настроено как в TerrainApp (глубина 4, выбор по экранной ошибке). Время - на кадр и на патч;
+// суммы треугольников печатаются, чтобы пути заведомо считали одно и то же.
+
+int main(int argc, char** argv)
+{
+    const bool quick = IsQuickRun(argc, argv);
+    const int repeats = quick ? 1 : 5;
+    const uint32_t flightFrames = quick ? 10 : 200;
+
+    std::vector<float> heights;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    if (!LoadTestWorldHeights(heights, width, height))
+    {
+        std::printf("cannot load Terrain/003/Height_Out.tif\n");
+        return 1;
+    }
+    HeightPyramid pyramid;
+    pyramid.Build(heights, width, height);
+
+    QuadTree tree;
+    tree.Initialize(TestWorld::TerrainSize, 4, { 200.0f, 500.0f, 1000.0f });
+    tree.RefitHeights(pyramid, TestWorld::HeightBoundsMargin);
+    tree.SetScreenSpaceErrorParams(TestWorld::CameraFovDegrees * 3.14159265f / 180.0f,
+                                   TestWorld::ViewportHeight, TestWorld::LodPixelTolerance);
+    tree.ComputeGeometricErrors(pyramid, TestWorld::LodErrorGridResolution);
+    tree.SetSelectionMode(LODSelectionMode::ScreenSpaceError);
+
+    TerrainInstanceBuilder instances;
+    instances.Configure((float)TestWorld::TileSize, TestWorld::TilesX, TestWorld::TilesY, TestWorld::PatchesPerTile);
+    TerrainTrianglePredictor predictor;
+
+    std::unique_ptr<WorkStealingPool> pool;
+    if (std::thread::hardware_concurrency() > 1)
+    {
+        pool = std::make_unique<WorkStealingPool>();
+    }
+
+    struct View
+    {
+        const char* Name;
+        std::vector<TestCameraPose> Poses;
+    };
+    View views[] =
+    {
+        { "reference", std::vector<TestCameraPose>(std::begin(ReferenceCameraPoses), std::end(ReferenceCameraPoses)) },
+        { "flight", {} },
+    };
+    for (uint32_t frame = 0; frame < flightFrames; frame++)
+    {
+        views[1].Poses.push_back(FlightPathPose(frame, flightFrames));
+    }
+
+    std::printf("hardware_concurrency %u\n", std::thread::hardware_concurrency());
+    std::printf("views       frames  patches/frame   method        us/frame  ns/patch   triangles/frame\n");
+    for (const View& view : views)
+    {
+        double predictorMs = 0.0, pooledMs = 0.0, scalarMs = 0.0;
+        uint64_t predictorTriangles = 0, pooledTriangles = 0, scalarTriangles = 0, patches = 0;
+        for (const TestCameraPose& pose : view.Poses)
+        {
+            Camera camera = MakeTestCamera(pose);
+            XMFLOAT3 eye = camera.GetPosition();
+            tree.Update(eye, camera.GetFrustum());
+            instances.Build(tree, tree.GetVisibleNodes());
+            patches += instances.GetPatchCount();
+
+            predictorMs += BestOfMs(repeats, [&]() { predictor.Predict(instances, eye, TestWorld::BasePatchSize); });
+            predictorTriangles += predictor.GetTotalTriangles();
+
+            if (pool)
+            {
+                pooledMs += BestOfMs(repeats, [&]() { predictor.Predict(instances, eye, TestWorld::BasePatchSize, pool.get()); });
+                pooledTriangles += predictor.GetTotalTriangles();
+            }
+
+            uint64_t triangles = 0;
+            scalarMs += BestOfMs(repeats, [&]()
+            {
+                const std::vector<TerrainInstance>& list = instances.GetInstances();
+                triangles = 0;
+                for (int grid = 0; grid < instances.GetGridCount(); grid++)
+                {
+                    uint32_t first = instances.GetGridFirstInstance(grid);
+                    for (uint32_t i = first; i < first + instances.GetGridInstanceCount(grid); i++)
+                    {
+                        triangles += ScalarGridTriangles(list[i].Origin, list[i].Scale,
+                                                         (uint32_t)instances.GetGridPatchesPerEdge(grid), eye,
+                                                         TestWorld::BasePatchSize);
+                    }
+                }
+            });
+            scalarTriangles += triangles;
+        }
+
+        const double frames = (double)view.Poses.size();
+        auto report = [&](const char* method, double ms, uint64_t triangles)
+        {
+            std::printf("%-11s %6zu %14.0f   %-12s %9.1f %9.2f %17.0f\n", view.Name, view.Poses.size(), patches / frames,
+                        method, ms * 1000.0 / frames, ms * 1e6 / patches, triangles / frames);
+        };
+        report("SSE", predictorMs, predictorTriangles);
+        if (pool)
+        {
+            report("SSE, pool", pooledMs, pooledTriangles);
+        }
+        report("scalar", scalarMs, scalarTriangles);
+    }
+    return 0;
+}
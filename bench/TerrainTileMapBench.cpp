@@ -0,0 +1,154 @@
+#include "TerrainTileMap.h"
+#include "TerrainInstanceBuilder.h"
+#include "QuadTree.h"
+#include "BenchCommon.h"
+#include <vector>
+#include <cstdio>
+
+using namespace DirectX;
+
+// Сопоставление видимых узлов тайлам и построение экземпляров на террейнах от 4x4 до 64x64 тайлов.
+// Прежнее сопоставление (каждый узел против каждого тайла, дубликаты линейным поиском по списку
+// видимых) против TerrainTileMap; рядом - TerrainInstanceBuilder::Build на тех же кадрах.
+// Облёт растянут по XZ под размер террейна, листья дерева по 128 единиц.
+
+namespace
+{
+    struct TileRecord
+    {
+        int TileX;
+        int TileY;
+    };
+
+    // Прежний TerrainApp::UpdateVisibleTiles: замкнутые интервалы, поэтому касание края тоже считается
+    void MapAllTiles(const QuadTree& tree, const std::vector<QuadTreeRenderNode>& nodes, float tileSize,
+                     std::vector<TileRecord>& tiles, std::vector<TileRecord*>& visible)
+    {
+        visible.clear();
+        for (const QuadTreeRenderNode& node : nodes)
+        {
+            BoundingBox bounds = tree.GetNodeBounds(node.NodeIndex);
+            float nodeMinX = bounds.Center.x - bounds.Extents.x;
+            float nodeMinZ = bounds.Center.z - bounds.Extents.z;
+            float nodeMaxX = bounds.Center.x + bounds.Extents.x;
+            float nodeMaxZ = bounds.Center.z + bounds.Extents.z;
+
+            for (TileRecord& tile : tiles)
+            {
+                float tileMinX = tile.TileX * tileSize;
+                float tileMinZ = tile.TileY * tileSize;
+                bool overlaps = !(nodeMaxX < tileMinX || nodeMinX > tileMinX + tileSize ||
+                                  nodeMaxZ < tileMinZ || nodeMinZ > tileMinZ + tileSize);
+                if (overlaps)
+                {
+                    bool alreadyAdded = false;
+                    for (TileRecord* t : visible)
+                    {
+                        if (t == &tile)
+                        {
+                            alreadyAdded = true;
+                            break;
+                        }
+                    }
+                    if (!alreadyAdded)
+                    {
+                        visible.push_back(&tile);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = IsQuickRun(argc, argv);
+    const uint32_t frameCount = quick ? 8 : 128;
+    const int repeats = quick ? 1 : 3;
+    const std::vector<float> lodDistances = { 200.0f, 500.0f, 1000.0f };
+    const float tileSize = (float)TestWorld::TileSize;
+
+    std::printf("%u frames of the flight path, times in us/frame\n", frameCount);
+    std::printf("tiles   depth  nodes  tiles hit   all-tiles scan   tile map  speedup   instance build\n");
+    for (int tilesPerEdge : { 4, 8, 16, 32, 64 })
+    {
+        if (quick && tilesPerEdge > 16)
+        {
+            break;
+        }
+
+        const float terrainSize = tileSize * tilesPerEdge;
+        int depth = 0;
+        while ((terrainSize / (float)(1 << depth)) > 128.0f)
+        {
+            depth++;
+        }
+
+        QuadTree tree;
+        tree.Initialize(terrainSize, depth, lodDistances);
+        std::vector<std::vector<QuadTreeRenderNode>> frames;
+        uint64_t nodes = 0;
+        for (uint32_t f = 0; f < frameCount; f++)
+        {
+            TestCameraPose pose = FlightPathPose(f, frameCount);
+            pose.X *= terrainSize / TestWorld::TerrainSize;
+            pose.Z *= terrainSize / TestWorld::TerrainSize;
+            Camera camera = MakeTestCamera(pose);
+            tree.Update(camera.GetPosition(), camera.GetFrustum());
+            frames.push_back(tree.GetVisibleNodes());
+            nodes += frames.back().size();
+        }
+
+        std::vector<TileRecord> tiles;
+        for (int y = 0; y < tilesPerEdge; y++)
+        {
+            for (int x = 0; x < tilesPerEdge; x++)
+            {
+                tiles.push_back({ x, y });
+            }
+        }
+        std::vector<TileRecord*> visible;
+        uint64_t scanTiles = 0;
+        double scanMs = BestOfMs(repeats, [&]()
+        {
+            scanTiles = 0;
+            for (const auto& frame : frames)
+            {
+                MapAllTiles(tree, frame, tileSize, tiles, visible);
+                scanTiles += visible.size();
+            }
+        });
+
+        TerrainTileMap map;
+        map.Configure(tileSize, tilesPerEdge, tilesPerEdge);
+        uint64_t mapTiles = 0;
+        double mapMs = BestOfMs(repeats, [&]()
+        {
+            mapTiles = 0;
+            for (const auto& frame : frames)
+            {
+                map.Map(tree, frame);
+                mapTiles += map.GetVisibleTiles().size();
+            }
+        });
+
+        TerrainInstanceBuilder builder;
+        builder.Configure(tileSize, tilesPerEdge, tilesPerEdge, TestWorld::PatchesPerTile);
+        double buildMs = BestOfMs(repeats, [&]()
+        {
+            for (const auto& frame : frames)
+            {
+                builder.Build(tree, frame);
+                KeepResult(builder.GetInstances().size());
+            }
+        });
+
+        // Прежний перебор захватывает ещё и тайлы, которых узлы только касаются
+        std::printf("%2dx%-2d %7d %6.0f %5.1f/%-5.1f %12.2f %10.2f %8.1f %16.2f\n",
+                    tilesPerEdge, tilesPerEdge, depth, (double)nodes / frameCount,
+                    (double)mapTiles / frameCount, (double)scanTiles / frameCount,
+                    scanMs * 1000.0 / frameCount, mapMs * 1000.0 / frameCount, scanMs / mapMs,
+                    buildMs * 1000.0 / frameCount);
+    }
+    return 0;
+}
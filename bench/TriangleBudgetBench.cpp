@@ -0,0 +1,132 @@
+#include "QuadTree.h"
+#include "HeightPyramid.h"
+#include "Heightfield.h"
+#include "TerrainInstanceBuilder.h"
+#include "TerrainTessellation.h"
+#include "BenchCommon.h"
+#include <algorithm>
+#include <cstdio>
+
+using namespace DirectX;
+
+// Выбор узлов под бюджет треугольников (LODSelectionMode::TriangleBudget) против ScreenSpaceError.
+// По эталонным камерам и камере у самой земли: узлы, разбиения, патчи и треугольники тесселяции
+// (по TerrainTrianglePredictor на построенных экземплярах) и цена Update для бюджетов 4M..500k.
+// Затем случайные низкие облёты с бюджетом 1.5M: средняя и пиковая нагрузка обоих режимов.
+
+namespace
+{
+    const uint32_t SweepBudget = 1500000;
+
+    void SetUp(QuadTree& tree, const HeightPyramid& pyramid)
+    {
+        tree.Initialize(TestWorld::TerrainSize, 4, { 200.0f, 500.0f, 1000.0f });
+        tree.RefitHeights(pyramid, TestWorld::HeightBoundsMargin);
+        tree.SetScreenSpaceErrorParams(TestWorld::CameraFovDegrees * 3.14159265f / 180.0f,
+                                       TestWorld::ViewportHeight, TestWorld::LodPixelTolerance);
+        tree.ComputeGeometricErrors(pyramid, TestWorld::LodErrorGridResolution);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = IsQuickRun(argc, argv);
+    const int repeats = quick ? 1 : 20;
+    const int sweepViews = quick ? 20 : 300;
+
+    std::vector<float> heights;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    if (!LoadTestWorldHeights(heights, width, height))
+    {
+        std::printf("cannot load Terrain/003/Height_Out.tif\n");
+        return 1;
+    }
+    HeightPyramid pyramid;
+    pyramid.Build(heights, width, height);
+    Heightfield heightfield;
+    heightfield.Build(heights, width, height, TestWorld::TerrainSize, TestWorld::TerrainSize, 1.0f);
+
+    QuadTree screenSpace;
+    QuadTree budgeted;
+    SetUp(screenSpace, pyramid);
+    SetUp(budgeted, pyramid);
+    screenSpace.SetSelectionMode(LODSelectionMode::ScreenSpaceError);
+
+    TerrainInstanceBuilder instances;
+    instances.Configure((float)TestWorld::TileSize, TestWorld::TilesX, TestWorld::TilesY, TestWorld::PatchesPerTile);
+    TerrainTrianglePredictor predictor;
+
+    std::vector<TestCameraPose> poses(std::begin(ReferenceCameraPoses), std::end(ReferenceCameraPoses));
+    poses.push_back({ 1024.0f, heightfield.SampleHeight(1024.0f, 1024.0f) + 15.0f, 1024.0f, 0.0f, 90.0f });
+
+    const uint32_t budgets[] = { 4000000, 2000000, 1000000, 500000 };
+    std::printf("camera  selection    nodes  splits  patches  triangles  exhausted  ms/update\n");
+    for (size_t i = 0; i < poses.size(); i++)
+    {
+        Camera camera = MakeTestCamera(poses[i]);
+        XMFLOAT3 eye = camera.GetPosition();
+        BoundingFrustum frustum = camera.GetFrustum();
+
+        double ms = BestOfMs(repeats, [&]() { screenSpace.Update(eye, frustum); });
+        instances.Build(screenSpace, screenSpace.GetVisibleNodes());
+        predictor.Predict(instances, eye, TestWorld::BasePatchSize);
+        std::printf("%6zu  %-11s %6zu %7s %8u %10llu %10s %10.3f\n", i, "SSE", screenSpace.GetVisibleNodes().size(), "-",
+                    predictor.GetPatchCount(), (unsigned long long)predictor.GetTotalTriangles(), "-", ms);
+
+        for (uint32_t budget : budgets)
+        {
+            budgeted.SetTriangleBudget(budget, UINT32_MAX, TestWorld::BasePatchSize);
+            ms = BestOfMs(repeats, [&]() { budgeted.Update(eye, frustum); });
+            const QuadTreeCullStats& stats = budgeted.GetCullStats();
+            instances.Build(budgeted, budgeted.GetVisibleNodes());
+            predictor.Predict(instances, eye, TestWorld::BasePatchSize);
+            std::printf("%6zu  budget %4.1fM %6zu %7u %8u %10llu %10s %10.3f\n", i, budget / 1e6,
+                        budgeted.GetVisibleNodes().size(), stats.BudgetSplits, predictor.GetPatchCount(),
+                        (unsigned long long)predictor.GetTotalTriangles(), stats.BudgetExhausted ? "yes" : "no", ms);
+        }
+    }
+
+    // Низкие облёты с наклоном вниз: пиковая нагрузка ScreenSpaceError против бюджета
+    budgeted.SetTriangleBudget(SweepBudget, UINT32_MAX, TestWorld::BasePatchSize);
+    TestRandom random(3);
+    uint64_t screenSpaceSum = 0, screenSpacePeak = 0, budgetedSum = 0, budgetedPeak = 0;
+    int overBudget = 0;
+    int screenSpaceOver = 0;
+    double screenSpaceMs = 0.0, budgetedMs = 0.0;
+    for (int view = 0; view < sweepViews; view++)
+    {
+        TestCameraPose pose;
+        pose.X = random.Uniform(24.0f, TestWorld::TerrainSize - 24.0f);
+        pose.Z = random.Uniform(24.0f, TestWorld::TerrainSize - 24.0f);
+        pose.Y = heightfield.SampleHeight(pose.X, pose.Z) + 5.0f + random.Uniform(0.0f, 1.0f) * random.Uniform(0.0f, 800.0f);
+        pose.Pitch = random.Uniform(-10.0f, 30.0f);
+        pose.Yaw = random.Uniform(0.0f, 360.0f);
+        Camera camera = MakeTestCamera(pose);
+        XMFLOAT3 eye = camera.GetPosition();
+        BoundingFrustum frustum = camera.GetFrustum();
+
+        screenSpaceMs += BestOfMs(1, [&]() { screenSpace.Update(eye, frustum); });
+        instances.Build(screenSpace, screenSpace.GetVisibleNodes());
+        predictor.Predict(instances, eye, TestWorld::BasePatchSize);
+        uint64_t triangles = predictor.GetTotalTriangles();
+        screenSpaceSum += triangles;
+        screenSpacePeak = std::max(screenSpacePeak, triangles);
+        screenSpaceOver += triangles > SweepBudget;
+
+        budgetedMs += BestOfMs(1, [&]() { budgeted.Update(eye, frustum); });
+        instances.Build(budgeted, budgeted.GetVisibleNodes());
+        predictor.Predict(instances, eye, TestWorld::BasePatchSize);
+        triangles = predictor.GetTotalTriangles();
+        budgetedSum += triangles;
+        budgetedPeak = std::max(budgetedPeak, triangles);
+        overBudget += triangles > SweepBudget;
+    }
+    std::printf("\n%d low views, budget %.1fM triangles\n", sweepViews, SweepBudget / 1e6);
+    std::printf("selection    mean tris   peak tris  over budget  ms/update\n");
+    std::printf("%-11s %10llu %11llu %12d %10.3f\n", "SSE", (unsigned long long)(screenSpaceSum / sweepViews),
+                (unsigned long long)screenSpacePeak, screenSpaceOver, screenSpaceMs / sweepViews);
+    std::printf("%-11s %10llu %11llu %12d %10.3f\n", "budget", (unsigned long long)(budgetedSum / sweepViews),
+                (unsigned long long)budgetedPeak, overBudget, budgetedMs / sweepViews);
+    return 0;
+}
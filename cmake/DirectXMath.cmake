@@ -0,0 +1,47 @@
+# Provides the header-only target `DirectXMath` (DirectXMath.h, DirectXCollision.h).
+#
+# Pass -DDIRECTXMATH_INCLUDE_DIR=<dir> to use an installed copy (vcpkg, a Windows SDK
+# checkout, a distro package). Otherwise the headers are fetched from GitHub.
+# Outside Windows DirectXMath also needs <sal.h>; pass -DSAL_INCLUDE_DIR=<dir> or let
+# it be downloaded from dotnet/runtime, as the vcpkg port does.
+
+set(DIRECTXMATH_GIT_TAG "may2024" CACHE STRING "DirectXMath release tag to fetch when no local copy is found")
+set(SAL_HEADER_URL "https://raw.githubusercontent.com/dotnet/runtime/v8.0.1/src/coreclr/pal/inc/rt/sal.h"
+    CACHE STRING "sal.h to download for non-Windows builds")
+
+find_path(DIRECTXMATH_INCLUDE_DIR DirectXMath.h PATH_SUFFIXES directxmath DirectXMath)
+
+if(NOT DIRECTXMATH_INCLUDE_DIR)
+  include(FetchContent)
+  FetchContent_Declare(directxmath
+    GIT_REPOSITORY https://github.com/microsoft/DirectXMath.git
+    GIT_TAG ${DIRECTXMATH_GIT_TAG}
+    GIT_SHALLOW TRUE)
+  FetchContent_GetProperties(directxmath)
+  if(NOT directxmath_POPULATED)
+    message(STATUS "DirectXMath not found locally, fetching ${DIRECTXMATH_GIT_TAG}")
+    FetchContent_Populate(directxmath)
+  endif()
+  set(DIRECTXMATH_INCLUDE_DIR "${directxmath_SOURCE_DIR}/Inc" CACHE PATH "DirectXMath headers" FORCE)
+endif()
+
+add_library(DirectXMath INTERFACE)
+target_include_directories(DirectXMath SYSTEM INTERFACE "${DIRECTXMATH_INCLUDE_DIR}")
+
+if(NOT WIN32)
+  find_path(SAL_INCLUDE_DIR sal.h HINTS "${DIRECTXMATH_INCLUDE_DIR}")
+  if(NOT SAL_INCLUDE_DIR)
+    set(_sal_dir "${CMAKE_BINARY_DIR}/_deps/sal")
+    if(NOT EXISTS "${_sal_dir}/sal.h")
+      message(STATUS "sal.h not found locally, downloading ${SAL_HEADER_URL}")
+      file(DOWNLOAD "${SAL_HEADER_URL}" "${_sal_dir}/sal.h" STATUS _sal_status)
+      list(GET _sal_status 0 _sal_code)
+      if(NOT _sal_code EQUAL 0)
+        file(REMOVE "${_sal_dir}/sal.h")
+        message(FATAL_ERROR "Could not download sal.h (${_sal_status}); pass -DSAL_INCLUDE_DIR=<dir>")
+      endif()
+    endif()
+    set(SAL_INCLUDE_DIR "${_sal_dir}" CACHE PATH "Directory with sal.h" FORCE)
+  endif()
+  target_include_directories(DirectXMath SYSTEM INTERFACE "${SAL_INCLUDE_DIR}")
+endif()
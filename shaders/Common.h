@@ -2,9 +2,18 @@
 
 struct VertexIn
 {
-  float3 positionWorld : POSITION;
-  float2 texCoord : TEXCOORD0;      // Global coords for heightmap
-  float2 localTexCoord : TEXCOORD1; // Local coords for color texture
+#ifdef COMPACT_VERTEX
+  uint2 gridPos : POSITION;                      // Unit grid position, 1.15 fixed point (32768 = 1.0)
+#else
+  float2 gridPos : POSITION;                     // Unit grid position (0..1) within the instance
+#endif
+
+  // Per-instance data
+  float2 instanceOrigin : INSTANCE_ORIGIN;       // World XZ of the instance corner
+  float instanceScale : INSTANCE_SCALE;          // World size of the instance
+  uint textureSlot : INSTANCE_TEXSLOT;           // Color texture of the tile
+  float4 heightTexRect : INSTANCE_HEIGHTRECT;    // Heightmap coords: (u0, v0, du, dv)
+  float4 colorTexRect : INSTANCE_COLORRECT;      // Color texture coords: (u0, v0, du, dv)
 };
 
 
@@ -13,6 +22,7 @@ struct HullIn
   float3 positionWorld : POSITION;
   float2 texCoord : TEXCOORD0;
   float2 localTexCoord : TEXCOORD1;
+  uint textureSlot : TEXSLOT;
 };
 
 struct DomainIn
@@ -20,6 +30,7 @@ struct DomainIn
   float3 positionWorld : POSITION;
   float2 texCoord : TEXCOORD0;
   float2 localTexCoord : TEXCOORD1;
+  uint textureSlot : TEXSLOT;
 };
 
 struct PixelIn
@@ -29,6 +40,7 @@ struct PixelIn
   float2 texCoord : TEXCOORD0;      // Global coords (for heightmap)
   float2 localTexCoord : TEXCOORD1; // Local coords (for color texture)
   float3 normal : NORMAL;
+  nointerpolation uint textureSlot : TEXSLOT;
 };
 
 struct PatchTess
@@ -13,7 +13,7 @@ cbuffer PassConstants : register(b0)
   float gTotalTime;
   float gDeltaTime;
   float gHeightScale;
-  float gPadding2;
+  float gBasePatchSize;
 };
 
 Texture2D heightMap : register(t0);
@@ -42,6 +42,9 @@ PixelIn DS(PatchTess patchTess, float2 uv : SV_DomainLocation, const OutputPatch
 		lerp(quad[2].localTexCoord, quad[3].localTexCoord, uv.x),
 		uv.y);
 
+  // The whole patch belongs to one instance
+  output.textureSlot = quad[0].textureSlot;
+
   // Sample heightmap and displace vertex
   float height = heightMap.SampleLevel(heightSampler, output.texCoord, 0).r;
   output.positionWorld.y = height * gHeightScale; // Use height scale from constant buffer
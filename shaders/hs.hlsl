@@ -13,7 +13,7 @@ cbuffer PassConstants : register(b0)
   float gTotalTime;
   float gDeltaTime;
   float gHeightScale;
-  float gPadding2;
+  float gBasePatchSize;
 };
 
 // LOD параметры - настрой под свои нужды
@@ -36,6 +36,13 @@ float CalcTessFactor(float3 p)
   return max(1.0f, tess);
 }
 
+// Длина ребра в базовых патчах. Патчи грубых LOD длиннее, и их фактор растёт пропорционально,
+// чтобы общее ребро соседних узлов разной плотности делилось примерно одинаково
+float EdgeScale(float3 a, float3 b)
+{
+  return distance(a.xz, b.xz) / gBasePatchSize;
+}
+
 PatchTess ConstantHS(InputPatch<HullIn, 4> patch, uint patchID : SV_PrimitiveID)
 {
   PatchTess pt;
@@ -48,12 +55,12 @@ PatchTess ConstantHS(InputPatch<HullIn, 4> patch, uint patchID : SV_PrimitiveID)
   float3 c = 0.25f * (patch[0].positionWorld + patch[1].positionWorld + patch[2].positionWorld + patch[3].positionWorld);
 
   // Calculate tessellation for each edge
-  pt.edgeTess[0] = CalcTessFactor(e0);
-  pt.edgeTess[1] = CalcTessFactor(e1);
-  pt.edgeTess[2] = CalcTessFactor(e2);
-  pt.edgeTess[3] = CalcTessFactor(e3);
+  pt.edgeTess[0] = min(CalcTessFactor(e0) * EdgeScale(patch[0].positionWorld, patch[2].positionWorld), 64.0f);
+  pt.edgeTess[1] = min(CalcTessFactor(e1) * EdgeScale(patch[0].positionWorld, patch[1].positionWorld), 64.0f);
+  pt.edgeTess[2] = min(CalcTessFactor(e2) * EdgeScale(patch[1].positionWorld, patch[3].positionWorld), 64.0f);
+  pt.edgeTess[3] = min(CalcTessFactor(e3) * EdgeScale(patch[2].positionWorld, patch[3].positionWorld), 64.0f);
 
-  pt.insideTess[0] = CalcTessFactor(c);
+  pt.insideTess[0] = min(CalcTessFactor(c) * EdgeScale(patch[0].positionWorld, patch[1].positionWorld), 64.0f);
   pt.insideTess[1] = pt.insideTess[0];
 
   return pt;
@@ -72,6 +79,7 @@ DomainIn HS(InputPatch<HullIn, 4> p, uint i : SV_OutputControlPointID, uint patc
   output.positionWorld = p[i].positionWorld;
   output.texCoord = p[i].texCoord;
   output.localTexCoord = p[i].localTexCoord;
+  output.textureSlot = p[i].textureSlot;
 
   return output;
 }
@@ -1,12 +1,12 @@
 #include "Common.h"
 
-Texture2D colorTexture : register(t1);  // Color texture at t1 (heightmap is at t0)
+Texture2D colorTextures[16] : register(t1);  // Color textures of all tiles from t1 (heightmap is at t0)
 SamplerState samplerState : register(s0);
 
 float4 PS(PixelIn input) : SV_TARGET
 {
-  // Sample the color texture using local coordinates
-  float4 textureColor = colorTexture.Sample(samplerState, input.localTexCoord);
+  // Sample the tile's color texture using local coordinates
+  float4 textureColor = colorTextures[NonUniformResourceIndex(input.textureSlot)].Sample(samplerState, input.localTexCoord);
   
   // Use normal from domain shader (calculated from heightmap)
   float3 normal = normalize(input.normal);
@@ -4,9 +4,19 @@ HullIn VS(VertexIn input)
 {
   HullIn output;
 
-  output.positionWorld = input.positionWorld.xyz;
-  output.texCoord = input.texCoord;           // Global coords for heightmap
-  output.localTexCoord = input.localTexCoord; // Local coords for color texture
+#ifdef COMPACT_VERTEX
+  // Exact for power-of-two grids, matches DecodeTerrainVertex on the CPU
+  float2 gridPos = float2(input.gridPos) * (1.0f / 32768.0f);
+#else
+  float2 gridPos = input.gridPos;
+#endif
+
+  // Stretch the shared unit grid over the instance
+  output.positionWorld = float3(input.instanceOrigin.x + gridPos.x * input.instanceScale, 0.0f,
+                                input.instanceOrigin.y + gridPos.y * input.instanceScale);
+  output.texCoord = input.heightTexRect.xy + gridPos * input.heightTexRect.zw;     // Global coords for heightmap
+  output.localTexCoord = input.colorTexRect.xy + gridPos * input.colorTexRect.zw;  // Local coords for color texture
+  output.textureSlot = input.textureSlot;
 
   return output;
 }
\ No newline at end of file
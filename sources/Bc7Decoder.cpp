@@ -0,0 +1,585 @@
+#include "Bc7Decoder.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Декодирование в RGBA - все четыре канала
+    const uint32_t AllChannels = 4;
+
+    // Строк блоков в одной задаче пула: 512x512 делится на 32 задачи
+    const uint32_t BlockRowsPerTask = 4;
+
+    struct ModeInfo
+    {
+        uint8_t Subsets;
+        uint8_t PartitionBits;
+        uint8_t RotationBits;
+        uint8_t IndexSelectionBits;
+        uint8_t ColorBits;
+        uint8_t AlphaBits;
+        uint8_t EndpointPBits;     // По p-биту на каждый конец
+        uint8_t SharedPBits;       // Один p-бит на оба конца подмножества
+        uint8_t IndexBits;
+        uint8_t IndexBits2;        // Второй набор индексов (режимы 4 и 5)
+    };
+
+    constexpr ModeInfo Modes[8] =
+    {
+        { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+        { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+        { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+        { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+        { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+        { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+        { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+        { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+    };
+
+    // Разбиения на два подмножества: бит i - подмножество пикселя i (строка за строкой)
+    const uint16_t Partitions2[64] =
+    {
+        0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+        0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+        0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+        0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+        0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+        0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+        0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+        0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+    };
+
+    // Разбиения на три подмножества: по два бита на пиксель
+    const uint32_t Partitions3[64] =
+    {
+        0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+        0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+        0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+        0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+        0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+        0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+        0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+        0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254,
+    };
+
+    // Опорные пиксели подмножеств 1 (и 2): их индекс короче на старший бит, равный нулю
+    const uint8_t Anchors2[64] =
+    {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+        15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+         6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+    };
+
+    const uint8_t Anchors3Second[64] =
+    {
+         3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+         3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+         8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+         3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+    };
+
+    const uint8_t Anchors3Third[64] =
+    {
+        15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+        15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+        15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+        15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+    };
+
+    const uint8_t Weights2[4] = { 0, 21, 43, 64 };
+    const uint8_t Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const uint8_t Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    const uint8_t* GetWeights(uint32_t indexBits)
+    {
+        return indexBits == 2 ? Weights2 : (indexBits == 3 ? Weights3 : Weights4);
+    }
+
+    // Маски разбиений, развёрнутые в байт подмножества на пиксель: [подмножеств - 2][разбиение]
+    struct PartitionTable
+    {
+        uint8_t Subsets[2][64][16];
+
+        PartitionTable()
+        {
+            for (uint32_t partition = 0; partition < 64; partition++)
+            {
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    Subsets[0][partition][i] = (uint8_t)((Partitions2[partition] >> i) & 1);
+                    Subsets[1][partition][i] = (uint8_t)((Partitions3[partition] >> (2 * i)) & 3);
+                }
+            }
+        }
+    };
+
+    const PartitionTable PartitionSubsets;
+
+    // Номер младшего единичного бита полубайта
+    const uint8_t LowestBit[16] = { 0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0 };
+
+    // Чтение 128-битного блока с младших битов
+    class BitReader
+    {
+    public:
+        explicit BitReader(const uint8_t* block)
+        {
+            mLow = 0;
+            mHigh = 0;
+            for (int i = 7; i >= 0; i--)
+            {
+                mLow = (mLow << 8) | block[i];
+                mHigh = (mHigh << 8) | block[i + 8];
+            }
+        }
+
+        // 0 < count < 64
+        uint32_t Read(uint32_t count)
+        {
+            if (count == 0)
+            {
+                return 0;
+            }
+            uint32_t value = (uint32_t)(mLow & ((1ull << count) - 1));
+            Skip(count);
+            return value;
+        }
+
+        void Skip(uint32_t count)
+        {
+            mLow = (mLow >> count) | (mHigh << (64 - count));
+            mHigh >>= count;
+        }
+
+        // Следующие 64 бита без сдвига
+        uint64_t Peek() const { return mLow; }
+
+    private:
+        uint64_t mLow;
+        uint64_t mHigh;
+    };
+
+    // Разобранный блок. Концы подмножеств лежат таблицей [подмножество * 4 + канал] -
+    // её читает pshufb, - уже с учётом поворота каналов. AlphaChannel - канал, который
+    // интерполируется весом альфы (3 без поворота).
+    // Итог канала - ((64 - w) * e0 + w * e1 + 32) >> 6 для всех режимов.
+    struct alignas(16) BlockParams
+    {
+        uint8_t Endpoints0[16];
+        uint8_t Endpoints1[16];
+        uint8_t Subsets[16];
+        uint8_t ColorWeights[16];
+        uint8_t AlphaWeights[16];
+        uint32_t AlphaChannel;
+    };
+
+    // Квантованное значение с p-битом или без - в 8 бит повторением старших битов
+    uint8_t ExpandEndpoint(uint32_t value, uint32_t bits)
+    {
+        value <<= 8 - bits;
+        return (uint8_t)(value | (value >> bits));
+    }
+
+    // Разбор блока известного режима: все размеры полей - константы, и циклы разворачиваются
+    // без ветвлений, зависящих от данных
+    template <uint32_t Mode>
+    void ParseMode(BitReader& reader, BlockParams& params)
+    {
+        constexpr ModeInfo info = Modes[Mode];
+        constexpr uint32_t subsets = info.Subsets;
+
+        uint32_t partition = reader.Read(info.PartitionBits);
+        uint32_t rotation = reader.Read(info.RotationBits);
+        uint32_t indexSelection = reader.Read(info.IndexSelectionBits);
+
+        // [подмножество][конец][канал]
+        uint32_t endpoints[subsets][2][4];
+        for (uint32_t channel = 0; channel < 3; channel++)
+        {
+            for (uint32_t s = 0; s < subsets; s++)
+            {
+                endpoints[s][0][channel] = reader.Read(info.ColorBits);
+                endpoints[s][1][channel] = reader.Read(info.ColorBits);
+            }
+        }
+        for (uint32_t s = 0; s < subsets; s++)
+        {
+            endpoints[s][0][3] = reader.Read(info.AlphaBits);
+            endpoints[s][1][3] = reader.Read(info.AlphaBits);
+        }
+
+        constexpr bool hasPBits = info.EndpointPBits || info.SharedPBits;
+        constexpr uint32_t colorBits = info.ColorBits + (hasPBits ? 1 : 0);
+        constexpr uint32_t alphaBits = info.AlphaBits + ((hasPBits && info.AlphaBits) ? 1 : 0);
+        if (hasPBits)
+        {
+            for (uint32_t s = 0; s < subsets; s++)
+            {
+                uint32_t pbit0 = reader.Read(1);
+                uint32_t pbit1 = info.SharedPBits ? pbit0 : reader.Read(1);
+                for (uint32_t channel = 0; channel < 4; channel++)
+                {
+                    endpoints[s][0][channel] = (endpoints[s][0][channel] << 1) | pbit0;
+                    endpoints[s][1][channel] = (endpoints[s][1][channel] << 1) | pbit1;
+                }
+            }
+        }
+
+        // Поворот меняет альфу с одним из цветовых каналов после интерполяции -
+        // то же самое, что поменять их в концах заранее и интерполировать тот канал весом альфы
+        params.AlphaChannel = rotation == 0 ? 3 : rotation - 1;
+        memset(params.Endpoints0, 0, sizeof(params.Endpoints0));
+        memset(params.Endpoints1, 0, sizeof(params.Endpoints1));
+        for (uint32_t s = 0; s < subsets; s++)
+        {
+            uint8_t* ends[2] = { &params.Endpoints0[s * 4], &params.Endpoints1[s * 4] };
+            for (uint32_t e = 0; e < 2; e++)
+            {
+                for (uint32_t channel = 0; channel < 3; channel++)
+                {
+                    ends[e][channel] = ExpandEndpoint(endpoints[s][e][channel], colorBits);
+                }
+                ends[e][3] = alphaBits ? ExpandEndpoint(endpoints[s][e][3], alphaBits) : 255;
+                if (rotation != 0)
+                {
+                    std::swap(ends[e][rotation - 1], ends[e][3]);
+                }
+            }
+        }
+
+        uint32_t anchor1 = 16;
+        uint32_t anchor2 = 16;
+        if (subsets == 1)
+        {
+            memset(params.Subsets, 0, sizeof(params.Subsets));
+        }
+        else
+        {
+            memcpy(params.Subsets, PartitionSubsets.Subsets[subsets - 2][partition], sizeof(params.Subsets));
+            anchor1 = subsets == 2 ? Anchors2[partition] : Anchors3Second[partition];
+            anchor2 = subsets == 2 ? 16 : Anchors3Third[partition];
+        }
+
+        // Каждый набор индексов - не больше 63 бит (16 * 4 - 1), так что он целиком
+        // берётся одним 64-битным словом и разбирается без 128-битных сдвигов
+        const uint8_t* weights = GetWeights(info.IndexBits);
+        uint64_t indexBits = reader.Peek();
+        uint32_t indexBitCount = 0;
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            uint32_t bits = info.IndexBits - ((i == 0 || i == anchor1 || i == anchor2) ? 1 : 0);
+            params.ColorWeights[i] = weights[indexBits & ((1u << bits) - 1)];
+            indexBits >>= bits;
+            indexBitCount += bits;
+        }
+
+        if (info.IndexBits2 == 0)
+        {
+            memcpy(params.AlphaWeights, params.ColorWeights, sizeof(params.AlphaWeights));
+            return;
+        }
+
+        // Режимы 4 и 5: второй набор - альфа, или цвет, если выбран битом indexSelection
+        reader.Skip(indexBitCount);
+        indexBits = reader.Peek();
+        weights = GetWeights(info.IndexBits2);
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            uint32_t bits = info.IndexBits2 - (i == 0 ? 1 : 0);
+            params.AlphaWeights[i] = weights[indexBits & ((1u << bits) - 1)];
+            indexBits >>= bits;
+        }
+        if (indexSelection)
+        {
+            std::swap(params.ColorWeights, params.AlphaWeights);
+        }
+    }
+
+    void ParseBlock(const uint8_t* block, BlockParams& params)
+    {
+        // Режим - номер младшего единичного бита; блок без него недопустим и даёт нули
+        uint32_t modeByte = block[0];
+        if (modeByte == 0)
+        {
+            memset(&params, 0, sizeof(params));
+            params.AlphaChannel = 3;
+            return;
+        }
+
+        uint32_t mode = (modeByte & 15) ? LowestBit[modeByte & 15] : 4 + LowestBit[modeByte >> 4];
+        BitReader reader(block);
+        reader.Skip(mode + 1);
+        switch (mode)
+        {
+        case 0: ParseMode<0>(reader, params); break;
+        case 1: ParseMode<1>(reader, params); break;
+        case 2: ParseMode<2>(reader, params); break;
+        case 3: ParseMode<3>(reader, params); break;
+        case 4: ParseMode<4>(reader, params); break;
+        case 5: ParseMode<5>(reader, params); break;
+        case 6: ParseMode<6>(reader, params); break;
+        default: ParseMode<7>(reader, params); break;
+        }
+    }
+
+    void DecodeBlockScalar(const uint8_t* block, uint8_t* rgba)
+    {
+        BlockParams params;
+        ParseBlock(block, params);
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            const uint8_t* e0 = &params.Endpoints0[params.Subsets[i] * 4];
+            const uint8_t* e1 = &params.Endpoints1[params.Subsets[i] * 4];
+            for (uint32_t channel = 0; channel < 4; channel++)
+            {
+                uint32_t weight = channel == params.AlphaChannel ? params.AlphaWeights[i] : params.ColorWeights[i];
+                rgba[i * 4 + channel] = (uint8_t)(((64 - weight) * e0[channel] + weight * e1[channel] + 32) >> 6);
+            }
+        }
+    }
+
+#ifdef CPU_X86
+    // Перестановки pshufb для четырёх пикселей. Веса идут парами (цвет, альфа) на пиксель,
+    // [канал альфы][байт] выбирает из пары вес каждого канала.
+    alignas(16) const uint8_t WeightShuffles[4][16] =
+    {
+        { 1, 0, 0, 0, 3, 2, 2, 2, 5, 4, 4, 4, 7, 6, 6, 6 },
+        { 0, 1, 0, 0, 2, 3, 2, 2, 4, 5, 4, 4, 6, 7, 6, 6 },
+        { 0, 0, 1, 0, 2, 2, 3, 2, 4, 4, 5, 4, 6, 6, 7, 6 },
+        { 0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7 },
+    };
+
+    // Подмножество пикселя - на все четыре его канала, плюс номер канала
+    alignas(16) const uint8_t SubsetShuffle[16] = { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3 };
+    alignas(16) const uint8_t ChannelOffsets[16] = { 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3 };
+
+    // Четыре пикселя за итерацию: концы выбираются pshufb из таблицы подмножеств, веса -
+    // из пар (цвет, альфа); pmaddubsw сразу даёт e0 * (64 - w) + e1 * w (не больше 16320).
+    CPU_TARGET_SSE41 void DecodeBlockSse41(const uint8_t* block, uint8_t* rgba)
+    {
+        BlockParams params;
+        ParseBlock(block, params);
+
+        const __m128i endpoints0 = _mm_load_si128(reinterpret_cast<const __m128i*>(params.Endpoints0));
+        const __m128i endpoints1 = _mm_load_si128(reinterpret_cast<const __m128i*>(params.Endpoints1));
+        const __m128i subsets = _mm_load_si128(reinterpret_cast<const __m128i*>(params.Subsets));
+        const __m128i colorWeights = _mm_load_si128(reinterpret_cast<const __m128i*>(params.ColorWeights));
+        const __m128i alphaWeights = _mm_load_si128(reinterpret_cast<const __m128i*>(params.AlphaWeights));
+        const __m128i weightShuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(WeightShuffles[params.AlphaChannel]));
+        const __m128i subsetShuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(SubsetShuffle));
+        const __m128i channelOffsets = _mm_load_si128(reinterpret_cast<const __m128i*>(ChannelOffsets));
+        const __m128i four = _mm_set1_epi8(4);
+        const __m128i full = _mm_set1_epi8(64);
+        const __m128i round = _mm_set1_epi16(32);
+
+        __m128i weightPairs[2] = { _mm_unpacklo_epi8(colorWeights, alphaWeights),
+                                   _mm_unpackhi_epi8(colorWeights, alphaWeights) };
+        __m128i pixelShuffle = subsetShuffle;
+        for (uint32_t group = 0; group < 4; group++)
+        {
+            __m128i subsetBytes = _mm_shuffle_epi8(subsets, pixelShuffle);
+            __m128i endpointIndex = _mm_add_epi8(_mm_slli_epi16(subsetBytes, 2), channelOffsets);
+            __m128i e0 = _mm_shuffle_epi8(endpoints0, endpointIndex);
+            __m128i e1 = _mm_shuffle_epi8(endpoints1, endpointIndex);
+            pixelShuffle = _mm_add_epi8(pixelShuffle, four);
+
+            __m128i pairs = (group & 1) ? _mm_srli_si128(weightPairs[group >> 1], 8) : weightPairs[group >> 1];
+            __m128i w = _mm_shuffle_epi8(pairs, weightShuffle);
+            __m128i invW = _mm_sub_epi8(full, w);
+
+            __m128i low = _mm_maddubs_epi16(_mm_unpacklo_epi8(e0, e1), _mm_unpacklo_epi8(invW, w));
+            __m128i high = _mm_maddubs_epi16(_mm_unpackhi_epi8(e0, e1), _mm_unpackhi_epi8(invW, w));
+            low = _mm_srli_epi16(_mm_add_epi16(low, round), 6);
+            high = _mm_srli_epi16(_mm_add_epi16(high, round), 6);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + group * 16), _mm_packus_epi16(low, high));
+        }
+    }
+
+    // То же по восемь пикселей: таблицы повторены в обеих 128-битных половинах, младшая
+    // половина берёт пиксели 0-3 группы, старшая - 4-7. unpack и packus работают внутри
+    // половин, поэтому порядок байт на выходе совпадает со входом.
+    CPU_TARGET_AVX2 void DecodeBlockAvx2(const uint8_t* block, uint8_t* rgba)
+    {
+        BlockParams params;
+        ParseBlock(block, params);
+
+        const __m256i endpoints0 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(params.Endpoints0)));
+        const __m256i endpoints1 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(params.Endpoints1)));
+        const __m256i subsets = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(params.Subsets)));
+        const __m128i colorWeights = _mm_load_si128(reinterpret_cast<const __m128i*>(params.ColorWeights));
+        const __m128i alphaWeights = _mm_load_si128(reinterpret_cast<const __m128i*>(params.AlphaWeights));
+        const __m256i weightShuffle = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(WeightShuffles[params.AlphaChannel])));
+        const __m256i channelOffsets = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(ChannelOffsets)));
+        const __m128i subsetShuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(SubsetShuffle));
+        const __m256i eight = _mm256_set1_epi8(8);
+        const __m256i full = _mm256_set1_epi8(64);
+        const __m256i round = _mm256_set1_epi16(32);
+
+        __m256i pixelShuffle = _mm256_inserti128_si256(_mm256_castsi128_si256(subsetShuffle),
+                                                       _mm_add_epi8(subsetShuffle, _mm_set1_epi8(4)), 1);
+        __m128i weightPairs[2] = { _mm_unpacklo_epi8(colorWeights, alphaWeights),
+                                   _mm_unpackhi_epi8(colorWeights, alphaWeights) };
+        for (uint32_t half = 0; half < 2; half++)
+        {
+            __m256i subsetBytes = _mm256_shuffle_epi8(subsets, pixelShuffle);
+            __m256i endpointIndex = _mm256_add_epi8(_mm256_slli_epi16(subsetBytes, 2), channelOffsets);
+            __m256i e0 = _mm256_shuffle_epi8(endpoints0, endpointIndex);
+            __m256i e1 = _mm256_shuffle_epi8(endpoints1, endpointIndex);
+            pixelShuffle = _mm256_add_epi8(pixelShuffle, eight);
+
+            __m256i pairs = _mm256_inserti128_si256(_mm256_castsi128_si256(weightPairs[half]),
+                                                    _mm_srli_si128(weightPairs[half], 8), 1);
+            __m256i w = _mm256_shuffle_epi8(pairs, weightShuffle);
+            __m256i invW = _mm256_sub_epi8(full, w);
+
+            __m256i low = _mm256_maddubs_epi16(_mm256_unpacklo_epi8(e0, e1), _mm256_unpacklo_epi8(invW, w));
+            __m256i high = _mm256_maddubs_epi16(_mm256_unpackhi_epi8(e0, e1), _mm256_unpackhi_epi8(invW, w));
+            low = _mm256_srli_epi16(_mm256_add_epi16(low, round), 6);
+            high = _mm256_srli_epi16(_mm256_add_epi16(high, round), 6);
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + half * 32), _mm256_packus_epi16(low, high));
+        }
+    }
+
+#endif
+
+    void CopyBlockRows(const uint8_t* decoded, uint32_t channel, uint32_t columns, uint32_t rows,
+                       uint8_t* output, size_t outputRowPitch)
+    {
+        for (uint32_t y = 0; y < rows; y++)
+        {
+            uint8_t* row = output + y * outputRowPitch;
+            if (channel == AllChannels)
+            {
+                memcpy(row, decoded + y * 16, columns * 4);
+                continue;
+            }
+            for (uint32_t x = 0; x < columns; x++)
+            {
+                row[x] = decoded[y * 16 + x * 4 + channel];
+            }
+        }
+    }
+}
+
+bool IsBc7Format(uint32_t dxgiFormat)
+{
+    return dxgiFormat >= 97 && dxgiFormat <= 99;
+}
+
+Bc7Decoder::Bc7Decoder(SimdLevel level)
+    : mLevel(SimdLevel::Scalar), mDecode(DecodeBlockScalar)
+{
+    SetSimdLevel(level);
+}
+
+void Bc7Decoder::SetSimdLevel(SimdLevel level)
+{
+    mLevel = std::min(level, GetSupportedSimdLevel());
+    switch (mLevel)
+    {
+#ifdef CPU_X86
+    case SimdLevel::Avx2: mDecode = DecodeBlockAvx2; break;
+    case SimdLevel::Sse41: mDecode = DecodeBlockSse41; break;
+#endif
+    default: mDecode = DecodeBlockScalar; break;
+    }
+}
+
+void Bc7Decoder::DecodeBlock(const uint8_t* block, uint8_t* rgba, size_t rgbaRowPitch) const
+{
+    uint8_t decoded[64];
+    mDecode(block, decoded);
+    CopyBlockRows(decoded, AllChannels, 4, 4, rgba, rgbaRowPitch);
+}
+
+void Bc7Decoder::DecodeBlockChannel(const uint8_t* block, uint32_t channel, uint8_t* output, size_t outputRowPitch) const
+{
+    uint8_t decoded[64];
+    mDecode(block, decoded);
+    CopyBlockRows(decoded, channel, 4, 4, output, outputRowPitch);
+}
+
+void Bc7Decoder::DecodeSurface(const uint8_t* blocks, size_t blockRowPitch, uint32_t width, uint32_t height,
+                               uint8_t* rgba, size_t rgbaRowPitch, WorkStealingPool* pool) const
+{
+    DecodeRows(blocks, blockRowPitch, width, height, AllChannels, rgba, rgbaRowPitch, pool);
+}
+
+void Bc7Decoder::DecodeSurfaceChannel(const uint8_t* blocks, size_t blockRowPitch, uint32_t width, uint32_t height,
+                                      uint32_t channel, uint8_t* output, size_t outputRowPitch,
+                                      WorkStealingPool* pool) const
+{
+    DecodeRows(blocks, blockRowPitch, width, height, std::min(channel, 3u), output, outputRowPitch, pool);
+}
+
+void Bc7Decoder::DecodeRows(const uint8_t* blocks, size_t blockRowPitch, uint32_t width, uint32_t height,
+                            uint32_t channel, uint8_t* output, size_t outputRowPitch, WorkStealingPool* pool) const
+{
+    const uint32_t blocksX = (width + 3) / 4;
+    const uint32_t blocksY = (height + 3) / 4;
+    const uint32_t pixelBytes = channel == AllChannels ? 4 : 1;
+
+    auto decodeBand = [&](uint32_t task, uint32_t)
+    {
+        uint32_t firstRow = task * BlockRowsPerTask;
+        uint32_t lastRow = std::min(firstRow + BlockRowsPerTask, blocksY);
+        uint8_t decoded[64];
+        for (uint32_t by = firstRow; by < lastRow; by++)
+        {
+            const uint8_t* block = blocks + by * blockRowPitch;
+            uint32_t rows = std::min(height - by * 4, 4u);
+            for (uint32_t bx = 0; bx < blocksX; bx++, block += 16)
+            {
+                mDecode(block, decoded);
+                CopyBlockRows(decoded, channel, std::min(width - bx * 4, 4u), rows,
+                              output + by * 4 * outputRowPitch + bx * 4 * pixelBytes, outputRowPitch);
+            }
+        }
+    };
+
+    uint32_t taskCount = (blocksY + BlockRowsPerTask - 1) / BlockRowsPerTask;
+    if (pool != nullptr)
+    {
+        pool->Run(taskCount, decodeBand);
+        return;
+    }
+    for (uint32_t task = 0; task < taskCount; task++)
+    {
+        decodeBand(task, 0);
+    }
+}
+
+bool Bc7Decoder::DecodeMip(const DdsLayout& layout, const uint8_t* fileData, uint32_t mip,
+                           std::vector<uint8_t>& rgba, WorkStealingPool* pool) const
+{
+    if (!IsBc7Format(layout.DxgiFormat) || mip >= layout.Mips.size())
+    {
+        return false;
+    }
+
+    const DdsMipInfo& info = layout.Mips[mip];
+    DdsSubresource source = GetDdsSubresource(layout, fileData, mip);
+    rgba.resize((size_t)info.Width * info.Height * 4);
+    DecodeSurface(source.Data, source.RowPitch, info.Width, info.Height, rgba.data(), (size_t)info.Width * 4, pool);
+    return true;
+}
+
+bool Bc7Decoder::DecodeMipChannel(const DdsLayout& layout, const uint8_t* fileData, uint32_t mip, uint32_t channel,
+                                  std::vector<uint8_t>& output, WorkStealingPool* pool) const
+{
+    if (!IsBc7Format(layout.DxgiFormat) || mip >= layout.Mips.size())
+    {
+        return false;
+    }
+
+    const DdsMipInfo& info = layout.Mips[mip];
+    DdsSubresource source = GetDdsSubresource(layout, fileData, mip);
+    output.resize((size_t)info.Width * info.Height);
+    DecodeSurfaceChannel(source.Data, source.RowPitch, info.Width, info.Height, channel,
+                         output.data(), info.Width, pool);
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "DdsFile.h"
+#include "CpuFeatures.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+class WorkStealingPool;
+
+// DXGI_FORMAT_BC7_TYPELESS / _UNORM / _UNORM_SRGB
+bool IsBc7Format(uint32_t dxgiFormat);
+
+// Декодирование BC7 на процессоре, без графического API.
+// Блок разбирается скалярно (режим, разбиение, концевые точки, веса индексов), а сборка
+// концов и весов по пикселям и интерполяция одинаковы для всех режимов и идут на SSE4.1/AVX2:
+// концы выбираются из таблицы подмножеств через pshufb, смесь считается pmaddubsw.
+// Поверхности делятся на полосы строк блоков между потоками пула.
+class Bc7Decoder
+{
+public:
+    explicit Bc7Decoder(SimdLevel level = GetSupportedSimdLevel());
+
+    // Уровень выше поддерживаемого понижается до поддерживаемого
+    void SetSimdLevel(SimdLevel level);
+    SimdLevel GetSimdLevel() const { return mLevel; }
+
+    // Один блок (16 байт) в RGBA8 4x4, строки через rgbaRowPitch байт
+    void DecodeBlock(const uint8_t* block, uint8_t* rgba, size_t rgbaRowPitch) const;
+
+    // Один канал блока (0 - R, 1 - G, 2 - B, 3 - A), байт на пиксель
+    void DecodeBlockChannel(const uint8_t* block, uint32_t channel, uint8_t* output, size_t outputRowPitch) const;
+
+    // Поверхность width x height: blocks - строки блоков через blockRowPitch байт.
+    // Блоки на краях, не кратных 4, обрезаются. pool == nullptr - всё в вызывающем потоке.
+    void DecodeSurface(const uint8_t* blocks, size_t blockRowPitch, uint32_t width, uint32_t height,
+                       uint8_t* rgba, size_t rgbaRowPitch, WorkStealingPool* pool = nullptr) const;
+    void DecodeSurfaceChannel(const uint8_t* blocks, size_t blockRowPitch, uint32_t width, uint32_t height,
+                              uint32_t channel, uint8_t* output, size_t outputRowPitch,
+                              WorkStealingPool* pool = nullptr) const;
+
+    // Мип-уровень DDS файла (данные файла целиком, например из MappedFile), плотно упакованный.
+    // false - формат не BC7 или нет такого мипа.
+    bool DecodeMip(const DdsLayout& layout, const uint8_t* fileData, uint32_t mip,
+                   std::vector<uint8_t>& rgba, WorkStealingPool* pool = nullptr) const;
+    bool DecodeMipChannel(const DdsLayout& layout, const uint8_t* fileData, uint32_t mip, uint32_t channel,
+                          std::vector<uint8_t>& output, WorkStealingPool* pool = nullptr) const;
+
+private:
+    // Пиксели блока подряд, 64 байта
+    typedef void (*InterpolateFunction)(const uint8_t* block, uint8_t* rgba);
+
+    void DecodeRows(const uint8_t* blocks, size_t blockRowPitch, uint32_t width, uint32_t height,
+                    uint32_t channel, uint8_t* output, size_t outputRowPitch, WorkStealingPool* pool) const;
+
+    SimdLevel mLevel;
+    InterpolateFunction mDecode;
+};
@@ -37,6 +37,14 @@ void Camera::SetPosition(float x, float y, float z)
   UpdateViewMatrix();
 }
 
+void Camera::SetRotation(float pitchDegrees, float yawDegrees)
+{
+  m_rotation.x = pitchDegrees;
+  m_rotation.y = yawDegrees;
+
+  UpdateViewMatrix();
+}
+
 void Camera::MoveForward()
 {
   float forwardSpeed = 10.0f; // Increased speed
@@ -188,3 +196,20 @@ DirectX::BoundingFrustum Camera::GetFrustum() const
   
   return frustum;
 }
+
+void Camera::GetPickRay(float screenX, float screenY, float screenWidth, float screenHeight,
+                        DirectX::XMFLOAT3& origin, DirectX::XMFLOAT3& direction) const
+{
+  XMMATRIX proj = XMMatrixTranspose(XMLoadFloat4x4(&m_projectionMatrix));
+  XMMATRIX view = XMMatrixTranspose(XMLoadFloat4x4(&m_viewMatrix));
+
+  // Pixel to a view-space direction on the z = 1 plane
+  float viewX = (2.0f * screenX / screenWidth - 1.0f) / XMVectorGetX(proj.r[0]);
+  float viewY = (1.0f - 2.0f * screenY / screenHeight) / XMVectorGetY(proj.r[1]);
+
+  XMMATRIX invView = XMMatrixInverse(nullptr, view);
+  XMVECTOR worldDir = XMVector3TransformNormal(XMVectorSet(viewX, viewY, 1.0f, 0.0f), invView);
+
+  origin = m_position;
+  XMStoreFloat3(&direction, XMVector3Normalize(worldDir));
+}
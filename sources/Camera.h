@@ -12,6 +12,7 @@ public:
   void SetProjectionValues(float fovDegrees, float aspectRatio, float nearZ, float farZ);
   void SetOrthographicValues(float width, float height);
   void SetPosition(float x, float y, float z);
+  void SetRotation(float pitchDegrees, float yawDegrees);
 
   // Movement
   void MoveForward();
@@ -31,6 +32,10 @@ public:
   DirectX::BoundingFrustum GetFrustum() const;
   DirectX::XMFLOAT3 GetPosition() const { return m_position; }
 
+  // World-space ray through a pixel: origin at the eye, unit direction
+  void GetPickRay(float screenX, float screenY, float screenWidth, float screenHeight,
+                  DirectX::XMFLOAT3& origin, DirectX::XMFLOAT3& direction) const;
+
 private:
   void UpdateViewMatrix();
 
@@ -0,0 +1,51 @@
+#include "CpuFeatures.h"
+
+#if defined(CPU_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+#ifdef CPU_X86
+    void ReadCpuFeatures(bool& sse41, bool& avx2)
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        sse41 = (info[2] & (1 << 19)) != 0 && (info[2] & (1 << 9)) != 0;   // SSE4.1 и SSSE3
+
+        // AVX2 нужна и поддержка ОС: сохранение YMM регистров (OSXSAVE + XCR0)
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        avx2 = false;
+        if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+        {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+        }
+#else
+        sse41 = __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3");
+        avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+    }
+#endif
+}
+
+SimdLevel GetSupportedSimdLevel()
+{
+#ifdef CPU_X86
+    static const SimdLevel level = []
+    {
+        bool sse41 = false;
+        bool avx2 = false;
+        ReadCpuFeatures(sse41, avx2);
+        return avx2 ? SimdLevel::Avx2 : (sse41 ? SimdLevel::Sse41 : SimdLevel::Scalar);
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
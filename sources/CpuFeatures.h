@@ -0,0 +1,28 @@
+#pragma once
+
+// Выбор SIMD кода во время выполнения: модули (BC7, карта высот) собираются с базовыми
+// флагами проекта, а функции под SSE4.1/AVX2 помечаются CPU_TARGET_* и вызываются,
+// только если процессор их поддерживает.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+// MSVC разрешает любые intrinsics без флагов компиляции
+#define CPU_TARGET_SSE41
+#define CPU_TARGET_AVX2
+#else
+#define CPU_TARGET_SSE41 __attribute__((target("ssse3,sse4.1")))
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Sse41 включает SSSE3: процессоров с SSE4.1 без SSSE3 не бывает
+enum class SimdLevel
+{
+    Scalar,
+    Sse41,
+    Avx2
+};
+
+// Лучший уровень, доступный на этом процессоре и ОС (CPUID проверяется один раз)
+SimdLevel GetSupportedSimdLevel();
@@ -0,0 +1,309 @@
+#include "DdsFile.h"
+#include <algorithm>
+#include <fstream>
+
+namespace
+{
+    const uint32_t DdsMagic = 0x20534444;          // "DDS "
+    const uint32_t DdsHeaderSize = 124;
+    const uint32_t DdsPixelFormatSize = 32;
+    const uint32_t Dx10HeaderSize = 20;
+    const size_t DdsHeaderEnd = 4 + DdsHeaderSize;
+
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDPF_RGB = 0x40;
+    const uint32_t DDPF_LUMINANCE = 0x20000;
+    const uint32_t DDSD_DEPTH = 0x800000;
+    const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+    const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+    const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+    uint32_t MakeFourCC(char a, char b, char c, char d)
+    {
+        return (uint32_t)(uint8_t)a | ((uint32_t)(uint8_t)b << 8) | ((uint32_t)(uint8_t)c << 16) | ((uint32_t)(uint8_t)d << 24);
+    }
+
+    uint32_t ReadLE32(const uint8_t* p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    // Размер блока 4x4 или пикселя в байтах; 0 - формат не поддерживается
+    uint32_t GetFormatBlockBytes(uint32_t dxgiFormat, bool& blockCompressed)
+    {
+        blockCompressed = true;
+        switch (dxgiFormat)
+        {
+        case 70: case 71: case 72:                  // BC1
+        case 79: case 80: case 81:                  // BC4
+            return 8;
+        case 73: case 74: case 75:                  // BC2
+        case 76: case 77: case 78:                  // BC3
+        case 82: case 83: case 84:                  // BC5
+        case 94: case 95: case 96:                  // BC6H
+        case 97: case 98: case 99:                  // BC7
+            return 16;
+        }
+
+        blockCompressed = false;
+        switch (dxgiFormat)
+        {
+        case 1: case 2: case 3: case 4:             // R32G32B32A32
+            return 16;
+        case 9: case 10: case 11: case 12: case 13: case 14:   // R16G16B16A16
+            return 8;
+        case 27: case 28: case 29: case 30: case 31: case 32:  // R8G8B8A8
+        case 33: case 34: case 35: case 36: case 37: case 38:  // R16G16
+        case 39: case 40: case 41: case 42: case 43:           // R32
+        case 87: case 88: case 90: case 91:                    // B8G8R8A8 / B8G8R8X8
+            return 4;
+        case 53: case 54: case 55: case 56: case 57: case 58: case 59:   // R16
+            return 2;
+        case 60: case 61: case 62: case 63: case 64: case 65:  // R8 / A8
+            return 1;
+        }
+        return 0;
+    }
+
+    // Формат legacy заголовка без DX10 расширения
+    uint32_t GetLegacyFormat(const uint8_t* pixelFormat)
+    {
+        uint32_t flags = ReadLE32(pixelFormat + 4);
+        uint32_t fourCC = ReadLE32(pixelFormat + 8);
+        uint32_t bitCount = ReadLE32(pixelFormat + 12);
+        uint32_t redMask = ReadLE32(pixelFormat + 16);
+        uint32_t greenMask = ReadLE32(pixelFormat + 20);
+        uint32_t blueMask = ReadLE32(pixelFormat + 24);
+
+        if (flags & DDPF_FOURCC)
+        {
+            if (fourCC == MakeFourCC('D', 'X', 'T', '1')) return 71;
+            if (fourCC == MakeFourCC('D', 'X', 'T', '2') || fourCC == MakeFourCC('D', 'X', 'T', '3')) return 74;
+            if (fourCC == MakeFourCC('D', 'X', 'T', '4') || fourCC == MakeFourCC('D', 'X', 'T', '5')) return 77;
+            if (fourCC == MakeFourCC('A', 'T', 'I', '1') || fourCC == MakeFourCC('B', 'C', '4', 'U')) return 80;
+            if (fourCC == MakeFourCC('A', 'T', 'I', '2') || fourCC == MakeFourCC('B', 'C', '5', 'U')) return 83;
+            return 0;
+        }
+        if ((flags & DDPF_RGB) && bitCount == 32)
+        {
+            if (redMask == 0x000000FF && greenMask == 0x0000FF00 && blueMask == 0x00FF0000) return 28;
+            if (redMask == 0x00FF0000 && greenMask == 0x0000FF00 && blueMask == 0x000000FF) return 87;
+            return 0;
+        }
+        if (flags & DDPF_LUMINANCE)
+        {
+            if (bitCount == 8) return 61;
+            if (bitCount == 16) return 56;
+        }
+        return 0;
+    }
+
+    // header - байты файла с начала (магия, DDS_HEADER и, если есть, DDS_HEADER_DXT10)
+    bool ParseDdsHeader(const uint8_t* header, size_t headerSize, uint64_t fileSize, DdsLayout& layout)
+    {
+        if (headerSize < DdsHeaderEnd || ReadLE32(header) != DdsMagic)
+        {
+            return false;
+        }
+
+        const uint8_t* h = header + 4;
+        if (ReadLE32(h) != DdsHeaderSize || ReadLE32(h + 72) != DdsPixelFormatSize)
+        {
+            return false;
+        }
+
+        uint32_t flags = ReadLE32(h + 4);
+        uint32_t height = ReadLE32(h + 8);
+        uint32_t width = ReadLE32(h + 12);
+        uint32_t mipCount = std::max(ReadLE32(h + 24), 1u);
+        uint32_t caps2 = ReadLE32(h + 108);
+        const uint8_t* pixelFormat = h + 72;
+
+        if (width == 0 || height == 0 || mipCount > 32 || (flags & DDSD_DEPTH) || (caps2 & DDSCAPS2_CUBEMAP))
+        {
+            return false;
+        }
+
+        uint64_t dataOffset = DdsHeaderEnd;
+        uint32_t format = 0;
+        if ((ReadLE32(pixelFormat + 4) & DDPF_FOURCC) && ReadLE32(pixelFormat + 8) == MakeFourCC('D', 'X', '1', '0'))
+        {
+            if (headerSize < DdsHeaderEnd + Dx10HeaderSize)
+            {
+                return false;
+            }
+
+            const uint8_t* dx10 = header + DdsHeaderEnd;
+            format = ReadLE32(dx10);
+            if (ReadLE32(dx10 + 4) != DDS_DIMENSION_TEXTURE2D || (ReadLE32(dx10 + 8) & DDS_RESOURCE_MISC_TEXTURECUBE) ||
+                ReadLE32(dx10 + 12) != 1)
+            {
+                return false;
+            }
+            dataOffset += Dx10HeaderSize;
+        }
+        else
+        {
+            format = GetLegacyFormat(pixelFormat);
+        }
+
+        bool blockCompressed = false;
+        uint32_t blockBytes = GetFormatBlockBytes(format, blockCompressed);
+        if (blockBytes == 0)
+        {
+            return false;
+        }
+
+        layout.Width = width;
+        layout.Height = height;
+        layout.DxgiFormat = format;
+        layout.BytesPerBlock = blockBytes;
+        layout.BlockCompressed = blockCompressed;
+        layout.DataOffset = dataOffset;
+        layout.Mips.clear();
+
+        uint64_t offset = dataOffset;
+        for (uint32_t mip = 0; mip < mipCount; mip++)
+        {
+            DdsMipInfo info;
+            info.Width = std::max(width >> mip, 1u);
+            info.Height = std::max(height >> mip, 1u);
+            if (blockCompressed)
+            {
+                info.RowPitch = std::max((info.Width + 3) / 4, 1u) * blockBytes;
+                info.RowCount = std::max((info.Height + 3) / 4, 1u);
+            }
+            else
+            {
+                info.RowPitch = info.Width * blockBytes;
+                info.RowCount = info.Height;
+            }
+            info.Offset = offset;
+            info.Size = (uint64_t)info.RowPitch * info.RowCount;
+            offset += info.Size;
+
+            layout.Mips.push_back(info);
+
+            // Цепочка, заявленная в заголовке, может быть длиннее, чем нужно до 1x1
+            if (info.Width == 1 && info.Height == 1)
+            {
+                break;
+            }
+        }
+
+        // Файл должен вмещать все мипы
+        return offset <= fileSize;
+    }
+}
+
+bool ParseDdsLayout(const uint8_t* data, size_t size, DdsLayout& layout)
+{
+    if (data == nullptr)
+    {
+        return false;
+    }
+    return ParseDdsHeader(data, size, size, layout);
+}
+
+DdsSubresource GetDdsSubresource(const DdsLayout& layout, const uint8_t* fileData, uint32_t mip)
+{
+    const DdsMipInfo& info = layout.Mips[mip];
+
+    DdsSubresource subresource;
+    subresource.Data = fileData + info.Offset;
+    subresource.RowPitch = info.RowPitch;
+    subresource.RowCount = info.RowCount;
+    subresource.Size = info.Size;
+    return subresource;
+}
+
+uint32_t SelectDdsFirstMip(const DdsLayout& layout, uint32_t resolution)
+{
+    uint32_t mip = 0;
+    while (mip + 1 < layout.Mips.size() &&
+           std::max(layout.Mips[mip + 1].Width, layout.Mips[mip + 1].Height) >= resolution)
+    {
+        mip++;
+    }
+
+    while (mip > 0 && layout.BlockCompressed && (layout.Mips[mip].Width % 4 != 0 || layout.Mips[mip].Height % 4 != 0))
+    {
+        mip--;
+    }
+    return mip;
+}
+
+uint64_t GetDdsMipChainSize(const DdsLayout& layout, uint32_t firstMip)
+{
+    uint64_t size = 0;
+    for (size_t mip = firstMip; mip < layout.Mips.size(); mip++)
+    {
+        size += layout.Mips[mip].Size;
+    }
+    return size;
+}
+
+bool ReadDdsLayout(const std::string& path, DdsLayout& layout)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        return false;
+    }
+
+    uint64_t fileSize = (uint64_t)file.tellg();
+    uint8_t header[DdsHeaderEnd + Dx10HeaderSize];
+    size_t headerSize = (size_t)std::min<uint64_t>(fileSize, sizeof(header));
+
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(header), headerSize))
+    {
+        return false;
+    }
+    return ParseDdsHeader(header, headerSize, fileSize, layout);
+}
+
+bool ReadDdsMips(const std::string& path, const DdsLayout& layout, uint32_t firstMip, uint32_t mipCount,
+                 const DdsStagingFootprint* footprints, uint8_t* staging)
+{
+    if (firstMip + mipCount > layout.Mips.size())
+    {
+        return false;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < mipCount; i++)
+    {
+        const DdsMipInfo& info = layout.Mips[firstMip + i];
+        const DdsStagingFootprint& footprint = footprints[i];
+        if (footprint.RowPitch < info.RowPitch)
+        {
+            return false;
+        }
+
+        file.seekg((std::streamoff)info.Offset);
+        uint8_t* destination = staging + footprint.Offset;
+        if (footprint.RowPitch == info.RowPitch)
+        {
+            if (!file.read(reinterpret_cast<char*>(destination), (std::streamsize)info.Size))
+            {
+                return false;
+            }
+            continue;
+        }
+
+        for (uint32_t row = 0; row < info.RowCount; row++)
+        {
+            if (!file.read(reinterpret_cast<char*>(destination + (size_t)row * footprint.RowPitch), info.RowPitch))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
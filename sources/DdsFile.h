@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Разбор DDS без графического API: заголовки проверяются прямо в отображённом файле,
+// мип-уровни описываются смещениями в нём. Поддерживаются 2D текстуры без массивов:
+// BC1-BC7 и основные несжатые форматы (DX10 заголовок или эквивалентный legacy).
+
+// Один мип-уровень внутри файла
+struct DdsMipInfo
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t RowPitch;     // Байт в строке (для блочных форматов - в строке блоков)
+    uint32_t RowCount;     // Строк (строк блоков)
+    uint64_t Offset;       // От начала файла
+    uint64_t Size;         // RowPitch * RowCount
+};
+
+struct DdsLayout
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t DxgiFormat;   // Значение DXGI_FORMAT
+    uint32_t BytesPerBlock;
+    bool BlockCompressed;  // Блоки 4x4
+    uint64_t DataOffset;   // Начало данных первого мипа
+    std::vector<DdsMipInfo> Mips;
+};
+
+// Вид мип-уровня, указывающий прямо в данные файла
+struct DdsSubresource
+{
+    const uint8_t* Data;
+    uint32_t RowPitch;
+    uint32_t RowCount;
+    uint64_t Size;
+};
+
+// Место мипа в памяти вызывающего (upload heap и т.п.)
+struct DdsStagingFootprint
+{
+    uint64_t Offset;
+    uint32_t RowPitch;     // Не меньше DdsMipInfo::RowPitch
+};
+
+// Проверяет DDS_HEADER / DDS_HEADER_DXT10 в данных файла и строит раскладку мипов.
+// false - файл повреждён, обрезан или формат не поддерживается.
+bool ParseDdsLayout(const uint8_t* data, size_t size, DdsLayout& layout);
+
+DdsSubresource GetDdsSubresource(const DdsLayout& layout, const uint8_t* fileData, uint32_t mip);
+
+// Самый грубый мип, у которого на ребре не меньше resolution текселей (0, если таких нет).
+// У блочных форматов старший мип ресурса должен делиться на 4 - такой мип и выбирается.
+uint32_t SelectDdsFirstMip(const DdsLayout& layout, uint32_t resolution);
+
+// Байты мипов firstMip..последний
+uint64_t GetDdsMipChainSize(const DdsLayout& layout, uint32_t firstMip);
+
+// Читает мипы firstMip..firstMip+mipCount-1 из файла прямо в staging память по footprints
+// (по одному на мип). Нужны только байты этих мипов; если шаги строк совпадают, мип читается
+// одним вызовом, иначе построчно.
+bool ReadDdsMips(const std::string& path, const DdsLayout& layout, uint32_t firstMip, uint32_t mipCount,
+                 const DdsStagingFootprint* footprints, uint8_t* staging);
+
+// Читает и разбирает только заголовок файла (до 148 байт)
+bool ReadDdsLayout(const std::string& path, DdsLayout& layout);
@@ -0,0 +1,229 @@
+#include "FrustumCulling.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FRUSTUM_CULLING_SSE 1
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+
+void FrustumPlanes::Build(const BoundingFrustum& frustum)
+{
+    // GetPlanes строит плоскости так же, как BoundingFrustum::Contains,
+    // но делает это один раз, а не на каждый тест
+    XMVECTOR planes[PlaneCount];
+    frustum.GetPlanes(&planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+
+    for (int i = 0; i < PlaneCount; i++)
+    {
+        XMFLOAT4 plane;
+        XMStoreFloat4(&plane, planes[i]);
+        NormalX[i] = plane.x;
+        NormalY[i] = plane.y;
+        NormalZ[i] = plane.z;
+        Distance[i] = plane.w;
+    }
+}
+
+uint32_t ClassifyBox(const FrustumPlanes& planes, uint32_t planeMask,
+                     float centerX, float centerY, float centerZ,
+                     float extentX, float extentY, float extentZ,
+                     ContainmentType& containment,
+                     uint8_t& straddleMask, uint8_t& rejectPlane,
+                     float& margin, float& insideMargin)
+{
+    uint32_t tests = 0;
+    straddleMask = 0;
+    margin = FLT_MAX;
+    insideMargin = FLT_MAX;
+
+    // Сначала плоскость из кэша, затем остальные по маске
+    uint32_t hint = rejectPlane < FrustumPlanes::PlaneCount ? rejectPlane : 0;
+    for (int n = 0; n < FrustumPlanes::PlaneCount; n++)
+    {
+        uint32_t i = (hint + n) % FrustumPlanes::PlaneCount;
+        if (!(planeMask & (1u << i)))
+        {
+            continue;
+        }
+
+        float dist = centerX * planes.NormalX[i] + centerY * planes.NormalY[i] +
+                     centerZ * planes.NormalZ[i] + planes.Distance[i];
+        float radius = extentX * fabsf(planes.NormalX[i]) + extentY * fabsf(planes.NormalY[i]) +
+                       extentZ * fabsf(planes.NormalZ[i]);
+        tests++;
+
+        if (dist > radius)
+        {
+            containment = DISJOINT;
+            rejectPlane = static_cast<uint8_t>(i);
+            straddleMask = 0;
+            margin = dist - radius;
+            insideMargin = FLT_MAX;
+            return tests;
+        }
+        if (!(dist < -radius))
+        {
+            straddleMask |= static_cast<uint8_t>(1u << i);
+            margin = std::min(margin, radius - dist);
+        }
+        else
+        {
+            insideMargin = std::min(insideMargin, -radius - dist);
+        }
+    }
+
+    containment = straddleMask ? INTERSECTS : CONTAINS;
+    return tests;
+}
+
+uint32_t ClassifyBoxes4(const FrustumPlanes& planes, uint32_t planeMask,
+                        const uint8_t rejectHint[4],
+                        const float* centerX, const float* centerY, const float* centerZ,
+                        const float* extentX, const float* extentY, const float* extentZ,
+                        BoxCullResult4& result)
+{
+#if FRUSTUM_CULLING_SSE
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+
+    __m128 cx = _mm_load_ps(centerX);
+    __m128 cy = _mm_load_ps(centerY);
+    __m128 cz = _mm_load_ps(centerZ);
+    __m128 ex = _mm_load_ps(extentX);
+    __m128 ey = _mm_load_ps(extentY);
+    __m128 ez = _mm_load_ps(extentZ);
+
+    uint32_t tests = 0;
+    int outsideMask = 0;
+    uint32_t straddle[4] = { 0, 0, 0, 0 };
+
+    // Запасы до смены результата: для отброшенных - d - r отбросившей плоскости,
+    // для остальных - минимум r - d по пересекаемым и -r - d по пройденным плоскостям
+    __m128 outsideMargin = _mm_setzero_ps();
+    __m128 straddleMargin = _mm_set1_ps(FLT_MAX);
+    __m128 insideMargin = _mm_set1_ps(FLT_MAX);
+
+    for (int lane = 0; lane < 4; lane++)
+    {
+        result.RejectPlane[lane] = rejectHint[lane];
+    }
+
+    // Проход по плоскостям из кэша: у каждого бокса своя плоскость.
+    // Пока камера движется плавно, большинство невидимых узлов отбрасывается здесь.
+    if (planeMask)
+    {
+        const uint8_t* h = rejectHint;
+        __m128 nx = _mm_setr_ps(planes.NormalX[h[0]], planes.NormalX[h[1]], planes.NormalX[h[2]], planes.NormalX[h[3]]);
+        __m128 ny = _mm_setr_ps(planes.NormalY[h[0]], planes.NormalY[h[1]], planes.NormalY[h[2]], planes.NormalY[h[3]]);
+        __m128 nz = _mm_setr_ps(planes.NormalZ[h[0]], planes.NormalZ[h[1]], planes.NormalZ[h[2]], planes.NormalZ[h[3]]);
+        __m128 d = _mm_setr_ps(planes.Distance[h[0]], planes.Distance[h[1]], planes.Distance[h[2]], planes.Distance[h[3]]);
+
+        __m128 dist = _mm_add_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, nx), _mm_mul_ps(cy, ny)), _mm_mul_ps(cz, nz)), d);
+        __m128 radius = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(ex, _mm_andnot_ps(signMask, nx)),
+                       _mm_mul_ps(ey, _mm_andnot_ps(signMask, ny))),
+            _mm_mul_ps(ez, _mm_andnot_ps(signMask, nz)));
+
+        outsideMask = _mm_movemask_ps(_mm_cmpgt_ps(dist, radius));
+        outsideMargin = _mm_sub_ps(dist, radius);
+        tests += 4;
+    }
+
+    for (int i = 0; i < FrustumPlanes::PlaneCount && outsideMask != 0xF; i++)
+    {
+        if (!(planeMask & (1u << i)))
+        {
+            continue;
+        }
+
+        __m128 nx = _mm_set1_ps(planes.NormalX[i]);
+        __m128 ny = _mm_set1_ps(planes.NormalY[i]);
+        __m128 nz = _mm_set1_ps(planes.NormalZ[i]);
+
+        __m128 dist = _mm_add_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, nx), _mm_mul_ps(cy, ny)), _mm_mul_ps(cz, nz)),
+            _mm_set1_ps(planes.Distance[i]));
+        __m128 radius = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(ex, _mm_andnot_ps(signMask, nx)),
+                       _mm_mul_ps(ey, _mm_andnot_ps(signMask, ny))),
+            _mm_mul_ps(ez, _mm_andnot_ps(signMask, nz)));
+
+        __m128 outside = _mm_cmpgt_ps(dist, radius);
+        __m128 inside = _mm_cmplt_ps(dist, _mm_xor_ps(radius, signMask));
+        int planeOutside = _mm_movemask_ps(outside);
+        int planeInside = _mm_movemask_ps(inside);
+        tests += 4;
+
+        // Дорожки, уже отброшенные раньше, не трогаем - их запас задан отбросившей плоскостью
+        __m128 alive = _mm_castsi128_ps(_mm_cmpeq_epi32(
+            _mm_and_si128(_mm_set1_epi32(outsideMask), _mm_setr_epi32(1, 2, 4, 8)), _mm_setzero_si128()));
+        __m128 newlyOutside = _mm_and_ps(outside, alive);
+        __m128 straddling = _mm_andnot_ps(_mm_or_ps(outside, inside), alive);
+        __m128 passed = _mm_and_ps(inside, alive);
+        __m128 maxMargin = _mm_set1_ps(FLT_MAX);
+
+        outsideMargin = _mm_or_ps(_mm_and_ps(newlyOutside, _mm_sub_ps(dist, radius)),
+                                  _mm_andnot_ps(newlyOutside, outsideMargin));
+        straddleMargin = _mm_min_ps(straddleMargin,
+            _mm_or_ps(_mm_and_ps(straddling, _mm_sub_ps(radius, dist)), _mm_andnot_ps(straddling, maxMargin)));
+        insideMargin = _mm_min_ps(insideMargin,
+            _mm_or_ps(_mm_and_ps(passed, _mm_sub_ps(_mm_xor_ps(radius, signMask), dist)), _mm_andnot_ps(passed, maxMargin)));
+
+        for (int lane = 0; lane < 4; lane++)
+        {
+            int bit = 1 << lane;
+            if (outsideMask & bit)
+            {
+                continue;
+            }
+            if (planeOutside & bit)
+            {
+                result.RejectPlane[lane] = static_cast<uint8_t>(i);
+            }
+            else if (!(planeInside & bit))
+            {
+                straddle[lane] |= 1u << i;
+            }
+        }
+        outsideMask |= planeOutside;
+    }
+
+    alignas(16) float outsideValues[4];
+    _mm_store_ps(outsideValues, outsideMargin);
+    _mm_storeu_ps(result.Margin, straddleMargin);
+    _mm_storeu_ps(result.InsideMargin, insideMargin);
+
+    for (int lane = 0; lane < 4; lane++)
+    {
+        if (outsideMask & (1 << lane))
+        {
+            result.Containment[lane] = DISJOINT;
+            result.PlaneMask[lane] = 0;
+            result.Margin[lane] = outsideValues[lane];
+            result.InsideMargin[lane] = FLT_MAX;
+        }
+        else
+        {
+            result.Containment[lane] = straddle[lane] ? INTERSECTS : CONTAINS;
+            result.PlaneMask[lane] = static_cast<uint8_t>(straddle[lane]);
+        }
+    }
+
+    return tests;
+#else
+    uint32_t tests = 0;
+    for (int lane = 0; lane < 4; lane++)
+    {
+        result.RejectPlane[lane] = rejectHint[lane];
+        tests += ClassifyBox(planes, planeMask, centerX[lane], centerY[lane], centerZ[lane],
+                             extentX[lane], extentY[lane], extentZ[lane],
+                             result.Containment[lane], result.PlaneMask[lane], result.RejectPlane[lane],
+                             result.Margin[lane], result.InsideMargin[lane]);
+    }
+    return tests;
+#endif
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+
+// Плоскости пирамиды видимости в SoA виде, строятся один раз за кадр.
+// Конвенция та же, что у DirectXCollision: нормали нормированы и смотрят наружу,
+// точка p снаружи плоскости, если dot(n, p) + d > 0.
+struct alignas(16) FrustumPlanes
+{
+    static const int PlaneCount = 6;            // Near, Far, Right, Left, Top, Bottom
+    static const uint32_t AllPlanesMask = 0x3F;
+
+    float NormalX[PlaneCount];
+    float NormalY[PlaneCount];
+    float NormalZ[PlaneCount];
+    float Distance[PlaneCount];
+
+    void Build(const DirectX::BoundingFrustum& frustum);
+};
+
+// Результат проверки четырёх боксов
+struct BoxCullResult4
+{
+    DirectX::ContainmentType Containment[4];
+    uint8_t PlaneMask[4];    // Плоскости, которые бокс пересекает - только их нужно проверять у детей
+    uint8_t RejectPlane[4];  // Плоскость, отбросившая бокс (для DISJOINT)
+    float Margin[4];         // DISJOINT: насколько бокс снаружи отбросившей плоскости,
+                             // иначе - насколько он может сместиться, не выйдя за пересекаемые плоскости
+    float InsideMargin[4];   // Насколько бокс может сместиться, оставаясь внутри плоскостей, пройденных целиком
+};
+
+// Классификация одного AABB относительно пирамиды (скалярный путь).
+// Проверяются только плоскости из planeMask, остальные считаются пройденными.
+// rejectPlane на входе - плоскость, с которой начинать (кэш прошлого кадра),
+// на выходе - плоскость, отбросившая бокс. margin и insideMargin - запасы, как в BoxCullResult4
+// (FLT_MAX, если ограничивающих плоскостей нет). Возвращает число проверок бокс-плоскость.
+uint32_t ClassifyBox(const FrustumPlanes& planes, uint32_t planeMask,
+                     float centerX, float centerY, float centerZ,
+                     float extentX, float extentY, float extentZ,
+                     DirectX::ContainmentType& containment,
+                     uint8_t& straddleMask, uint8_t& rejectPlane,
+                     float& margin, float& insideMargin);
+
+// Классификация четырёх AABB за один проход по плоскостям.
+// Данные передаются в SoA виде (по 4 float в каждом массиве, выравнивание 16 байт) -
+// ровно так лежат сёстры в QuadTreeNodeBlock. На SSE все четыре бокса считаются
+// одновременно, на остальных платформах используется скалярный запасной путь.
+// rejectHint - плоскости, отбросившие каждый бокс в прошлый раз; они проверяются первыми.
+// Возвращает число проверок бокс-плоскость.
+uint32_t ClassifyBoxes4(const FrustumPlanes& planes, uint32_t planeMask,
+                        const uint8_t rejectHint[4],
+                        const float* centerX, const float* centerY, const float* centerZ,
+                        const float* extentX, const float* extentY, const float* extentZ,
+                        BoxCullResult4& result);
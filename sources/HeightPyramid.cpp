@@ -0,0 +1,113 @@
+#include "HeightPyramid.h"
+#include <algorithm>
+#include <cmath>
+
+HeightPyramid::HeightPyramid()
+{
+}
+
+void HeightPyramid::Build(const std::vector<float>& heights, uint32_t width, uint32_t height)
+{
+    mLevels.clear();
+    if (width == 0 || height == 0 || heights.size() < (size_t)width * height)
+    {
+        return;
+    }
+
+    Level base;
+    base.Width = width;
+    base.Height = height;
+    base.Min.assign(heights.begin(), heights.begin() + (size_t)width * height);
+    base.Max = base.Min;
+    mLevels.push_back(std::move(base));
+
+    // Каждый следующий уровень - min/max блоков 2x2, пока не останется один тексель
+    while (mLevels.back().Width > 1 || mLevels.back().Height > 1)
+    {
+        const Level& src = mLevels.back();
+
+        Level dst;
+        dst.Width = (src.Width + 1) / 2;
+        dst.Height = (src.Height + 1) / 2;
+        dst.Min.resize((size_t)dst.Width * dst.Height);
+        dst.Max.resize((size_t)dst.Width * dst.Height);
+
+        for (uint32_t y = 0; y < dst.Height; y++)
+        {
+            uint32_t y0 = 2 * y;
+            uint32_t y1 = std::min(y0 + 1, src.Height - 1);
+            for (uint32_t x = 0; x < dst.Width; x++)
+            {
+                uint32_t x0 = 2 * x;
+                uint32_t x1 = std::min(x0 + 1, src.Width - 1);
+
+                size_t i00 = (size_t)y0 * src.Width + x0;
+                size_t i01 = (size_t)y0 * src.Width + x1;
+                size_t i10 = (size_t)y1 * src.Width + x0;
+                size_t i11 = (size_t)y1 * src.Width + x1;
+
+                dst.Min[(size_t)y * dst.Width + x] = std::min(std::min(src.Min[i00], src.Min[i01]),
+                                                              std::min(src.Min[i10], src.Min[i11]));
+                dst.Max[(size_t)y * dst.Width + x] = std::max(std::max(src.Max[i00], src.Max[i01]),
+                                                              std::max(src.Max[i10], src.Max[i11]));
+            }
+        }
+
+        mLevels.push_back(std::move(dst));
+    }
+}
+
+float HeightPyramid::GetHeight(int x, int y) const
+{
+    const Level& base = mLevels[0];
+    x = std::max(0, std::min(x, (int)base.Width - 1));
+    y = std::max(0, std::min(y, (int)base.Height - 1));
+    return base.Min[(size_t)y * base.Width + x];
+}
+
+void HeightPyramid::QueryRange(float u0, float v0, float u1, float v1,
+                               float& minHeight, float& maxHeight) const
+{
+    if (mLevels.empty())
+    {
+        minHeight = 0.0f;
+        maxHeight = 0.0f;
+        return;
+    }
+
+    const Level& base = mLevels[0];
+
+    // Билинейная выборка в точке u берёт тексели floor(u * W - 0.5) и следующий за ним
+    int x0 = (int)floorf(std::min(u0, u1) * base.Width - 0.5f);
+    int x1 = (int)floorf(std::max(u0, u1) * base.Width - 0.5f) + 1;
+    int y0 = (int)floorf(std::min(v0, v1) * base.Height - 0.5f);
+    int y1 = (int)floorf(std::max(v0, v1) * base.Height - 0.5f) + 1;
+
+    x0 = std::max(0, std::min(x0, (int)base.Width - 1));
+    x1 = std::max(0, std::min(x1, (int)base.Width - 1));
+    y0 = std::max(0, std::min(y0, (int)base.Height - 1));
+    y1 = std::max(0, std::min(y1, (int)base.Height - 1));
+
+    // Поднимаемся по пирамиде, пока прямоугольник не накроется небольшим числом ячеек
+    const int maxCellsPerAxis = 8;
+    uint32_t level = 0;
+    while (level + 1 < mLevels.size() &&
+           ((x1 >> level) - (x0 >> level) >= maxCellsPerAxis ||
+            (y1 >> level) - (y0 >> level) >= maxCellsPerAxis))
+    {
+        level++;
+    }
+
+    const Level& lv = mLevels[level];
+    minHeight = lv.Min[(size_t)(y0 >> level) * lv.Width + (x0 >> level)];
+    maxHeight = lv.Max[(size_t)(y0 >> level) * lv.Width + (x0 >> level)];
+
+    for (int y = y0 >> level; y <= (y1 >> level); y++)
+    {
+        for (int x = x0 >> level; x <= (x1 >> level); x++)
+        {
+            minHeight = std::min(minHeight, lv.Min[(size_t)y * lv.Width + x]);
+            maxHeight = std::max(maxHeight, lv.Max[(size_t)y * lv.Width + x]);
+        }
+    }
+}
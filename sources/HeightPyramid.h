@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// Min/max пирамида карты высот.
+// Уровень 0 - сами высоты, каждый следующий уровень хранит min/max блока 2x2 предыдущего.
+// Позволяет за O(1) получить консервативный диапазон высот любой области террейна.
+class HeightPyramid
+{
+public:
+    HeightPyramid();
+
+    // heights - высоты в мировых единицах, построчно; строка 0 соответствует v = 0
+    void Build(const std::vector<float>& heights, uint32_t width, uint32_t height);
+
+    bool IsEmpty() const { return mLevels.empty(); }
+    uint32_t GetLevelCount() const { return (uint32_t)mLevels.size(); }
+    uint32_t GetLevelWidth(uint32_t level) const { return mLevels[level].Width; }
+    uint32_t GetLevelHeight(uint32_t level) const { return mLevels[level].Height; }
+
+    float GetMin(uint32_t level, uint32_t x, uint32_t y) const { return mLevels[level].Min[y * mLevels[level].Width + x]; }
+    float GetMax(uint32_t level, uint32_t x, uint32_t y) const { return mLevels[level].Max[y * mLevels[level].Width + x]; }
+
+    // Исходная высота текселя уровня 0, координаты зажимаются в границы карты
+    float GetHeight(int x, int y) const;
+
+    // Диапазон высот в прямоугольнике текстурных координат [u0, u1] x [v0, v1].
+    // Учитывает билинейную фильтрацию: захватываются все тексели, влияющие на выборку.
+    void QueryRange(float u0, float v0, float u1, float v1, float& minHeight, float& maxHeight) const;
+
+    // Диапазон высот всей карты
+    float GetGlobalMin() const { return mLevels.back().Min[0]; }
+    float GetGlobalMax() const { return mLevels.back().Max[0]; }
+
+private:
+    struct Level
+    {
+        uint32_t Width;
+        uint32_t Height;
+        std::vector<float> Min;
+        std::vector<float> Max;
+    };
+
+    std::vector<Level> mLevels;
+};
@@ -0,0 +1,496 @@
+#include "Heightfield.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Тайл 8x8: 3 бита координаты внутри тайла
+    const uint32_t TileShift = 3;
+    const uint32_t TileMask = 7;
+
+    // Пачки от ParallelQueryThreshold точек делятся между потоками по QueriesPerTask
+    const size_t ParallelQueryThreshold = 16384;
+    const size_t QueriesPerTask = 4096;
+
+    // Биты 0..2 в позиции 0, 2, 4 - чётные биты индекса Мортона
+    uint32_t SpreadTileBits(uint32_t value)
+    {
+        return (value & 1) | ((value & 2) << 1) | ((value & 4) << 2);
+    }
+
+    // Индекс раскладывается на вклад столбца и вклад строки, так что 4 тексела выборки
+    // стоят 2 + 2 вычисления вместо 4
+    uint32_t ColumnOffset(uint32_t x)
+    {
+        return ((x >> TileShift) << 6) | SpreadTileBits(x & TileMask);
+    }
+
+    uint32_t RowOffset(const HeightfieldLayout& layout, uint32_t y)
+    {
+        return (y >> TileShift) * layout.TileRowStride + (SpreadTileBits(y & TileMask) << 1);
+    }
+
+    // Координата в текселях зажимается заранее: дальше [-1, size] результат не меняется,
+    // а огромные значения и NaN не переполняют перевод в целое
+    float ClampTexelCoordinate(float t, uint32_t size)
+    {
+        return std::min(std::max(t, -1.0f), (float)size);
+    }
+
+    float TexelX(const HeightfieldLayout& layout, float x)
+    {
+        return x * layout.ScaleX + layout.OffsetX;
+    }
+
+    float TexelY(const HeightfieldLayout& layout, float z)
+    {
+        return z * layout.ScaleZ + layout.OffsetZ;
+    }
+
+    // Нормированное значение в точке (tx, ty) текселей, с зажатием на краях
+    float BilinearScalar(const HeightfieldLayout& layout, const float* samples, float tx, float ty)
+    {
+        tx = ClampTexelCoordinate(tx, layout.Width);
+        ty = ClampTexelCoordinate(ty, layout.Height);
+        float floorX = std::floor(tx);
+        float floorY = std::floor(ty);
+        float fx = tx - floorX;
+        float fy = ty - floorY;
+
+        int maxX = (int)layout.Width - 1;
+        int maxY = (int)layout.Height - 1;
+        uint32_t column0 = ColumnOffset((uint32_t)std::max(0, std::min((int)floorX, maxX)));
+        uint32_t column1 = ColumnOffset((uint32_t)std::max(0, std::min((int)floorX + 1, maxX)));
+        uint32_t row0 = RowOffset(layout, (uint32_t)std::max(0, std::min((int)floorY, maxY)));
+        uint32_t row1 = RowOffset(layout, (uint32_t)std::max(0, std::min((int)floorY + 1, maxY)));
+
+        float h00 = samples[row0 + column0];
+        float h01 = samples[row0 + column1];
+        float h10 = samples[row1 + column0];
+        float h11 = samples[row1 + column1];
+        float top = h00 + (h01 - h00) * fx;
+        float bottom = h10 + (h11 - h10) * fx;
+        return top + (bottom - top) * fy;
+    }
+
+    float SampleScalar(const HeightfieldLayout& layout, const float* samples, float x, float z)
+    {
+        return BilinearScalar(layout, samples, TexelX(layout, x), TexelY(layout, z)) * layout.HeightScale;
+    }
+
+    void SampleHeightsScalar(const HeightfieldLayout& layout, const float* samples,
+                             const float* x, const float* z, float* heights, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            heights[i] = SampleScalar(layout, samples, x[i], z[i]);
+        }
+    }
+
+    // Нормаль как в ds.hlsl: высоты в +-1 тексель по u и v, касательные (2, hR - hL, 0) и
+    // (0, hU - hD, 2), нормаль - их векторное произведение. После сокращения длин касательных
+    // это normalize(hL - hR, 2, hD - hU); U - шаг по -v, то есть по +z.
+    void SampleNormalsScalar(const HeightfieldLayout& layout, const float* samples,
+                             const float* x, const float* z, HeightfieldSamples output, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            float tx = TexelX(layout, x[i]);
+            float ty = TexelY(layout, z[i]);
+            float h = BilinearScalar(layout, samples, tx, ty) * layout.HeightScale;
+            float hL = BilinearScalar(layout, samples, tx - 1.0f, ty) * layout.HeightScale;
+            float hR = BilinearScalar(layout, samples, tx + 1.0f, ty) * layout.HeightScale;
+            float hD = BilinearScalar(layout, samples, tx, ty + 1.0f) * layout.HeightScale;
+            float hU = BilinearScalar(layout, samples, tx, ty - 1.0f) * layout.HeightScale;
+
+            float nx = hL - hR;
+            float nz = hD - hU;
+            float invLength = 1.0f / std::sqrt(nx * nx + 4.0f + nz * nz);
+            output.Heights[i] = h;
+            output.NormalX[i] = nx * invLength;
+            output.NormalY[i] = 2.0f * invLength;
+            output.NormalZ[i] = nz * invLength;
+        }
+    }
+
+#ifdef CPU_X86
+    // Векторные версии повторяют скалярные по шагам, без FMA - результаты совпадают бит в бит
+
+    CPU_TARGET_SSE41 __m128i SpreadTileBitsSse41(__m128i value)
+    {
+        __m128i bit0 = _mm_and_si128(value, _mm_set1_epi32(1));
+        __m128i bit1 = _mm_slli_epi32(_mm_and_si128(value, _mm_set1_epi32(2)), 1);
+        __m128i bit2 = _mm_slli_epi32(_mm_and_si128(value, _mm_set1_epi32(4)), 2);
+        return _mm_or_si128(bit0, _mm_or_si128(bit1, bit2));
+    }
+
+    CPU_TARGET_SSE41 __m128i ColumnOffsetSse41(__m128i x)
+    {
+        __m128i tile = _mm_slli_epi32(_mm_srli_epi32(x, TileShift), 6);
+        return _mm_or_si128(tile, SpreadTileBitsSse41(_mm_and_si128(x, _mm_set1_epi32(TileMask))));
+    }
+
+    CPU_TARGET_SSE41 __m128i RowOffsetSse41(__m128i y, __m128i tileRowStride)
+    {
+        __m128i tile = _mm_mullo_epi32(_mm_srli_epi32(y, TileShift), tileRowStride);
+        __m128i inTile = _mm_slli_epi32(SpreadTileBitsSse41(_mm_and_si128(y, _mm_set1_epi32(TileMask))), 1);
+        return _mm_add_epi32(tile, inTile);
+    }
+
+    // Константы раскладки в регистрах, загружаются один раз на вызов
+    struct LayoutSse41
+    {
+        __m128 ScaleX, OffsetX, ScaleZ, OffsetZ, HeightScale;
+        __m128 MaxTexelX, MaxTexelY;
+        __m128i MaxX, MaxY, TileRowStride;
+    };
+
+    CPU_TARGET_SSE41 LayoutSse41 LoadLayoutSse41(const HeightfieldLayout& layout)
+    {
+        LayoutSse41 result;
+        result.ScaleX = _mm_set1_ps(layout.ScaleX);
+        result.OffsetX = _mm_set1_ps(layout.OffsetX);
+        result.ScaleZ = _mm_set1_ps(layout.ScaleZ);
+        result.OffsetZ = _mm_set1_ps(layout.OffsetZ);
+        result.HeightScale = _mm_set1_ps(layout.HeightScale);
+        result.MaxTexelX = _mm_set1_ps((float)layout.Width);
+        result.MaxTexelY = _mm_set1_ps((float)layout.Height);
+        result.MaxX = _mm_set1_epi32((int)layout.Width - 1);
+        result.MaxY = _mm_set1_epi32((int)layout.Height - 1);
+        result.TileRowStride = _mm_set1_epi32((int)layout.TileRowStride);
+        return result;
+    }
+
+    CPU_TARGET_SSE41 __m128 BilinearSse41(const LayoutSse41& layout, const float* samples, __m128 tx, __m128 ty)
+    {
+        const __m128 minTexel = _mm_set1_ps(-1.0f);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi32(1);
+
+        tx = _mm_min_ps(_mm_max_ps(tx, minTexel), layout.MaxTexelX);
+        ty = _mm_min_ps(_mm_max_ps(ty, minTexel), layout.MaxTexelY);
+        __m128 floorX = _mm_floor_ps(tx);
+        __m128 floorY = _mm_floor_ps(ty);
+        __m128 fx = _mm_sub_ps(tx, floorX);
+        __m128 fy = _mm_sub_ps(ty, floorY);
+
+        __m128i x0 = _mm_cvttps_epi32(floorX);
+        __m128i y0 = _mm_cvttps_epi32(floorY);
+        __m128i x1 = _mm_add_epi32(x0, one);
+        __m128i y1 = _mm_add_epi32(y0, one);
+        __m128i column0 = ColumnOffsetSse41(_mm_max_epi32(zero, _mm_min_epi32(x0, layout.MaxX)));
+        __m128i column1 = ColumnOffsetSse41(_mm_max_epi32(zero, _mm_min_epi32(x1, layout.MaxX)));
+        __m128i row0 = RowOffsetSse41(_mm_max_epi32(zero, _mm_min_epi32(y0, layout.MaxY)), layout.TileRowStride);
+        __m128i row1 = RowOffsetSse41(_mm_max_epi32(zero, _mm_min_epi32(y1, layout.MaxY)), layout.TileRowStride);
+
+        // Сбора в SSE нет - индексы выгружаются и значения читаются по одному
+        alignas(16) uint32_t index[4][4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(index[0]), _mm_add_epi32(row0, column0));
+        _mm_store_si128(reinterpret_cast<__m128i*>(index[1]), _mm_add_epi32(row0, column1));
+        _mm_store_si128(reinterpret_cast<__m128i*>(index[2]), _mm_add_epi32(row1, column0));
+        _mm_store_si128(reinterpret_cast<__m128i*>(index[3]), _mm_add_epi32(row1, column1));
+        __m128 h[4];
+        for (uint32_t corner = 0; corner < 4; corner++)
+        {
+            h[corner] = _mm_setr_ps(samples[index[corner][0]], samples[index[corner][1]],
+                                    samples[index[corner][2]], samples[index[corner][3]]);
+        }
+
+        __m128 top = _mm_add_ps(h[0], _mm_mul_ps(_mm_sub_ps(h[1], h[0]), fx));
+        __m128 bottom = _mm_add_ps(h[2], _mm_mul_ps(_mm_sub_ps(h[3], h[2]), fx));
+        return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), fy));
+    }
+
+    CPU_TARGET_SSE41 void SampleHeightsSse41(const HeightfieldLayout& layout, const float* samples,
+                                             const float* x, const float* z, float* heights, size_t count)
+    {
+        const LayoutSse41 constants = LoadLayoutSse41(layout);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 tx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i), constants.ScaleX), constants.OffsetX);
+            __m128 ty = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(z + i), constants.ScaleZ), constants.OffsetZ);
+            _mm_storeu_ps(heights + i, _mm_mul_ps(BilinearSse41(constants, samples, tx, ty), constants.HeightScale));
+        }
+        SampleHeightsScalar(layout, samples, x + i, z + i, heights + i, count - i);
+    }
+
+    CPU_TARGET_SSE41 void SampleNormalsSse41(const HeightfieldLayout& layout, const float* samples,
+                                             const float* x, const float* z, HeightfieldSamples output, size_t count)
+    {
+        const LayoutSse41 constants = LoadLayoutSse41(layout);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+        const __m128 four = _mm_set1_ps(4.0f);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 tx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i), constants.ScaleX), constants.OffsetX);
+            __m128 ty = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(z + i), constants.ScaleZ), constants.OffsetZ);
+            __m128 h = _mm_mul_ps(BilinearSse41(constants, samples, tx, ty), constants.HeightScale);
+            __m128 hL = _mm_mul_ps(BilinearSse41(constants, samples, _mm_sub_ps(tx, one), ty), constants.HeightScale);
+            __m128 hR = _mm_mul_ps(BilinearSse41(constants, samples, _mm_add_ps(tx, one), ty), constants.HeightScale);
+            __m128 hD = _mm_mul_ps(BilinearSse41(constants, samples, tx, _mm_add_ps(ty, one)), constants.HeightScale);
+            __m128 hU = _mm_mul_ps(BilinearSse41(constants, samples, tx, _mm_sub_ps(ty, one)), constants.HeightScale);
+
+            __m128 nx = _mm_sub_ps(hL, hR);
+            __m128 nz = _mm_sub_ps(hD, hU);
+            __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), four), _mm_mul_ps(nz, nz));
+            __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+            _mm_storeu_ps(output.Heights + i, h);
+            _mm_storeu_ps(output.NormalX + i, _mm_mul_ps(nx, invLength));
+            _mm_storeu_ps(output.NormalY + i, _mm_mul_ps(two, invLength));
+            _mm_storeu_ps(output.NormalZ + i, _mm_mul_ps(nz, invLength));
+        }
+        SampleNormalsScalar(layout, samples, x + i, z + i, output.Offset(i), count - i);
+    }
+
+    CPU_TARGET_AVX2 __m256i SpreadTileBitsAvx2(__m256i value)
+    {
+        __m256i bit0 = _mm256_and_si256(value, _mm256_set1_epi32(1));
+        __m256i bit1 = _mm256_slli_epi32(_mm256_and_si256(value, _mm256_set1_epi32(2)), 1);
+        __m256i bit2 = _mm256_slli_epi32(_mm256_and_si256(value, _mm256_set1_epi32(4)), 2);
+        return _mm256_or_si256(bit0, _mm256_or_si256(bit1, bit2));
+    }
+
+    CPU_TARGET_AVX2 __m256i ColumnOffsetAvx2(__m256i x)
+    {
+        __m256i tile = _mm256_slli_epi32(_mm256_srli_epi32(x, TileShift), 6);
+        return _mm256_or_si256(tile, SpreadTileBitsAvx2(_mm256_and_si256(x, _mm256_set1_epi32(TileMask))));
+    }
+
+    CPU_TARGET_AVX2 __m256i RowOffsetAvx2(__m256i y, __m256i tileRowStride)
+    {
+        __m256i tile = _mm256_mullo_epi32(_mm256_srli_epi32(y, TileShift), tileRowStride);
+        __m256i inTile = _mm256_slli_epi32(SpreadTileBitsAvx2(_mm256_and_si256(y, _mm256_set1_epi32(TileMask))), 1);
+        return _mm256_add_epi32(tile, inTile);
+    }
+
+    struct LayoutAvx2
+    {
+        __m256 ScaleX, OffsetX, ScaleZ, OffsetZ, HeightScale;
+        __m256 MaxTexelX, MaxTexelY;
+        __m256i MaxX, MaxY, TileRowStride;
+    };
+
+    CPU_TARGET_AVX2 LayoutAvx2 LoadLayoutAvx2(const HeightfieldLayout& layout)
+    {
+        LayoutAvx2 result;
+        result.ScaleX = _mm256_set1_ps(layout.ScaleX);
+        result.OffsetX = _mm256_set1_ps(layout.OffsetX);
+        result.ScaleZ = _mm256_set1_ps(layout.ScaleZ);
+        result.OffsetZ = _mm256_set1_ps(layout.OffsetZ);
+        result.HeightScale = _mm256_set1_ps(layout.HeightScale);
+        result.MaxTexelX = _mm256_set1_ps((float)layout.Width);
+        result.MaxTexelY = _mm256_set1_ps((float)layout.Height);
+        result.MaxX = _mm256_set1_epi32((int)layout.Width - 1);
+        result.MaxY = _mm256_set1_epi32((int)layout.Height - 1);
+        result.TileRowStride = _mm256_set1_epi32((int)layout.TileRowStride);
+        return result;
+    }
+
+    CPU_TARGET_AVX2 __m256 BilinearAvx2(const LayoutAvx2& layout, const float* samples, __m256 tx, __m256 ty)
+    {
+        const __m256 minTexel = _mm256_set1_ps(-1.0f);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i one = _mm256_set1_epi32(1);
+
+        tx = _mm256_min_ps(_mm256_max_ps(tx, minTexel), layout.MaxTexelX);
+        ty = _mm256_min_ps(_mm256_max_ps(ty, minTexel), layout.MaxTexelY);
+        __m256 floorX = _mm256_floor_ps(tx);
+        __m256 floorY = _mm256_floor_ps(ty);
+        __m256 fx = _mm256_sub_ps(tx, floorX);
+        __m256 fy = _mm256_sub_ps(ty, floorY);
+
+        __m256i x0 = _mm256_cvttps_epi32(floorX);
+        __m256i y0 = _mm256_cvttps_epi32(floorY);
+        __m256i x1 = _mm256_add_epi32(x0, one);
+        __m256i y1 = _mm256_add_epi32(y0, one);
+        __m256i column0 = ColumnOffsetAvx2(_mm256_max_epi32(zero, _mm256_min_epi32(x0, layout.MaxX)));
+        __m256i column1 = ColumnOffsetAvx2(_mm256_max_epi32(zero, _mm256_min_epi32(x1, layout.MaxX)));
+        __m256i row0 = RowOffsetAvx2(_mm256_max_epi32(zero, _mm256_min_epi32(y0, layout.MaxY)), layout.TileRowStride);
+        __m256i row1 = RowOffsetAvx2(_mm256_max_epi32(zero, _mm256_min_epi32(y1, layout.MaxY)), layout.TileRowStride);
+
+        __m256 h00 = _mm256_i32gather_ps(samples, _mm256_add_epi32(row0, column0), 4);
+        __m256 h01 = _mm256_i32gather_ps(samples, _mm256_add_epi32(row0, column1), 4);
+        __m256 h10 = _mm256_i32gather_ps(samples, _mm256_add_epi32(row1, column0), 4);
+        __m256 h11 = _mm256_i32gather_ps(samples, _mm256_add_epi32(row1, column1), 4);
+
+        __m256 top = _mm256_add_ps(h00, _mm256_mul_ps(_mm256_sub_ps(h01, h00), fx));
+        __m256 bottom = _mm256_add_ps(h10, _mm256_mul_ps(_mm256_sub_ps(h11, h10), fx));
+        return _mm256_add_ps(top, _mm256_mul_ps(_mm256_sub_ps(bottom, top), fy));
+    }
+
+    CPU_TARGET_AVX2 void SampleHeightsAvx2(const HeightfieldLayout& layout, const float* samples,
+                                           const float* x, const float* z, float* heights, size_t count)
+    {
+        const LayoutAvx2 constants = LoadLayoutAvx2(layout);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 tx = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(x + i), constants.ScaleX), constants.OffsetX);
+            __m256 ty = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(z + i), constants.ScaleZ), constants.OffsetZ);
+            _mm256_storeu_ps(heights + i, _mm256_mul_ps(BilinearAvx2(constants, samples, tx, ty), constants.HeightScale));
+        }
+        SampleHeightsScalar(layout, samples, x + i, z + i, heights + i, count - i);
+    }
+
+    CPU_TARGET_AVX2 void SampleNormalsAvx2(const HeightfieldLayout& layout, const float* samples,
+                                           const float* x, const float* z, HeightfieldSamples output, size_t count)
+    {
+        const LayoutAvx2 constants = LoadLayoutAvx2(layout);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 two = _mm256_set1_ps(2.0f);
+        const __m256 four = _mm256_set1_ps(4.0f);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 tx = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(x + i), constants.ScaleX), constants.OffsetX);
+            __m256 ty = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(z + i), constants.ScaleZ), constants.OffsetZ);
+            __m256 h = _mm256_mul_ps(BilinearAvx2(constants, samples, tx, ty), constants.HeightScale);
+            __m256 hL = _mm256_mul_ps(BilinearAvx2(constants, samples, _mm256_sub_ps(tx, one), ty), constants.HeightScale);
+            __m256 hR = _mm256_mul_ps(BilinearAvx2(constants, samples, _mm256_add_ps(tx, one), ty), constants.HeightScale);
+            __m256 hD = _mm256_mul_ps(BilinearAvx2(constants, samples, tx, _mm256_add_ps(ty, one)), constants.HeightScale);
+            __m256 hU = _mm256_mul_ps(BilinearAvx2(constants, samples, tx, _mm256_sub_ps(ty, one)), constants.HeightScale);
+
+            __m256 nx = _mm256_sub_ps(hL, hR);
+            __m256 nz = _mm256_sub_ps(hD, hU);
+            __m256 lengthSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), four), _mm256_mul_ps(nz, nz));
+            __m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSquared));
+            _mm256_storeu_ps(output.Heights + i, h);
+            _mm256_storeu_ps(output.NormalX + i, _mm256_mul_ps(nx, invLength));
+            _mm256_storeu_ps(output.NormalY + i, _mm256_mul_ps(two, invLength));
+            _mm256_storeu_ps(output.NormalZ + i, _mm256_mul_ps(nz, invLength));
+        }
+        SampleNormalsScalar(layout, samples, x + i, z + i, output.Offset(i), count - i);
+    }
+#endif
+}
+
+Heightfield::Heightfield(SimdLevel level)
+    : mLayout(), mLevel(SimdLevel::Scalar), mSample(SampleHeightsScalar), mSampleNormals(SampleNormalsScalar)
+{
+    SetSimdLevel(level);
+}
+
+void Heightfield::Build(const std::vector<float>& values, uint32_t width, uint32_t height,
+                        float terrainSizeX, float terrainSizeZ, float heightScale)
+{
+    mSamples.clear();
+    mLayout = HeightfieldLayout();
+    if (width == 0 || height == 0 || values.size() < (size_t)width * height ||
+        terrainSizeX <= 0.0f || terrainSizeZ <= 0.0f)
+    {
+        return;
+    }
+
+    // Размеры выравниваются до целых тайлов; лишние тексели никогда не читаются
+    uint32_t paddedWidth = (width + TileMask) & ~TileMask;
+    uint32_t paddedHeight = (height + TileMask) & ~TileMask;
+
+    mLayout.Width = width;
+    mLayout.Height = height;
+    mLayout.TileRowStride = paddedWidth << TileShift;
+    mLayout.ScaleX = width / terrainSizeX;
+    mLayout.OffsetX = -0.5f;
+    mLayout.ScaleZ = -(height / terrainSizeZ);
+    mLayout.OffsetZ = height - 0.5f;
+    mLayout.HeightScale = heightScale;
+
+    mSamples.assign((size_t)paddedWidth * paddedHeight, 0.0f);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const float* row = &values[(size_t)y * width];
+        uint32_t rowOffset = RowOffset(mLayout, y);
+        for (uint32_t x = 0; x < width; x++)
+        {
+            mSamples[rowOffset + ColumnOffset(x)] = row[x];
+        }
+    }
+}
+
+void Heightfield::SetSimdLevel(SimdLevel level)
+{
+    mLevel = std::min(level, GetSupportedSimdLevel());
+    switch (mLevel)
+    {
+#ifdef CPU_X86
+    case SimdLevel::Avx2:
+        mSample = SampleHeightsAvx2;
+        mSampleNormals = SampleNormalsAvx2;
+        break;
+    case SimdLevel::Sse41:
+        mSample = SampleHeightsSse41;
+        mSampleNormals = SampleNormalsSse41;
+        break;
+#endif
+    default:
+        mSample = SampleHeightsScalar;
+        mSampleNormals = SampleNormalsScalar;
+        break;
+    }
+}
+
+float Heightfield::GetSample(int x, int y) const
+{
+    x = std::max(0, std::min(x, (int)mLayout.Width - 1));
+    y = std::max(0, std::min(y, (int)mLayout.Height - 1));
+    return mSamples[RowOffset(mLayout, (uint32_t)y) + ColumnOffset((uint32_t)x)];
+}
+
+float Heightfield::SampleHeight(float x, float z) const
+{
+    if (mSamples.empty())
+    {
+        return 0.0f;
+    }
+    return SampleScalar(mLayout, mSamples.data(), x, z);
+}
+
+void Heightfield::SampleHeights(const float* x, const float* z, float* heights, size_t count,
+                                WorkStealingPool* pool) const
+{
+    if (mSamples.empty())
+    {
+        std::fill(heights, heights + count, 0.0f);
+        return;
+    }
+    if (pool == nullptr || count < ParallelQueryThreshold)
+    {
+        mSample(mLayout, mSamples.data(), x, z, heights, count);
+        return;
+    }
+
+    pool->Run((uint32_t)((count + QueriesPerTask - 1) / QueriesPerTask), [&](uint32_t task, uint32_t)
+    {
+        size_t first = task * QueriesPerTask;
+        mSample(mLayout, mSamples.data(), x + first, z + first, heights + first, std::min(QueriesPerTask, count - first));
+    });
+}
+
+void Heightfield::SampleHeightsAndNormals(const float* x, const float* z, const HeightfieldSamples& output, size_t count,
+                                          WorkStealingPool* pool) const
+{
+    if (mSamples.empty())
+    {
+        // Плоская земля
+        std::fill(output.Heights, output.Heights + count, 0.0f);
+        std::fill(output.NormalX, output.NormalX + count, 0.0f);
+        std::fill(output.NormalY, output.NormalY + count, 1.0f);
+        std::fill(output.NormalZ, output.NormalZ + count, 0.0f);
+        return;
+    }
+    if (pool == nullptr || count < ParallelQueryThreshold)
+    {
+        mSampleNormals(mLayout, mSamples.data(), x, z, output, count);
+        return;
+    }
+
+    pool->Run((uint32_t)((count + QueriesPerTask - 1) / QueriesPerTask), [&](uint32_t task, uint32_t)
+    {
+        size_t first = task * QueriesPerTask;
+        mSampleNormals(mLayout, mSamples.data(), x + first, z + first, output.Offset(first),
+                       std::min(QueriesPerTask, count - first));
+    });
+}
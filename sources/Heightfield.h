@@ -0,0 +1,92 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Параметры выборки: перевод мировых координат в тексели и шаг строки тайлов хранилища
+struct HeightfieldLayout
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t TileRowStride;    // Значений в строке тайлов 8x8 (ширина с выравниванием * 8)
+    float ScaleX;              // tx = x * ScaleX + OffsetX - координата в текселях, центры на .5
+    float OffsetX;
+    float ScaleZ;              // ty = z * ScaleZ + OffsetZ, v = 1 - z / размер по Z
+    float OffsetZ;
+    float HeightScale;         // Мировая высота значения 1.0, как gHeightScale в шейдерах
+};
+
+// Выходные массивы пакетного запроса высот и нормалей (структура массивов, по count значений)
+struct HeightfieldSamples
+{
+    float* Heights;
+    float* NormalX;
+    float* NormalY;
+    float* NormalZ;
+
+    HeightfieldSamples Offset(size_t first) const
+    {
+        HeightfieldSamples result = { Heights + first, NormalX + first, NormalY + first, NormalZ + first };
+        return result;
+    }
+};
+
+class WorkStealingPool;
+
+// Карта высот в памяти процессора для запросов высоты (физика, пикинг, отсечение).
+// Значения хранятся тайлами 8x8 по 256 байт, внутри тайла - в порядке Мортона: четыре
+// тексела билинейной выборки почти всегда в одной-двух кэш-линиях при любом направлении
+// обхода, тогда как построчно соседние по Z тексели разнесены на всю ширину карты.
+// Выборка повторяет ds.hlsl: u = x / размер по X, v = 1 - z / размер по Z, билинейная
+// фильтрация с зажатием на краях, результат - значение * HeightScale.
+class Heightfield
+{
+public:
+    explicit Heightfield(SimdLevel level = GetSupportedSimdLevel());
+
+    // values - нормированные высоты 0..1 построчно (строка 0 соответствует v = 0),
+    // как канал R карты высот; terrainSizeX/Z - мировой размер, который покрывает карта
+    void Build(const std::vector<float>& values, uint32_t width, uint32_t height,
+               float terrainSizeX, float terrainSizeZ, float heightScale);
+
+    bool IsEmpty() const { return mSamples.empty(); }
+    uint32_t GetWidth() const { return mLayout.Width; }
+    uint32_t GetHeight() const { return mLayout.Height; }
+    float GetHeightScale() const { return mLayout.HeightScale; }
+    const HeightfieldLayout& GetLayout() const { return mLayout; }
+
+    // Уровень выше поддерживаемого понижается до поддерживаемого
+    void SetSimdLevel(SimdLevel level);
+    SimdLevel GetSimdLevel() const { return mLevel; }
+
+    // Нормированное значение текселя, координаты зажимаются в границы карты
+    float GetSample(int x, int y) const;
+
+    // Мировая высота в точке (x, z); пустая карта - 0
+    float SampleHeight(float x, float z) const;
+
+    // Высоты count точек за вызов: по 8 (AVX2, сбор через vgatherdps) или 4 (SSE4.1) точек
+    // за итерацию, остаток скалярно. Выгоднее всего пачками от 8-16 точек.
+    // Большие пачки с pool делятся между потоками пула.
+    void SampleHeights(const float* x, const float* z, float* heights, size_t count,
+                       WorkStealingPool* pool = nullptr) const;
+
+    // Высоты и единичные нормали count точек. Нормаль считается как в ds.hlsl - центральными
+    // разностями высот в +-1 тексель, так что совпадает с освещением отрисованного террейна.
+    void SampleHeightsAndNormals(const float* x, const float* z, const HeightfieldSamples& output, size_t count,
+                                 WorkStealingPool* pool = nullptr) const;
+
+private:
+    typedef void (*SampleFunction)(const HeightfieldLayout& layout, const float* samples,
+                                   const float* x, const float* z, float* heights, size_t count);
+    typedef void (*SampleNormalsFunction)(const HeightfieldLayout& layout, const float* samples,
+                                          const float* x, const float* z, HeightfieldSamples output, size_t count);
+
+    HeightfieldLayout mLayout;
+    std::vector<float> mSamples;
+    SimdLevel mLevel;
+    SampleFunction mSample;
+    SampleNormalsFunction mSampleNormals;
+};
@@ -0,0 +1,120 @@
+#include "HeightfieldFile.h"
+#include "TiffReader.h"
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+    // Строк TIFF, читаемых и записываемых за раз
+    const uint32_t ConvertRowsPerChunk = 64;
+}
+
+HeightfieldFile::HeightfieldFile()
+    : mHeader(nullptr), mSamples(nullptr)
+{
+}
+
+bool HeightfieldFile::Open(const std::string& path)
+{
+    Close();
+    if (!mFile.Open(path) || mFile.GetSize() < sizeof(HeightfieldHeader))
+    {
+        Close();
+        return false;
+    }
+
+    // Отображение выровнено на страницу, так что заголовок можно читать на месте
+    const HeightfieldHeader* header = reinterpret_cast<const HeightfieldHeader*>(mFile.GetData());
+    uint64_t dataSize = (uint64_t)header->Width * header->Height * sizeof(uint16_t);
+    if (header->Magic != HeightfieldMagic || header->Version != HeightfieldVersion ||
+        header->Width == 0 || header->Height == 0 ||
+        header->DataOffset < sizeof(HeightfieldHeader) || header->DataOffset % sizeof(uint16_t) != 0 ||
+        header->DataOffset + dataSize > mFile.GetSize())
+    {
+        Close();
+        return false;
+    }
+
+    mHeader = header;
+    mSamples = reinterpret_cast<const uint16_t*>(mFile.GetData() + header->DataOffset);
+    return true;
+}
+
+void HeightfieldFile::Close()
+{
+    mFile.Close();
+    mHeader = nullptr;
+    mSamples = nullptr;
+}
+
+bool ConvertTiffToHeightfield(const std::string& tiffPath, const std::string& outputPath,
+                              int32_t tileX, int32_t tileY, float heightScale)
+{
+    TiffStripReader reader;
+    if (!reader.Open(tiffPath))
+    {
+        return false;
+    }
+
+    HeightfieldHeader header = {};
+    header.Magic = HeightfieldMagic;
+    header.Version = HeightfieldVersion;
+    header.Width = reader.GetWidth();
+    header.Height = reader.GetHeight();
+    header.TileX = tileX;
+    header.TileY = tileY;
+    header.MinSample = 65535;
+    header.MaxSample = 0;
+    header.HeightScale = heightScale;
+    header.DataOffset = sizeof(HeightfieldHeader);
+
+    // Заголовок пишется дважды: место под него сейчас, min/max - после всех строк.
+    // Значения идут в порядке байт процессора - формат рассчитан на little-endian x86/x64.
+    std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+    if (!output.write(reinterpret_cast<const char*>(&header), sizeof(header)))
+    {
+        return false;
+    }
+
+    std::vector<uint16_t> chunk((size_t)header.Width * ConvertRowsPerChunk);
+    for (uint32_t row = 0; row < header.Height; row += ConvertRowsPerChunk)
+    {
+        uint32_t rows = std::min(ConvertRowsPerChunk, header.Height - row);
+        size_t count = (size_t)rows * header.Width;
+        if (!reader.ReadRows(row, rows, chunk.data()))
+        {
+            return false;
+        }
+
+        auto range = std::minmax_element(chunk.begin(), chunk.begin() + count);
+        header.MinSample = std::min(header.MinSample, *range.first);
+        header.MaxSample = std::max(header.MaxSample, *range.second);
+
+        if (!output.write(reinterpret_cast<const char*>(chunk.data()), (std::streamsize)(count * sizeof(uint16_t))))
+        {
+            return false;
+        }
+    }
+
+    output.seekp(0);
+    return (bool)output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+uint32_t ConvertGaeaHeightTiles(const std::string& directory, const std::string& baseName,
+                                uint32_t tilesX, uint32_t tilesY, float heightScale)
+{
+    uint32_t converted = 0;
+    for (uint32_t y = 0; y < tilesY; y++)
+    {
+        for (uint32_t x = 0; x < tilesX; x++)
+        {
+            std::string tile = directory + "/" + baseName + "_y" + std::to_string(y) + "_x" + std::to_string(x);
+            if (ConvertTiffToHeightfield(tile + ".tif", tile + ".hfd", (int32_t)x, (int32_t)y, heightScale))
+            {
+                converted++;
+            }
+        }
+    }
+    return converted;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "MappedFile.h"
+#include <string>
+#include <cstdint>
+
+// Упакованная карта высот (.hfd): 64-байтный заголовок и сразу за ним Width * Height значений
+// uint16 little-endian построчно. Файл отображается в память и используется как есть -
+// ни разбора, ни копирования; данные выровнены на 64 байта от начала отображения.
+struct HeightfieldHeader
+{
+    uint32_t Magic;            // HeightfieldMagic
+    uint32_t Version;
+    uint32_t Width;
+    uint32_t Height;
+    int32_t TileX;             // Позиция в сетке тайлов Gaea, -1 - карта целиком
+    int32_t TileY;
+    uint16_t MinSample;        // Диапазон значений, 0..65535
+    uint16_t MaxSample;
+    float HeightScale;         // Мировая высота значения 65535
+    uint32_t DataOffset;       // От начала файла
+    uint32_t Reserved[7];
+};
+
+static_assert(sizeof(HeightfieldHeader) == 64, "Heightfield header layout is part of the file format");
+
+const uint32_t HeightfieldMagic = 0x444C4648;     // "HFLD"
+const uint32_t HeightfieldVersion = 1;
+
+// Карта высот, отображённая из .hfd файла
+class HeightfieldFile
+{
+public:
+    HeightfieldFile();
+
+    // Одно отображение и проверка заголовка; false - файла нет, он обрезан или другой версии
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const { return mHeader != nullptr; }
+    const HeightfieldHeader& GetHeader() const { return *mHeader; }
+    uint32_t GetWidth() const { return mHeader->Width; }
+    uint32_t GetHeight() const { return mHeader->Height; }
+
+    // Значения построчно, строка 0 соответствует v = 0
+    const uint16_t* GetSamples() const { return mSamples; }
+    uint16_t GetSample(uint32_t x, uint32_t y) const { return mSamples[(size_t)y * mHeader->Width + x]; }
+
+    // Множитель значения в мировую высоту
+    float GetSampleScale() const { return mHeader->HeightScale / 65535.0f; }
+
+private:
+    MappedFile mFile;
+    const HeightfieldHeader* mHeader;
+    const uint16_t* mSamples;
+};
+
+// Переводит 16-битный TIFF Gaea в .hfd, читая его полосами: в памяти только одна порция строк.
+// tileX, tileY - позиция тайла (-1 для карты целиком), heightScale - мировая высота 65535.
+bool ConvertTiffToHeightfield(const std::string& tiffPath, const std::string& outputPath,
+                              int32_t tileX, int32_t tileY, float heightScale);
+
+// Переводит тайлы экспорта Gaea directory/baseName_y<Y>_x<X>.tif в .hfd рядом с ними.
+// Возвращает число переведённых тайлов.
+uint32_t ConvertGaeaHeightTiles(const std::string& directory, const std::string& baseName,
+                                uint32_t tilesX, uint32_t tilesY, float heightScale);
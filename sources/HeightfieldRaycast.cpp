@@ -0,0 +1,307 @@
+#include "HeightfieldRaycast.h"
+#include "Heightfield.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Пачки от ParallelRayThreshold лучей делятся между потоками по RaysPerTask
+    const size_t ParallelRayThreshold = 1024;
+    const size_t RaysPerTask = 256;
+
+    // Сужает [t0, t1] до участка, где origin + dir * t лежит в [lo, hi]
+    bool ClipSlab(double origin, double dir, double lo, double hi, double& t0, double& t1)
+    {
+        if (dir == 0.0)
+        {
+            return origin >= lo && origin <= hi;
+        }
+        double ta = (lo - origin) / dir;
+        double tb = (hi - origin) / dir;
+        if (ta > tb)
+        {
+            std::swap(ta, tb);
+        }
+        t0 = std::max(t0, ta);
+        t1 = std::min(t1, tb);
+        return t0 <= t1;
+    }
+}
+
+HeightfieldRaycaster::HeightfieldRaycaster()
+    : mHeightfield(nullptr)
+{
+}
+
+void HeightfieldRaycaster::Build(const Heightfield& heightfield)
+{
+    mLevels.clear();
+    mHeightfield = &heightfield;
+    if (heightfield.IsEmpty())
+    {
+        return;
+    }
+
+    // Ячейка i лежит между текселями i - 1 и i: крайние ячейки - полосы зажатия у границ карты
+    Level cells;
+    cells.Width = heightfield.GetWidth() + 1;
+    cells.Height = heightfield.GetHeight() + 1;
+    cells.Max.resize((size_t)cells.Width * cells.Height);
+    for (uint32_t y = 0; y < cells.Height; y++)
+    {
+        for (uint32_t x = 0; x < cells.Width; x++)
+        {
+            float h00 = heightfield.GetSample((int)x - 1, (int)y - 1);
+            float h01 = heightfield.GetSample((int)x, (int)y - 1);
+            float h10 = heightfield.GetSample((int)x - 1, (int)y);
+            float h11 = heightfield.GetSample((int)x, (int)y);
+            cells.Max[(size_t)y * cells.Width + x] = std::max(std::max(h00, h01), std::max(h10, h11));
+        }
+    }
+    mLevels.push_back(std::move(cells));
+
+    while (mLevels.back().Width > 1 || mLevels.back().Height > 1)
+    {
+        const Level& src = mLevels.back();
+
+        Level dst;
+        dst.Width = (src.Width + 1) / 2;
+        dst.Height = (src.Height + 1) / 2;
+        dst.Max.resize((size_t)dst.Width * dst.Height);
+
+        for (uint32_t y = 0; y < dst.Height; y++)
+        {
+            uint32_t y0 = 2 * y;
+            uint32_t y1 = std::min(y0 + 1, src.Height - 1);
+            for (uint32_t x = 0; x < dst.Width; x++)
+            {
+                uint32_t x0 = 2 * x;
+                uint32_t x1 = std::min(x0 + 1, src.Width - 1);
+
+                size_t i00 = (size_t)y0 * src.Width + x0;
+                size_t i01 = (size_t)y0 * src.Width + x1;
+                size_t i10 = (size_t)y1 * src.Width + x0;
+                size_t i11 = (size_t)y1 * src.Width + x1;
+
+                dst.Max[(size_t)y * dst.Width + x] = std::max(std::max(src.Max[i00], src.Max[i01]),
+                                                              std::max(src.Max[i10], src.Max[i11]));
+            }
+        }
+
+        mLevels.push_back(std::move(dst));
+    }
+}
+
+bool HeightfieldRaycaster::IntersectCell(const TexelRay& ray, uint32_t cellX, uint32_t cellY,
+                                         double t0, double t1, double& t) const
+{
+    // Углы ячейки и билинейный патч h(u, v) = a + e1 u + e2 v + e3 u v, u, v - от угла ячейки
+    int x0 = (int)cellX - 1;
+    int y0 = (int)cellY - 1;
+    double a = mHeightfield->GetSample(x0, y0);
+    double b = mHeightfield->GetSample(x0 + 1, y0);
+    double c = mHeightfield->GetSample(x0, y0 + 1);
+    double d = mHeightfield->GetSample(x0 + 1, y0 + 1);
+    double e1 = b - a;
+    double e2 = c - a;
+    double e3 = a - b - c + d;
+
+    // Вдоль луча u = u0 + DX s, v = v0 + DY s, s = t - t0: луч минус патч - квадратный трёхчлен
+    double u0 = ray.X + ray.DX * t0 - x0;
+    double v0 = ray.Y + ray.DY * t0 - y0;
+    double qa = e3 * ray.DX * ray.DY;
+    double qb = e1 * ray.DX + e2 * ray.DY + e3 * (u0 * ray.DY + v0 * ray.DX) - ray.DH;
+    double qc = ray.H + ray.DH * t0 - (a + e1 * u0 + e2 * v0 + e3 * u0 * v0);   // Высота луча над патчем
+    double length = t1 - t0;
+
+    if (qc <= 0.0)
+    {
+        t = t0;
+        return true;
+    }
+
+    // Высота над патчем qc - qb s - qa s^2; ищем её первый ноль на [0, length], луч входит сверху
+    double root = -1.0;
+    double discriminant = qb * qb + 4.0 * qa * qc;
+    if (discriminant >= 0.0)
+    {
+        // Корни qa s^2 + qb s - qc в устойчивой форме, без вычитания близких чисел; при qa = 0
+        // остаётся линейный корень qc / qb
+        double q = -0.5 * (qb + std::copysign(std::sqrt(discriminant), qb));
+        if (q != 0.0)
+        {
+            double r0 = qa != 0.0 ? q / qa : -1.0;
+            double r1 = -qc / q;
+            if (r0 > r1)
+            {
+                std::swap(r0, r1);
+            }
+            root = r0 >= 0.0 ? r0 : r1;
+        }
+    }
+
+    if (root >= 0.0 && root <= length)
+    {
+        t = t0 + root;
+        return true;
+    }
+    return false;
+}
+
+bool HeightfieldRaycaster::Raycast(const TerrainRay& worldRay, float& distance) const
+{
+    if (mLevels.empty() || !(worldRay.MaxDistance >= 0.0f))
+    {
+        return false;
+    }
+
+    // Координаты до 4096 текселей и скользящие лучи требуют двойной точности: в float касание
+    // поверхности путается с пролётом над ней на тысячные доли единицы
+    const HeightfieldLayout& layout = mHeightfield->GetLayout();
+    TexelRay ray;
+    ray.X = (double)worldRay.OriginX * layout.ScaleX + layout.OffsetX;
+    ray.Y = (double)worldRay.OriginZ * layout.ScaleZ + layout.OffsetZ;
+    ray.H = (double)worldRay.OriginY / layout.HeightScale;
+    ray.DX = (double)worldRay.DirectionX * layout.ScaleX;
+    ray.DY = (double)worldRay.DirectionZ * layout.ScaleZ;
+    ray.DH = (double)worldRay.DirectionY / layout.HeightScale;
+
+    // Карта покрывает тексели [-0.5, size - 0.5] - ровно мировые [0, размер террейна]
+    double t = 0.0;
+    double tEnd = worldRay.MaxDistance;
+    if (!ClipSlab(ray.X, ray.DX, -0.5, layout.Width - 0.5, t, tEnd) ||
+        !ClipSlab(ray.Y, ray.DY, -0.5, layout.Height - 0.5, t, tEnd))
+    {
+        return false;
+    }
+
+    if (t == 0.0 && worldRay.OriginY <= mHeightfield->SampleHeight(worldRay.OriginX, worldRay.OriginZ))
+    {
+        distance = 0.0f;
+        return true;
+    }
+
+    // Шаг по узлам уровня в сторону луча; узлы по краям ячеек, ячейка i начинается в текселе i - 1
+    const int stepX = ray.DX > 0.0 ? 1 : -1;
+    const int stepY = ray.DY > 0.0 ? 1 : -1;
+    const double invDX = ray.DX != 0.0 ? 1.0 / ray.DX : 0.0;
+    const double invDY = ray.DY != 0.0 ? 1.0 / ray.DY : 0.0;
+    const uint32_t topLevel = (uint32_t)mLevels.size() - 1;
+
+    uint32_t level = topLevel;
+    int nodeX = 0;
+    int nodeY = 0;
+    for (;;)
+    {
+        const Level& current = mLevels[level];
+        const double nodeSize = (double)(1u << level);
+        const double lowX = nodeX * nodeSize - 1.0;
+        const double lowY = nodeY * nodeSize - 1.0;
+
+        // Выход из узла по X и по Y; луч вдоль оси не выходит по ней вовсе
+        double exitX = ray.DX != 0.0 ? ((ray.DX > 0.0 ? lowX + nodeSize : lowX) - ray.X) * invDX : tEnd;
+        double exitY = ray.DY != 0.0 ? ((ray.DY > 0.0 ? lowY + nodeSize : lowY) - ray.Y) * invDY : tEnd;
+        double exit = std::max(t, std::min(std::min(exitX, exitY), tEnd));
+
+        // Высота луча линейна по t - её минимум на участке в одном из концов
+        double rayMin = std::min(ray.H + ray.DH * t, ray.H + ray.DH * exit);
+        bool above = rayMin > current.Max[(size_t)nodeY * current.Width + nodeX];
+
+        if (!above && level > 0)
+        {
+            // Спуск в ребёнка, где луч сейчас. Средняя линия сравнивается по времени пересечения,
+            // посчитанному так же, как выходы из узлов: на общей границе луч не возвращается
+            // в только что пройденный узел
+            level--;
+            double midX = lowX + 0.5 * nodeSize;
+            double midY = lowY + 0.5 * nodeSize;
+            bool upperX = ray.DX != 0.0 ? (((midX - ray.X) * invDX <= t) == (ray.DX > 0.0)) : ray.X >= midX;
+            bool upperY = ray.DY != 0.0 ? (((midY - ray.Y) * invDY <= t) == (ray.DY > 0.0)) : ray.Y >= midY;
+            nodeX = nodeX * 2 + (upperX ? 1 : 0);
+            nodeY = nodeY * 2 + (upperY ? 1 : 0);
+            nodeX = std::min(nodeX, (int)mLevels[level].Width - 1);
+            nodeY = std::min(nodeY, (int)mLevels[level].Height - 1);
+            continue;
+        }
+
+        if (!above)
+        {
+            double hit;
+            if (IntersectCell(ray, (uint32_t)nodeX, (uint32_t)nodeY, t, exit, hit))
+            {
+                distance = (float)hit;
+                return true;
+            }
+        }
+
+        // Узел пройден: соседний узел по оси раннего выхода. Если он в другом родителе, подъём
+        // на уровень выше - над открытыми участками луч снова идёт крупными шагами
+        if (exit >= tEnd)
+        {
+            return false;
+        }
+        int parentX = nodeX >> 1;
+        int parentY = nodeY >> 1;
+        if (exitX <= exitY)
+        {
+            nodeX += stepX;
+        }
+        else
+        {
+            nodeY += stepY;
+        }
+        if (nodeX < 0 || nodeY < 0 || nodeX >= (int)current.Width || nodeY >= (int)current.Height)
+        {
+            return false;
+        }
+        t = exit;
+        if (level < topLevel && ((nodeX >> 1) != parentX || (nodeY >> 1) != parentY))
+        {
+            level++;
+            nodeX >>= 1;
+            nodeY >>= 1;
+        }
+    }
+}
+
+void HeightfieldRaycaster::RaycastBatch(const TerrainRay* rays, float* distances, size_t count,
+                                        WorkStealingPool* pool) const
+{
+    auto trace = [&](size_t first, size_t last)
+    {
+        for (size_t i = first; i < last; i++)
+        {
+            float distance;
+            distances[i] = Raycast(rays[i], distance) ? distance : -1.0f;
+        }
+    };
+
+    if (pool == nullptr || count < ParallelRayThreshold)
+    {
+        trace(0, count);
+        return;
+    }
+
+    pool->Run((uint32_t)((count + RaysPerTask - 1) / RaysPerTask), [&](uint32_t task, uint32_t)
+    {
+        size_t first = task * RaysPerTask;
+        trace(first, std::min(first + RaysPerTask, count));
+    });
+}
+
+bool HeightfieldRaycaster::HasLineOfSight(float fromX, float fromY, float fromZ, float toX, float toY, float toZ) const
+{
+    float dx = toX - fromX;
+    float dy = toY - fromY;
+    float dz = toZ - fromZ;
+    float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+    if (length == 0.0f)
+    {
+        return true;
+    }
+
+    TerrainRay ray = { fromX, fromY, fromZ, dx / length, dy / length, dz / length, length };
+    float distance;
+    return !Raycast(ray, distance);
+}
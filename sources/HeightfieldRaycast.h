@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+class Heightfield;
+class WorkStealingPool;
+
+// Луч в мировых координатах; Direction - единичный вектор
+struct TerrainRay
+{
+    float OriginX, OriginY, OriginZ;
+    float DirectionX, DirectionY, DirectionZ;
+    float MaxDistance;
+};
+
+// Пересечение лучей с поверхностью Heightfield (пикинг, прямая видимость).
+// Поверхность - билинейные ячейки между центрами текселей, как её выбирает Heightfield.
+// Над ячейками строится иерархия максимумов: ячейка уровня 0 хранит максимум своих четырёх
+// углов, узел уровня L - максимум блока 2^L x 2^L ячеек (минимумы лучу сверху не нужны). Луч идёт по узлам без стека:
+// узел, над максимумом которого он проходит целиком, пропускается с подъёмом на уровень выше,
+// иначе луч спускается в ребёнка; в ячейке уровня 0 точка находится решением квадратного
+// уравнения луч - билинейный патч.
+class HeightfieldRaycaster
+{
+public:
+    HeightfieldRaycaster();
+
+    // Иерархия строится по карте; heightfield должен жить, пока используется Raycast
+    void Build(const Heightfield& heightfield);
+
+    bool IsEmpty() const { return mLevels.empty(); }
+
+    // Расстояние до первого пересечения не дальше ray.MaxDistance; false - пересечения нет.
+    // Начало под поверхностью - пересечение на расстоянии 0. Вне карты поверхности нет.
+    bool Raycast(const TerrainRay& ray, float& distance) const;
+
+    // distances[i] - расстояние до пересечения или -1, если его нет. Пачки от 1024 лучей
+    // с pool делятся между потоками пула.
+    void RaycastBatch(const TerrainRay* rays, float* distances, size_t count, WorkStealingPool* pool = nullptr) const;
+
+    // Прямая видимость между двумя точками: отрезок не пересекает поверхность
+    bool HasLineOfSight(float fromX, float fromY, float fromZ, float toX, float toY, float toZ) const;
+
+private:
+    struct Level
+    {
+        uint32_t Width;
+        uint32_t Height;
+        std::vector<float> Max;
+    };
+
+    // Луч в пространстве текселей: X, Y - координаты текселя, H - нормированная высота
+    struct TexelRay
+    {
+        double X, Y, H;
+        double DX, DY, DH;
+    };
+
+    // Первое пересечение с билинейным патчем ячейки на [t0, t1]
+    bool IntersectCell(const TexelRay& ray, uint32_t cellX, uint32_t cellY, double t0, double t1, double& t) const;
+
+    const Heightfield* mHeightfield;
+    std::vector<Level> mLevels;   // 0 - ячейки, последний - один узел на всю карту
+};
@@ -0,0 +1,225 @@
+#include "HorizonCulling.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+namespace
+{
+    // Камера ближе этого к прямоугольнику (по горизонтали) считается над ним
+    const float InsideEpsilon = 1e-3f;
+
+    // Запас на погрешность псевдоугла: загораживающие сектора сужаются, проверяемые - расширяются
+    const float AzimuthEpsilon = 1e-5f;
+
+    const float SectorsPerUnit = OcclusionHorizon::SectorCount / 4.0f;
+
+    // Монотонный по углу псевдоугол направления (dx, dz) в [0, 4) - без atan2
+    float PseudoAngle(float dx, float dz)
+    {
+        if (dz >= 0.0f)
+        {
+            return dx >= 0.0f ? dz / (dx + dz) : 1.0f - dx / (dz - dx);
+        }
+        return dx < 0.0f ? 2.0f - dz / (-dx - dz) : 3.0f + dx / (dx - dz);
+    }
+
+    // Корзин сортировки отложенных прямоугольников по расстоянию
+    const uint32_t DistanceBucketCount = 256;
+}
+
+OcclusionHorizon::OcclusionHorizon()
+    : mCameraX(0), mCameraY(0), mCameraZ(0), mNextPending(0), mPendingSorted(false)
+{
+    std::fill(mSlope, mSlope + SectorCount, -FLT_MAX);
+}
+
+void OcclusionHorizon::Reset(float cameraX, float cameraY, float cameraZ)
+{
+    mCameraX = cameraX;
+    mCameraY = cameraY;
+    mCameraZ = cameraZ;
+    std::fill(mSlope, mSlope + SectorCount, -FLT_MAX);
+    mPending.clear();
+    mOrder.clear();
+    mNextPending = 0;
+    mPendingSorted = false;
+}
+
+float OcclusionHorizon::NearestDistance(float minX, float minZ, float maxX, float maxZ) const
+{
+    float dx = std::max(std::max(minX - mCameraX, mCameraX - maxX), 0.0f);
+    float dz = std::max(std::max(minZ - mCameraZ, mCameraZ - maxZ), 0.0f);
+    return sqrtf(dx * dx + dz * dz);
+}
+
+float OcclusionHorizon::FarthestDistance(float minX, float minZ, float maxX, float maxZ) const
+{
+    float dx = std::max(mCameraX - minX, maxX - mCameraX);
+    float dz = std::max(mCameraZ - minZ, maxZ - mCameraZ);
+    return sqrtf(dx * dx + dz * dz);
+}
+
+bool OcclusionHorizon::AzimuthRange(float minX, float minZ, float maxX, float maxZ, float& first, float& last) const
+{
+    int sideX = mCameraX <= minX - InsideEpsilon ? -1 : (mCameraX >= maxX + InsideEpsilon ? 1 : 0);
+    int sideZ = mCameraZ <= minZ - InsideEpsilon ? -1 : (mCameraZ >= maxZ + InsideEpsilon ? 1 : 0);
+    if (sideX == 0 && sideZ == 0)
+    {
+        return false;
+    }
+
+    // Крайние направления на прямоугольник проходят через две вершины силуэта,
+    // которые определяются тем, с какой стороны от него камера
+    float x0, z0, x1, z1;
+    if (sideX == 0)
+    {
+        x0 = minX; x1 = maxX;
+        z0 = z1 = sideZ < 0 ? minZ : maxZ;
+    }
+    else if (sideZ == 0)
+    {
+        x0 = x1 = sideX < 0 ? minX : maxX;
+        z0 = minZ; z1 = maxZ;
+    }
+    else if (sideX == sideZ)
+    {
+        x0 = maxX; z0 = minZ;
+        x1 = minX; z1 = maxZ;
+    }
+    else
+    {
+        x0 = minX; z0 = minZ;
+        x1 = maxX; z1 = maxZ;
+    }
+
+    // Прямоугольник без камеры виден под углом меньше 180 градусов (2 в псевдоуглах),
+    // так что короткая дуга между вершинами силуэта однозначна
+    first = PseudoAngle(x0 - mCameraX, z0 - mCameraZ);
+    float span = PseudoAngle(x1 - mCameraX, z1 - mCameraZ) - first;
+    if (span >= 2.0f)
+    {
+        span -= 4.0f;
+    }
+    else if (span < -2.0f)
+    {
+        span += 4.0f;
+    }
+    if (span < 0.0f)
+    {
+        first += span;
+        span = -span;
+    }
+    last = first + span;
+    return true;
+}
+
+void OcclusionHorizon::QueueOccluder(float minX, float minZ, float maxX, float maxZ, float minY)
+{
+    Occluder occluder = { FarthestDistance(minX, minZ, maxX, maxZ), minX, minZ, maxX, maxZ, minY };
+    mPending.push_back(occluder);
+}
+
+void OcclusionHorizon::FlushOccluders(float distance)
+{
+    if (!mPendingSorted)
+    {
+        SortPending();
+    }
+
+    // Внутри корзины порядок произвольный: остановка на первом слишком дальнем только
+    // откладывает остальные до следующего вызова, раньше времени в горизонт ничего не попадает
+    while (mNextPending < mOrder.size())
+    {
+        const Occluder& occluder = mPending[mOrder[mNextPending]];
+        if (occluder.FarDistance > distance)
+        {
+            break;
+        }
+        AddOccluder(occluder);
+        mNextPending++;
+    }
+}
+
+void OcclusionHorizon::SortPending()
+{
+    // Сортировка подсчётом по корзинам расстояния - линейная, в отличие от std::sort,
+    // который на сотнях прямоугольников стоит дороже самого горизонта
+    float maxDistance = 0.0f;
+    for (const Occluder& occluder : mPending)
+    {
+        maxDistance = std::max(maxDistance, occluder.FarDistance);
+    }
+    float bucketScale = maxDistance > 0.0f ? (DistanceBucketCount - 1) / maxDistance : 0.0f;
+
+    mBucketStart.assign(DistanceBucketCount + 1, 0);
+    for (const Occluder& occluder : mPending)
+    {
+        mBucketStart[(uint32_t)(occluder.FarDistance * bucketScale) + 1]++;
+    }
+    for (uint32_t bucket = 0; bucket < DistanceBucketCount; bucket++)
+    {
+        mBucketStart[bucket + 1] += mBucketStart[bucket];
+    }
+
+    mOrder.resize(mPending.size());
+    for (uint32_t i = 0; i < (uint32_t)mPending.size(); i++)
+    {
+        mOrder[mBucketStart[(uint32_t)(mPending[i].FarDistance * bucketScale)]++] = i;
+    }
+    mPendingSorted = true;
+}
+
+void OcclusionHorizon::AddOccluder(const Occluder& occluder)
+{
+    float first, last;
+    if (!AzimuthRange(occluder.MinX, occluder.MinZ, occluder.MaxX, occluder.MaxZ, first, last))
+    {
+        return;
+    }
+
+    // Луч с наклоном s проходит над прямоугольником на расстояниях [dIn, dOut] своего азимута и
+    // упирается в поверхность, если cameraY + s * d <= minY хотя бы для одного d. Порог - минимум
+    // (minY - cameraY) / d по всем азимутам: при minY выше камеры худший случай - самая дальняя
+    // точка входа, иначе - самая ближняя точка выхода.
+    float height = occluder.MinY - mCameraY;
+    float slope = height >= 0.0f
+        ? height / occluder.FarDistance
+        : height / NearestDistance(occluder.MinX, occluder.MinZ, occluder.MaxX, occluder.MaxZ);
+
+    // Только сектора, целиком накрытые прямоугольником
+    int firstSector = (int)ceilf((first + AzimuthEpsilon) * SectorsPerUnit);
+    int lastSector = (int)floorf((last - AzimuthEpsilon) * SectorsPerUnit) - 1;
+    for (int sector = firstSector; sector <= lastSector; sector++)
+    {
+        float& threshold = mSlope[sector & (SectorCount - 1)];
+        threshold = std::max(threshold, slope);
+    }
+}
+
+bool OcclusionHorizon::IsOccluded(float minX, float minZ, float maxX, float maxZ, float maxY) const
+{
+    float first, last;
+    if (!AzimuthRange(minX, minZ, maxX, maxZ, first, last))
+    {
+        return false;
+    }
+
+    // Самый крутой луч в узел: к верху узла через ближайшую точку, если верх выше камеры,
+    // иначе через самую дальнюю
+    float height = maxY - mCameraY;
+    float slope = height >= 0.0f
+        ? height / NearestDistance(minX, minZ, maxX, maxZ)
+        : height / FarthestDistance(minX, minZ, maxX, maxZ);
+
+    // Все сектора, которых касается узел
+    int firstSector = (int)floorf((first - AzimuthEpsilon) * SectorsPerUnit);
+    int lastSector = (int)floorf((last + AzimuthEpsilon) * SectorsPerUnit);
+    for (int sector = firstSector; sector <= lastSector; sector++)
+    {
+        if (!(slope < mSlope[sector & (SectorCount - 1)]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
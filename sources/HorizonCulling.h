@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Горизонт вокруг камеры для отсечения перекрытых узлов террейна.
+// Для каждого направления (сектора азимута) хранится наклон (dy / горизонтальное расстояние),
+// ниже которого любой луч из камеры уже упёрся в рельеф. Горизонт строится из прямоугольников
+// с известной нижней границей высоты, так что он консервативен: загораживающая поверхность
+// не ниже minY, а проверяемый узел не выше maxY.
+//
+// Экранная линия горизонта для наклонённой камеры не консервативна (вертикаль мира на экране
+// не вертикальна), поэтому горизонт ведётся по азимуту в мировых координатах - от поворота
+// камеры он не зависит.
+class OcclusionHorizon
+{
+public:
+    static const uint32_t SectorCount = 1024;   // Степень двойки
+
+    OcclusionHorizon();
+
+    // Новый кадр: пустой горизонт вокруг камеры
+    void Reset(float cameraX, float cameraY, float cameraZ);
+
+    // Прямоугольник [minX, maxX] x [minZ, maxZ] с поверхностью не ниже minY. В горизонт он попадает
+    // только в FlushOccluders, когда все проверяемые дальше узлы гарантированно за ним.
+    // Все прямоугольники кадра ставятся в очередь до первого FlushOccluders.
+    void QueueOccluder(float minX, float minZ, float maxX, float maxZ, float minY);
+
+    // Добавляет в горизонт все отложенные прямоугольники, целиком лежащие ближе distance
+    // (горизонтальное расстояние от камеры). distance не убывает от вызова к вызову.
+    void FlushOccluders(float distance);
+
+    // Узел [minX, maxX] x [minZ, maxZ] не выше maxY целиком ниже горизонта.
+    // Узлы проверяются в порядке возрастания ближайшего горизонтального расстояния,
+    // перед проверкой вызывается FlushOccluders с этим расстоянием.
+    bool IsOccluded(float minX, float minZ, float maxX, float maxZ, float maxY) const;
+
+    // Ближайшее и самое дальнее горизонтальное расстояние от камеры до прямоугольника
+    float NearestDistance(float minX, float minZ, float maxX, float maxZ) const;
+    float FarthestDistance(float minX, float minZ, float maxX, float maxZ) const;
+
+private:
+    struct Occluder
+    {
+        float FarDistance;
+        float MinX, MinZ, MaxX, MaxZ;
+        float MinY;
+    };
+
+    // Диапазон азимутов прямоугольника в псевдоуглах [0, 4) на полный оборот, first может быть
+    // отрицательным, а last - больше 4. false - камера над прямоугольником.
+    bool AzimuthRange(float minX, float minZ, float maxX, float maxZ, float& first, float& last) const;
+    void SortPending();
+    void AddOccluder(const Occluder& occluder);
+
+    float mCameraX;
+    float mCameraY;
+    float mCameraZ;
+    float mSlope[SectorCount];          // Порог наклона сектора, -FLT_MAX - ничего не загорожено
+    std::vector<Occluder> mPending;
+    std::vector<uint32_t> mOrder;       // Номера mPending по корзинам FarDistance, строится в первом FlushOccluders
+    std::vector<uint32_t> mBucketStart;
+    size_t mNextPending;                // Первый номер, ещё не добавленный в горизонт
+    bool mPendingSorted;
+};
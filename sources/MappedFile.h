@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Файл, отображённый в память только для чтения (mmap на POSIX, CreateFileMapping на Windows).
+// Данные читаются прямо из страничного кэша, без промежуточного буфера.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // false, если файл не открылся, пустой или не отображается
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const { return mData != nullptr; }
+    const uint8_t* GetData() const { return mData; }
+    size_t GetSize() const { return mSize; }
+
+private:
+    const uint8_t* mData;
+    size_t mSize;
+#ifdef _WIN32
+    void* mFile;
+    void* mMapping;
+#endif
+};
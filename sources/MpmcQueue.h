@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Ограниченная lock-free очередь с несколькими писателями и читателями (схема Вьюкова).
+// У каждой ячейки свой счётчик последовательности: писатель и читатель захватывают
+// позицию одним CAS и дальше работают со своей ячейкой, не мешая остальным.
+// Ёмкость округляется вверх до степени двойки.
+template<typename T>
+class MpmcQueue
+{
+public:
+    explicit MpmcQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+
+        mCells = std::vector<Cell>(size);
+        mMask = size - 1;
+        for (size_t i = 0; i < size; i++)
+        {
+            mCells[i].Sequence.store(i, std::memory_order_relaxed);
+        }
+        mEnqueuePos.store(0, std::memory_order_relaxed);
+        mDequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    // false, если очередь заполнена
+    bool TryPush(const T& value)
+    {
+        size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = mCells[pos & mMask];
+            size_t sequence = cell.Sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.Value = value;
+                    cell.Sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // false, если очередь пуста
+    bool TryPop(T& value)
+    {
+        size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = mCells[pos & mMask];
+            size_t sequence = cell.Sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+            if (diff == 0)
+            {
+                if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = cell.Value;
+                    cell.Sequence.store(pos + mMask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = mDequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> Sequence;
+        T Value;
+
+        Cell() : Sequence(0), Value() {}
+    };
+
+    std::vector<Cell> mCells;
+    size_t mMask;
+
+    // Позиции писателей и читателей в разных строках кэша
+    alignas(64) std::atomic<size_t> mEnqueuePos;
+    alignas(64) std::atomic<size_t> mDequeuePos;
+};
@@ -0,0 +1,483 @@
+#include "OcclusionRasterizer.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define OCCLUSION_RASTERIZER_SSE 1
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+    // Треугольники с меньшей экранной площадью (в пикселях) ничего не закрывают
+    const float MinTriangleArea = 1e-6f;
+
+    // Задачи пула или тот же цикл в вызывающем потоке
+    template <typename Task>
+    void RunTasks(WorkStealingPool* pool, uint32_t taskCount, const Task& task)
+    {
+        if (pool == nullptr || pool->GetThreadCount() <= 1)
+        {
+            for (uint32_t i = 0; i < taskCount; i++)
+            {
+                task(i, 0);
+            }
+            return;
+        }
+        pool->Run(taskCount, task);
+    }
+}
+
+OcclusionRasterizer::OcclusionRasterizer()
+    : mAxes(), mOrigin(), mLeftSlope(0), mRightSlope(0), mTopSlope(0), mBottomSlope(0),
+      mScaleX(0), mScaleY(0), mNear(0), mValid(false),
+      mDepth(Width * Height, 0.0f), mRowMin(Width * Height, 0.0f), mRasterizedTriangles(0)
+{
+    for (uint32_t level = 0; level < LevelCount; level++)
+    {
+        mLevels[level].assign((Width >> level) * (Height >> level), 0.0f);
+    }
+}
+
+void OcclusionRasterizer::SetView(const BoundingFrustum& frustum)
+{
+    // Оси камеры в мире - столбцы матрицы поворота Orientation
+    const XMFLOAT4& q = frustum.Orientation;
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    const float axes[3][3] =
+    {
+        { 1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy) },
+        { 2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx) },
+        { 2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy) },
+    };
+    std::copy(&axes[0][0], &axes[0][0] + 9, &mAxes[0][0]);
+
+    mOrigin[0] = frustum.Origin.x;
+    mOrigin[1] = frustum.Origin.y;
+    mOrigin[2] = frustum.Origin.z;
+    mLeftSlope = frustum.LeftSlope;
+    mRightSlope = frustum.RightSlope;
+    mTopSlope = frustum.TopSlope;
+    mBottomSlope = frustum.BottomSlope;
+    mNear = frustum.Near;
+    mValid = mRightSlope > mLeftSlope && mTopSlope > mBottomSlope && mNear > 0.0f;
+    mScaleX = mValid ? Width / (mRightSlope - mLeftSlope) : 0.0f;
+    mScaleY = mValid ? Height / (mTopSlope - mBottomSlope) : 0.0f;
+}
+
+void OcclusionRasterizer::Render(const BoundingFrustum& frustum, const float* heights, uint32_t gridSize, float spacing,
+                                 WorkStealingPool* pool)
+{
+    SetView(frustum);
+    std::fill(mDepth.begin(), mDepth.end(), 0.0f);
+    mRasterizedTriangles = 0;
+    if (!mValid || heights == nullptr || gridSize < 2)
+    {
+        mValid = false;
+        return;
+    }
+
+    // Вершины в пространство камеры, затем треугольники полос строк сетки - каждая полоса в свой пакет,
+    // затем тайлы экрана независимо друг от друга: тайл читает все пакеты, но пишет только свои пиксели
+    size_t vertexCount = (size_t)gridSize * gridSize;
+    mViewX.resize(vertexCount);
+    mViewY.resize(vertexCount);
+    mViewZ.resize(vertexCount);
+
+    uint32_t rowsPerBatch = (gridSize + SetupBatchCount - 1) / SetupBatchCount;
+    RunTasks(pool, SetupBatchCount, [&](uint32_t batch, uint32_t)
+    {
+        uint32_t first = batch * rowsPerBatch;
+        if (first < gridSize)
+        {
+            TransformRows(heights, gridSize, spacing, first, std::min(rowsPerBatch, gridSize - first));
+        }
+    });
+
+    uint32_t cellRows = gridSize - 1;
+    uint32_t cellsPerBatch = (cellRows + SetupBatchCount - 1) / SetupBatchCount;
+    RunTasks(pool, SetupBatchCount, [&](uint32_t batch, uint32_t)
+    {
+        SetupBatch& output = mBatches[batch];
+        output.Triangles.clear();
+        for (std::vector<uint32_t>& bin : output.Bins)
+        {
+            bin.clear();
+        }
+
+        uint32_t first = batch * cellsPerBatch;
+        if (first < cellRows)
+        {
+            SetupRows(gridSize, first, std::min(cellsPerBatch, cellRows - first), output);
+        }
+    });
+
+    for (const SetupBatch& batch : mBatches)
+    {
+        mRasterizedTriangles += (uint32_t)batch.Triangles.size();
+    }
+
+    RunTasks(pool, TilesX * TilesY, [&](uint32_t tile, uint32_t)
+    {
+        RasterizeTile(tile);
+    });
+
+    Erode();
+    BuildHierarchy();
+}
+
+void OcclusionRasterizer::TransformRows(const float* heights, uint32_t gridSize, float spacing,
+                                        uint32_t firstRow, uint32_t rowCount)
+{
+    for (uint32_t row = firstRow; row < firstRow + rowCount; row++)
+    {
+        float dz = row * spacing - mOrigin[2];
+        size_t offset = (size_t)row * gridSize;
+        for (uint32_t column = 0; column < gridSize; column++)
+        {
+            float dx = column * spacing - mOrigin[0];
+            float dy = heights[offset + column] - mOrigin[1];
+            mViewX[offset + column] = mAxes[0][0] * dx + mAxes[0][1] * dy + mAxes[0][2] * dz;
+            mViewY[offset + column] = mAxes[1][0] * dx + mAxes[1][1] * dy + mAxes[1][2] * dz;
+            mViewZ[offset + column] = mAxes[2][0] * dx + mAxes[2][1] * dy + mAxes[2][2] * dz;
+        }
+    }
+}
+
+void OcclusionRasterizer::SetupRows(uint32_t gridSize, uint32_t firstCell, uint32_t cellCount, SetupBatch& batch) const
+{
+    for (uint32_t cellZ = firstCell; cellZ < firstCell + cellCount; cellZ++)
+    {
+        for (uint32_t cellX = 0; cellX + 1 < gridSize; cellX++)
+        {
+            // Ячейка делится по диагонали (x, z) - (x + 1, z + 1) на (a, c, d) и (a, d, b)
+            uint32_t a = cellZ * gridSize + cellX;
+            uint32_t b = a + 1;
+            uint32_t c = a + gridSize;
+            uint32_t d = c + 1;
+            const uint32_t triangles[2][3] = { { a, c, d }, { a, d, b } };
+
+            for (const uint32_t* triangle : triangles)
+            {
+                float x[3], y[3], z[3];
+                for (int i = 0; i < 3; i++)
+                {
+                    x[i] = mViewX[triangle[i]];
+                    y[i] = mViewY[triangle[i]];
+                    z[i] = mViewZ[triangle[i]];
+                }
+
+                // Целиком за ближней плоскостью или за одной из боковых
+                if ((z[0] < mNear && z[1] < mNear && z[2] < mNear) ||
+                    (x[0] > mRightSlope * z[0] && x[1] > mRightSlope * z[1] && x[2] > mRightSlope * z[2]) ||
+                    (x[0] < mLeftSlope * z[0] && x[1] < mLeftSlope * z[1] && x[2] < mLeftSlope * z[2]) ||
+                    (y[0] > mTopSlope * z[0] && y[1] > mTopSlope * z[1] && y[2] > mTopSlope * z[2]) ||
+                    (y[0] < mBottomSlope * z[0] && y[1] < mBottomSlope * z[1] && y[2] < mBottomSlope * z[2]))
+                {
+                    continue;
+                }
+
+                // При обходе (a, c, d) и (a, d, b) нормаль cross(v1 - v0, v2 - v0) смотрит вверх (поворот
+                // в пространство камеры её не меняет). Камера - начало координат, и треугольник
+                // обращён к ней, только если она над его плоскостью: dot(n, -v0) > 0.
+                float e1x = x[1] - x[0], e1y = y[1] - y[0], e1z = z[1] - z[0];
+                float e2x = x[2] - x[0], e2y = y[2] - y[0], e2z = z[2] - z[0];
+                float nx = e1y * e2z - e1z * e2y;
+                float ny = e1z * e2x - e1x * e2z;
+                float nz = e1x * e2y - e1y * e2x;
+                if (nx * x[0] + ny * y[0] + nz * z[0] >= 0.0f)
+                {
+                    continue;
+                }
+
+                AddTriangle(x, y, z, batch);
+            }
+        }
+    }
+}
+
+void OcclusionRasterizer::AddTriangle(const float* viewX, const float* viewY, const float* viewZ, SetupBatch& batch) const
+{
+    // Отсечение ближней плоскостью: треугольник превращается в многоугольник до четырёх вершин
+    float clipX[4], clipY[4], clipZ[4];
+    int count = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        int j = (i + 1) % 3;
+        bool inside = viewZ[i] >= mNear;
+        if (inside)
+        {
+            clipX[count] = viewX[i];
+            clipY[count] = viewY[i];
+            clipZ[count] = viewZ[i];
+            count++;
+        }
+        if (inside != (viewZ[j] >= mNear))
+        {
+            float t = (mNear - viewZ[i]) / (viewZ[j] - viewZ[i]);
+            clipX[count] = viewX[i] + (viewX[j] - viewX[i]) * t;
+            clipY[count] = viewY[i] + (viewY[j] - viewY[i]) * t;
+            clipZ[count] = mNear;
+            count++;
+        }
+    }
+
+    float screenX[4], screenY[4], inverseZ[4];
+    for (int i = 0; i < count; i++)
+    {
+        inverseZ[i] = 1.0f / clipZ[i];
+        screenX[i] = (clipX[i] * inverseZ[i] - mLeftSlope) * mScaleX;
+        screenY[i] = (mTopSlope - clipY[i] * inverseZ[i]) * mScaleY;
+    }
+
+    // Веер из первой вершины
+    for (int second = 1; second + 1 < count; second++)
+    {
+        int v[3] = { 0, second, second + 1 };
+        float area = (screenX[v[1]] - screenX[v[0]]) * (screenY[v[2]] - screenY[v[0]]) -
+                     (screenX[v[2]] - screenX[v[0]]) * (screenY[v[1]] - screenY[v[0]]);
+        if (fabsf(area) < MinTriangleArea)
+        {
+            continue;
+        }
+        if (area < 0.0f)
+        {
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+
+        // Пиксели, центры которых попадают в описанный прямоугольник
+        float minX = std::min(std::min(screenX[v[0]], screenX[v[1]]), screenX[v[2]]);
+        float maxX = std::max(std::max(screenX[v[0]], screenX[v[1]]), screenX[v[2]]);
+        float minY = std::min(std::min(screenY[v[0]], screenY[v[1]]), screenY[v[2]]);
+        float maxY = std::max(std::max(screenY[v[0]], screenY[v[1]]), screenY[v[2]]);
+        ScreenTriangle triangle;
+        triangle.MinX = std::max((int32_t)ceilf(minX - 0.5f), 0);
+        triangle.MaxX = std::min((int32_t)floorf(maxX - 0.5f), (int32_t)Width - 1);
+        triangle.MinY = std::max((int32_t)ceilf(minY - 0.5f), 0);
+        triangle.MaxY = std::min((int32_t)floorf(maxY - 0.5f), (int32_t)Height - 1);
+        if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY)
+        {
+            continue;
+        }
+
+        // Ребро i идёт от вершины i к следующей; при положительной площади внутренность слева
+        for (int i = 0; i < 3; i++)
+        {
+            int from = v[i], to = v[(i + 1) % 3];
+            triangle.EdgeA[i] = screenY[from] - screenY[to];
+            triangle.EdgeB[i] = screenX[to] - screenX[from];
+            triangle.EdgeC[i] = -(triangle.EdgeA[i] * screenX[from] + triangle.EdgeB[i] * screenY[from]);
+        }
+
+        // 1/z линейна в экранных координатах
+        float dz1 = inverseZ[v[1]] - inverseZ[v[0]], dz2 = inverseZ[v[2]] - inverseZ[v[0]];
+        float dx1 = screenX[v[1]] - screenX[v[0]], dx2 = screenX[v[2]] - screenX[v[0]];
+        float dy1 = screenY[v[1]] - screenY[v[0]], dy2 = screenY[v[2]] - screenY[v[0]];
+        triangle.DepthA = (dz1 * dy2 - dz2 * dy1) / area;
+        triangle.DepthB = (dz2 * dx1 - dz1 * dx2) / area;
+        triangle.DepthC = inverseZ[v[0]] - triangle.DepthA * screenX[v[0]] - triangle.DepthB * screenY[v[0]];
+
+        uint32_t index = (uint32_t)batch.Triangles.size();
+        batch.Triangles.push_back(triangle);
+        for (int32_t tileY = triangle.MinY / (int32_t)TileHeight; tileY <= triangle.MaxY / (int32_t)TileHeight; tileY++)
+        {
+            for (int32_t tileX = triangle.MinX / (int32_t)TileWidth; tileX <= triangle.MaxX / (int32_t)TileWidth; tileX++)
+            {
+                batch.Bins[tileY * TilesX + tileX].push_back(index);
+            }
+        }
+    }
+}
+
+void OcclusionRasterizer::RasterizeTile(uint32_t tile)
+{
+    const int32_t tileMinX = (int32_t)((tile % TilesX) * TileWidth);
+    const int32_t tileMinY = (int32_t)((tile / TilesX) * TileHeight);
+    const int32_t tileMaxX = tileMinX + (int32_t)TileWidth - 1;
+    const int32_t tileMaxY = tileMinY + (int32_t)TileHeight - 1;
+
+    for (const SetupBatch& batch : mBatches)
+    {
+        for (uint32_t index : batch.Bins[tile])
+        {
+            const ScreenTriangle& t = batch.Triangles[index];
+            int32_t minY = std::max(t.MinY, tileMinY);
+            int32_t maxY = std::min(t.MaxY, tileMaxY);
+            // Строка идёт выровненными четвёрками пикселей; лишние пиксели отбрасывают рёберные функции
+            int32_t minX = std::max(t.MinX, tileMinX) & ~3;
+            int32_t maxX = std::min(t.MaxX, tileMaxX);
+
+            for (int32_t y = minY; y <= maxY; y++)
+            {
+                float* row = &mDepth[(size_t)y * Width];
+                float centerY = y + 0.5f;
+#ifdef OCCLUSION_RASTERIZER_SSE
+                const __m128 zero = _mm_setzero_ps();
+                __m128 rowEdge[3], edgeStep[3];
+                __m128 centerX = _mm_add_ps(_mm_set1_ps(minX + 0.5f), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+                for (int i = 0; i < 3; i++)
+                {
+                    rowEdge[i] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.EdgeA[i]), centerX),
+                                            _mm_set1_ps(t.EdgeB[i] * centerY + t.EdgeC[i]));
+                    edgeStep[i] = _mm_set1_ps(t.EdgeA[i] * 4.0f);
+                }
+                __m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.DepthA), centerX),
+                                          _mm_set1_ps(t.DepthB * centerY + t.DepthC));
+                const __m128 depthStep = _mm_set1_ps(t.DepthA * 4.0f);
+
+                for (int32_t x = minX; x <= maxX; x += 4)
+                {
+                    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(rowEdge[0], zero), _mm_cmpge_ps(rowEdge[1], zero)),
+                                               _mm_cmpge_ps(rowEdge[2], zero));
+                    __m128 current = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_max_ps(current, depth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+
+                    for (int i = 0; i < 3; i++)
+                    {
+                        rowEdge[i] = _mm_add_ps(rowEdge[i], edgeStep[i]);
+                    }
+                    depth = _mm_add_ps(depth, depthStep);
+                }
+#else
+                for (int32_t x = minX; x <= maxX; x++)
+                {
+                    float centerX = x + 0.5f;
+                    if (t.EdgeA[0] * centerX + t.EdgeB[0] * centerY + t.EdgeC[0] >= 0.0f &&
+                        t.EdgeA[1] * centerX + t.EdgeB[1] * centerY + t.EdgeC[1] >= 0.0f &&
+                        t.EdgeA[2] * centerX + t.EdgeB[2] * centerY + t.EdgeC[2] >= 0.0f)
+                    {
+                        row[x] = std::max(row[x], t.DepthA * centerX + t.DepthB * centerY + t.DepthC);
+                    }
+                }
+#endif
+            }
+        }
+    }
+}
+
+void OcclusionRasterizer::Erode()
+{
+    // Минимум 3x3 раздельно: по строке, затем по столбцу. Пиксели за краем экрана не учитываются.
+    for (uint32_t y = 0; y < Height; y++)
+    {
+        const float* source = &mDepth[(size_t)y * Width];
+        float* target = &mRowMin[(size_t)y * Width];
+        target[0] = std::min(source[0], source[1]);
+        for (uint32_t x = 1; x + 1 < Width; x++)
+        {
+            target[x] = std::min(std::min(source[x - 1], source[x]), source[x + 1]);
+        }
+        target[Width - 1] = std::min(source[Width - 2], source[Width - 1]);
+    }
+
+    std::vector<float>& eroded = mLevels[0];
+    for (uint32_t y = 0; y < Height; y++)
+    {
+        const float* above = &mRowMin[(size_t)(y > 0 ? y - 1 : y) * Width];
+        const float* middle = &mRowMin[(size_t)y * Width];
+        const float* below = &mRowMin[(size_t)(y + 1 < Height ? y + 1 : y) * Width];
+        float* target = &eroded[(size_t)y * Width];
+        for (uint32_t x = 0; x < Width; x++)
+        {
+            target[x] = std::min(std::min(above[x], middle[x]), below[x]);
+        }
+    }
+}
+
+void OcclusionRasterizer::BuildHierarchy()
+{
+    for (uint32_t level = 1; level < LevelCount; level++)
+    {
+        const std::vector<float>& source = mLevels[level - 1];
+        std::vector<float>& target = mLevels[level];
+        uint32_t sourceWidth = Width >> (level - 1);
+        uint32_t width = Width >> level;
+        uint32_t height = Height >> level;
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const float* top = &source[(size_t)(2 * y) * sourceWidth];
+            const float* bottom = top + sourceWidth;
+            for (uint32_t x = 0; x < width; x++)
+            {
+                target[(size_t)y * width + x] = std::min(std::min(top[2 * x], top[2 * x + 1]),
+                                                         std::min(bottom[2 * x], bottom[2 * x + 1]));
+            }
+        }
+    }
+}
+
+bool OcclusionRasterizer::IsOccluded(float centerX, float centerY, float centerZ,
+                                     float extentX, float extentY, float extentZ) const
+{
+    if (!mValid)
+    {
+        return false;
+    }
+
+    // Экранный прямоугольник бокса по восьми вершинам и ближайшая глубина
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    float nearest = 0.0f;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        float dx = centerX + ((corner & 1) ? extentX : -extentX) - mOrigin[0];
+        float dy = centerY + ((corner & 2) ? extentY : -extentY) - mOrigin[1];
+        float dz = centerZ + ((corner & 4) ? extentZ : -extentZ) - mOrigin[2];
+        float viewX = mAxes[0][0] * dx + mAxes[0][1] * dy + mAxes[0][2] * dz;
+        float viewY = mAxes[1][0] * dx + mAxes[1][1] * dy + mAxes[1][2] * dz;
+        float viewZ = mAxes[2][0] * dx + mAxes[2][1] * dy + mAxes[2][2] * dz;
+        if (viewZ < mNear)
+        {
+            return false;
+        }
+
+        float inverseZ = 1.0f / viewZ;
+        float screenX = (viewX * inverseZ - mLeftSlope) * mScaleX;
+        float screenY = (mTopSlope - viewY * inverseZ) * mScaleY;
+        minX = std::min(minX, screenX);
+        maxX = std::max(maxX, screenX);
+        minY = std::min(minY, screenY);
+        maxY = std::max(maxY, screenY);
+        nearest = std::max(nearest, inverseZ);
+    }
+
+    // Все пиксели, которых касается прямоугольник
+    int32_t x0 = std::max((int32_t)floorf(minX), 0);
+    int32_t x1 = std::min((int32_t)floorf(maxX), (int32_t)Width - 1);
+    int32_t y0 = std::max((int32_t)floorf(minY), 0);
+    int32_t y1 = std::min((int32_t)floorf(maxY), (int32_t)Height - 1);
+    if (x0 > x1 || y0 > y1)
+    {
+        return false;
+    }
+
+    // Уровень пирамиды, на котором прямоугольник укладывается в 4x4 текселя
+    uint32_t level = 0;
+    while (level + 1 < LevelCount && (x1 - x0 >= 4 || y1 - y0 >= 4))
+    {
+        x0 >>= 1; x1 >>= 1;
+        y0 >>= 1; y1 >>= 1;
+        level++;
+    }
+
+    const std::vector<float>& depth = mLevels[level];
+    uint32_t width = Width >> level;
+    for (int32_t y = y0; y <= y1; y++)
+    {
+        for (int32_t x = x0; x <= x1; x++)
+        {
+            if (!(nearest < depth[(size_t)y * width + x]))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
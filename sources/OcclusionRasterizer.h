@@ -0,0 +1,91 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <vector>
+#include <cstdint>
+
+class WorkStealingPool;
+
+// Программный растеризатор глубины низкого разрешения для отсечения перекрытых узлов.
+// Загораживающая геометрия - регулярная сетка вершин, лежащая не выше рельефа (в QuadTree - минимумы
+// ячеек). Она растеризуется по тайлам экрана в буфер обратной глубины 1/z (больше - ближе, 0 - пусто),
+// по буферу строится пирамида минимумов (HiZ), и бокс отсекается, если его ближайшая точка дальше
+// самого дальнего загораживающего пикселя во всех покрытых им текселях пирамиды.
+//
+// Глубина берётся в центрах пикселей, а бокс покрывает пиксели целиком, так что на силуэте и на
+// крутых склонах пиксель мог бы закрыть то, что видно в его углу. Перед построением пирамиды буфер
+// сужается на пиксель (минимум 3x3): загораживающий пиксель должен быть окружён загораживающими.
+class OcclusionRasterizer
+{
+public:
+    static const uint32_t Width = 256;
+    static const uint32_t Height = 128;
+    static const uint32_t TileWidth = 64;          // Кратно 4 - строка тайла идёт четвёрками пикселей
+    static const uint32_t TileHeight = 32;
+    static const uint32_t TilesX = Width / TileWidth;
+    static const uint32_t TilesY = Height / TileHeight;
+    static const uint32_t LevelCount = 6;          // 256x128 .. 8x4
+
+    OcclusionRasterizer();
+
+    // Растеризация сетки gridSize x gridSize вершин с шагом spacing от (0, 0) по X и Z, высоты построчно
+    // по Z. Треугольники, обращённые от камеры, пропускаются. pool == nullptr - всё в вызывающем потоке.
+    void Render(const DirectX::BoundingFrustum& frustum, const float* heights, uint32_t gridSize, float spacing,
+                WorkStealingPool* pool);
+
+    // AABB целиком за загораживающей геометрией последнего Render. Боксы, пересекающие
+    // ближнюю плоскость, не отсекаются.
+    bool IsOccluded(float centerX, float centerY, float centerZ,
+                    float extentX, float extentY, float extentZ) const;
+
+    // Буфер 1/z последнего Render до сужения, Width x Height построчно сверху вниз
+    const float* GetDepth() const { return mDepth.data(); }
+
+    // Треугольники, дошедшие до растеризации в последнем Render
+    uint32_t GetRasterizedTriangles() const { return mRasterizedTriangles; }
+
+private:
+    // Треугольник в экранных координатах: рёберные функции (внутри - все >= 0), плоскость 1/z и
+    // пиксельный прямоугольник
+    struct ScreenTriangle
+    {
+        float EdgeA[3];
+        float EdgeB[3];
+        float EdgeC[3];
+        float DepthA, DepthB, DepthC;
+        int32_t MinX, MinY, MaxX, MaxY;
+    };
+
+    // Треугольники полосы строк сетки и их раскладка по тайлам
+    struct SetupBatch
+    {
+        std::vector<ScreenTriangle> Triangles;
+        std::vector<uint32_t> Bins[TilesX * TilesY];
+    };
+
+    static const uint32_t SetupBatchCount = 16;
+
+    void SetView(const DirectX::BoundingFrustum& frustum);
+    void TransformRows(const float* heights, uint32_t gridSize, float spacing, uint32_t firstRow, uint32_t rowCount);
+    void SetupRows(uint32_t gridSize, uint32_t firstCell, uint32_t cellCount, SetupBatch& batch) const;
+    void AddTriangle(const float* viewX, const float* viewY, const float* viewZ, SetupBatch& batch) const;
+    void RasterizeTile(uint32_t tile);
+    void Erode();
+    void BuildHierarchy();
+
+    // Поворот мир -> камера (строки - оси камеры в мире), позиция камеры, проекция на экран
+    float mAxes[3][3];
+    float mOrigin[3];
+    float mLeftSlope, mRightSlope, mTopSlope, mBottomSlope;
+    float mScaleX, mScaleY;        // Пикселей на единицу наклона
+    float mNear;
+    bool mValid;
+
+    std::vector<float> mViewX, mViewY, mViewZ;   // Вершины сетки в пространстве камеры
+    SetupBatch mBatches[SetupBatchCount];
+    std::vector<float> mDepth;
+    std::vector<float> mRowMin;                  // Промежуточный минимум по строкам при сужении
+    std::vector<float> mLevels[LevelCount];      // Пирамида минимумов 1/z, уровень 0 - суженный буфер
+    uint32_t mRasterizedTriangles;
+};
@@ -1,11 +1,46 @@
 #include "QuadTree.h"
+#include "HeightPyramid.h"
+#include "WorkStealingPool.h"
+#include "TerrainTessellation.h"
 #include <algorithm>
 #include <cmath>
+#include <cfloat>
 
 using namespace DirectX;
 
+namespace
+{
+    void AddCullStats(QuadTreeCullStats& total, const QuadTreeCullStats& stats)
+    {
+        total.NodesVisited += stats.NodesVisited;
+        total.BoxTests += stats.BoxTests;
+        total.PlaneTests += stats.PlaneTests;
+        total.ContainedNodes += stats.ContainedNodes;
+        total.CulledNodes += stats.CulledNodes;
+        total.ReusedSubtrees += stats.ReusedSubtrees;
+        total.ReusedNodes += stats.ReusedNodes;
+        total.BudgetSplits += stats.BudgetSplits;
+        total.BudgetPatches += stats.BudgetPatches;
+        total.BudgetTriangles += stats.BudgetTriangles;
+        total.BudgetExhausted |= stats.BudgetExhausted;
+    }
+
+    // Запасы считаются во float от координат порядка размера террейна, оценка смещения - тоже:
+    // поддерево переиспользуется, только если смещение меньше запаса с поправкой на округление,
+    // пропорциональной удалённости точек поддерева от камеры
+    const float SlackRoundoff = 1e-5f;
+}
+
 QuadTree::QuadTree()
-    : mTerrainSize(0), mMaxDepth(0)
+    : mCullStats(), mSelectionMode(LODSelectionMode::Distance),
+      mErrorToPixels(1.0f), mPixelTolerance(1.0f),
+      mTerrainSize(0), mMaxDepth(0), mNodeCount(0),
+      mIncremental(false), mHistoryValid(false), mPositionEpsilon(0.0f), mAngleEpsilon(0.0f),
+      mFrame(0), mPoseHistory(), mFrustumShape(),
+      mFrameIncremental(false), mFrameReuse(false), mFramePose(),
+      mPool(nullptr), mWorkers(1), mTaskCount(0),
+      mMaxTriangles(UINT32_MAX), mMaxPatches(UINT32_MAX), mBasePatchSize(1.0f),
+      mOcclusionCulling(false), mOccluderCellSize(0.0f), mOcclusionReach(0.0f), mDepthOcclusion(false)
 {
 }
 
@@ -13,120 +48,961 @@ QuadTree::~QuadTree()
 {
 }
 
-void QuadTree::Initialize(float terrainSize, int maxDepth, 
+void QuadTree::Initialize(float terrainSize, int maxDepth,
                           const std::vector<float>& lodDistances)
 {
     mTerrainSize = terrainSize;
     mMaxDepth = maxDepth;
     mLodDistances = lodDistances;
-    
-    // Создаём корневой узел
-    mRoot = std::make_unique<QuadTreeNode>();
-    
-    // Строим дерево рекурсивно
-    BuildTree(mRoot.get(), 0, 0, terrainSize, 0);
+
+    // Раскладка уровней: корень занимает целый блок (сёстры всегда выровнены по блоку),
+    // за ним уровни подряд - 4^d узлов уровня d без пропусков
+    mLevelStart.assign(1, RootIndex);
+    mNodeCount = 1;
+    for (int depth = 1; depth <= maxDepth + 1; depth++)
+    {
+        mLevelStart.push_back(depth == 1 ? 4 : mLevelStart.back() + (1u << (2 * (depth - 1))));
+        if (depth <= maxDepth)
+        {
+            mNodeCount += 1u << (2 * depth);
+        }
+    }
+
+    uint32_t lastLevelCount = 1u << (2 * maxDepth);
+    uint32_t arraySize = mLevelStart.back();
+
+    // Весь пул выделяется одним куском - никаких аллокаций на узел
+    mNodeBlocks.assign(arraySize / 4, QuadTreeNodeBlock());
+    mNodeData.assign(arraySize, QuadTreeNodeData());
+    mLastRejectPlane.assign(arraySize, 0);
+    mNodeCache.assign(arraySize, NodeCache());
+    mBudgetSplit.assign(arraySize, 0);
+    mHistoryValid = false;
+    // На каждом уровне в стеке не больше трёх сестёр и одной записи завершения
+    mWorkers.resize(std::max<size_t>(mWorkers.size(), 1));
+    for (TraversalWorker& worker : mWorkers)
+    {
+        worker.Stack.reserve(4 * maxDepth + 1);
+    }
+    mVisibleNodes.reserve(lastLevelCount);
+    mPrevVisibleNodes.reserve(lastLevelCount);
+    mUnoccludedNodes.reserve(lastLevelCount);
+    mOccluderHeights.clear();
+    mOccluderMesh.clear();
+    mOccluderCellSize = terrainSize / OccluderGridResolution;
+
+    // Строим дерево
+    BuildTree(RootIndex, 0, 0, terrainSize, 0);
 }
 
-void QuadTree::BuildTree(QuadTreeNode* node, float x, float z, float size, int depth)
+void QuadTree::BuildTree(uint32_t index, float x, float z, float size, int depth)
 {
-    node->Size = size;
-    node->Depth = depth;
-    node->Center = XMFLOAT3(x + size * 0.5f, 0, z + size * 0.5f);
-    
     // Создаём BoundingBox (высота террейна 0-500)
     float minY = 0.0f;
     float maxY = 500.0f;
-    node->Bounds = BoundingBox(
-        XMFLOAT3(x + size * 0.5f, (minY + maxY) * 0.5f, z + size * 0.5f),
-        XMFLOAT3(size * 0.5f, (maxY - minY) * 0.5f, size * 0.5f)
-    );
-    
+
+    QuadTreeNodeBlock& block = Block(index);
+    uint32_t slot = index & 3;
+    block.CenterX[slot] = x + size * 0.5f;
+    block.CenterY[slot] = (minY + maxY) * 0.5f;
+    block.CenterZ[slot] = z + size * 0.5f;
+    block.ExtentX[slot] = size * 0.5f;
+    block.ExtentY[slot] = (maxY - minY) * 0.5f;
+    block.ExtentZ[slot] = size * 0.5f;
+    block.GeometricError[slot] = 0.0f;
+
     // Текстурные координаты (0-1 по всему террейну)
-    node->TexCoordMin = XMFLOAT2(x / mTerrainSize, 1.0f - (z + size) / mTerrainSize);
-    node->TexCoordMax = XMFLOAT2((x + size) / mTerrainSize, 1.0f - z / mTerrainSize);
-    
+    QuadTreeNodeData& data = mNodeData[index];
+    data.TexCoordMin = XMFLOAT2(x / mTerrainSize, 1.0f - (z + size) / mTerrainSize);
+    data.TexCoordMax = XMFLOAT2((x + size) / mTerrainSize, 1.0f - z / mTerrainSize);
+
     // Если достигли максимальной глубины - это лист
     if (depth >= mMaxDepth)
     {
-        node->IsLeaf = true;
         return;
     }
-    
-    node->IsLeaf = false;
+
     float halfSize = size * 0.5f;
-    
+    uint32_t child = FirstChild(index, depth);
+
     // Создаём 4 дочерних узла (NW, NE, SW, SE)
-    // NW (North-West) - верхний левый
-    node->Children[0] = std::make_unique<QuadTreeNode>();
-    BuildTree(node->Children[0].get(), x, z, halfSize, depth + 1);
-    
-    // NE (North-East) - верхний правый
-    node->Children[1] = std::make_unique<QuadTreeNode>();
-    BuildTree(node->Children[1].get(), x + halfSize, z, halfSize, depth + 1);
-    
-    // SW (South-West) - нижний левый
-    node->Children[2] = std::make_unique<QuadTreeNode>();
-    BuildTree(node->Children[2].get(), x, z + halfSize, halfSize, depth + 1);
-    
-    // SE (South-East) - нижний правый
-    node->Children[3] = std::make_unique<QuadTreeNode>();
-    BuildTree(node->Children[3].get(), x + halfSize, z + halfSize, halfSize, depth + 1);
+    BuildTree(child + 0, x, z, halfSize, depth + 1);
+    BuildTree(child + 1, x + halfSize, z, halfSize, depth + 1);
+    BuildTree(child + 2, x, z + halfSize, halfSize, depth + 1);
+    BuildTree(child + 3, x + halfSize, z + halfSize, halfSize, depth + 1);
+}
+
+void QuadTree::RefitHeights(const HeightPyramid& heights, float margin)
+{
+    if (mNodeBlocks.empty() || heights.IsEmpty())
+    {
+        return;
+    }
+
+    // Снизу вверх: листья берут диапазон из пирамиды, родители - объединение детей.
+    // Так бокс ребёнка всегда вложен в бокс родителя, на чём держится наследование масок плоскостей.
+    for (int depth = mMaxDepth; depth >= 0; depth--)
+    {
+        uint32_t levelStart = mLevelStart[depth];
+        uint32_t levelCount = 1u << (2 * depth);
+
+        for (uint32_t index = levelStart; index < levelStart + levelCount; index++)
+        {
+            QuadTreeNodeBlock& block = Block(index);
+            uint32_t slot = index & 3;
+
+            float minY, maxY;
+            if (depth == mMaxDepth)
+            {
+                const QuadTreeNodeData& data = mNodeData[index];
+                heights.QueryRange(data.TexCoordMin.x, data.TexCoordMin.y,
+                                   data.TexCoordMax.x, data.TexCoordMax.y, minY, maxY);
+                minY -= margin;
+                maxY += margin;
+            }
+            else
+            {
+                const QuadTreeNodeBlock& childBlock = Block(FirstChild(index, depth));
+                minY = childBlock.CenterY[0] - childBlock.ExtentY[0];
+                maxY = childBlock.CenterY[0] + childBlock.ExtentY[0];
+                for (int i = 1; i < 4; i++)
+                {
+                    minY = std::min(minY, childBlock.CenterY[i] - childBlock.ExtentY[i]);
+                    maxY = std::max(maxY, childBlock.CenterY[i] + childBlock.ExtentY[i]);
+                }
+            }
+
+            block.CenterY[slot] = (minY + maxY) * 0.5f;
+            block.ExtentY[slot] = (maxY - minY) * 0.5f;
+        }
+    }
+
+    // Сетка загораживающих ячеек: для горизонта нужна нижняя граница поверхности, и чем мельче
+    // ячейка, тем она выше - минимум целого узла обычно лежит на дне соседней долины
+    mOccluderHeights.resize(OccluderGridResolution * OccluderGridResolution);
+    for (uint32_t cellZ = 0; cellZ < OccluderGridResolution; cellZ++)
+    {
+        for (uint32_t cellX = 0; cellX < OccluderGridResolution; cellX++)
+        {
+            float x = cellX * mOccluderCellSize;
+            float z = cellZ * mOccluderCellSize;
+            float minY, maxY;
+            heights.QueryRange(x / mTerrainSize, 1.0f - (z + mOccluderCellSize) / mTerrainSize,
+                               (x + mOccluderCellSize) / mTerrainSize, 1.0f - z / mTerrainSize, minY, maxY);
+            mOccluderHeights[cellZ * OccluderGridResolution + cellX] = minY - margin;
+        }
+    }
+
+    // Поверхность для буфера глубины: вершина не выше ни одной из своих ячеек, тогда и треугольники
+    // внутри ячейки не выше её минимума
+    const uint32_t meshSize = OccluderGridResolution + 1;
+    mOccluderMesh.resize(meshSize * meshSize);
+    for (uint32_t vertexZ = 0; vertexZ < meshSize; vertexZ++)
+    {
+        for (uint32_t vertexX = 0; vertexX < meshSize; vertexX++)
+        {
+            float height = FLT_MAX;
+            for (uint32_t cellZ = vertexZ > 0 ? vertexZ - 1 : 0; cellZ <= std::min(vertexZ, OccluderGridResolution - 1); cellZ++)
+            {
+                for (uint32_t cellX = vertexX > 0 ? vertexX - 1 : 0; cellX <= std::min(vertexX, OccluderGridResolution - 1); cellX++)
+                {
+                    height = std::min(height, mOccluderHeights[cellZ * OccluderGridResolution + cellX]);
+                }
+            }
+            mOccluderMesh[vertexZ * meshSize + vertexX] = height;
+        }
+    }
+
+    mHistoryValid = false;
+}
+
+void QuadTree::ComputeGeometricErrors(const HeightPyramid& heights, int gridResolution)
+{
+    if (mNodeBlocks.empty() || heights.IsEmpty() || gridResolution < 1)
+    {
+        return;
+    }
+
+    const int mapWidth = (int)heights.GetLevelWidth(0);
+    const int mapHeight = (int)heights.GetLevelHeight(0);
+
+    for (int depth = mMaxDepth; depth >= 0; depth--)
+    {
+        uint32_t levelStart = mLevelStart[depth];
+        uint32_t levelCount = 1u << (2 * depth);
+
+        for (uint32_t index = levelStart; index < levelStart + levelCount; index++)
+        {
+            const QuadTreeNodeData& data = mNodeData[index];
+            int x0 = (int)lroundf(data.TexCoordMin.x * mapWidth);
+            int y0 = (int)lroundf(data.TexCoordMin.y * mapHeight);
+            int texelsX = (int)lroundf((data.TexCoordMax.x - data.TexCoordMin.x) * mapWidth);
+            int texelsY = (int)lroundf((data.TexCoordMax.y - data.TexCoordMin.y) * mapHeight);
+
+            // Шаг сетки отсчётов узла в текселях. Если сетка не грубее карты, узел точен.
+            float stepX = (float)texelsX / gridResolution;
+            float stepY = (float)texelsY / gridResolution;
+            float error = 0.0f;
+
+            if (stepX > 1.0f || stepY > 1.0f)
+            {
+                for (int ty = 0; ty <= texelsY; ty++)
+                {
+                    float gy = ty / stepY;
+                    int cy = std::min((int)gy, gridResolution - 1);
+                    float fy = gy - cy;
+                    int sy0 = y0 + (int)lroundf(cy * stepY);
+                    int sy1 = y0 + (int)lroundf((cy + 1) * stepY);
+
+                    for (int tx = 0; tx <= texelsX; tx++)
+                    {
+                        float gx = tx / stepX;
+                        int cx = std::min((int)gx, gridResolution - 1);
+                        float fx = gx - cx;
+                        int sx0 = x0 + (int)lroundf(cx * stepX);
+                        int sx1 = x0 + (int)lroundf((cx + 1) * stepX);
+
+                        // Билинейная реконструкция по четырём ближайшим отсчётам сетки узла
+                        float h00 = heights.GetHeight(sx0, sy0);
+                        float h10 = heights.GetHeight(sx1, sy0);
+                        float h01 = heights.GetHeight(sx0, sy1);
+                        float h11 = heights.GetHeight(sx1, sy1);
+                        float coarse = (h00 * (1.0f - fx) + h10 * fx) * (1.0f - fy) +
+                                       (h01 * (1.0f - fx) + h11 * fx) * fy;
+
+                        error = std::max(error, fabsf(heights.GetHeight(x0 + tx, y0 + ty) - coarse));
+                    }
+                }
+            }
+
+            // Ошибка родителя не меньше ошибки детей - иначе выбор LOD не монотонен
+            if (depth < mMaxDepth)
+            {
+                const QuadTreeNodeBlock& childBlock = Block(FirstChild(index, depth));
+                for (int i = 0; i < 4; i++)
+                {
+                    error = std::max(error, childBlock.GeometricError[i]);
+                }
+            }
+
+            Block(index).GeometricError[index & 3] = error;
+        }
+    }
+
+    mHistoryValid = false;
+}
+
+void QuadTree::SetScreenSpaceErrorParams(float fovY, float viewportHeight, float pixelTolerance)
+{
+    mErrorToPixels = viewportHeight / (2.0f * tanf(fovY * 0.5f));
+    mPixelTolerance = pixelTolerance;
+    mHistoryValid = false;
+}
+
+void QuadTree::SetTriangleBudget(uint32_t maxTriangles, uint32_t maxPatches, float basePatchSize)
+{
+    mMaxTriangles = maxTriangles;
+    mMaxPatches = maxPatches;
+    mBasePatchSize = basePatchSize;
+    mSelectionMode = LODSelectionMode::TriangleBudget;
+    mHistoryValid = false;
+}
+
+void QuadTree::SetIncrementalUpdate(bool enabled, float positionEpsilon, float angleEpsilon)
+{
+    mIncremental = enabled;
+    mPositionEpsilon = positionEpsilon;
+    mAngleEpsilon = angleEpsilon;
+    mHistoryValid = false;
+}
+
+BoundingBox QuadTree::GetNodeBounds(uint32_t index) const
+{
+    const QuadTreeNodeBlock& block = Block(index);
+    uint32_t slot = index & 3;
+    return BoundingBox(
+        XMFLOAT3(block.CenterX[slot], block.CenterY[slot], block.CenterZ[slot]),
+        XMFLOAT3(block.ExtentX[slot], block.ExtentY[slot], block.ExtentZ[slot]));
+}
+
+int QuadTree::GetNodeDepth(uint32_t index) const
+{
+    int depth = 0;
+    while (depth < mMaxDepth && index >= mLevelStart[depth + 1])
+    {
+        depth++;
+    }
+    return depth;
 }
 
 void QuadTree::Update(const XMFLOAT3& cameraPos, const BoundingFrustum& frustum)
 {
+    mCullStats = QuadTreeCullStats();
+
+    if (mNodeBlocks.empty())
+    {
+        mVisibleNodes.clear();
+        mUnoccludedNodes.clear();
+        return;
+    }
+
+    const bool budgeted = mSelectionMode == LODSelectionMode::TriangleBudget;
+    const bool parallel = !budgeted && mPool && mPool->GetThreadCount() > 1 && mMaxDepth >= ParallelMinDepth;
+    mFrameIncremental = mIncremental && !parallel && !budgeted;
+    mFrameReuse = false;
+    mFramePose = { cameraPos, frustum.Orientation };
+
+    if (mFrameIncremental)
+    {
+        // Смена проекции (например, изменение размера окна) меняет плоскости независимо от позы
+        const float shape[6] = { frustum.RightSlope, frustum.LeftSlope, frustum.TopSlope,
+                                 frustum.BottomSlope, frustum.Near, frustum.Far };
+        if (!std::equal(shape, shape + 6, mFrustumShape))
+        {
+            std::copy(shape, shape + 6, mFrustumShape);
+            mHistoryValid = false;
+        }
+
+        if (mHistoryValid)
+        {
+            // Камера почти не сдвинулась - прошлый результат остаётся в силе
+            const CameraPose& last = mPoseHistory[mFrame % PoseHistorySize];
+            float dx = cameraPos.x - last.Position.x;
+            float dy = cameraPos.y - last.Position.y;
+            float dz = cameraPos.z - last.Position.z;
+            if (sqrtf(dx * dx + dy * dy + dz * dz) <= mPositionEpsilon &&
+                RotationAngle(last.Orientation, mFramePose.Orientation) <= mAngleEpsilon)
+            {
+                mCullStats.FrameReused = 1;
+                return;
+            }
+        }
+
+        mFrameReuse = mHistoryValid;
+        std::swap(mVisibleNodes, mPrevVisibleNodes);
+        mFrame++;
+        mPoseHistory[mFrame % PoseHistorySize] = mFramePose;
+        mHistoryValid = true;
+    }
+    else
+    {
+        // Параллельный обход и выбор по бюджету не ведут кэш поддеревьев
+        mHistoryValid = false;
+    }
+
     mVisibleNodes.clear();
-    
-    if (mRoot)
+
+    // Плоскости строятся один раз за кадр, а не в каждом BoundingFrustum::Contains
+    mFrustumPlanes.Build(frustum);
+
+    // Frustum Culling корня; дальше дети проверяются сразу четвёрками
+    const QuadTreeNodeBlock& rootBlock = mNodeBlocks[0];
+    ContainmentType rootContainment;
+    uint8_t rootMask;
+    float rootMargin, rootInsideMargin;
+    mCullStats.BoxTests++;
+    mCullStats.PlaneTests += ClassifyBox(mFrustumPlanes, FrustumPlanes::AllPlanesMask,
+                                         rootBlock.CenterX[0], rootBlock.CenterY[0], rootBlock.CenterZ[0],
+                                         rootBlock.ExtentX[0], rootBlock.ExtentY[0], rootBlock.ExtentZ[0],
+                                         rootContainment, rootMask, mLastRejectPlane[RootIndex],
+                                         rootMargin, rootInsideMargin);
+    if (rootContainment == DISJOINT)
+    {
+        mCullStats.CulledNodes++;
+        mUnoccludedNodes.clear();
+        return;
+    }
+
+    for (TraversalWorker& worker : mWorkers)
+    {
+        worker.Stats = QuadTreeCullStats();
+    }
+
+    TraversalEntry root = { RootIndex, 0, rootMask, rootInsideMargin, false };
+    if (budgeted)
+    {
+        SelectWithinBudget(root, cameraPos);
+    }
+    else if (parallel)
+    {
+        TraverseParallel(root, cameraPos);
+    }
+    else
     {
-        UpdateNode(mRoot.get(), cameraPos, frustum);
+        Traverse(root, cameraPos, mWorkers[0], mVisibleNodes, -1);
+    }
+
+    for (const TraversalWorker& worker : mWorkers)
+    {
+        AddCullStats(mCullStats, worker.Stats);
+    }
+
+    if (mOcclusionCulling || mDepthOcclusion)
+    {
+        CullOccludedNodes(cameraPos, frustum);
     }
 }
 
-void QuadTree::UpdateNode(QuadTreeNode* node, const XMFLOAT3& cameraPos,
-                          const BoundingFrustum& frustum)
+void QuadTree::CullOccludedNodes(const XMFLOAT3& cameraPos, const BoundingFrustum& frustum)
 {
-    // Frustum Culling - проверяем видимость узла
-    if (frustum.Contains(node->Bounds) == DISJOINT)
+    mOccluded.assign(mVisibleNodes.size(), 0);
+    if (mOcclusionCulling)
     {
-        return; // Узел не видим - пропускаем
+        CullBehindHorizon(cameraPos);
     }
-    
-    // Вычисляем расстояние от камеры до центра узла
-    float dx = node->Center.x - cameraPos.x;
-    float dy = node->Center.y - cameraPos.y;
-    float dz = node->Center.z - cameraPos.z;
-    float distance = sqrtf(dx * dx + dy * dy + dz * dz);
-    
-    // Определяем LOD на основе расстояния
-    LODLevel lod = CalculateLOD(distance);
-    node->CurrentLOD = lod;
-    
-    // Определяем, нужно ли разбивать узел дальше
-    // Разбиваем если: не лист И LOD требует большей детализации чем текущая глубина
-    int requiredDepth = static_cast<int>(lod);
-    bool shouldSubdivide = !node->IsLeaf && (mMaxDepth - node->Depth) > requiredDepth;
-    
-    if (shouldSubdivide)
+    if (mDepthOcclusion && !mOccluderMesh.empty())
+    {
+        CullBehindDepth(frustum);
+    }
+
+    // Порядок обхода сохраняется
+    mUnoccludedNodes.clear();
+    for (size_t i = 0; i < mVisibleNodes.size(); i++)
+    {
+        if (!mOccluded[i])
+        {
+            mUnoccludedNodes.push_back(mVisibleNodes[i]);
+        }
+    }
+}
+
+void QuadTree::CullBehindHorizon(const XMFLOAT3& cameraPos)
+{
+    mHorizon.Reset(cameraPos.x, cameraPos.y, cameraPos.z);
+
+    // Узлы проверяются от ближних к дальним: к моменту проверки узла в горизонте все узлы,
+    // целиком лежащие ближе него, и только они
+    mOcclusionOrder.clear();
+    for (uint32_t i = 0; i < (uint32_t)mVisibleNodes.size(); i++)
+    {
+        const QuadTreeNodeBlock& block = Block(mVisibleNodes[i].NodeIndex);
+        uint32_t slot = mVisibleNodes[i].NodeIndex & 3;
+        float distance = mHorizon.NearestDistance(block.CenterX[slot] - block.ExtentX[slot],
+                                                  block.CenterZ[slot] - block.ExtentZ[slot],
+                                                  block.CenterX[slot] + block.ExtentX[slot],
+                                                  block.CenterZ[slot] + block.ExtentZ[slot]);
+        mOcclusionOrder.emplace_back(distance, i);
+    }
+    std::sort(mOcclusionOrder.begin(), mOcclusionOrder.end());
+    // Загораживающие прямоугольники дальше последнего узла ни на что не влияют
+    mOcclusionReach = mOcclusionOrder.empty() ? 0.0f : mOcclusionOrder.back().first;
+
+    // Рельеф всех узлов загораживает одинаково, скрыты они или нет
+    for (const QuadTreeRenderNode& node : mVisibleNodes)
+    {
+        QueueOccluders(node.NodeIndex);
+    }
+
+    for (const std::pair<float, uint32_t>& entry : mOcclusionOrder)
+    {
+        uint32_t index = mVisibleNodes[entry.second].NodeIndex;
+        const QuadTreeNodeBlock& block = Block(index);
+        uint32_t slot = index & 3;
+
+        mHorizon.FlushOccluders(entry.first);
+        if (mHorizon.IsOccluded(block.CenterX[slot] - block.ExtentX[slot], block.CenterZ[slot] - block.ExtentZ[slot],
+                                block.CenterX[slot] + block.ExtentX[slot], block.CenterZ[slot] + block.ExtentZ[slot],
+                                block.CenterY[slot] + block.ExtentY[slot]))
+        {
+            mOccluded[entry.second] = 1;
+            mCullStats.OccludedNodes++;
+        }
+    }
+}
+
+void QuadTree::QueueOccluders(uint32_t index)
+{
+    const QuadTreeNodeBlock& block = Block(index);
+    uint32_t slot = index & 3;
+    float minX = block.CenterX[slot] - block.ExtentX[slot];
+    float minZ = block.CenterZ[slot] - block.ExtentZ[slot];
+    float size = 2.0f * block.ExtentX[slot];
+
+    if (mOccluderHeights.empty() || size <= mOccluderCellSize)
+    {
+        mHorizon.QueueOccluder(minX, minZ, minX + size, minZ + size, block.CenterY[slot] - block.ExtentY[slot]);
+        return;
+    }
+
+    // Узел крупнее ячейки и выровнен по сетке - загораживают его ячейки
+    uint32_t firstX = (uint32_t)(minX / mOccluderCellSize + 0.5f);
+    uint32_t firstZ = (uint32_t)(minZ / mOccluderCellSize + 0.5f);
+    uint32_t cells = (uint32_t)(size / mOccluderCellSize + 0.5f);
+    for (uint32_t cellZ = firstZ; cellZ < firstZ + cells; cellZ++)
     {
-        // Рекурсивно обрабатываем дочерние узлы
-        for (int i = 0; i < 4; i++)
+        for (uint32_t cellX = firstX; cellX < firstX + cells; cellX++)
         {
-            if (node->Children[i])
+            float x = cellX * mOccluderCellSize;
+            float z = cellZ * mOccluderCellSize;
+            if (mHorizon.FarthestDistance(x, z, x + mOccluderCellSize, z + mOccluderCellSize) > mOcclusionReach)
             {
-                UpdateNode(node->Children[i].get(), cameraPos, frustum);
+                continue;
             }
+            mHorizon.QueueOccluder(x, z, x + mOccluderCellSize, z + mOccluderCellSize,
+                                   mOccluderHeights[cellZ * OccluderGridResolution + cellX]);
         }
     }
-    else
+}
+
+void QuadTree::CullBehindDepth(const BoundingFrustum& frustum)
+{
+    mOcclusionRasterizer.Render(frustum, mOccluderMesh.data(), OccluderGridResolution + 1, mOccluderCellSize, mPool);
+    mCullStats.OccluderTriangles = mOcclusionRasterizer.GetRasterizedTriangles();
+
+    for (size_t i = 0; i < mVisibleNodes.size(); i++)
+    {
+        uint32_t index = mVisibleNodes[i].NodeIndex;
+        const QuadTreeNodeBlock& block = Block(index);
+        uint32_t slot = index & 3;
+        if (!mOccluded[i] &&
+            mOcclusionRasterizer.IsOccluded(block.CenterX[slot], block.CenterY[slot], block.CenterZ[slot],
+                                            block.ExtentX[slot], block.ExtentY[slot], block.ExtentZ[slot]))
+        {
+            mOccluded[i] = 1;
+            mCullStats.DepthOccludedNodes++;
+        }
+    }
+}
+
+void QuadTree::TraverseParallel(const TraversalEntry& root, const XMFLOAT3& cameraPos)
+{
+    // Верхние уровни обходятся вызывающим потоком; видимые узлы глубины frontierDepth,
+    // которые нужно разбивать дальше, становятся задачами. Глубина выбирается так,
+    // чтобы задач было в несколько раз больше потоков - иначе нечего перехватывать.
+    // Задачи не делятся дальше: несбалансированное поддерево остаётся на одном потоке.
+    uint32_t threadCount = mPool->GetThreadCount();
+    int frontierDepth = 1;
+    while (frontierDepth < mMaxDepth - 1 && (1u << (2 * frontierDepth)) < TasksPerThread * threadCount)
+    {
+        frontierDepth++;
+    }
+
+    mTaskCount = 0;
+    Traverse(root, cameraPos, mWorkers[0], mVisibleNodes, frontierDepth);
+
+    mPool->Run(mTaskCount, [&](uint32_t taskIndex, uint32_t thread)
+    {
+        TraversalTask& task = mTasks[taskIndex];
+        task.Output.clear();
+        Traverse(task.Start, cameraPos, mWorkers[thread], task.Output, -1);
+    });
+
+    // Задачи упорядочены как в последовательном обходе, поэтому итоговый список
+    // совпадает с ним независимо от того, какой поток что обработал
+    mMergedNodes.clear();
+    size_t next = 0;
+    for (uint32_t i = 0; i < mTaskCount; i++)
+    {
+        const TraversalTask& task = mTasks[i];
+        mMergedNodes.insert(mMergedNodes.end(), mVisibleNodes.begin() + next, mVisibleNodes.begin() + task.OutputPosition);
+        mMergedNodes.insert(mMergedNodes.end(), task.Output.begin(), task.Output.end());
+        next = task.OutputPosition;
+    }
+    mMergedNodes.insert(mMergedNodes.end(), mVisibleNodes.begin() + next, mVisibleNodes.end());
+    std::swap(mVisibleNodes, mMergedNodes);
+}
+
+void QuadTree::SelectWithinBudget(const TraversalEntry& root, const XMFLOAT3& cameraPos)
+{
+    // Разрез дерева растёт от корня: куча держит узлы разреза, которые ещё можно разбить, по убыванию
+    // пиксельной ошибки на треугольник. Каждый узел попадает в кучу не больше одного раза, поэтому
+    // выбор стоит O(n log n) от числа видимых узлов.
+    QuadTreeCullStats& stats = mWorkers[0].Stats;
+    mBudgetCandidates.clear();
+    mBudgetHeap.clear();
+    AddBudgetCandidate(root.Index, root.Depth, root.PlaneMask, cameraPos);
+    QueueBudgetSplit(0, cameraPos);
+
+    uint32_t patches = mBudgetCandidates[0].Patches;
+    uint32_t triangles = mBudgetCandidates[0].Triangles;
+    while (!mBudgetHeap.empty())
+    {
+        std::pop_heap(mBudgetHeap.begin(), mBudgetHeap.end());
+        BudgetCandidate candidate = mBudgetCandidates[mBudgetHeap.back().second];
+        mBudgetHeap.pop_back();
+
+        uint32_t child = FirstChild(candidate.Index, candidate.Depth);
+        uint32_t firstChildCandidate = (uint32_t)mBudgetCandidates.size();
+        if (candidate.PlaneMask == 0)
+        {
+            // Узел целиком внутри пирамиды - дети принимаются без проверок
+            stats.ContainedNodes += 4;
+            for (uint32_t i = 0; i < 4; i++)
+            {
+                AddBudgetCandidate(child + i, candidate.Depth + 1, 0, cameraPos);
+            }
+        }
+        else
+        {
+            const QuadTreeNodeBlock& childBlock = Block(child);
+            BoxCullResult4 cull;
+            stats.BoxTests += 4;
+            stats.PlaneTests += ClassifyBoxes4(mFrustumPlanes, candidate.PlaneMask, &mLastRejectPlane[child],
+                                               childBlock.CenterX, childBlock.CenterY, childBlock.CenterZ,
+                                               childBlock.ExtentX, childBlock.ExtentY, childBlock.ExtentZ,
+                                               cull);
+            for (uint32_t i = 0; i < 4; i++)
+            {
+                if (cull.Containment[i] == DISJOINT)
+                {
+                    mLastRejectPlane[child + i] = cull.RejectPlane[i];
+                    stats.CulledNodes++;
+                }
+                else
+                {
+                    AddBudgetCandidate(child + i, candidate.Depth + 1, cull.PlaneMask[i], cameraPos);
+                }
+            }
+        }
+
+        // Разбиение заменяет стоимость узла стоимостью видимых детей
+        uint64_t splitPatches = (uint64_t)patches - candidate.Patches;
+        uint64_t splitTriangles = (uint64_t)triangles - candidate.Triangles;
+        for (uint32_t i = firstChildCandidate; i < mBudgetCandidates.size(); i++)
+        {
+            splitPatches += mBudgetCandidates[i].Patches;
+            splitTriangles += mBudgetCandidates[i].Triangles;
+        }
+        if (splitPatches > mMaxPatches || splitTriangles > mMaxTriangles)
+        {
+            // Узел остаётся в разрезе целиком; более дешёвые разбиения ниже по приоритету ещё могут влезть
+            mBudgetCandidates.resize(firstChildCandidate);
+            stats.BudgetExhausted = 1;
+            continue;
+        }
+
+        patches = (uint32_t)splitPatches;
+        triangles = (uint32_t)splitTriangles;
+        mBudgetSplit[candidate.Index] = 1;
+        stats.BudgetSplits++;
+        for (uint32_t i = firstChildCandidate; i < mBudgetCandidates.size(); i++)
+        {
+            QueueBudgetSplit(i, cameraPos);
+        }
+    }
+    stats.BudgetPatches = patches;
+    stats.BudgetTriangles = triangles;
+
+    // Узлы разреза выводятся в порядке обхода в глубину, как при обычном обходе. Кандидаты,
+    // отброшенные пирамидой, в список не попали - ребёнок разбитого узла выводится, только если он есть
+    // среди кандидатов, поэтому сначала помечаем их.
+    for (const BudgetCandidate& candidate : mBudgetCandidates)
+    {
+        mBudgetSplit[candidate.Index] |= 2;
+    }
+
+    std::vector<TraversalEntry>& stack = mWorkers[0].Stack;
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty())
     {
-        // Этот узел рендерится - добавляем в список
+        TraversalEntry entry = stack.back();
+        stack.pop_back();
+
+        if (mBudgetSplit[entry.Index] & 1)
+        {
+            uint32_t child = FirstChild(entry.Index, entry.Depth);
+            for (int i = 3; i >= 0; i--)
+            {
+                if (mBudgetSplit[child + i] & 2)
+                {
+                    stack.push_back({ child + i, entry.Depth + 1, 0, 0.0f, false });
+                }
+            }
+            continue;
+        }
+
         QuadTreeRenderNode renderNode;
-        renderNode.Node = node;
-        renderNode.LOD = lod;
-        renderNode.DistanceToCamera = distance;
+        renderNode.NodeIndex = entry.Index;
+        renderNode.LOD = DepthToLOD(entry.Depth);
+        renderNode.DistanceToCamera = DistanceToBase(Block(entry.Index), entry.Index & 3, cameraPos);
         mVisibleNodes.push_back(renderNode);
     }
+
+    for (const BudgetCandidate& candidate : mBudgetCandidates)
+    {
+        mBudgetSplit[candidate.Index] = 0;
+    }
+}
+
+void QuadTree::AddBudgetCandidate(uint32_t index, int depth, uint32_t planeMask, const XMFLOAT3& cameraPos)
+{
+    // Узел рисуется экземплярами TerrainInstanceBuilder: (size / basePatchSize) >> LOD патчей на ребро
+    const QuadTreeNodeBlock& block = Block(index);
+    uint32_t slot = index & 3;
+    float size = 2.0f * block.ExtentX[slot];
+    uint32_t patchesPerEdge = std::max((uint32_t)lroundf(size / mBasePatchSize) >> static_cast<int>(DepthToLOD(depth)), 1u);
+
+    BudgetCandidate candidate;
+    candidate.Index = index;
+    candidate.Depth = depth;
+    candidate.PlaneMask = planeMask;
+    candidate.Patches = patchesPerEdge * patchesPerEdge;
+    candidate.Triangles = PredictPatchGridTriangles(XMFLOAT2(block.CenterX[slot] - block.ExtentX[slot],
+                                                             block.CenterZ[slot] - block.ExtentZ[slot]),
+                                                    size, patchesPerEdge, cameraPos, mBasePatchSize);
+    mBudgetCandidates.push_back(candidate);
+    mWorkers[0].Stats.NodesVisited++;
+}
+
+void QuadTree::QueueBudgetSplit(uint32_t position, const XMFLOAT3& cameraPos)
+{
+    // В кучу попадают узлы, которые разбил бы и режим ScreenSpaceError
+    const BudgetCandidate& candidate = mBudgetCandidates[position];
+    if (candidate.Depth >= mMaxDepth)
+    {
+        return;
+    }
+
+    const QuadTreeNodeBlock& block = Block(candidate.Index);
+    uint32_t slot = candidate.Index & 3;
+    float pixelError = block.GeometricError[slot] * mErrorToPixels /
+                       std::max(DistanceToNode(block, slot, cameraPos), 1.0f);
+    if (pixelError > mPixelTolerance)
+    {
+        mBudgetHeap.emplace_back(pixelError / std::max(candidate.Triangles, 1u), position);
+        std::push_heap(mBudgetHeap.begin(), mBudgetHeap.end());
+    }
+}
+
+void QuadTree::Traverse(const TraversalEntry& start, const XMFLOAT3& cameraPos, TraversalWorker& worker,
+                        std::vector<QuadTreeRenderNode>& output, int frontierDepth)
+{
+    const bool incremental = mFrameIncremental;
+    const bool reuse = mFrameReuse;
+    const CameraPose& pose = mFramePose;
+    std::vector<TraversalEntry>& stack = worker.Stack;
+    QuadTreeCullStats& stats = worker.Stats;
+
+    // Обход в глубину с явным стеком вместо рекурсии по указателям.
+    // В стек попадают только узлы, уже прошедшие проверку видимости, вместе с маской
+    // плоскостей, которые они пересекают: плоскость, целиком пройденная родителем,
+    // пройдена и всеми его потомками.
+    //
+    // В инкрементальном режиме для каждого обойдённого узла запоминается диапазон его поддерева
+    // в выходном списке и запас - насколько могут сместиться (в пространстве камеры) точки поддерева,
+    // прежде чем изменится хоть одно решение внутри него: выбор LOD, отсечение или пересечение
+    // плоскостей детьми, а также вложенность в плоскости, исключённые из маски предками.
+    // Запас поддерева - минимум запасов решений в нём, он собирается снизу вверх записями Finalize.
+    stack.clear();
+    stack.push_back(start);
+
+    while (!stack.empty())
+    {
+        TraversalEntry entry = stack.back();
+        stack.pop_back();
+
+        if (entry.Finalize)
+        {
+            NodeCache& cache = mNodeCache[entry.Index];
+            cache.OutputFrame = mFrame;
+            cache.OutputCount = (uint32_t)output.size() - cache.OutputStart;
+            ReportSlack(entry.Index, entry.Depth, cache.Slack);
+            continue;
+        }
+
+        if (entry.Depth == frontierDepth)
+        {
+            // Граница параллельного обхода: поддерево уходит в отдельную задачу
+            if (mTaskCount == mTasks.size())
+            {
+                mTasks.emplace_back();
+            }
+            TraversalTask& task = mTasks[mTaskCount++];
+            task.Start = entry;
+            task.OutputPosition = (uint32_t)output.size();
+            continue;
+        }
+
+        stats.NodesVisited++;
+
+        const QuadTreeNodeBlock& block = Block(entry.Index);
+        uint32_t slot = entry.Index & 3;
+
+        if (reuse)
+        {
+            // Поддерево обходилось в прошлом кадре, и камера сместилась меньше его запаса -
+            // его часть списка не изменилась
+            NodeCache& cache = mNodeCache[entry.Index];
+            if (cache.OutputFrame == mFrame - 1 && mFrame - cache.EvalFrame < PoseHistorySize)
+            {
+                const CameraPose& evalPose = mPoseHistory[cache.EvalFrame % PoseHistorySize];
+                float dx = cameraPos.x - evalPose.Position.x;
+                float dy = cameraPos.y - evalPose.Position.y;
+                float dz = cameraPos.z - evalPose.Position.z;
+                float travel = sqrtf(dx * dx + dy * dy + dz * dz);
+                float reach = FarthestDistance(block, slot, cameraPos) + travel;
+                float moved = PoseDisplacement(evalPose, pose, reach) + SlackRoundoff * reach;
+
+                if (moved < cache.Slack)
+                {
+                    uint32_t start = (uint32_t)output.size();
+                    for (uint32_t i = 0; i < cache.OutputCount; i++)
+                    {
+                        QuadTreeRenderNode renderNode = mPrevVisibleNodes[cache.OutputStart + i];
+                        renderNode.DistanceToCamera = DistanceToBase(Block(renderNode.NodeIndex),
+                                                                     renderNode.NodeIndex & 3, cameraPos);
+                        output.push_back(renderNode);
+                    }
+
+                    cache.OutputFrame = mFrame;
+                    cache.OutputStart = start;
+                    stats.ReusedSubtrees++;
+                    stats.ReusedNodes += cache.OutputCount;
+                    ReportSlack(entry.Index, entry.Depth, cache.Slack - moved);
+                    continue;
+                }
+            }
+        }
+
+        // Вычисляем расстояние от камеры до центра основания узла
+        float distance = DistanceToBase(block, slot, cameraPos);
+
+        LODLevel lod;
+        bool shouldSubdivide;
+        if (mSelectionMode == LODSelectionMode::ScreenSpaceError)
+        {
+            // Ошибка узла в пикселях: мировая ошибка, спроецированная с ближайшей точки бокса
+            float pixelError = block.GeometricError[slot] * mErrorToPixels /
+                               std::max(DistanceToNode(block, slot, cameraPos), 1.0f);
+            shouldSubdivide = entry.Depth < mMaxDepth && pixelError > mPixelTolerance;
+            lod = DepthToLOD(entry.Depth);
+        }
+        else
+        {
+            // Определяем LOD на основе расстояния
+            lod = CalculateLOD(distance);
+
+            // Определяем, нужно ли разбивать узел дальше
+            // Разбиваем если: не лист И LOD требует большей детализации чем текущая глубина
+            int requiredDepth = static_cast<int>(lod);
+            shouldSubdivide = entry.Depth < mMaxDepth && (mMaxDepth - entry.Depth) > requiredDepth;
+        }
+
+        NodeCache* cache = nullptr;
+        if (incremental)
+        {
+            cache = &mNodeCache[entry.Index];
+            cache->OutputStart = (uint32_t)output.size();
+            cache->EvalFrame = mFrame;
+            cache->Slack = std::min(entry.InheritedMargin,
+                                    LODMargin(block, slot, entry.Depth, distance, cameraPos));
+        }
+
+        if (shouldSubdivide)
+        {
+            uint32_t child = FirstChild(entry.Index, entry.Depth);
+
+            if (incremental)
+            {
+                stack.push_back({ entry.Index, entry.Depth, 0, 0.0f, true });
+            }
+
+            if (entry.PlaneMask == 0)
+            {
+                // Узел целиком внутри пирамиды - поддерево принимается без проверок
+                stats.ContainedNodes += 4;
+                for (int i = 3; i >= 0; i--)
+                {
+                    stack.push_back({ child + i, entry.Depth + 1, 0, entry.InheritedMargin, false });
+                }
+                continue;
+            }
+
+            // Все четыре ребёнка лежат в одном блоке - проверяем их за один проход
+            const QuadTreeNodeBlock& childBlock = Block(child);
+            BoxCullResult4 cull;
+            stats.BoxTests += 4;
+            stats.PlaneTests += ClassifyBoxes4(mFrustumPlanes, entry.PlaneMask, &mLastRejectPlane[child],
+                                                    childBlock.CenterX, childBlock.CenterY, childBlock.CenterZ,
+                                                    childBlock.ExtentX, childBlock.ExtentY, childBlock.ExtentZ,
+                                                    cull);
+
+            // Дети кладутся в обратном порядке, чтобы NW обрабатывался первым
+            for (int i = 3; i >= 0; i--)
+            {
+                if (cache)
+                {
+                    // Ребёнок, вышедший из пирамиды или вошедший в неё, меняет результат этого узла
+                    cache->Slack = std::min(cache->Slack, cull.Margin[i]);
+                }
+
+                if (cull.Containment[i] == DISJOINT)
+                {
+                    mLastRejectPlane[child + i] = cull.RejectPlane[i];
+                    stats.CulledNodes++;
+                }
+                else
+                {
+                    stack.push_back({ child + i, entry.Depth + 1, cull.PlaneMask[i],
+                                                std::min(entry.InheritedMargin, cull.InsideMargin[i]), false });
+                }
+            }
+        }
+        else
+        {
+            // Этот узел рендерится - добавляем в список
+            QuadTreeRenderNode renderNode;
+            renderNode.NodeIndex = entry.Index;
+            renderNode.LOD = lod;
+            renderNode.DistanceToCamera = distance;
+            output.push_back(renderNode);
+
+            if (cache)
+            {
+                cache->OutputFrame = mFrame;
+                cache->OutputCount = 1;
+                ReportSlack(entry.Index, entry.Depth, cache->Slack);
+            }
+        }
+    }
+}
+
+void QuadTree::SetParallelUpdate(WorkStealingPool* pool)
+{
+    mPool = pool;
+    mWorkers.resize(pool ? std::max(pool->GetThreadCount(), 1u) : 1);
+    for (TraversalWorker& worker : mWorkers)
+    {
+        worker.Stack.reserve(4 * mMaxDepth + 1);
+    }
+    mHistoryValid = false;
+}
+
+void QuadTree::ReportSlack(uint32_t index, int depth, float slack)
+{
+    // Запас поддерева ограничивает запас родителя, который в этот момент ещё обходится
+    if (depth > 0)
+    {
+        NodeCache& parent = mNodeCache[Parent(index, depth)];
+        parent.Slack = std::min(parent.Slack, slack);
+    }
+}
+
+float QuadTree::PoseDisplacement(const CameraPose& from, const CameraPose& to, float reach)
+{
+    // Оценка сверху смещения точки в пространстве камеры при переходе между позами:
+    // сдвиг камеры плюс поворот на угол между ориентациями, умноженный на удалённость точки
+    // от старой позиции камеры (reach). Плоскости пирамиды и расстояния до камеры меняются
+    // не больше, чем на эту величину.
+    float dx = to.Position.x - from.Position.x;
+    float dy = to.Position.y - from.Position.y;
+    float dz = to.Position.z - from.Position.z;
+    float travel = sqrtf(dx * dx + dy * dy + dz * dz);
+
+    return travel + RotationAngle(from.Orientation, to.Orientation) * reach;
+}
+
+float QuadTree::RotationAngle(const XMFLOAT4& from, const XMFLOAT4& to)
+{
+    // Угол поворота между двумя ориентациями (кватернионы единичной длины) по относительному
+    // кватерниону conj(from) * to. acos скалярного произведения во float теряет малые углы
+    // (около 3e-4 рад при dot, округлённом до 1), поэтому угол берётся через atan2 от векторной части
+    float x = from.w * to.x - to.w * from.x - (from.y * to.z - from.z * to.y);
+    float y = from.w * to.y - to.w * from.y - (from.z * to.x - from.x * to.z);
+    float z = from.w * to.z - to.w * from.z - (from.x * to.y - from.y * to.x);
+    float w = from.w * to.w + from.x * to.x + from.y * to.y + from.z * to.z;
+    return 2.0f * atan2f(sqrtf(x * x + y * y + z * z), fabsf(w));
 }
 
 LODLevel QuadTree::CalculateLOD(float distance) const
@@ -135,7 +1011,7 @@ LODLevel QuadTree::CalculateLOD(float distance) const
     // mLodDistances[0] = расстояние для LOD0->LOD1
     // mLodDistances[1] = расстояние для LOD1->LOD2
     // и т.д.
-    
+
     for (size_t i = 0; i < mLodDistances.size(); i++)
     {
         if (distance < mLodDistances[i])
@@ -143,6 +1019,64 @@ LODLevel QuadTree::CalculateLOD(float distance) const
             return static_cast<LODLevel>(i);
         }
     }
-    
+
     return static_cast<LODLevel>(mLodDistances.size());
 }
+
+LODLevel QuadTree::DepthToLOD(int depth) const
+{
+    // Листья - максимальная детализация, каждый уровень вверх - на один LOD грубее
+    int lod = std::min(mMaxDepth - depth, static_cast<int>(LODLevel::LOD3));
+    return static_cast<LODLevel>(std::max(lod, 0));
+}
+
+float QuadTree::DistanceToNode(const QuadTreeNodeBlock& block, uint32_t slot, const XMFLOAT3& cameraPos) const
+{
+    // Расстояние до ближайшей точки бокса (0, если камера внутри)
+    float dx = std::max(fabsf(cameraPos.x - block.CenterX[slot]) - block.ExtentX[slot], 0.0f);
+    float dy = std::max(fabsf(cameraPos.y - block.CenterY[slot]) - block.ExtentY[slot], 0.0f);
+    float dz = std::max(fabsf(cameraPos.z - block.CenterZ[slot]) - block.ExtentZ[slot], 0.0f);
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+float QuadTree::DistanceToBase(const QuadTreeNodeBlock& block, uint32_t slot, const XMFLOAT3& cameraPos) const
+{
+    // Расстояние до центра основания узла
+    float dx = block.CenterX[slot] - cameraPos.x;
+    float dy = (block.CenterY[slot] - block.ExtentY[slot]) - cameraPos.y;
+    float dz = block.CenterZ[slot] - cameraPos.z;
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+float QuadTree::FarthestDistance(const QuadTreeNodeBlock& block, uint32_t slot, const XMFLOAT3& cameraPos) const
+{
+    // Расстояние до самой дальней точки бокса
+    float dx = fabsf(cameraPos.x - block.CenterX[slot]) + block.ExtentX[slot];
+    float dy = fabsf(cameraPos.y - block.CenterY[slot]) + block.ExtentY[slot];
+    float dz = fabsf(cameraPos.z - block.CenterZ[slot]) + block.ExtentZ[slot];
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+float QuadTree::LODMargin(const QuadTreeNodeBlock& block, uint32_t slot, int depth, float baseDistance,
+                          const XMFLOAT3& cameraPos) const
+{
+    // Насколько может измениться расстояние, прежде чем изменится выбор LOD узла
+    if (mSelectionMode == LODSelectionMode::ScreenSpaceError)
+    {
+        if (depth >= mMaxDepth)
+        {
+            return FLT_MAX;
+        }
+
+        // Узел разбивается, пока расстояние меньше error * K / tolerance
+        float switchDistance = block.GeometricError[slot] * mErrorToPixels / mPixelTolerance;
+        return fabsf(std::max(DistanceToNode(block, slot, cameraPos), 1.0f) - switchDistance);
+    }
+
+    float margin = FLT_MAX;
+    for (float threshold : mLodDistances)
+    {
+        margin = std::min(margin, fabsf(baseDistance - threshold));
+    }
+    return margin;
+}
@@ -1,12 +1,17 @@
 #pragma once
 
-#include <Windows.h>
 #include <DirectXMath.h>
 #include <DirectXCollision.h>
+#include "FrustumCulling.h"
+#include "HorizonCulling.h"
+#include "OcclusionRasterizer.h"
 #include <vector>
-#include <memory>
+#include <utility>
 #include <cstdint>
 
+class HeightPyramid;
+class WorkStealingPool;
+
 // LOD уровни для Quadtree
 enum class LODLevel
 {
@@ -16,73 +21,306 @@ enum class LODLevel
     LOD3 = 3   // Минимальная детализация (далеко)
 };
 
-// Узел Quadtree
-struct QuadTreeNode
+// Горячие данные узлов - всё, что нужно для отсечения и выбора LOD.
+// Узлы лежат в одном массиве в порядке обхода в ширину, по четыре сестры в блоке (AoSoA):
+// блок 0 содержит корень (слот 0, остальные слоты пустые), дальше уровни идут подряд без пропусков.
+// Индекс узла n соответствует блоку n / 4 и слоту n % 4; дети узла n глубины d (NW, NE, SW, SE)
+// занимают блок, начинающийся с GetLevelStart(d + 1) + 4 * (n - GetLevelStart(d)).
+struct alignas(16) QuadTreeNodeBlock
+{
+    float CenterX[4];
+    float CenterY[4];
+    float CenterZ[4];
+    float ExtentX[4];                      // Половина размера узла
+    float ExtentY[4];
+    float ExtentZ[4];
+    float GeometricError[4];               // Максимальное отклонение упрощённой поверхности узла от полной (мировые единицы)
+};
+
+// Способ выбора LOD
+enum class LODSelectionMode
+{
+    Distance,          // Фиксированные пороги расстояния (mLodDistances)
+    ScreenSpaceError,  // Проекция геометрической ошибки узла в пиксели
+    TriangleBudget     // Как ScreenSpaceError, но разбиения по убыванию ошибки на треугольник до бюджета
+};
+
+// Холодные данные узла - нужны только при рендеринге
+struct QuadTreeNodeData
 {
-    DirectX::BoundingBox Bounds;           // Границы узла
-    DirectX::XMFLOAT3 Center;              // Центр узла
-    float Size;                            // Размер узла
-    int Depth;                             // Глубина в дереве (0 = корень)
-    LODLevel CurrentLOD;                   // Текущий LOD уровень
-    bool IsLeaf;                           // Является ли листом
-    
-    // Дочерние узлы (NW, NE, SW, SE)
-    std::unique_ptr<QuadTreeNode> Children[4];
-    
-    // Индексы для рендеринга
-    uint32_t VertexOffset;
-    uint32_t IndexOffset;
-    uint32_t IndexCount;
-    
     // Текстурные координаты для этого узла
     DirectX::XMFLOAT2 TexCoordMin;
     DirectX::XMFLOAT2 TexCoordMax;
-    
-    QuadTreeNode() : Size(0), Depth(0), CurrentLOD(LODLevel::LOD0), 
-                     IsLeaf(true), VertexOffset(0), IndexOffset(0), IndexCount(0) {}
+
+    QuadTreeNodeData() : TexCoordMin(0, 0), TexCoordMax(0, 0) {}
 };
 
 // Результат обхода Quadtree - узлы для рендеринга
 struct QuadTreeRenderNode
 {
-    QuadTreeNode* Node;
+    uint32_t NodeIndex;
     LODLevel LOD;
     float DistanceToCamera;
 };
 
+// Счётчики отсечения за последний Update
+struct QuadTreeCullStats
+{
+    uint32_t NodesVisited;     // Узлы, снятые со стека обхода
+    uint32_t BoxTests;         // Боксы, прошедшие через тест пирамиды
+    uint32_t PlaneTests;       // Проверки бокс-плоскость
+    uint32_t ContainedNodes;   // Узлы, принятые без теста (предок целиком внутри пирамиды)
+    uint32_t CulledNodes;      // Узлы, отброшенные пирамидой
+    uint32_t ReusedSubtrees;   // Поддеревья, результат которых скопирован из прошлого кадра без обхода
+    uint32_t ReusedNodes;      // Узлы рендеринга, пришедшие из скопированных поддеревьев
+    uint32_t FrameReused;      // 1, если камера почти не сдвинулась и весь прошлый результат взят как есть
+    uint32_t OccludedNodes;    // Узлы, прошедшие пирамиду, но целиком скрытые за горизонтом
+    uint32_t DepthOccludedNodes;   // Узлы, отброшенные программным буфером глубины (после горизонта)
+    uint32_t OccluderTriangles;    // Загораживающие треугольники, дошедшие до растеризации
+    uint32_t BudgetSplits;         // Разбиения узлов в режиме TriangleBudget
+    uint32_t BudgetPatches;        // Патчи выбранных узлов до отсечения перекрытых (TriangleBudget)
+    uint32_t BudgetTriangles;      // Их треугольники тесселяции
+    uint32_t BudgetExhausted;      // 1, если разбиение остановил бюджет, а не допуск ошибки
+};
+
 class QuadTree
 {
 public:
     QuadTree();
     ~QuadTree();
-    
+
     // Инициализация дерева
-    void Initialize(float terrainSize, int maxDepth, 
+    void Initialize(float terrainSize, int maxDepth,
                     const std::vector<float>& lodDistances);
-    
+
+    // Подгонка вертикальных границ узлов по min/max пирамиде высот.
+    // margin - запас на погрешность сжатия карты высот на GPU.
+    void RefitHeights(const HeightPyramid& heights, float margin);
+
+    // Геометрическая ошибка узлов: отклонение полной карты высот от её билинейной
+    // реконструкции по сетке gridResolution x gridResolution отсчётов на узел.
+    // Ошибка родителя не меньше ошибки детей. Режим выбора LOD не меняет.
+    void ComputeGeometricErrors(const HeightPyramid& heights, int gridResolution);
+
+    // Параметры проекции ошибки в пиксели: вертикальный FOV (радианы), высота вьюпорта, допуск в пикселях
+    void SetScreenSpaceErrorParams(float fovY, float viewportHeight, float pixelTolerance);
+    void SetSelectionMode(LODSelectionMode mode) { mSelectionMode = mode; mHistoryValid = false; }
+
+    // Режим TriangleBudget: вместо обхода сверху вниз узлы разбиваются жадно - из кучи кандидатов
+    // берётся узел с наибольшей пиксельной ошибкой на треугольник и разбивается, если ошибка больше
+    // допуска и разбиение не превысит бюджет треугольников или патчей (иначе узел остаётся как есть).
+    // Стоимость узла - патчи, которыми его нарисует TerrainInstanceBuilder ((size / basePatchSize) >> LOD
+    // на ребро), и их треугольники по факторам hs.hlsl (TerrainTessellation), basePatchSize - gBasePatchSize.
+    // Без бюджета выбор совпадает с ScreenSpaceError. Нужны ComputeGeometricErrors и
+    // SetScreenSpaceErrorParams; инкрементальный и параллельный обход в этом режиме не действуют.
+    void SetTriangleBudget(uint32_t maxTriangles, uint32_t maxPatches, float basePatchSize);
+    LODSelectionMode GetSelectionMode() const { return mSelectionMode; }
+    float GetNodeGeometricError(uint32_t index) const { return Block(index).GeometricError[index & 3]; }
+
+    // Инкрементальный режим. Если с прошлого обхода камера сместилась меньше чем на positionEpsilon
+    // и повернулась меньше чем на angleEpsilon (радианы), Update оставляет прошлый результат.
+    // Иначе поддеревья, у которых ни выбор LOD, ни классификация пирамидой не могли измениться
+    // (смещение камеры меньше запаса, посчитанного при их обходе), копируются из прошлого списка.
+    void SetIncrementalUpdate(bool enabled, float positionEpsilon, float angleEpsilon);
+    bool IsIncrementalUpdate() const { return mIncremental; }
+
+    // Параллельный обход: вызывающий поток обходит верхние уровни, и видимые узлы глубины разреза
+    // (около TasksPerThread задач на поток) становятся задачами. Разбиение статическое: задачу целиком
+    // обходит взявший её поток, перехват перераспределяет только эти задачи, а не части поддеревьев.
+    // Результат собирается в том же порядке, что и при последовательном обходе.
+    // Включается только для деревьев глубиной от ParallelMinDepth; инкрементальный режим при этом не действует.
+    // Растеризация загораживающей сетки (SetDepthOcclusion) идёт на пуле при любой глубине.
+    // nullptr - последовательный обход. Пул должен жить, пока используется дерево.
+    void SetParallelUpdate(WorkStealingPool* pool);
+    static const int ParallelMinDepth = 6;
+
+    // Отсечение перекрытых узлов: после обхода видимые узлы проверяются от ближних к дальним
+    // против горизонта из узлов, целиком лежащих ближе проверяемого (OcclusionHorizon). Загораживающие
+    // прямоугольники - ячейки сетки OccluderGridResolution x OccluderGridResolution с минимальными
+    // высотами из RefitHeights (или сами узлы, если они мельче ячейки). Отсечение консервативно.
+    // Кэш инкрементального режима работает со списком до отсечения, GetVisibleNodes возвращает список после.
+    void SetOcclusionCulling(bool enabled) { mOcclusionCulling = enabled; mHistoryValid = false; }
+    bool IsOcclusionCulling() const { return mOcclusionCulling; }
+    static const uint32_t OccluderGridResolution = 64;
+
+    // Отсечение по программному буферу глубины (OcclusionRasterizer): та же сетка минимумов, но как
+    // сплошная поверхность - вершина берёт минимум соседних ячеек, так что треугольники лежат не выше
+    // рельефа. Растеризуется по тайлам в потоках пула SetParallelUpdate (при любой глубине дерева),
+    // затем боксы оставшихся после горизонта узлов проверяются по пирамиде глубины.
+    void SetDepthOcclusion(bool enabled) { mDepthOcclusion = enabled; mHistoryValid = false; }
+    bool IsDepthOcclusion() const { return mDepthOcclusion; }
+    const OcclusionRasterizer& GetOcclusionRasterizer() const { return mOcclusionRasterizer; }
+
     // Обновление LOD на основе позиции камеры
-    void Update(const DirectX::XMFLOAT3& cameraPos, 
+    void Update(const DirectX::XMFLOAT3& cameraPos,
                 const DirectX::BoundingFrustum& frustum);
-    
+
     // Получить узлы для рендеринга
-    const std::vector<QuadTreeRenderNode>& GetVisibleNodes() const { return mVisibleNodes; }
-    
-    // Получить корневой узел
-    QuadTreeNode* GetRoot() { return mRoot.get(); }
-    
+    const std::vector<QuadTreeRenderNode>& GetVisibleNodes() const
+    {
+        return (mOcclusionCulling || mDepthOcclusion) ? mUnoccludedNodes : mVisibleNodes;
+    }
+
+    // Счётчики отсечения последнего кадра
+    const QuadTreeCullStats& GetCullStats() const { return mCullStats; }
+
+    // Доступ к данным узла по индексу
+    DirectX::BoundingBox GetNodeBounds(uint32_t index) const;
+    float GetNodeSize(uint32_t index) const { return 2.0f * Block(index).ExtentX[index & 3]; }
+    int GetNodeDepth(uint32_t index) const;
+    const QuadTreeNodeData& GetNodeData(uint32_t index) const { return mNodeData[index]; }
+    QuadTreeNodeData& GetNodeData(uint32_t index) { return mNodeData[index]; }
+
     // Параметры
     int GetMaxDepth() const { return mMaxDepth; }
     float GetTerrainSize() const { return mTerrainSize; }
+    uint32_t GetNodeCount() const { return mNodeCount; }
+
+    // Размер массивов, индексируемых номером узла: GetNodeCount плюс три пустых слота блока корня
+    uint32_t GetNodeSlotCount() const { return mLevelStart.empty() ? 0 : mLevelStart.back(); }
+
+    static constexpr uint32_t RootIndex = 0;
+    // Индекс первого узла уровня depth (depth <= GetMaxDepth() + 1, последний - конец массива)
+    uint32_t GetLevelStart(int depth) const { return mLevelStart[depth]; }
+    uint32_t FirstChild(uint32_t index, int depth) const { return mLevelStart[depth + 1] + 4 * (index - mLevelStart[depth]); }
+    uint32_t Parent(uint32_t index, int depth) const { return mLevelStart[depth - 1] + (index - mLevelStart[depth]) / 4; }
 
 private:
-    void BuildTree(QuadTreeNode* node, float x, float z, float size, int depth);
-    void UpdateNode(QuadTreeNode* node, const DirectX::XMFLOAT3& cameraPos,
-                    const DirectX::BoundingFrustum& frustum);
+    struct TraversalEntry
+    {
+        uint32_t Index;
+        int Depth;
+        uint32_t PlaneMask;   // Плоскости, которые пересекает родитель; 0 - поддерево целиком внутри
+        float InheritedMargin; // Запас плоскостей, исключённых из маски предками
+        bool Finalize;        // Дети узла обработаны - закрыть его диапазон в списке (инкрементальный режим)
+    };
+
+    // Запомненный результат поддерева для инкрементального режима
+    struct NodeCache
+    {
+        uint32_t OutputFrame;  // Кадр, в списке которого лежит результат поддерева
+        uint32_t OutputStart;  // Диапазон узлов поддерева в этом списке
+        uint32_t OutputCount;
+        uint32_t EvalFrame;    // Кадр, от позы камеры которого отсчитан запас
+        float Slack;           // Допустимое смещение точек поддерева в пространстве камеры
+    };
+
+    struct CameraPose
+    {
+        DirectX::XMFLOAT3 Position;
+        DirectX::XMFLOAT4 Orientation;
+    };
+
+    static const uint32_t PoseHistorySize = 64;
+
+    // Состояние потока обхода
+    struct TraversalWorker
+    {
+        std::vector<TraversalEntry> Stack;
+        QuadTreeCullStats Stats;
+    };
+
+    // Поддерево, обходимое отдельной задачей в параллельном режиме
+    struct TraversalTask
+    {
+        TraversalEntry Start;
+        uint32_t OutputPosition;                 // Сколько узлов верхних уровней предшествует поддереву
+        std::vector<QuadTreeRenderNode> Output;
+    };
+
+    static const uint32_t TasksPerThread = 8;
+
+    // Узел, прошедший пирамиду в режиме TriangleBudget, и его стоимость
+    struct BudgetCandidate
+    {
+        uint32_t Index;
+        int Depth;
+        uint32_t PlaneMask;
+        uint32_t Patches;
+        uint32_t Triangles;
+    };
+
+    void BuildTree(uint32_t index, float x, float z, float size, int depth);
+    void Traverse(const TraversalEntry& start, const DirectX::XMFLOAT3& cameraPos, TraversalWorker& worker,
+                  std::vector<QuadTreeRenderNode>& output, int frontierDepth);
+    void TraverseParallel(const TraversalEntry& root, const DirectX::XMFLOAT3& cameraPos);
+    void SelectWithinBudget(const TraversalEntry& root, const DirectX::XMFLOAT3& cameraPos);
+    void AddBudgetCandidate(uint32_t index, int depth, uint32_t planeMask, const DirectX::XMFLOAT3& cameraPos);
+    void QueueBudgetSplit(uint32_t position, const DirectX::XMFLOAT3& cameraPos);
+    void CullOccludedNodes(const DirectX::XMFLOAT3& cameraPos, const DirectX::BoundingFrustum& frustum);
+    void CullBehindHorizon(const DirectX::XMFLOAT3& cameraPos);
+    void CullBehindDepth(const DirectX::BoundingFrustum& frustum);
+    void QueueOccluders(uint32_t index);
     LODLevel CalculateLOD(float distance) const;
-    
-    std::unique_ptr<QuadTreeNode> mRoot;
+    LODLevel DepthToLOD(int depth) const;
+    float DistanceToNode(const QuadTreeNodeBlock& block, uint32_t slot, const DirectX::XMFLOAT3& cameraPos) const;
+    float DistanceToBase(const QuadTreeNodeBlock& block, uint32_t slot, const DirectX::XMFLOAT3& cameraPos) const;
+    float FarthestDistance(const QuadTreeNodeBlock& block, uint32_t slot, const DirectX::XMFLOAT3& cameraPos) const;
+    float LODMargin(const QuadTreeNodeBlock& block, uint32_t slot, int depth, float baseDistance,
+                    const DirectX::XMFLOAT3& cameraPos) const;
+    static float PoseDisplacement(const CameraPose& from, const CameraPose& to, float reach);
+    static float RotationAngle(const DirectX::XMFLOAT4& from, const DirectX::XMFLOAT4& to);
+    void ReportSlack(uint32_t index, int depth, float slack);
+
+    const QuadTreeNodeBlock& Block(uint32_t index) const { return mNodeBlocks[index / 4]; }
+    QuadTreeNodeBlock& Block(uint32_t index) { return mNodeBlocks[index / 4]; }
+
+    std::vector<QuadTreeNodeBlock> mNodeBlocks;  // Горячие данные (отсечение)
+    std::vector<QuadTreeNodeData> mNodeData;     // Холодные данные (рендеринг), по индексу узла
+    std::vector<uint32_t> mLevelStart;           // Индекс первого узла каждого уровня и конец массива
+    FrustumPlanes mFrustumPlanes;                // Плоскости текущего кадра
+    std::vector<uint8_t> mLastRejectPlane;       // Плоскость, отбросившая узел в прошлый раз
+    QuadTreeCullStats mCullStats;
     std::vector<QuadTreeRenderNode> mVisibleNodes;
     std::vector<float> mLodDistances;  // Расстояния переключения LOD
+    LODSelectionMode mSelectionMode;
+    float mErrorToPixels;              // Высота вьюпорта / (2 * tan(fovY / 2))
+    float mPixelTolerance;             // Допустимая ошибка на экране в пикселях
     float mTerrainSize;
     int mMaxDepth;
+    uint32_t mNodeCount;
+
+    // Инкрементальный режим
+    bool mIncremental;
+    bool mHistoryValid;                          // Прошлый результат соответствует текущим параметрам
+    float mPositionEpsilon;
+    float mAngleEpsilon;
+    uint32_t mFrame;                             // Номер последнего полноценного обхода
+    CameraPose mPoseHistory[PoseHistorySize];    // Позы камеры последних обходов, по mFrame % PoseHistorySize
+    float mFrustumShape[6];                      // Наклоны и плоскости отсечения пирамиды прошлого обхода
+    std::vector<NodeCache> mNodeCache;
+    std::vector<QuadTreeRenderNode> mPrevVisibleNodes;
+
+    // Параметры текущего обхода, общие для всех потоков
+    bool mFrameIncremental;
+    bool mFrameReuse;
+    CameraPose mFramePose;
+
+    // Параллельный режим
+    WorkStealingPool* mPool;
+    std::vector<TraversalWorker> mWorkers;       // По одному на поток; 0 - вызывающий поток
+    std::vector<TraversalTask> mTasks;
+    uint32_t mTaskCount;
+    std::vector<QuadTreeRenderNode> mMergedNodes;
+
+    // Режим TriangleBudget
+    uint32_t mMaxTriangles;
+    uint32_t mMaxPatches;
+    float mBasePatchSize;
+    std::vector<BudgetCandidate> mBudgetCandidates;
+    std::vector<std::pair<float, uint32_t>> mBudgetHeap;     // Приоритет и позиция в mBudgetCandidates
+    std::vector<uint8_t> mBudgetSplit;                       // По индексу узла: 1 - разбит в этом кадре
+
+    // Отсечение перекрытых узлов
+    bool mOcclusionCulling;
+    OcclusionHorizon mHorizon;
+    std::vector<float> mOccluderHeights;         // Минимальные высоты ячеек сетки, построчно по Z; пусто - без RefitHeights
+    float mOccluderCellSize;
+    std::vector<std::pair<float, uint32_t>> mOcclusionOrder;  // Ближайшее расстояние и позиция в mVisibleNodes
+    std::vector<uint8_t> mOccluded;
+    float mOcclusionReach;                       // Ближайшее расстояние до самого дальнего узла кадра
+    std::vector<QuadTreeRenderNode> mUnoccludedNodes;
+    bool mDepthOcclusion;
+    OcclusionRasterizer mOcclusionRasterizer;
+    std::vector<float> mOccluderMesh;            // Высоты вершин (OccluderGridResolution + 1)^2, построчно по Z
 };
@@ -1,12 +1,44 @@
 #include "TerrainApp.h"
 #include "DDSTextureLoader.h"
 #include <sstream>
+#include <chrono>
+#include <filesystem>
 
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
 const int gNumFrameResources = 1;
 
+namespace
+{
+    // Morton (Z-order) code of a patch inside a tile: x in even bits, z in odd bits.
+    // Matches the QuadTree child order NW, NE, SW, SE, so every aligned square of
+    // patches - and every QuadTree node inside a tile - is a contiguous code range.
+    // Returns the x coordinate of a code; z is MortonDecodeX(code >> 1).
+    uint32_t MortonDecodeX(uint32_t code)
+    {
+        uint32_t x = 0;
+        for (uint32_t bit = 0; bit < 16; bit++)
+        {
+            x |= ((code >> (2 * bit)) & 1u) << bit;
+        }
+        return x;
+    }
+
+    // Directory of the running executable, with a trailing separator; empty if it cannot be queried
+    std::string ExecutableDirectory()
+    {
+        char path[MAX_PATH];
+        DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+        if (length == 0 || length == MAX_PATH)
+        {
+            return std::string();
+        }
+        std::string directory(path, length);
+        return directory.substr(0, directory.find_last_of("\\/") + 1);
+    }
+}
+
 TerrainApp::TerrainApp(HINSTANCE hInstance)
     : D3DApp(hInstance)
 {
@@ -29,10 +61,26 @@ bool TerrainApp::Initialize()
 
     // Initialize camera
     mCamera.SetPosition(1024.0f, 300.0f, 200.0f);
-    mCamera.SetProjectionValues(45.0f, AspectRatio(), 1.0f, 10000.0f);
+    mCamera.SetProjectionValues(CameraFovDegrees, AspectRatio(), 1.0f, 10000.0f);
 
     LoadTextures();
+    LoadHeightData();
+    ClampCameraToTerrain();
     BuildRootSignature();
+
+    // The compact format needs every grid vertex to survive quantization exactly. PatchesPerTile
+    // is a compile-time constant, so a failure here is a configuration bug, not a runtime condition.
+    mCompactVertices = UseCompactVertices;
+    if (UseCompactVertices && !IsTerrainVertexRoundTripExact(PatchesPerTile))
+    {
+        OutputDebugStringA(("ERROR: a " + std::to_string(PatchesPerTile) + "x" + std::to_string(PatchesPerTile) +
+                            " patch grid does not round-trip through TerrainVertexCompact;"
+                            " falling back to float vertices\n").c_str());
+        assert(false && "PatchesPerTile grid is not exact in TerrainVertexCompact");
+        mCompactVertices = false;
+    }
+    OutputDebugStringA(mCompactVertices ? "Vertex format: compact (4 bytes)\n" : "Vertex format: float (8 bytes)\n");
+
     BuildShadersAndInputLayout();
     BuildTerrainGeometry();
     BuildDescriptorHeaps();
@@ -50,7 +98,8 @@ bool TerrainApp::Initialize()
     mPassCB = std::make_unique<UploadBuffer<PassConstants>>(md3dDevice.Get(), 1, true);
 
     // Initialize Quadtree for LOD
-    // LOD distances: LOD0 < 200, LOD1 < 500, LOD2 < 1000, LOD3 >= 1000
+    // LOD distances (used only if no height data is available):
+    // LOD0 < 200, LOD1 < 500, LOD2 < 1000, LOD3 >= 1000
     std::vector<float> lodDistances = { 200.0f, 500.0f, 1000.0f };
     float terrainSize = (float)(TilesX * TileSize); // 2048
     int maxDepth = 4; // 4 levels of subdivision
@@ -59,6 +108,40 @@ bool TerrainApp::Initialize()
     OutputDebugStringA(("QuadTree initialized: size=" + std::to_string(terrainSize) + 
                         ", maxDepth=" + std::to_string(maxDepth) + "\n").c_str());
 
+    // Tighten node Y ranges from the height pyramid and log the effect on culling
+    if (!mHeightPyramid.IsEmpty())
+    {
+        ReportReferenceCameras("flat bounds");
+        mQuadTree.RefitHeights(mHeightPyramid, HeightBoundsMargin);
+        ReportReferenceCameras("height bounds");
+
+        // Switch from fixed LOD distances to projected geometric error
+        mQuadTree.SetScreenSpaceErrorParams(XMConvertToRadians(CameraFovDegrees), (float)mClientHeight, LodPixelTolerance);
+        mQuadTree.ComputeGeometricErrors(mHeightPyramid, LodErrorGridResolution);
+        mQuadTree.SetSelectionMode(LODSelectionMode::ScreenSpaceError);
+        ReportReferenceCameras("screen-space error");
+
+        // Drop nodes hidden behind nearer terrain; needs the refit heights for its occluders
+        mQuadTree.SetOcclusionCulling(true);
+        ReportReferenceCameras("horizon occlusion");
+
+        // Then rasterize the low-LOD terrain into a small depth buffer for what the horizon misses
+        mQuadTree.SetDepthOcclusion(true);
+        ReportReferenceCameras("depth occlusion");
+
+        // Same error metric, refined greedily within a fixed tessellation budget (toggled with B)
+        mQuadTree.SetTriangleBudget(LodTriangleBudget, LodPatchBudget, (float)TileSize / PatchesPerTile);
+        ReportReferenceCameras("triangle budget");
+        mQuadTree.SetSelectionMode(LODSelectionMode::ScreenSpaceError);
+    }
+
+    // Occluder rasterization always runs on all cores; the tree itself only when it is deep enough
+    mCullingPool = std::make_unique<WorkStealingPool>();
+    mQuadTree.SetParallelUpdate(mCullingPool.get());
+
+    // Reuse last frame's culling while the camera is (nearly) still
+    mQuadTree.SetIncrementalUpdate(true, CullPositionEpsilon, XMConvertToRadians(CullAngleEpsilonDegrees));
+
     return true;
 }
 
@@ -67,13 +150,17 @@ void TerrainApp::OnResize()
     D3DApp::OnResize();
 
     // Update projection matrix
-    mCamera.SetProjectionValues(45.0f, AspectRatio(), 1.0f, 10000.0f);
+    mCamera.SetProjectionValues(CameraFovDegrees, AspectRatio(), 1.0f, 10000.0f);
+
+    // Pixel error depends on viewport height, so LOD stays consistent across window sizes
+    mQuadTree.SetScreenSpaceErrorParams(XMConvertToRadians(CameraFovDegrees), (float)mClientHeight, LodPixelTolerance);
 }
 
 void TerrainApp::Update(const GameTimer& gt)
 {
     UpdatePassCB(gt);
     UpdateVisibleTiles();
+    RequestTileTextures();
 }
 
 void TerrainApp::Draw(const GameTimer& gt)
@@ -82,6 +169,9 @@ void TerrainApp::Draw(const GameTimer& gt)
     ThrowIfFailed(mDirectCmdListAlloc->Reset());
     ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), mPSOs["terrain"].Get()));
 
+    // Upload tile textures that finished loading in the background
+    mTextureStreamer.ProcessCompletions(*this, TextureUploadsPerFrame);
+
     mCommandList->RSSetViewports(1, &mScreenViewport);
     mCommandList->RSSetScissorRects(1, &mScissorRect);
 
@@ -112,35 +202,47 @@ void TerrainApp::Draw(const GameTimer& gt)
     heightmapHandle.Offset(mHeightmapSrvIndex, mCbvSrvUavDescriptorSize);
     mCommandList->SetGraphicsRootDescriptorTable(1, heightmapHandle);
 
-    // Set vertex and index buffers
-    mCommandList->IASetVertexBuffers(0, 1, &mTerrainVBV);
+    // Set color textures (slot 2): all tiles in one table, indexed per instance
+    CD3DX12_GPU_DESCRIPTOR_HANDLE colorHandle(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+    colorHandle.Offset(1, mCbvSrvUavDescriptorSize);
+    mCommandList->SetGraphicsRootDescriptorTable(2, colorHandle);
+
+    // Set vertex and index buffers: slot 0 is the shared unit grid, slot 1 the per-instance data
+    D3D12_VERTEX_BUFFER_VIEW vertexBuffers[2] = { mTerrainVBV, {} };
+    if (mInstanceBuffer)
+    {
+        vertexBuffers[1].BufferLocation = mInstanceBuffer->Resource()->GetGPUVirtualAddress();
+        vertexBuffers[1].StrideInBytes = sizeof(TerrainInstance);
+        vertexBuffers[1].SizeInBytes = mInstanceCapacity * sizeof(TerrainInstance);
+    }
+    mCommandList->IASetVertexBuffers(0, 2, vertexBuffers);
     mCommandList->IASetIndexBuffer(&mTerrainIBV);
     mCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
 
-    // Debug: draw all tiles without frustum culling
+    // Periodic log of the culled instance list that is drawn below
     static int debugFrame = 0;
     if (debugFrame++ % 120 == 0)
     {
-        OutputDebugStringA(("Drawing " + std::to_string(mVisibleTiles.size()) + " tiles, textures: " + std::to_string(mTextures.size()) + "\n").c_str());
+        OutputDebugStringA(("Drawing " + std::to_string(mVisibleTiles.size()) + " tiles as " +
+                            std::to_string(mInstanceBuilder.GetInstances().size()) + " instances, " +
+                            std::to_string(mSubmittedPatches) + " patches, " +
+                            std::to_string(mSubmittedPatches * 4) + " control points, resident tile textures: " +
+                            std::to_string(mTextureStreamer.GetStats().ResidentTiles) + "\n").c_str());
         XMFLOAT3 pos = mCamera.GetPosition();
         OutputDebugStringA(("Camera pos: " + std::to_string(pos.x) + ", " + std::to_string(pos.y) + ", " + std::to_string(pos.z) + "\n").c_str());
     }
 
-    // Draw visible tiles
-    for (auto* tile : mVisibleTiles)
+    // One instanced draw per grid density
+    for (int grid = 0; grid < mInstanceBuilder.GetGridCount(); grid++)
     {
-        // Set color texture for this tile (slot 2)
-        // Make sure we don't go out of bounds
-        int texIndex = tile->ColorTextureIndex;
-        if (texIndex >= 0 && texIndex < (int)mTextures.size())
+        UINT instanceCount = mInstanceBuilder.GetGridInstanceCount(grid);
+        if (instanceCount == 0)
         {
-            CD3DX12_GPU_DESCRIPTOR_HANDLE colorHandle(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-            colorHandle.Offset(texIndex, mCbvSrvUavDescriptorSize);
-            mCommandList->SetGraphicsRootDescriptorTable(2, colorHandle);
+            continue;
         }
 
-        // Draw tile
-        mCommandList->DrawIndexedInstanced(tile->IndexCount, 1, tile->IndexOffset, tile->VertexOffset, 0);
+        mCommandList->DrawIndexedInstanced(mGridIndexCount[grid], instanceCount, mGridIndexOffset[grid], 0,
+                                           mInstanceBuilder.GetGridFirstInstance(grid));
     }
 
     // Transition back buffer to present
@@ -158,6 +260,7 @@ void TerrainApp::Draw(const GameTimer& gt)
     mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
 
     FlushCommandQueue();
+    mFrameUploadHeaps.clear();
 }
 
 
@@ -166,6 +269,12 @@ void TerrainApp::OnMouseDown(WPARAM btnState, int x, int y)
     mLastMousePos.x = x;
     mLastMousePos.y = y;
     SetCapture(mhMainWnd);
+
+    // Left button drags the camera, right button picks a point on the terrain
+    if ((btnState & MK_RBUTTON) != 0)
+    {
+        PickTerrain(x, y);
+    }
 }
 
 void TerrainApp::OnMouseUp(WPARAM btnState, int x, int y)
@@ -226,6 +335,45 @@ void TerrainApp::OnKeyPressed(const GameTimer& gt, WPARAM key)
     case 'F':
         mCamera.TurnDown();
         break;
+    case 'P':
+        RenderReferenceFrame();
+        break;
+    case 'B':
+        ToggleTriangleBudget();
+        break;
+    }
+
+    ClampCameraToTerrain();
+}
+
+void TerrainApp::PickTerrain(int x, int y)
+{
+    XMFLOAT3 origin;
+    XMFLOAT3 direction;
+    mCamera.GetPickRay((float)x + 0.5f, (float)y + 0.5f, (float)mClientWidth, (float)mClientHeight, origin, direction);
+
+    TerrainRay ray = { origin.x, origin.y, origin.z, direction.x, direction.y, direction.z, PickDistance };
+    float distance;
+    if (!mHeightfieldRaycaster.Raycast(ray, distance))
+    {
+        OutputDebugStringA("Pick: no terrain under the cursor\n");
+        return;
+    }
+
+    OutputDebugStringA(("Pick: (" + std::to_string(origin.x + direction.x * distance) + ", " +
+                        std::to_string(origin.y + direction.y * distance) + ", " +
+                        std::to_string(origin.z + direction.z * distance) + "), distance=" +
+                        std::to_string(distance) + "\n").c_str());
+}
+
+void TerrainApp::ClampCameraToTerrain()
+{
+    // The camera flies freely but never sinks below the surface the domain shader displaces
+    XMFLOAT3 position = mCamera.GetPosition();
+    float minHeight = mHeightfield.SampleHeight(position.x, position.z) + CameraGroundClearance;
+    if (position.y < minHeight)
+    {
+        mCamera.SetPosition(position.x, minHeight, position.z);
     }
 }
 
@@ -233,13 +381,13 @@ void TerrainApp::BuildRootSignature()
 {
     // Root parameter 0: Pass constants (CBV)
     // Root parameter 1: Heightmap texture (SRV)
-    // Root parameter 2: Color texture (SRV)
+    // Root parameter 2: Color textures of all tiles (SRV table)
 
     CD3DX12_DESCRIPTOR_RANGE texTable0;
     texTable0.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0); // t0 - heightmap
 
     CD3DX12_DESCRIPTOR_RANGE texTable1;
-    texTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1); // t1 - color texture
+    texTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, TilesX * TilesY, 1); // t1.. - color textures, indexed per instance
 
     CD3DX12_ROOT_PARAMETER slotRootParameter[3];
     slotRootParameter[0].InitAsConstantBufferView(0); // b0 - pass constants
@@ -279,7 +427,14 @@ void TerrainApp::BuildShadersAndInputLayout()
 {
     OutputDebugStringW(L"Compiling shaders...\n");
     
-    mShaders["terrainVS"] = d3dUtil::CompileShader(L"shaders/vs.hlsl", nullptr, "VS", "vs_5_0");
+    const D3D_SHADER_MACRO compactVertexDefines[] =
+    {
+        { "COMPACT_VERTEX", "1" },
+        { nullptr, nullptr }
+    };
+
+    mShaders["terrainVS"] = d3dUtil::CompileShader(L"shaders/vs.hlsl",
+        mCompactVertices ? compactVertexDefines : nullptr, "VS", "vs_5_0");
     OutputDebugStringW(L"VS compiled\n");
     
     mShaders["terrainHS"] = d3dUtil::CompileShader(L"shaders/hs.hlsl", nullptr, "HS", "hs_5_0");
@@ -288,14 +443,20 @@ void TerrainApp::BuildShadersAndInputLayout()
     mShaders["terrainDS"] = d3dUtil::CompileShader(L"shaders/ds.hlsl", nullptr, "DS", "ds_5_0");
     OutputDebugStringW(L"DS compiled\n");
     
-    mShaders["terrainPS"] = d3dUtil::CompileShader(L"shaders/ps.hlsl", nullptr, "PS", "ps_5_0");
+    mShaders["terrainPS"] = d3dUtil::CompileShader(L"shaders/ps.hlsl", nullptr, "PS", "ps_5_1");
     OutputDebugStringW(L"PS compiled\n");
 
     mInputLayout =
     {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD", 1, DXGI_FORMAT_R32G32_FLOAT, 0, 20, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+        { "POSITION", 0, mCompactVertices ? DXGI_FORMAT_R16G16_UINT : DXGI_FORMAT_R32G32_FLOAT, 0, 0,
+          D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+
+        // Per-instance data, laid out as TerrainInstance
+        { "INSTANCE_ORIGIN", 0, DXGI_FORMAT_R32G32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE_SCALE", 0, DXGI_FORMAT_R32_FLOAT, 1, 8, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE_TEXSLOT", 0, DXGI_FORMAT_R32_UINT, 1, 12, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE_HEIGHTRECT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE_COLORRECT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 }
     };
     
     OutputDebugStringW(L"Shaders and input layout built\n");
@@ -331,11 +492,13 @@ void TerrainApp::BuildTerrainGeometry()
     std::vector<TerrainVertex> allVertices;
     std::vector<uint16_t> allIndices;
 
-    const float patchSize = (float)TileSize / PatchesPerTile;
     const float totalSizeX = (float)(TilesX * TileSize);
     const float totalSizeZ = (float)(TilesY * TileSize);
 
-    // Create geometry for each tile
+    mInstanceBuilder.Configure((float)TileSize, TilesX, TilesY, PatchesPerTile);
+    mTileMap.Configure((float)TileSize, TilesX, TilesY);
+
+    // Tile records: bounds and color texture only - geometry is shared by all tiles
     for (int tileY = 0; tileY < TilesY; tileY++)
     {
         for (int tileX = 0; tileX < TilesX; tileX++)
@@ -344,62 +507,21 @@ void TerrainApp::BuildTerrainGeometry()
             tile.TileX = tileX;
             tile.TileY = tileY;
             tile.TileSize = TileSize;
-            tile.VertexOffset = (UINT)allVertices.size();
-            tile.IndexOffset = (UINT)allIndices.size();
 
             float startX = (float)(tileX * TileSize);
             float startZ = (float)(tileY * TileSize);
 
-            // Create vertices for this tile
-            for (int z = 0; z <= PatchesPerTile; z++)
-            {
-                for (int x = 0; x <= PatchesPerTile; x++)
-                {
-                    TerrainVertex vertex;
-
-                    float worldX = startX + x * patchSize;
-                    float worldZ = startZ + z * patchSize;
-
-                    vertex.Pos = XMFLOAT3(worldX, 0.0f, worldZ);
-
-                    // Global texture coordinates for heightmap (0 to 1 across entire terrain)
-                    float globalU = worldX / totalSizeX;
-                    float globalV = 1.0f - (worldZ / totalSizeZ); // Flip V
-
-                    // Local texture coordinates for color texture (0 to 1 within this tile)
-                    float localU = (float)x / PatchesPerTile;
-                    float localV = 1.0f - ((float)z / PatchesPerTile); // Flip V
-
-                    vertex.TexC = XMFLOAT2(globalU, globalV);
-                    vertex.LocalTexC = XMFLOAT2(localU, localV);
-
-                    allVertices.push_back(vertex);
-                }
-            }
-
-            // Create indices for 4-control-point patches
-            UINT baseVertex = tile.VertexOffset;
-            for (int z = 0; z < PatchesPerTile; z++)
-            {
-                for (int x = 0; x < PatchesPerTile; x++)
-                {
-                    int topLeft = z * (PatchesPerTile + 1) + x;
-                    int topRight = topLeft + 1;
-                    int bottomLeft = (z + 1) * (PatchesPerTile + 1) + x;
-                    int bottomRight = bottomLeft + 1;
-
-                    allIndices.push_back((uint16_t)(topLeft));
-                    allIndices.push_back((uint16_t)(topRight));
-                    allIndices.push_back((uint16_t)(bottomLeft));
-                    allIndices.push_back((uint16_t)(bottomRight));
-                }
-            }
-
-            tile.IndexCount = PatchesPerTile * PatchesPerTile * 4;
-
             // Calculate bounding box
             float minY = 0.0f;
-            float maxY = 500.0f; // Match height scale in shader
+            float maxY = HeightScale; // Match height scale in shader
+            if (!mHeightPyramid.IsEmpty())
+            {
+                mHeightPyramid.QueryRange(startX / totalSizeX, 1.0f - (startZ + TileSize) / totalSizeZ,
+                                          (startX + TileSize) / totalSizeX, 1.0f - startZ / totalSizeZ,
+                                          minY, maxY);
+                minY -= HeightBoundsMargin;
+                maxY += HeightBoundsMargin;
+            }
 
             XMFLOAT3 minPoint(startX, minY, startZ);
             XMFLOAT3 maxPoint(startX + TileSize, maxY, startZ + TileSize);
@@ -414,6 +536,7 @@ void TerrainApp::BuildTerrainGeometry()
             // So tile at (tileX, tileY) uses texture at index 1 + tileY * TilesX + tileX
             tile.ColorTextureIndex = 1 + tileY * TilesX + tileX;
             tile.NormalTextureIndex = -1; // Not used for now
+            tile.FinestLOD = LODLevel::LOD3;
 
             OutputDebugStringA(("Tile (" + std::to_string(tileX) + "," + std::to_string(tileY) + ") -> texture index " + std::to_string(tile.ColorTextureIndex) + "\n").c_str());
 
@@ -421,19 +544,74 @@ void TerrainApp::BuildTerrainGeometry()
         }
     }
 
-    // Create vertex buffer
-    const UINT vbByteSize = (UINT)allVertices.size() * sizeof(TerrainVertex);
+    // One unit grid of (PatchesPerTile + 1)^2 vertices, stretched over every instance
+    for (int z = 0; z <= PatchesPerTile; z++)
+    {
+        for (int x = 0; x <= PatchesPerTile; x++)
+        {
+            TerrainVertex vertex;
+            vertex.GridPos = XMFLOAT2((float)x / PatchesPerTile, (float)z / PatchesPerTile);
+            allVertices.push_back(vertex);
+        }
+    }
+
+    // Create indices for 4-control-point patches: one block per grid density.
+    // Grid g merges 2^g x 2^g cells into one patch; patches within a block are in Morton order.
+    static_assert((PatchesPerTile & (PatchesPerTile - 1)) == 0, "Morton patch order needs a power-of-two grid");
+    int gridCount = mInstanceBuilder.GetGridCount();
+    mGridIndexOffset.assign(gridCount, 0);
+    mGridIndexCount.assign(gridCount, 0);
+    for (int grid = 0; grid < gridCount; grid++)
+    {
+        int stride = 1 << grid;
+        int patchesPerEdge = mInstanceBuilder.GetGridPatchesPerEdge(grid);
+
+        mGridIndexOffset[grid] = (UINT)allIndices.size();
+        for (int code = 0; code < patchesPerEdge * patchesPerEdge; code++)
+        {
+            int x = (int)MortonDecodeX((uint32_t)code) * stride;
+            int z = (int)MortonDecodeX((uint32_t)code >> 1) * stride;
+
+            int topLeft = z * (PatchesPerTile + 1) + x;
+            int topRight = topLeft + stride;
+            int bottomLeft = (z + stride) * (PatchesPerTile + 1) + x;
+            int bottomRight = bottomLeft + stride;
+
+            allIndices.push_back((uint16_t)(topLeft));
+            allIndices.push_back((uint16_t)(topRight));
+            allIndices.push_back((uint16_t)(bottomLeft));
+            allIndices.push_back((uint16_t)(bottomRight));
+        }
+        mGridIndexCount[grid] = (UINT)allIndices.size() - mGridIndexOffset[grid];
+    }
+
+    // Create vertex buffer, quantized to the compact format if enabled
+    std::vector<TerrainVertexCompact> compactVertices;
+    const void* vertexData = allVertices.data();
+    UINT vertexStride = sizeof(TerrainVertex);
+    if (mCompactVertices)
+    {
+        compactVertices.reserve(allVertices.size());
+        for (const auto& vertex : allVertices)
+        {
+            compactVertices.push_back(EncodeTerrainVertex(vertex));
+        }
+        vertexData = compactVertices.data();
+        vertexStride = sizeof(TerrainVertexCompact);
+    }
+
+    const UINT vbByteSize = (UINT)allVertices.size() * vertexStride;
     const UINT ibByteSize = (UINT)allIndices.size() * sizeof(uint16_t);
 
     mTerrainVertexBuffer = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), allVertices.data(), vbByteSize, mTerrainVertexUploadBuffer);
+        mCommandList.Get(), vertexData, vbByteSize, mTerrainVertexUploadBuffer);
 
     mTerrainIndexBuffer = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
         mCommandList.Get(), allIndices.data(), ibByteSize, mTerrainIndexUploadBuffer);
 
     // Setup vertex buffer view
     mTerrainVBV.BufferLocation = mTerrainVertexBuffer->GetGPUVirtualAddress();
-    mTerrainVBV.StrideInBytes = sizeof(TerrainVertex);
+    mTerrainVBV.StrideInBytes = vertexStride;
     mTerrainVBV.SizeInBytes = vbByteSize;
 
     // Setup index buffer view
@@ -441,7 +619,7 @@ void TerrainApp::BuildTerrainGeometry()
     mTerrainIBV.Format = DXGI_FORMAT_R16_UINT;
     mTerrainIBV.SizeInBytes = ibByteSize;
 
-    OutputDebugStringA(("Total vertices: " + std::to_string(allVertices.size()) + "\n").c_str());
+    OutputDebugStringA(("Total vertices: " + std::to_string(allVertices.size()) + " (" + std::to_string(vbByteSize) + " bytes)\n").c_str());
     OutputDebugStringA(("Total indices: " + std::to_string(allIndices.size()) + "\n").c_str());
     OutputDebugStringA(("Total tiles: " + std::to_string(mTiles.size()) + "\n").c_str());
 }
@@ -455,7 +633,7 @@ void TerrainApp::BuildDescriptorHeaps()
     srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
     ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
 
-    // Create SRVs for all textures
+    // Create SRVs for resident textures (the heightmap)
     CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
 
     for (size_t i = 0; i < mTextures.size(); i++)
@@ -473,27 +651,43 @@ void TerrainApp::BuildDescriptorHeaps()
         md3dDevice->CreateShaderResourceView(tex->Resource.Get(), &srvDesc, hDescriptor);
         hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
     }
+
+    // Tile textures start as the placeholder and are replaced as they stream in
+    for (uint32_t tile = 0; tile < (uint32_t)mTileTextures.size(); tile++)
+    {
+        WriteTileSrv(tile, nullptr);
+    }
 }
 
 
 void TerrainApp::LoadTextures()
 {
-    // Load global heightmap from 003 folder
+    // Load global heightmap from 003 folder, reading the mips straight into the upload heap
+    const std::string heightmapPath = "Terrain/003/Height_Out.dds";
     auto heightmapTex = std::make_unique<Texture>();
     heightmapTex->Name = "heightmap";
-    heightmapTex->Filename = L"Terrain/003/Height_Out.dds";
+    heightmapTex->Filename = std::wstring(heightmapPath.begin(), heightmapPath.end());
 
-    ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-        mCommandList.Get(), heightmapTex->Filename.c_str(),
-        heightmapTex->Resource, heightmapTex->UploadHeap));
+    DdsLayout heightmapLayout;
+    if (!ReadDdsLayout(heightmapPath, heightmapLayout) ||
+        !CreateTextureFromDds(heightmapLayout, 0, nullptr, heightmapPath, *heightmapTex))
+    {
+        // Formats DdsFile does not know go through the full loader
+        ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
+            mCommandList.Get(), heightmapTex->Filename.c_str(),
+            heightmapTex->Resource, heightmapTex->UploadHeap));
+    }
 
     mHeightmapSrvIndex = 0;
     mTextures.push_back(std::move(heightmapTex));
 
     OutputDebugStringW(L"Loaded global heightmap from Terrain/003/Height_Out.dds\n");
 
-    // Load 4x4 grid of color textures from 001 folder
+    BuildPlaceholderTexture();
+
+    // Color textures of the 4x4 grid from 001 folder are streamed in on demand.
     // Invert Y to match texture file naming with world coordinates
+    std::vector<std::string> tilePaths;
     for (int y = 0; y < TilesY; y++)
     {
         for (int x = 0; x < TilesX; x++)
@@ -501,31 +695,339 @@ void TerrainApp::LoadTextures()
             // Invert Y for texture file loading to match world space
             int fileY = (TilesY - 1) - y;
 
-            std::wstringstream texSS;
-            texSS << L"Terrain/001/Weathering/Weathering_Out_y" << fileY << L"_x" << x << L".dds";
-            std::wstring texturePath = texSS.str();
+            std::stringstream texSS;
+            texSS << "Terrain/001/Weathering/Weathering_Out_y" << fileY << "_x" << x << ".dds";
+            tilePaths.push_back(texSS.str());
 
             auto colorTex = std::make_unique<Texture>();
             colorTex->Name = "color_" + std::to_string(y) + "_" + std::to_string(x);
-            colorTex->Filename = texturePath;
+            colorTex->Filename = std::wstring(tilePaths.back().begin(), tilePaths.back().end());
+            mTileTextures.push_back(std::move(colorTex));
+        }
+    }
 
-            HRESULT hr = DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-                mCommandList.Get(), colorTex->Filename.c_str(),
-                colorTex->Resource, colorTex->UploadHeap);
+    mTextureStreamer.Initialize(tilePaths, TextureMemoryBudget, TextureTailResolution);
 
-            if (SUCCEEDED(hr))
-            {
-                mTextures.push_back(std::move(colorTex));
-                OutputDebugStringW((L"Loaded tile texture: " + texturePath + L"\n").c_str());
-            }
-            else
+    OutputDebugStringA(("Texture streaming: " + std::to_string(tilePaths.size()) + " tiles, budget " +
+                        std::to_string(TextureMemoryBudget >> 20) + " MB\n").c_str());
+}
+
+void TerrainApp::BuildPlaceholderTexture()
+{
+    // 1x1 neutral grey, shown for tiles whose texture has not arrived yet
+    mPlaceholderTexture = std::make_unique<Texture>();
+    mPlaceholderTexture->Name = "placeholder";
+
+    ThrowIfFailed(md3dDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 1),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&mPlaceholderTexture->Resource)));
+
+    const UINT64 uploadBufferSize = GetRequiredIntermediateSize(mPlaceholderTexture->Resource.Get(), 0, 1);
+    ThrowIfFailed(md3dDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&mPlaceholderTexture->UploadHeap)));
+
+    const uint32_t texel = 0xFF808080;
+    D3D12_SUBRESOURCE_DATA texelData = {};
+    texelData.pData = &texel;
+    texelData.RowPitch = sizeof(texel);
+    texelData.SlicePitch = sizeof(texel);
+
+    UpdateSubresources(mCommandList.Get(), mPlaceholderTexture->Resource.Get(),
+        mPlaceholderTexture->UploadHeap.Get(), 0, 0, 1, &texelData);
+    mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mPlaceholderTexture->Resource.Get(),
+        D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+}
+
+void TerrainApp::WriteTileSrv(uint32_t tile, ID3D12Resource* resource)
+{
+    // nullptr points the tile back at the placeholder
+    if (resource == nullptr)
+    {
+        resource = mPlaceholderTexture->Resource.Get();
+    }
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.Format = resource->GetDesc().Format;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Texture2D.MostDetailedMip = 0;
+    srvDesc.Texture2D.MipLevels = resource->GetDesc().MipLevels;
+    srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+
+    CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+    hDescriptor.Offset(1 + tile, mCbvSrvUavDescriptorSize);
+    md3dDevice->CreateShaderResourceView(resource, &srvDesc, hDescriptor);
+}
+
+void TerrainApp::RequestTileTextures()
+{
+    // Nearer tiles first; coarser tiles are pushed back by one tile size per LOD level.
+    // The resolution a tile needs follows from its projected size: at distance d one world
+    // unit covers (viewport height / 2) / tan(fov / 2) / d pixels.
+    XMFLOAT3 eye = mCamera.GetPosition();
+    const float pixelsPerUnitAtUnitDistance = 0.5f * mClientHeight / tanf(0.5f * XMConvertToRadians(CameraFovDegrees));
+
+    mTextureRequests.clear();
+    for (const auto* tile : mVisibleTiles)
+    {
+        const BoundingBox& bounds = tile->Bounds;
+        float dx = std::max(fabsf(eye.x - bounds.Center.x) - bounds.Extents.x, 0.0f);
+        float dy = std::max(fabsf(eye.y - bounds.Center.y) - bounds.Extents.y, 0.0f);
+        float dz = std::max(fabsf(eye.z - bounds.Center.z) - bounds.Extents.z, 0.0f);
+        float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+        float texelsPerEdge = TileSize * pixelsPerUnitAtUnitDistance / std::max(distance, 1.0f);
+
+        TextureRequest request;
+        request.Tile = (uint32_t)(tile->TileY * TilesX + tile->TileX);
+        request.Priority = distance + (float)tile->FinestLOD * TileSize;
+        request.Resolution = (uint32_t)std::min(texelsPerEdge, 65536.0f);
+        mTextureRequests.push_back(request);
+    }
+
+    mTextureStreamer.Update(mTextureRequests);
+}
+
+bool TerrainApp::CreateTextureFromDds(const DdsLayout& layout, uint32_t firstMip, const MappedFile* mapping,
+                                      const std::string& path, Texture& tex)
+{
+    // Mips are copied from the file mapping, or read from the file, directly into the
+    // upload heap at the copyable footprints - no intermediate CPU buffer.
+    // The resource holds mips firstMip and coarser only. tex is replaced only on success,
+    // so a texture that is already bound stays valid if this fails.
+    const UINT mipCount = (UINT)layout.Mips.size() - firstMip;
+    const CD3DX12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex2D((DXGI_FORMAT)layout.DxgiFormat,
+        layout.Mips[firstMip].Width, layout.Mips[firstMip].Height, 1, (UINT16)mipCount);
+
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(mipCount);
+    UINT64 uploadBufferSize = 0;
+    md3dDevice->GetCopyableFootprints(&texDesc, 0, mipCount, 0, footprints.data(), nullptr, nullptr, &uploadBufferSize);
+
+    ComPtr<ID3D12Resource> resource;
+    ComPtr<ID3D12Resource> uploadHeap;
+    if (FAILED(md3dDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+            D3D12_HEAP_FLAG_NONE, &texDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&resource))) ||
+        FAILED(md3dDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+            D3D12_HEAP_FLAG_NONE, &CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize), D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr, IID_PPV_ARGS(&uploadHeap))))
+    {
+        return false;
+    }
+
+    uint8_t* staging = nullptr;
+    if (FAILED(uploadHeap->Map(0, nullptr, reinterpret_cast<void**>(&staging))))
+    {
+        return false;
+    }
+
+    bool filled = true;
+    if (mapping != nullptr)
+    {
+        for (UINT mip = 0; mip < mipCount; mip++)
+        {
+            DdsSubresource source = GetDdsSubresource(layout, mapping->GetData(), firstMip + mip);
+            uint8_t* destination = staging + footprints[mip].Offset;
+            for (uint32_t row = 0; row < source.RowCount; row++)
             {
-                OutputDebugStringW((L"Failed to load tile texture: " + texturePath + L"\n").c_str());
+                memcpy(destination + (size_t)row * footprints[mip].Footprint.RowPitch,
+                       source.Data + (size_t)row * source.RowPitch, source.RowPitch);
             }
         }
     }
+    else
+    {
+        std::vector<DdsStagingFootprint> stagingFootprints(mipCount);
+        for (UINT mip = 0; mip < mipCount; mip++)
+        {
+            stagingFootprints[mip].Offset = footprints[mip].Offset;
+            stagingFootprints[mip].RowPitch = footprints[mip].Footprint.RowPitch;
+        }
+        filled = ReadDdsMips(path, layout, firstMip, mipCount, stagingFootprints.data(), staging);
+    }
+    uploadHeap->Unmap(0, nullptr);
+
+    if (!filled)
+    {
+        return false;
+    }
+
+    for (UINT mip = 0; mip < mipCount; mip++)
+    {
+        CD3DX12_TEXTURE_COPY_LOCATION dst(resource.Get(), mip);
+        CD3DX12_TEXTURE_COPY_LOCATION src(uploadHeap.Get(), footprints[mip]);
+        mCommandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    }
+    mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(resource.Get(),
+        D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+    tex.Resource = std::move(resource);
+    tex.UploadHeap = std::move(uploadHeap);
+    return true;
+}
+
+size_t TerrainApp::Upload(const TextureTileData& data)
+{
+    // Called from Draw while the command list is open; the previous frame is already flushed.
+    // The new mips go into a separate texture that replaces the tile's only once it exists:
+    // on failure the streamer keeps the resident coarser copy, so its resource and SRV must stay.
+    Texture& tex = *mTileTextures[data.Tile];
+    Texture loaded;
+    if (!CreateTextureFromDds(data.Layout, data.FirstMip, &data.File, std::string(), loaded))
+    {
+        OutputDebugStringW((L"Failed to load tile texture: " + tex.Filename + L"\n").c_str());
+        return 0;
+    }
+
+    WriteTileSrv(data.Tile, loaded.Resource.Get());
+    tex.Resource = std::move(loaded.Resource);
+    mFrameUploadHeaps.push_back(std::move(loaded.UploadHeap));
 
-    OutputDebugStringA(("Total textures loaded: " + std::to_string(mTextures.size()) + "\n").c_str());
+    D3D12_RESOURCE_DESC desc = tex.Resource->GetDesc();
+    return (size_t)md3dDevice->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+}
+
+void TerrainApp::Evict(uint32_t tile)
+{
+    // The GPU is idle between frames, so the resource can go right away
+    WriteTileSrv(tile, nullptr);
+    mTileTextures[tile]->Resource = nullptr;
+}
+
+void TerrainApp::LoadHeightData()
+{
+    // CPU copy of the heightmap. The 16-bit TIFF exported next to Terrain/003/Height_Out.dds is
+    // converted once into a packed heightfield that later runs simply map; a cache written with
+    // a different HeightScale or older than the TIFF is rebuilt. The cache is derived data, so it
+    // lives next to the executable rather than in the (possibly read-only) asset tree; if it cannot
+    // be written the TIFF is read directly. Without the TIFF the R channel of the BC7 DDS itself
+    // is decoded (8-bit precision).
+    const std::string tiffPath = "Terrain/003/Height_Out.tif";
+    const std::string heightfieldPath = ExecutableDirectory() + "Height_Out.hfd";
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<float> values;
+
+    std::error_code tiffError, cacheError;
+    auto tiffTime = std::filesystem::last_write_time(tiffPath, tiffError);
+    auto cacheTime = std::filesystem::last_write_time(heightfieldPath, cacheError);
+    bool stale = !tiffError && !cacheError && cacheTime < tiffTime;
+
+    HeightfieldFile heightfield;
+    bool cached = !stale && heightfield.Open(heightfieldPath) && heightfield.GetHeader().HeightScale == HeightScale;
+    if (!cached)
+    {
+        heightfield.Close();
+        if (ConvertTiffToHeightfield(tiffPath, heightfieldPath, -1, -1, HeightScale) && heightfield.Open(heightfieldPath))
+        {
+            OutputDebugStringA(("Converted " + tiffPath + " to " + heightfieldPath + "\n").c_str());
+        }
+        else
+        {
+            heightfield.Close();
+            std::filesystem::remove(heightfieldPath, cacheError);
+        }
+    }
+
+    if (heightfield.IsOpen() && heightfield.GetHeader().HeightScale == HeightScale)
+    {
+        width = heightfield.GetWidth();
+        height = heightfield.GetHeight();
+        values.resize((size_t)width * height);
+
+        const uint16_t* samples = heightfield.GetSamples();
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            values[i] = samples[i] / 65535.0f;
+        }
+    }
+    else if (ReadHeightTiff(tiffPath, values, width, height))
+    {
+        OutputDebugStringA(("Cannot write " + heightfieldPath + ", read " + tiffPath + " directly\n").c_str());
+    }
+    else if (!DecodeHeightDds("Terrain/003/Height_Out.dds", values, width, height))
+    {
+        OutputDebugStringA("Failed to load Terrain/003/Height_Out.tif or .dds, using flat height bounds\n");
+        return;
+    }
+
+    // Height queries sample the same normalized values the domain shader does
+    mHeightfield.Build(values, width, height, (float)(TilesX * TileSize), (float)(TilesY * TileSize), HeightScale);
+    mHeightfieldRaycaster.Build(mHeightfield);
+    mReferenceRenderer.SetHeightfield(&mHeightfield, (float)TileSize / PatchesPerTile);
+
+    std::vector<float> heights(values.size());
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        heights[i] = values[i] * HeightScale;
+    }
+    mHeightPyramid.Build(heights, width, height);
+
+    OutputDebugStringA(("Height pyramid: " + std::to_string(width) + "x" + std::to_string(height) +
+                        ", levels=" + std::to_string(mHeightPyramid.GetLevelCount()) +
+                        ", range=" + std::to_string(mHeightPyramid.GetGlobalMin()) + ".." +
+                        std::to_string(mHeightPyramid.GetGlobalMax()) +
+                        ", heightfield SIMD level=" + std::to_string((int)mHeightfield.GetSimdLevel()) + "\n").c_str());
+}
+
+bool TerrainApp::ReadHeightTiff(const std::string& path, std::vector<float>& values, uint32_t& width, uint32_t& height)
+{
+    TiffStripReader reader;
+    if (!reader.Open(path))
+    {
+        return false;
+    }
+
+    std::vector<uint16_t> samples((size_t)reader.GetWidth() * reader.GetHeight());
+    if (!reader.ReadRows(0, reader.GetHeight(), samples.data()))
+    {
+        return false;
+    }
+
+    width = reader.GetWidth();
+    height = reader.GetHeight();
+    values.resize(samples.size());
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        values[i] = samples[i] / 65535.0f;
+    }
+    return true;
+}
+
+bool TerrainApp::DecodeHeightDds(const std::string& path, std::vector<float>& values, uint32_t& width, uint32_t& height)
+{
+    MappedFile file;
+    DdsLayout layout;
+    if (!file.Open(path) || !ParseDdsLayout(file.GetData(), file.GetSize(), layout))
+    {
+        return false;
+    }
+
+    // Decoding is split across all cores; the pool only lives for this call
+    WorkStealingPool pool;
+    Bc7Decoder decoder;
+    std::vector<uint8_t> samples;
+    if (!decoder.DecodeMipChannel(layout, file.GetData(), 0, 0, samples, &pool))
+    {
+        return false;
+    }
+
+    width = layout.Width;
+    height = layout.Height;
+    values.resize(samples.size());
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        values[i] = samples[i] / 255.0f;
+    }
+    return true;
 }
 
 void TerrainApp::UpdatePassCB(const GameTimer& gt)
@@ -550,15 +1052,14 @@ void TerrainApp::UpdatePassCB(const GameTimer& gt)
     passConstants.FarZ = 10000.0f;
     passConstants.TotalTime = gt.TotalTime();
     passConstants.DeltaTime = gt.DeltaTime();
-    passConstants.HeightScale = 500.0f;
+    passConstants.HeightScale = HeightScale;
+    passConstants.BasePatchSize = (float)TileSize / PatchesPerTile;
 
     mPassCB->CopyData(0, passConstants);
 }
 
 void TerrainApp::UpdateVisibleTiles()
 {
-    mVisibleTiles.clear();
-
     // Get camera position and frustum
     XMFLOAT3 cameraPos = mCamera.GetPosition();
     BoundingFrustum frustum = GetFrustum();
@@ -569,48 +1070,10 @@ void TerrainApp::UpdateVisibleTiles()
     // Get visible nodes from Quadtree
     const auto& visibleNodes = mQuadTree.GetVisibleNodes();
     
-    // Map Quadtree nodes to terrain tiles
-    // Each Quadtree leaf node corresponds to a region of the terrain
-    for (const auto& renderNode : visibleNodes)
-    {
-        QuadTreeNode* node = renderNode.Node;
-        
-        // Find which tile(s) this node overlaps with
-        float nodeMinX = node->Center.x - node->Size * 0.5f;
-        float nodeMinZ = node->Center.z - node->Size * 0.5f;
-        float nodeMaxX = node->Center.x + node->Size * 0.5f;
-        float nodeMaxZ = node->Center.z + node->Size * 0.5f;
-        
-        for (auto& tile : mTiles)
-        {
-            float tileMinX = (float)(tile.TileX * tile.TileSize);
-            float tileMinZ = (float)(tile.TileY * tile.TileSize);
-            float tileMaxX = tileMinX + tile.TileSize;
-            float tileMaxZ = tileMinZ + tile.TileSize;
-            
-            // Check if node overlaps with tile
-            bool overlaps = !(nodeMaxX < tileMinX || nodeMinX > tileMaxX ||
-                             nodeMaxZ < tileMinZ || nodeMinZ > tileMaxZ);
-            
-            if (overlaps)
-            {
-                // Avoid duplicates
-                bool alreadyAdded = false;
-                for (auto* t : mVisibleTiles)
-                {
-                    if (t == &tile)
-                    {
-                        alreadyAdded = true;
-                        break;
-                    }
-                }
-                if (!alreadyAdded)
-                {
-                    mVisibleTiles.push_back(&tile);
-                }
-            }
-        }
-    }
+    BuildInstances();
+
+    // Expected tessellator output of the submitted patches, same factors as hs.hlsl
+    mTrianglePredictor.Predict(mInstanceBuilder, cameraPos, (float)TileSize / PatchesPerTile, mCullingPool.get());
 
     // Debug output
     static int frameCount = 0;
@@ -629,7 +1092,123 @@ void TerrainApp::UpdateVisibleTiles()
                            " LOD1=" + std::to_string(lodCounts[1]) +
                            " LOD2=" + std::to_string(lodCounts[2]) +
                            " LOD3=" + std::to_string(lodCounts[3]) + "\n").c_str());
+
+        int tileLodCounts[4] = {0, 0, 0, 0};
+        for (const auto* tile : mVisibleTiles)
+        {
+            tileLodCounts[static_cast<int>(tile->FinestLOD)]++;
+        }
+        OutputDebugStringA(("Tiles by finest LOD: LOD0=" + std::to_string(tileLodCounts[0]) +
+                           " LOD1=" + std::to_string(tileLodCounts[1]) +
+                           " LOD2=" + std::to_string(tileLodCounts[2]) +
+                           " LOD3=" + std::to_string(tileLodCounts[3]) + "\n").c_str());
+
+        const QuadTreeCullStats& cullStats = mQuadTree.GetCullStats();
+        OutputDebugStringA(("Culling: visited=" + std::to_string(cullStats.NodesVisited) +
+                           " boxTests=" + std::to_string(cullStats.BoxTests) +
+                           " planeTests=" + std::to_string(cullStats.PlaneTests) +
+                           " contained=" + std::to_string(cullStats.ContainedNodes) +
+                           " culled=" + std::to_string(cullStats.CulledNodes) +
+                           " occluded=" + std::to_string(cullStats.OccludedNodes) +
+                           " depthOccluded=" + std::to_string(cullStats.DepthOccludedNodes) +
+                           " occluderTris=" + std::to_string(cullStats.OccluderTriangles) +
+                           " reusedSubtrees=" + std::to_string(cullStats.ReusedSubtrees) +
+                           " reusedNodes=" + std::to_string(cullStats.ReusedNodes) +
+                           " frameReused=" + std::to_string(cullStats.FrameReused) + "\n").c_str());
+
+        if (mQuadTree.GetSelectionMode() == LODSelectionMode::TriangleBudget)
+        {
+            OutputDebugStringA(("LOD budget: splits=" + std::to_string(cullStats.BudgetSplits) +
+                               " patches=" + std::to_string(cullStats.BudgetPatches) +
+                               " triangles=" + std::to_string(cullStats.BudgetTriangles) +
+                               " exhausted=" + std::to_string(cullStats.BudgetExhausted) + "\n").c_str());
+        }
+
+        const TextureStreamerStats& streamStats = mTextureStreamer.GetStats();
+        OutputDebugStringA(("Streaming: resident=" + std::to_string(streamStats.ResidentTiles) +
+                           " (" + std::to_string(streamStats.ResidentBytes >> 10) + " KB)" +
+                           " pending=" + std::to_string(streamStats.PendingTiles) +
+                           " loaded=" + std::to_string(streamStats.LoadedTiles) +
+                           " refined=" + std::to_string(streamStats.RefinedTiles) +
+                           " read=" + std::to_string(streamStats.BytesRead >> 10) + " KB" +
+                           " evicted=" + std::to_string(streamStats.EvictedTiles) +
+                           " failed=" + std::to_string(streamStats.FailedTiles) + "\n").c_str());
+
+        const std::vector<uint32_t>& nodeTriangles = mTrianglePredictor.GetNodeTriangles();
+        uint32_t heaviestNode = nodeTriangles.empty() ? 0 :
+            *std::max_element(nodeTriangles.begin(), nodeTriangles.end());
+        OutputDebugStringA(("Tessellation: predicted triangles=" + std::to_string(mTrianglePredictor.GetTotalTriangles()) +
+                           " patches=" + std::to_string(mTrianglePredictor.GetPatchCount()) +
+                           " heaviest node=" + std::to_string(heaviestNode) + "\n").c_str());
+    }
+}
+
+void TerrainApp::BuildInstances()
+{
+    mVisibleTiles.clear();
+
+    const auto& visibleNodes = mQuadTree.GetVisibleNodes();
+
+    // Map Quadtree nodes to terrain tiles; visible tiles come back in tile order
+    mTileMap.Map(mQuadTree, visibleNodes);
+    for (uint32_t tileIndex : mTileMap.GetVisibleTiles())
+    {
+        TerrainTileInfo& tile = mTiles[tileIndex];
+        tile.FinestLOD = mTileMap.GetFinestLOD(tileIndex);
+        mVisibleTiles.push_back(&tile);
+    }
+
+    // Instances for all visible nodes, grouped by grid density
+    mInstanceBuilder.Build(mQuadTree, visibleNodes);
+    mSubmittedPatches = mInstanceBuilder.GetPatchCount();
+
+    // The previous frame is flushed in Draw, so the upload buffer can be rewritten or regrown here
+    const auto& instances = mInstanceBuilder.GetInstances();
+    if (instances.size() > mInstanceCapacity)
+    {
+        mInstanceCapacity = std::max((UINT)instances.size(), 2 * mInstanceCapacity);
+        mInstanceBuffer = std::make_unique<UploadBuffer<TerrainInstance>>(md3dDevice.Get(), mInstanceCapacity, false);
+    }
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        mInstanceBuffer->CopyData((int)i, instances[i]);
+    }
+}
+
+int TerrainApp::CountPatchesInFrustum(const BoundingFrustum& frustum) const
+{
+    // Reference count: every patch whose height-bounded box intersects the frustum
+    const float patchSize = (float)TileSize / PatchesPerTile;
+    const float totalSizeX = (float)(TilesX * TileSize);
+    const float totalSizeZ = (float)(TilesY * TileSize);
+
+    int count = 0;
+    for (int z = 0; z < TilesY * PatchesPerTile; z++)
+    {
+        for (int x = 0; x < TilesX * PatchesPerTile; x++)
+        {
+            float minX = x * patchSize;
+            float minZ = z * patchSize;
+            float minY = 0.0f;
+            float maxY = HeightScale;
+            if (!mHeightPyramid.IsEmpty())
+            {
+                mHeightPyramid.QueryRange(minX / totalSizeX, 1.0f - (minZ + patchSize) / totalSizeZ,
+                                          (minX + patchSize) / totalSizeX, 1.0f - minZ / totalSizeZ,
+                                          minY, maxY);
+                minY -= HeightBoundsMargin;
+                maxY += HeightBoundsMargin;
+            }
+
+            BoundingBox bounds(XMFLOAT3(minX + patchSize * 0.5f, (minY + maxY) * 0.5f, minZ + patchSize * 0.5f),
+                               XMFLOAT3(patchSize * 0.5f, (maxY - minY) * 0.5f, patchSize * 0.5f));
+            if (frustum.Contains(bounds) != DISJOINT)
+            {
+                count++;
+            }
+        }
     }
+    return count;
 }
 
 BoundingFrustum TerrainApp::GetFrustum() const
@@ -648,3 +1227,119 @@ BoundingFrustum TerrainApp::GetFrustum() const
 
     return frustum;
 }
+
+void TerrainApp::ReportReferenceCameras(const char* label)
+{
+    // Fixed camera set used to compare culling changes between builds
+    struct ReferenceCamera { float X, Y, Z, Pitch, Yaw; };
+    const ReferenceCamera cameras[] =
+    {
+        { 1024.0f,  300.0f,  200.0f,  0.0f,   0.0f }, // Start position
+        { 1024.0f,  120.0f, 1024.0f,  5.0f,  90.0f }, // Low, terrain center
+        {  200.0f,   80.0f,  200.0f, 10.0f,  45.0f }, // Near ground, corner
+        { 1024.0f, 1500.0f, -600.0f, 35.0f,   0.0f }, // Overview
+        { 1024.0f, 2000.0f, 1024.0f, 89.0f,   0.0f }, // Top down
+    };
+
+    int total = 0;
+    std::string line = std::string("Reference cameras (") + label + "): visible nodes";
+    std::string patchLine = "  patches submitted/whole tiles/in frustum:";
+    std::string triangleLine = "  predicted triangles:";
+    for (const auto& rc : cameras)
+    {
+        Camera camera;
+        camera.SetProjectionValues(CameraFovDegrees, AspectRatio(), 1.0f, 10000.0f);
+        camera.SetPosition(rc.X, rc.Y, rc.Z);
+        camera.SetRotation(rc.Pitch, rc.Yaw);
+
+        mQuadTree.Update(camera.GetPosition(), camera.GetFrustum());
+        int count = (int)mQuadTree.GetVisibleNodes().size();
+        total += count;
+        line += " " + std::to_string(count);
+
+        BuildInstances();
+        patchLine += " " + std::to_string(mSubmittedPatches) + "/" +
+                     std::to_string(mVisibleTiles.size() * PatchesPerTile * PatchesPerTile) + "/" +
+                     std::to_string(CountPatchesInFrustum(camera.GetFrustum()));
+
+        mTrianglePredictor.Predict(mInstanceBuilder, camera.GetPosition(), (float)TileSize / PatchesPerTile);
+        triangleLine += " " + std::to_string(mTrianglePredictor.GetTotalTriangles());
+    }
+    line += ", total " + std::to_string(total) + "\n";
+    OutputDebugStringA(line.c_str());
+    OutputDebugStringA((patchLine + "\n").c_str());
+    OutputDebugStringA((triangleLine + "\n").c_str());
+}
+
+void TerrainApp::ToggleTriangleBudget()
+{
+    // Both modes use the geometric errors; without a height pyramid the tree stays on distances
+    if (mHeightPyramid.IsEmpty())
+    {
+        return;
+    }
+
+    if (mQuadTree.GetSelectionMode() == LODSelectionMode::TriangleBudget)
+    {
+        mQuadTree.SetSelectionMode(LODSelectionMode::ScreenSpaceError);
+        OutputDebugStringA("LOD selection: screen-space error\n");
+    }
+    else
+    {
+        mQuadTree.SetTriangleBudget(LodTriangleBudget, LodPatchBudget, (float)TileSize / PatchesPerTile);
+        OutputDebugStringA(("LOD selection: triangle budget " + std::to_string(LodTriangleBudget) +
+                            ", patch budget " + std::to_string(LodPatchBudget) + "\n").c_str());
+    }
+}
+
+void TerrainApp::RenderReferenceFrame()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // The streamer only keeps GPU mips within budget, so the reference decodes full chains itself
+    if (!mReferenceTexturesLoaded)
+    {
+        Bc7Decoder decoder;
+        for (size_t tile = 0; tile < mTileTextures.size(); tile++)
+        {
+            const std::wstring& filename = mTileTextures[tile]->Filename;
+            if (!mReferenceRenderer.LoadTileTexture((uint32_t)tile, std::string(filename.begin(), filename.end()),
+                                                    decoder, mCullingPool.get()))
+            {
+                OutputDebugStringA(("Reference: tile " + std::to_string(tile) + " texture not loaded\n").c_str());
+            }
+        }
+        mReferenceTexturesLoaded = true;
+    }
+    auto texturesLoaded = std::chrono::steady_clock::now();
+
+    // Same world -> clip transform as UpdatePassCB, transposed back for row vectors
+    TerrainReferenceView view;
+    XMStoreFloat4x4(&view.ViewProj,
+                    XMMatrixTranspose(XMMatrixMultiply(mCamera.GetProjectionMatrix(), mCamera.GetViewMatrix())));
+    view.EyePosition = mCamera.GetPosition();
+    view.Width = (uint32_t)mClientWidth;
+    view.Height = (uint32_t)mClientHeight;
+
+    // mInstanceBuilder holds the instances of the last UpdateVisibleTiles, i.e. what Draw submits
+    mReferenceRenderer.Render(view, mInstanceBuilder, mCullingPool.get());
+    auto rendered = std::chrono::steady_clock::now();
+
+    std::string path = "reference_" + std::to_string(mReferenceFrameCount++) + ".bmp";
+    bool written = mReferenceRenderer.WriteBmp(path);
+
+    const TerrainReferenceStats& stats = mReferenceRenderer.GetStats();
+    auto milliseconds = [](std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+    {
+        return std::to_string(std::chrono::duration<double, std::milli>(to - from).count());
+    };
+    OutputDebugStringA(("Reference frame " + path + (written ? "" : " (not written)") +
+                        ": textures=" + milliseconds(start, texturesLoaded) +
+                        " ms render=" + milliseconds(texturesLoaded, rendered) +
+                        " ms patches=" + std::to_string(stats.Patches) +
+                        " culled=" + std::to_string(stats.CulledPatches) +
+                        " triangles=" + std::to_string(stats.Triangles) +
+                        " rasterized=" + std::to_string(stats.RasterTriangles) +
+                        " waves=" + std::to_string(stats.Waves) +
+                        " shaded=" + std::to_string(stats.ShadedPixels) + "\n").c_str());
+}
@@ -6,16 +6,20 @@
 #include "UploadBuffer.h"
 #include "MathHelper.h"
 #include "QuadTree.h"
+#include "HeightPyramid.h"
+#include "HeightfieldFile.h"
+#include "TiffReader.h"
+#include "Heightfield.h"
+#include "HeightfieldRaycast.h"
+#include "WorkStealingPool.h"
+#include "TerrainInstanceBuilder.h"
+#include "TerrainTileMap.h"
+#include "TerrainVertexFormat.h"
+#include "TextureStreamer.h"
+#include "Bc7Decoder.h"
+#include "TerrainReferenceRenderer.h"
 #include <DirectXCollision.h>
 
-// Vertex structure for terrain patches
-struct TerrainVertex
-{
-    DirectX::XMFLOAT3 Pos;
-    DirectX::XMFLOAT2 TexC;      // Global coords for heightmap
-    DirectX::XMFLOAT2 LocalTexC; // Local coords for color texture
-};
-
 // Constant buffer for matrices
 struct PassConstants
 {
@@ -30,7 +34,7 @@ struct PassConstants
     float TotalTime = 0.0f;
     float DeltaTime = 0.0f;
     float HeightScale = 500.0f;
-    float Padding2;
+    float BasePatchSize = 32.0f;    // World size of an LOD0 patch, for tessellation scaling
 };
 
 // Terrain tile info
@@ -40,14 +44,12 @@ struct TerrainTileInfo
     int TileY;
     int TileSize;
     DirectX::BoundingBox Bounds;
-    UINT VertexOffset;
-    UINT IndexOffset;
-    UINT IndexCount;
     int ColorTextureIndex;
     int NormalTextureIndex;
+    LODLevel FinestLOD;      // Finest LOD requested by a visible node this frame
 };
 
-class TerrainApp : public D3DApp
+class TerrainApp : public D3DApp, private ITextureUploader
 {
 public:
     TerrainApp(HINSTANCE hInstance);
@@ -73,11 +75,32 @@ private:
     void BuildTerrainGeometry();
     void BuildDescriptorHeaps();
     void LoadTextures();
+    void LoadHeightData();
+    void ClampCameraToTerrain();
+    void PickTerrain(int x, int y);
+    bool ReadHeightTiff(const std::string& path, std::vector<float>& values, uint32_t& width, uint32_t& height);
+    bool DecodeHeightDds(const std::string& path, std::vector<float>& values, uint32_t& width, uint32_t& height);
+
+    // Texture streaming: tile textures are requested from visible nodes and uploaded in Draw
+    void BuildPlaceholderTexture();
+    bool CreateTextureFromDds(const DdsLayout& layout, uint32_t firstMip, const MappedFile* mapping,
+                              const std::string& path, Texture& tex);
+    void WriteTileSrv(uint32_t tile, ID3D12Resource* resource);
+    void RequestTileTextures();
+    size_t Upload(const TextureTileData& data) override;
+    void Evict(uint32_t tile) override;
     void UpdatePassCB(const GameTimer& gt);
 
     // Frustum culling
     void UpdateVisibleTiles();
+    void BuildInstances();
+    int CountPatchesInFrustum(const DirectX::BoundingFrustum& frustum) const;
     DirectX::BoundingFrustum GetFrustum() const;
+    void ReportReferenceCameras(const char* label);
+    void ToggleTriangleBudget();
+
+    // Headless CPU render of the current view, written next to the executable
+    void RenderReferenceFrame();
 
 private:
     Microsoft::WRL::ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
@@ -95,18 +118,50 @@ private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mTerrainIndexUploadBuffer = nullptr;
 
     D3D12_VERTEX_BUFFER_VIEW mTerrainVBV;
+    bool mCompactVertices = false;   // TerrainVertexCompact instead of TerrainVertex
     D3D12_INDEX_BUFFER_VIEW mTerrainIBV;
 
     std::vector<TerrainTileInfo> mTiles;
     std::vector<TerrainTileInfo*> mVisibleTiles;
+    TerrainTileMap mTileMap;
+    UINT mSubmittedPatches = 0;
+
+    // Instanced drawing: one index block per grid density, instances rebuilt every frame
+    TerrainInstanceBuilder mInstanceBuilder;
+    std::vector<UINT> mGridIndexOffset;
+    std::vector<UINT> mGridIndexCount;
+    std::unique_ptr<UploadBuffer<TerrainInstance>> mInstanceBuffer = nullptr;
+    UINT mInstanceCapacity = 0;
     
     // Quadtree for LOD
     QuadTree mQuadTree;
+    std::unique_ptr<WorkStealingPool> mCullingPool;
+
+    // CPU-side min/max height pyramid (world units)
+    HeightPyramid mHeightPyramid;
+    // CPU-side bilinear height queries, same mapping and HeightScale as ds.hlsl
+    Heightfield mHeightfield;
+    HeightfieldRaycaster mHeightfieldRaycaster;
+
+    // Software reference of the tessellation pipeline; tile textures are decoded on first use
+    TerrainReferenceRenderer mReferenceRenderer;
+    bool mReferenceTexturesLoaded = false;
+    int mReferenceFrameCount = 0;
+
+    // Triangles the tessellator will emit for the current instances, per node and per frame
+    TerrainTrianglePredictor mTrianglePredictor;
 
     // Textures
     std::vector<std::unique_ptr<Texture>> mTextures;
     int mHeightmapSrvIndex = -1;
 
+    // Streamed tile textures: SRV 1 + tile shows the placeholder until the tile is resident
+    TextureStreamer mTextureStreamer;
+    std::vector<std::unique_ptr<Texture>> mTileTextures;
+    std::unique_ptr<Texture> mPlaceholderTexture;
+    std::vector<TextureRequest> mTextureRequests;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mFrameUploadHeaps;   // Released after the frame's flush
+
     // Constant buffers
     std::unique_ptr<UploadBuffer<PassConstants>> mPassCB = nullptr;
 
@@ -121,6 +176,30 @@ private:
     static const int TilesY = 4;
     static const int TileSize = 512;
     static const int PatchesPerTile = 16;
+    // 4-byte quantized grid vertices (COMPACT_VERTEX in the shaders) instead of 8-byte float ones
+    static const bool UseCompactVertices = true;
+    // Resident tile textures; tiles not visible this frame are evicted beyond it (LRU)
+    static const uint64_t TextureMemoryBudget = 8ull << 20;
+    static const uint32_t TextureUploadsPerFrame = 4;
+    // Edge of the coarse mip tail every tile gets first; finer mips follow texel density on screen
+    static const uint32_t TextureTailResolution = 64;
+    static constexpr float HeightScale = 500.0f;
+    // Slack for BC7 quantization of the GPU heightmap relative to the 16-bit source
+    static constexpr float HeightBoundsMargin = 8.0f;
+    static constexpr float CameraFovDegrees = 45.0f;
+    // Picking rays reach as far as the camera far plane
+    static constexpr float PickDistance = 10000.0f;
+    // Minimum camera height above the CPU heightfield: BC7 error of the GPU heightmap plus the near plane
+    static constexpr float CameraGroundClearance = HeightBoundsMargin + 2.0f;
+    // Screen-space LOD: allowed projected height error and height samples per node edge
+    static constexpr float LodPixelTolerance = 4.0f;
+    static const int LodErrorGridResolution = 16;
+    // Tessellated triangles and patches the budgeted LOD mode may select per frame
+    static const uint32_t LodTriangleBudget = 1500000;
+    static const uint32_t LodPatchBudget = 4096;
+    // Camera motion below which the previous culling result is kept as is
+    static constexpr float CullPositionEpsilon = 0.01f;
+    static constexpr float CullAngleEpsilonDegrees = 0.01f;
     
     // Wireframe mode toggle
     bool mWireframeMode = false;
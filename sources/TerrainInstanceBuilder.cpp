@@ -0,0 +1,129 @@
+#include "TerrainInstanceBuilder.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+TerrainInstanceBuilder::TerrainInstanceBuilder()
+    : mTileSize(1.0f), mTilesX(1), mTilesY(1), mPatchesPerTile(1), mGridCount(1), mPatchCount(0), mNodeCount(0)
+{
+}
+
+void TerrainInstanceBuilder::Configure(float tileSize, int tilesX, int tilesY, int patchesPerTile)
+{
+    mTileSize = tileSize;
+    mTilesX = tilesX;
+    mTilesY = tilesY;
+    mPatchesPerTile = patchesPerTile;
+
+    // Сетки от patchesPerTile патчей на ребро до одного
+    mGridCount = 1;
+    while ((patchesPerTile >> mGridCount) >= 1)
+    {
+        mGridCount++;
+    }
+
+    mGridFirst.assign(mGridCount, 0);
+    mGridCounts.assign(mGridCount, 0);
+}
+
+int TerrainInstanceBuilder::SelectGrid(uint32_t patchesPerEdge, LODLevel lod) const
+{
+    // Экземпляр из patchesPerEdge патчей огрубляется на lod уровней, но минимум до одного патча
+    uint32_t patches = std::max(patchesPerEdge >> static_cast<int>(lod), 1u);
+    int grid = 0;
+    while (grid + 1 < mGridCount && (uint32_t)(mPatchesPerTile >> grid) > patches)
+    {
+        grid++;
+    }
+    return grid;
+}
+
+void TerrainInstanceBuilder::Build(const QuadTree& tree, const std::vector<QuadTreeRenderNode>& nodes)
+{
+    mUnsorted.clear();
+    mUnsortedGrid.clear();
+    mUnsortedNode.clear();
+    mPatchCount = 0;
+    mNodeCount = (uint32_t)nodes.size();
+
+    for (uint32_t nodeIndex = 0; nodeIndex < mNodeCount; nodeIndex++)
+    {
+        const QuadTreeRenderNode& node = nodes[nodeIndex];
+        BoundingBox bounds = tree.GetNodeBounds(node.NodeIndex);
+        float size = 2.0f * bounds.Extents.x;
+        float minX = bounds.Center.x - bounds.Extents.x;
+        float minZ = bounds.Center.z - bounds.Extents.z;
+
+        if (size <= mTileSize * 1.001f)
+        {
+            AddInstance(minX, minZ, size, node.LOD, nodeIndex);
+            continue;
+        }
+
+        // У экземпляра одна цветовая текстура - большие узлы режутся по тайлам
+        int tilesPerEdge = (int)lroundf(size / mTileSize);
+        for (int z = 0; z < tilesPerEdge; z++)
+        {
+            for (int x = 0; x < tilesPerEdge; x++)
+            {
+                AddInstance(minX + x * mTileSize, minZ + z * mTileSize, mTileSize, node.LOD, nodeIndex);
+            }
+        }
+    }
+
+    // Устойчивая сортировка подсчётом по сетке: порядок обхода внутри группы сохраняется
+    std::fill(mGridCounts.begin(), mGridCounts.end(), 0u);
+    for (uint8_t grid : mUnsortedGrid)
+    {
+        mGridCounts[grid]++;
+    }
+
+    uint32_t first = 0;
+    for (int grid = 0; grid < mGridCount; grid++)
+    {
+        mGridFirst[grid] = first;
+        first += mGridCounts[grid];
+    }
+
+    mInstances.resize(mUnsorted.size());
+    mInstanceNodes.resize(mUnsorted.size());
+    mGridCursor = mGridFirst;
+    for (size_t i = 0; i < mUnsorted.size(); i++)
+    {
+        uint32_t slot = mGridCursor[mUnsortedGrid[i]]++;
+        mInstances[slot] = mUnsorted[i];
+        mInstanceNodes[slot] = mUnsortedNode[i];
+    }
+}
+
+void TerrainInstanceBuilder::AddInstance(float minX, float minZ, float size, LODLevel lod, uint32_t node)
+{
+    const float terrainSizeX = mTileSize * mTilesX;
+    const float terrainSizeZ = mTileSize * mTilesY;
+    const float patchSize = mTileSize / mPatchesPerTile;
+
+    int tileX = std::max(0, std::min((int)(minX / mTileSize), mTilesX - 1));
+    int tileY = std::max(0, std::min((int)(minZ / mTileSize), mTilesY - 1));
+    float localX = minX - tileX * mTileSize;
+    float localZ = minZ - tileY * mTileSize;
+
+    uint32_t patchesPerEdge = std::max((uint32_t)lroundf(size / patchSize), 1u);
+    int grid = SelectGrid(patchesPerEdge, lod);
+    uint32_t gridPatches = (uint32_t)(mPatchesPerTile >> grid);
+
+    // V перевёрнута и у карты высот, и у цветовых текстур
+    TerrainInstance instance;
+    instance.Origin = XMFLOAT2(minX, minZ);
+    instance.Scale = size;
+    instance.TextureSlot = (uint32_t)(tileY * mTilesX + tileX);
+    instance.HeightTexRect = XMFLOAT4(minX / terrainSizeX, 1.0f - minZ / terrainSizeZ,
+                                      size / terrainSizeX, -size / terrainSizeZ);
+    instance.ColorTexRect = XMFLOAT4(localX / mTileSize, 1.0f - localZ / mTileSize,
+                                     size / mTileSize, -size / mTileSize);
+
+    mUnsorted.push_back(instance);
+    mUnsortedGrid.push_back((uint8_t)grid);
+    mUnsortedNode.push_back(node);
+    mPatchCount += gridPatches * gridPatches;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include "QuadTree.h"
+#include <vector>
+#include <cstdint>
+
+// Данные экземпляра: единичная сетка патчей растягивается на квадрат узла.
+// Раскладка совпадает с per-instance входом вершинного шейдера.
+struct TerrainInstance
+{
+    DirectX::XMFLOAT2 Origin;        // Мировые XZ угла узла с минимальными координатами
+    float Scale;                     // Мировой размер узла
+    uint32_t TextureSlot;            // Индекс цветовой текстуры тайла (tileY * tilesX + tileX)
+    DirectX::XMFLOAT4 HeightTexRect; // Текстурные координаты карты высот: (u0, v0, du, dv)
+    DirectX::XMFLOAT4 ColorTexRect;  // Текстурные координаты внутри тайла: (u0, v0, du, dv)
+};
+
+// Построение потока экземпляров из видимых узлов Quadtree.
+// Не зависит от графического API: на входе узлы дерева, на выходе массив экземпляров,
+// сгруппированный по плотности сетки, - по одному инстансному вызову на группу.
+// Сетка g содержит patchesPerTile >> g патчей на ребро экземпляра.
+class TerrainInstanceBuilder
+{
+public:
+    TerrainInstanceBuilder();
+
+    // tileSize - мировой размер тайла (одна цветовая текстура), patchesPerTile - степень двойки
+    void Configure(float tileSize, int tilesX, int tilesY, int patchesPerTile);
+
+    // Узлы больше тайла делятся на экземпляры по тайлам. LOD узла k огрубляет сетку в 2^k раз,
+    // но не грубее одного патча на экземпляр.
+    void Build(const QuadTree& tree, const std::vector<QuadTreeRenderNode>& nodes);
+
+    const std::vector<TerrainInstance>& GetInstances() const { return mInstances; }
+    int GetGridCount() const { return mGridCount; }
+    int GetGridPatchesPerEdge(int grid) const { return mPatchesPerTile >> grid; }
+    uint32_t GetGridFirstInstance(int grid) const { return mGridFirst[grid]; }
+    uint32_t GetGridInstanceCount(int grid) const { return mGridCounts[grid]; }
+
+    // Сетка, которой узел из patchesPerEdge патчей LOD0 рисуется на данном LOD
+    int SelectGrid(uint32_t patchesPerEdge, LODLevel lod) const;
+
+    // Патчей во всех экземплярах последнего Build
+    uint32_t GetPatchCount() const { return mPatchCount; }
+
+    // Узел экземпляра - индекс в списке nodes последнего Build
+    uint32_t GetInstanceNode(size_t instance) const { return mInstanceNodes[instance]; }
+    uint32_t GetNodeCount() const { return mNodeCount; }
+
+private:
+    void AddInstance(float minX, float minZ, float size, LODLevel lod, uint32_t node);
+
+    float mTileSize;
+    int mTilesX;
+    int mTilesY;
+    int mPatchesPerTile;
+    int mGridCount;
+
+    std::vector<TerrainInstance> mInstances;   // Сгруппированы по сетке, внутри группы - порядок обхода
+    std::vector<TerrainInstance> mUnsorted;
+    std::vector<uint8_t> mUnsortedGrid;
+    std::vector<uint32_t> mUnsortedNode;
+    std::vector<uint32_t> mInstanceNodes;
+    std::vector<uint32_t> mGridFirst;
+    std::vector<uint32_t> mGridCounts;
+    std::vector<uint32_t> mGridCursor;
+    uint32_t mPatchCount;
+    uint32_t mNodeCount;
+};
@@ -0,0 +1,816 @@
+#include "TerrainReferenceRenderer.h"
+#include "Heightfield.h"
+#include "Bc7Decoder.h"
+#include "MappedFile.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define TERRAIN_REFERENCE_SSE 1
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+    const uint32_t EmptySlot = 0xFFFFFFFFu;
+
+    // Заглушка незагруженного тайла, как BuildPlaceholderTexture
+    const float PlaceholderColor[4] = { 128.0f / 255.0f, 128.0f / 255.0f, 128.0f / 255.0f, 1.0f };
+
+    // Цвет очистки TerrainApp::Draw
+    const float ClearColor[3] = { 0.1f, 0.1f, 0.3f };
+
+    // Освещение ps.hlsl: направленный свет normalize(0.3, -1, 0.3), ambient + diffuse * 0.6
+    const float LightX = 0.3f;
+    const float LightY = -1.0f;
+    const float LightZ = 0.3f;
+    const float Ambient = 0.4f;
+    const float DiffuseWeight = 0.6f;
+
+    // Треугольники с меньшей удвоенной экранной площадью (в пикселях) не рисуются
+    const float MinTriangleArea = 1e-8f;
+
+    // Запас рёберной функции в пикселях: центр пикселя на общем ребре должен попасть хотя бы
+    // в один из двух треугольников, лишнее попадание снимает тест глубины
+    const float EdgeEpsilon = 1e-3f;
+
+    // Задачи пула или тот же цикл в вызывающем потоке
+    template <typename Task>
+    void RunTasks(WorkStealingPool* pool, uint32_t taskCount, const Task& task)
+    {
+        if (pool == nullptr || pool->GetThreadCount() <= 1)
+        {
+            for (uint32_t i = 0; i < taskCount; i++)
+            {
+                task(i, 0);
+            }
+            return;
+        }
+        pool->Run(taskCount, task);
+    }
+
+    // Точна на концах отрезка: общие углы соседних патчей совпадают побитно
+    float Lerp(float a, float b, float t)
+    {
+        return a * (1.0f - t) + b * t;
+    }
+
+    void TransformPoint(const XMFLOAT4X4& m, float x, float y, float z, float clip[4])
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            clip[column] = x * m.m[0][column] + y * m.m[1][column] + z * m.m[2][column] + m.m[3][column];
+        }
+    }
+
+    // Бокс целиком снаружи одной из плоскостей отсечения D3D (-w <= x, y <= w, 0 <= z <= w)
+    bool BoxOutsideClip(const XMFLOAT4X4& viewProj, float minX, float minY, float minZ,
+                        float maxX, float maxY, float maxZ)
+    {
+        uint32_t outside[6] = {};
+        for (int corner = 0; corner < 8; corner++)
+        {
+            float clip[4];
+            TransformPoint(viewProj, (corner & 1) ? maxX : minX, (corner & 2) ? maxY : minY,
+                           (corner & 4) ? maxZ : minZ, clip);
+            outside[0] += clip[0] < -clip[3];
+            outside[1] += clip[0] > clip[3];
+            outside[2] += clip[1] < -clip[3];
+            outside[3] += clip[1] > clip[3];
+            outside[4] += clip[2] < 0.0f;
+            outside[5] += clip[2] > clip[3];
+        }
+        for (uint32_t count : outside)
+        {
+            if (count == 8)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint8_t ToUnorm8(float value)
+    {
+        return (uint8_t)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    void PutLE(uint8_t* output, uint32_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+        {
+            output[i] = (uint8_t)(value >> (8 * i));
+        }
+    }
+}
+
+TerrainReferenceRenderer::TerrainReferenceRenderer()
+    : mHeightfield(nullptr), mBasePatchSize(1.0f),
+      mWidth(0), mHeight(0), mPitch(0), mTilesX(0), mTilesY(0), mStats()
+{
+}
+
+void TerrainReferenceRenderer::SetHeightfield(const Heightfield* heightfield, float basePatchSize)
+{
+    mHeightfield = heightfield;
+    mBasePatchSize = basePatchSize;
+}
+
+bool TerrainReferenceRenderer::LoadTileTexture(uint32_t slot, const std::string& path, const Bc7Decoder& decoder,
+                                               WorkStealingPool* pool)
+{
+    if (slot >= MaxSlots)
+    {
+        return false;
+    }
+
+    MappedFile file;
+    DdsLayout layout;
+    if (!file.Open(path) || !ParseDdsLayout(file.GetData(), file.GetSize(), layout) ||
+        !IsBc7Format(layout.DxgiFormat))
+    {
+        return false;
+    }
+
+    std::vector<MipLevel> mips(layout.Mips.size());
+    std::vector<uint8_t> rgba;
+    for (uint32_t mip = 0; mip < (uint32_t)mips.size(); mip++)
+    {
+        if (!decoder.DecodeMip(layout, file.GetData(), mip, rgba, pool))
+        {
+            return false;
+        }
+        mips[mip].Width = layout.Mips[mip].Width;
+        mips[mip].Height = layout.Mips[mip].Height;
+        mips[mip].Texels.resize((size_t)mips[mip].Width * mips[mip].Height);
+        memcpy(mips[mip].Texels.data(), rgba.data(), mips[mip].Texels.size() * sizeof(uint32_t));
+    }
+
+    mTextures[slot] = std::move(mips);
+    return true;
+}
+
+void TerrainReferenceRenderer::Render(const TerrainReferenceView& view, const TerrainInstanceBuilder& instances,
+                                      WorkStealingPool* pool)
+{
+    mStats = TerrainReferenceStats();
+    mWidth = view.Width;
+    mHeight = view.Height;
+    mTilesX = (mWidth + TileSize - 1) / TileSize;
+    mTilesY = (mHeight + TileSize - 1) / TileSize;
+    mPitch = mTilesX * TileSize;
+
+    // Буферы дополнены до целых тайлов, чтобы четвёрки пикселей не проверяли край экрана
+    size_t pixelCount = (size_t)mPitch * mTilesY * TileSize;
+    mDepth.assign(pixelCount, 1.0f);
+    mPixelSlot.assign(pixelCount, EmptySlot);
+    mPixelU.resize(pixelCount);
+    mPixelV.resize(pixelCount);
+    mPixelNormalX.resize(pixelCount);
+    mPixelNormalY.resize(pixelCount);
+    mPixelNormalZ.resize(pixelCount);
+    mPixelLod.resize(pixelCount);
+    mColor.resize((size_t)mWidth * mHeight);
+
+    const uint32_t tileCount = mTilesX * mTilesY;
+    if (mHeightfield != nullptr && !mHeightfield->IsEmpty() && tileCount > 0)
+    {
+        CollectPatches(view, instances);
+
+        // Задачи - подряд идущие патчи примерно по TrianglesPerTask треугольников
+        mTaskFirstJob.clear();
+        uint32_t taskTriangles = 0;
+        for (uint32_t job = 0; job < (uint32_t)mJobs.size(); job++)
+        {
+            if (job == 0 || taskTriangles >= TrianglesPerTask)
+            {
+                mTaskFirstJob.push_back(job);
+                taskTriangles = 0;
+            }
+            taskTriangles += mJobs[job].Triangles;
+        }
+        uint32_t taskCount = (uint32_t)mTaskFirstJob.size();
+        mTaskFirstJob.push_back((uint32_t)mJobs.size());
+
+        for (SetupBatch& batch : mBatches)
+        {
+            batch.Bins.resize(tileCount);
+        }
+
+        const std::vector<TerrainInstance>& instanceList = instances.GetInstances();
+        for (uint32_t firstTask = 0; firstTask < taskCount; firstTask += WaveTaskCount)
+        {
+            uint32_t waveTasks = std::min(taskCount - firstTask, (uint32_t)WaveTaskCount);
+            RunTasks(pool, waveTasks, [&](uint32_t task, uint32_t)
+            {
+                SetupBatch& batch = mBatches[task];
+                batch.Triangles.clear();
+                for (std::vector<uint32_t>& bin : batch.Bins)
+                {
+                    bin.clear();
+                }
+
+                for (uint32_t job = mTaskFirstJob[firstTask + task]; job < mTaskFirstJob[firstTask + task + 1]; job++)
+                {
+                    SetupPatch(view, instanceList[mJobs[job].Instance], mJobs[job], batch);
+                }
+            });
+
+            for (uint32_t task = 0; task < waveTasks; task++)
+            {
+                mStats.RasterTriangles += mBatches[task].Triangles.size();
+            }
+
+            RunTasks(pool, tileCount, [&](uint32_t tile, uint32_t)
+            {
+                RasterizeTile(tile, waveTasks);
+            });
+            mStats.Waves++;
+        }
+    }
+
+    // Освещение и текстуры - один раз на пиксель, полосами по высоте тайла
+    std::vector<uint32_t> shaded(mTilesY, 0);
+    RunTasks(pool, mTilesY, [&](uint32_t band, uint32_t)
+    {
+        uint32_t firstRow = band * TileSize;
+        shaded[band] = ResolveRows(firstRow, std::min(mHeight - firstRow, (uint32_t)TileSize));
+    });
+    for (uint32_t count : shaded)
+    {
+        mStats.ShadedPixels += count;
+    }
+}
+
+void TerrainReferenceRenderer::CollectPatches(const TerrainReferenceView& view, const TerrainInstanceBuilder& instances)
+{
+    mJobs.clear();
+    const std::vector<TerrainInstance>& instanceList = instances.GetInstances();
+    const float maxHeight = mHeightfield->GetHeightScale();
+
+    for (int grid = 0; grid < instances.GetGridCount(); grid++)
+    {
+        uint32_t patchesPerEdge = (uint32_t)instances.GetGridPatchesPerEdge(grid);
+        uint32_t first = instances.GetGridFirstInstance(grid);
+        for (uint32_t index = first; index < first + instances.GetGridInstanceCount(grid); index++)
+        {
+            const TerrainInstance& instance = instanceList[index];
+            for (uint32_t patchZ = 0; patchZ < patchesPerEdge; patchZ++)
+            {
+                for (uint32_t patchX = 0; patchX < patchesPerEdge; patchX++)
+                {
+                    mStats.Patches++;
+
+                    // Углы - как в vs.hlsl: начало экземпляра + координата единичной сетки * размер
+                    float x0 = instance.Origin.x + ((float)patchX / patchesPerEdge) * instance.Scale;
+                    float x1 = instance.Origin.x + ((float)(patchX + 1) / patchesPerEdge) * instance.Scale;
+                    float z0 = instance.Origin.y + ((float)patchZ / patchesPerEdge) * instance.Scale;
+                    float z1 = instance.Origin.y + ((float)(patchZ + 1) / patchesPerEdge) * instance.Scale;
+
+                    // Смещённая поверхность не выходит из [0, gHeightScale]
+                    if (BoxOutsideClip(view.ViewProj, x0, 0.0f, z0, x1, maxHeight, z1))
+                    {
+                        mStats.CulledPatches++;
+                        continue;
+                    }
+
+                    const XMFLOAT3 corners[4] =
+                    {
+                        XMFLOAT3(x0, 0.0f, z0), XMFLOAT3(x1, 0.0f, z0), XMFLOAT3(x0, 0.0f, z1), XMFLOAT3(x1, 0.0f, z1)
+                    };
+                    PatchTessFactors factors = ComputePatchTessFactors(corners, view.EyePosition, mBasePatchSize);
+
+                    PatchJob job;
+                    job.Instance = index;
+                    job.PatchX = patchX;
+                    job.PatchZ = patchZ;
+                    job.PatchesPerEdge = patchesPerEdge;
+                    job.Segments = FractionalEvenSegments(factors.Inside);
+                    for (int edge = 0; edge < 4; edge++)
+                    {
+                        job.EdgeSegments[edge] = FractionalEvenSegments(factors.Edge[edge]);
+                    }
+                    job.Triangles = CountPatchTriangles(factors);
+                    mStats.Triangles += job.Triangles;
+                    mJobs.push_back(job);
+                }
+            }
+        }
+    }
+}
+
+void TerrainReferenceRenderer::SetupPatch(const TerrainReferenceView& view, const TerrainInstance& instance,
+                                          const PatchJob& job, SetupBatch& batch) const
+{
+    const uint32_t segments = job.Segments;
+    const uint32_t innerSide = segments - 1;
+    const uint32_t innerCount = innerSide * innerSide;
+
+    // Контрольные точки патча (vs.hlsl) и их координаты в текстуре тайла
+    float gridX0 = (float)job.PatchX / job.PatchesPerEdge;
+    float gridX1 = (float)(job.PatchX + 1) / job.PatchesPerEdge;
+    float gridZ0 = (float)job.PatchZ / job.PatchesPerEdge;
+    float gridZ1 = (float)(job.PatchZ + 1) / job.PatchesPerEdge;
+    float x0 = instance.Origin.x + gridX0 * instance.Scale;
+    float x1 = instance.Origin.x + gridX1 * instance.Scale;
+    float z0 = instance.Origin.y + gridZ0 * instance.Scale;
+    float z1 = instance.Origin.y + gridZ1 * instance.Scale;
+    const XMFLOAT4& colorRect = instance.ColorTexRect;
+    float u0 = colorRect.x + gridX0 * colorRect.z;
+    float u1 = colorRect.x + gridX1 * colorRect.z;
+    float v0 = colorRect.y + gridZ0 * colorRect.w;
+    float v1 = colorRect.y + gridZ1 * colorRect.w;
+
+    // Точки домена: сначала внутренняя сетка (точки 1..segments-1 по обеим осям), затем рёбра
+    // от угла до угла. Параметры (доли патча по X и Z) пока лежат в SampleX / SampleZ.
+    uint32_t edgeFirst[5];
+    edgeFirst[0] = innerCount;
+    for (int edge = 0; edge < 4; edge++)
+    {
+        edgeFirst[edge + 1] = edgeFirst[edge] + job.EdgeSegments[edge] + 1;
+    }
+    const uint32_t vertexCount = edgeFirst[4];
+
+    batch.SampleX.resize(vertexCount);
+    batch.SampleZ.resize(vertexCount);
+    for (uint32_t row = 1; row < segments; row++)
+    {
+        for (uint32_t column = 1; column < segments; column++)
+        {
+            uint32_t index = (row - 1) * innerSide + column - 1;
+            batch.SampleX[index] = (float)column / segments;
+            batch.SampleZ[index] = (float)row / segments;
+        }
+    }
+    for (int edge = 0; edge < 4; edge++)
+    {
+        // Ребро 0 - u = 0, 1 - v = 0, 2 - u = 1, 3 - v = 1
+        bool alongX = (edge & 1) != 0;
+        float fixed = edge >= 2 ? 1.0f : 0.0f;
+        for (uint32_t point = 0; point <= job.EdgeSegments[edge]; point++)
+        {
+            float t = (float)point / job.EdgeSegments[edge];
+            batch.SampleX[edgeFirst[edge] + point] = alongX ? t : fixed;
+            batch.SampleZ[edgeFirst[edge] + point] = alongX ? fixed : t;
+        }
+    }
+
+    batch.Vertices.resize(vertexCount);
+    for (uint32_t index = 0; index < vertexCount; index++)
+    {
+        ClipVertex& vertex = batch.Vertices[index];
+        vertex.U = Lerp(u0, u1, batch.SampleX[index]);
+        vertex.V = Lerp(v0, v1, batch.SampleZ[index]);
+        batch.SampleX[index] = Lerp(x0, x1, batch.SampleX[index]);
+        batch.SampleZ[index] = Lerp(z0, z1, batch.SampleZ[index]);
+    }
+
+    // Высоты и нормали пакетом (ds.hlsl)
+    batch.Heights.resize(vertexCount);
+    batch.NormalX.resize(vertexCount);
+    batch.NormalY.resize(vertexCount);
+    batch.NormalZ.resize(vertexCount);
+    HeightfieldSamples samples = { batch.Heights.data(), batch.NormalX.data(), batch.NormalY.data(), batch.NormalZ.data() };
+    mHeightfield->SampleHeightsAndNormals(batch.SampleX.data(), batch.SampleZ.data(), samples, vertexCount);
+
+    for (uint32_t index = 0; index < vertexCount; index++)
+    {
+        ClipVertex& vertex = batch.Vertices[index];
+        float clip[4];
+        TransformPoint(view.ViewProj, batch.SampleX[index], batch.Heights[index], batch.SampleZ[index], clip);
+        vertex.X = clip[0];
+        vertex.Y = clip[1];
+        vertex.Z = clip[2];
+        vertex.W = clip[3];
+        vertex.NormalX = batch.NormalX[index];
+        vertex.NormalY = batch.NormalY[index];
+        vertex.NormalZ = batch.NormalZ[index];
+    }
+
+    const ClipVertex* vertices = batch.Vertices.data();
+    const uint32_t slot = instance.TextureSlot;
+    for (uint32_t row = 0; row + 1 < innerSide; row++)
+    {
+        for (uint32_t column = 0; column + 1 < innerSide; column++)
+        {
+            const ClipVertex* quad = vertices + row * innerSide + column;
+            AddTriangle(quad[0], quad[1], quad[innerSide], slot, batch);
+            AddTriangle(quad[1], quad[innerSide + 1], quad[innerSide], slot, batch);
+        }
+    }
+
+    // Кольцо у каждого ребра: точки ребра сшиваются со стороной внутренней сетки обходом
+    // по параметру вдоль ребра (ребро k / edgeSegments, сетка m / segments)
+    for (int edge = 0; edge < 4; edge++)
+    {
+        const uint32_t edgeSegments = job.EdgeSegments[edge];
+        const ClipVertex* outer = vertices + edgeFirst[edge];
+        uint32_t innerStart = edge == 2 ? innerSide - 1 : (edge == 3 ? (innerSide - 1) * innerSide : 0);
+        uint32_t innerStep = (edge & 1) ? 1 : innerSide;
+        auto inner = [&](uint32_t m) -> const ClipVertex&
+        {
+            return vertices[innerStart + (m - 1) * innerStep];
+        };
+
+        uint32_t k = 0;
+        uint32_t m = 1;
+        while (k < edgeSegments || m < innerSide)
+        {
+            if (m == innerSide || (k < edgeSegments && (k + 1) * segments <= (m + 1) * edgeSegments))
+            {
+                AddTriangle(outer[k], outer[k + 1], inner(m), slot, batch);
+                k++;
+            }
+            else
+            {
+                AddTriangle(outer[k], inner(m + 1), inner(m), slot, batch);
+                m++;
+            }
+        }
+    }
+}
+
+void TerrainReferenceRenderer::AddTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c,
+                                           uint32_t slot, SetupBatch& batch) const
+{
+    // Целиком за одной из плоскостей отсечения
+    if ((a.X < -a.W && b.X < -b.W && c.X < -c.W) || (a.X > a.W && b.X > b.W && c.X > c.W) ||
+        (a.Y < -a.W && b.Y < -b.W && c.Y < -c.W) || (a.Y > a.W && b.Y > b.W && c.Y > c.W) ||
+        (a.Z < 0.0f && b.Z < 0.0f && c.Z < 0.0f) || (a.Z > a.W && b.Z > b.W && c.Z > c.W))
+    {
+        return;
+    }
+
+    if (a.Z >= 0.0f && b.Z >= 0.0f && c.Z >= 0.0f)
+    {
+        const ClipVertex vertices[3] = { a, b, c };
+        SetupScreenTriangle(vertices, slot, batch);
+        return;
+    }
+
+    // Отсечение ближней плоскостью z = 0: многоугольник до 4 вершин, дальше веером.
+    // Атрибуты в пространстве отсечения интерполируются линейно.
+    const ClipVertex* input[3] = { &a, &b, &c };
+    ClipVertex polygon[4];
+    int count = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        const ClipVertex& current = *input[i];
+        const ClipVertex& next = *input[(i + 1) % 3];
+        if (current.Z >= 0.0f)
+        {
+            polygon[count++] = current;
+        }
+        if ((current.Z >= 0.0f) != (next.Z >= 0.0f))
+        {
+            float t = current.Z / (current.Z - next.Z);
+            ClipVertex& vertex = polygon[count++];
+            vertex.X = current.X + (next.X - current.X) * t;
+            vertex.Y = current.Y + (next.Y - current.Y) * t;
+            vertex.Z = 0.0f;
+            vertex.W = current.W + (next.W - current.W) * t;
+            vertex.U = current.U + (next.U - current.U) * t;
+            vertex.V = current.V + (next.V - current.V) * t;
+            vertex.NormalX = current.NormalX + (next.NormalX - current.NormalX) * t;
+            vertex.NormalY = current.NormalY + (next.NormalY - current.NormalY) * t;
+            vertex.NormalZ = current.NormalZ + (next.NormalZ - current.NormalZ) * t;
+        }
+    }
+
+    for (int i = 1; i + 1 < count; i++)
+    {
+        const ClipVertex vertices[3] = { polygon[0], polygon[i], polygon[i + 1] };
+        SetupScreenTriangle(vertices, slot, batch);
+    }
+}
+
+void TerrainReferenceRenderer::SetupScreenTriangle(const ClipVertex* vertices, uint32_t slot, SetupBatch& batch) const
+{
+    float x[3], y[3], invW[3];
+    for (int i = 0; i < 3; i++)
+    {
+        invW[i] = 1.0f / vertices[i].W;
+        x[i] = (vertices[i].X * invW[i] * 0.5f + 0.5f) * mWidth;
+        y[i] = (0.5f - vertices[i].Y * invW[i] * 0.5f) * mHeight;
+    }
+
+    float det = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (fabsf(det) < MinTriangleArea)
+    {
+        return;
+    }
+
+    // Прямоугольник центров пикселей (x + 0.5, y + 0.5) внутри экрана; без них треугольник ничего не рисует
+    float minX = std::max(ceilf(std::min(std::min(x[0], x[1]), x[2]) - 0.5f), 0.0f);
+    float maxX = std::min(floorf(std::max(std::max(x[0], x[1]), x[2]) - 0.5f), (float)mWidth - 1.0f);
+    float minY = std::max(ceilf(std::min(std::min(y[0], y[1]), y[2]) - 0.5f), 0.0f);
+    float maxY = std::min(floorf(std::max(std::max(y[0], y[1]), y[2]) - 0.5f), (float)mHeight - 1.0f);
+    if (minX > maxX || minY > maxY)
+    {
+        return;
+    }
+
+    ScreenTriangle triangle;
+    triangle.MinX = (int32_t)minX;
+    triangle.MaxX = (int32_t)maxX;
+    triangle.MinY = (int32_t)minY;
+    triangle.MaxY = (int32_t)maxY;
+    triangle.Slot = slot;
+
+    // Плоскости считаются в координатах пикселя, центр уже учтён в C.
+    // Рёбра нормированы: значение - расстояние до ребра в пикселях, внутри >= 0.
+    float orientation = det > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < 3; i++)
+    {
+        int from = (i + 1) % 3;
+        int to = (i + 2) % 3;
+        float a = -(y[to] - y[from]);
+        float b = x[to] - x[from];
+        float scale = orientation / sqrtf(a * a + b * b);
+        ScreenPlane& edge = triangle.Edges[i];
+        edge.A = a * scale;
+        edge.B = b * scale;
+        edge.C = -(a * (x[from] - 0.5f) + b * (y[from] - 0.5f)) * scale;
+    }
+
+    auto setPlane = [&](ScreenPlane& plane, float q0, float q1, float q2)
+    {
+        plane.A = ((q1 - q0) * (y[2] - y[0]) - (q2 - q0) * (y[1] - y[0])) / det;
+        plane.B = ((q2 - q0) * (x[1] - x[0]) - (q1 - q0) * (x[2] - x[0])) / det;
+        plane.C = q0 - plane.A * (x[0] - 0.5f) - plane.B * (y[0] - 0.5f);
+    };
+
+    setPlane(triangle.Depth, vertices[0].Z * invW[0], vertices[1].Z * invW[1], vertices[2].Z * invW[2]);
+    setPlane(triangle.Attributes[0], vertices[0].U * invW[0], vertices[1].U * invW[1], vertices[2].U * invW[2]);
+    setPlane(triangle.Attributes[1], vertices[0].V * invW[0], vertices[1].V * invW[1], vertices[2].V * invW[2]);
+    setPlane(triangle.Attributes[2], vertices[0].NormalX * invW[0], vertices[1].NormalX * invW[1], vertices[2].NormalX * invW[2]);
+    setPlane(triangle.Attributes[3], vertices[0].NormalY * invW[0], vertices[1].NormalY * invW[1], vertices[2].NormalY * invW[2]);
+    setPlane(triangle.Attributes[4], vertices[0].NormalZ * invW[0], vertices[1].NormalZ * invW[1], vertices[2].NormalZ * invW[2]);
+    setPlane(triangle.Attributes[5], invW[0], invW[1], invW[2]);
+
+    // Уровень мипа как у изотропной выборки: log2 наибольшего шага текстуры на пиксель по x или y.
+    // Производные - аффинные по треугольнику, для мелких треугольников тесселяции этого хватает.
+    bool textured = slot < MaxSlots && !mTextures[slot].empty();
+    float texelsX = textured ? (float)mTextures[slot][0].Width : 1.0f;
+    float texelsY = textured ? (float)mTextures[slot][0].Height : 1.0f;
+    ScreenPlane u, v;
+    setPlane(u, vertices[0].U * texelsX, vertices[1].U * texelsX, vertices[2].U * texelsX);
+    setPlane(v, vertices[0].V * texelsY, vertices[1].V * texelsY, vertices[2].V * texelsY);
+    float footprint = std::max(u.A * u.A + v.A * v.A, u.B * u.B + v.B * v.B);
+    triangle.Lod = footprint > 0.0f ? 0.5f * log2f(footprint) : 0.0f;
+
+    uint32_t index = (uint32_t)batch.Triangles.size();
+    batch.Triangles.push_back(triangle);
+    for (uint32_t tileY = triangle.MinY / TileSize; tileY <= triangle.MaxY / TileSize; tileY++)
+    {
+        for (uint32_t tileX = triangle.MinX / TileSize; tileX <= triangle.MaxX / TileSize; tileX++)
+        {
+            batch.Bins[tileY * mTilesX + tileX].push_back(index);
+        }
+    }
+}
+
+void TerrainReferenceRenderer::RasterizeTile(uint32_t tile, uint32_t batchCount)
+{
+    const int32_t tileMinX = (int32_t)((tile % mTilesX) * TileSize);
+    const int32_t tileMinY = (int32_t)((tile / mTilesX) * TileSize);
+    const int32_t tileMaxX = tileMinX + (int32_t)TileSize - 1;
+    const int32_t tileMaxY = tileMinY + (int32_t)TileSize - 1;
+
+    for (uint32_t batchIndex = 0; batchIndex < batchCount; batchIndex++)
+    {
+        const SetupBatch& batch = mBatches[batchIndex];
+        for (uint32_t triangleIndex : batch.Bins[tile])
+        {
+            const ScreenTriangle& triangle = batch.Triangles[triangleIndex];
+            // Четвёрки пикселей выровнены: тайл и шаг строки кратны 4
+            int32_t minX = std::max(triangle.MinX, tileMinX) & ~3;
+            int32_t maxX = std::min(triangle.MaxX, tileMaxX);
+            int32_t minY = std::max(triangle.MinY, tileMinY);
+            int32_t maxY = std::min(triangle.MaxY, tileMaxY);
+            const ScreenPlane* attributes = triangle.Attributes;
+
+            for (int32_t y = minY; y <= maxY; y++)
+            {
+                const float fy = (float)y;
+                size_t row = (size_t)y * mPitch;
+#if TERRAIN_REFERENCE_SSE
+                const __m128 offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+                const __m128 epsilon = _mm_set1_ps(-EdgeEpsilon);
+                const __m128 one = _mm_set1_ps(1.0f);
+                const __m128 lod = _mm_set1_ps(triangle.Lod);
+                const __m128 slot = _mm_castsi128_ps(_mm_set1_epi32((int)triangle.Slot));
+                auto plane = [&](const ScreenPlane& p, __m128 px)
+                {
+                    return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.A), px), _mm_set1_ps(p.B * fy + p.C));
+                };
+                auto blend = [](float* target, __m128 mask, __m128 value)
+                {
+                    __m128 old = _mm_loadu_ps(target);
+                    _mm_storeu_ps(target, _mm_or_ps(_mm_and_ps(mask, value), _mm_andnot_ps(mask, old)));
+                };
+
+                for (int32_t x = minX; x <= maxX; x += 4)
+                {
+                    __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                    __m128 mask = _mm_and_ps(_mm_cmpge_ps(plane(triangle.Edges[0], px), epsilon),
+                                             _mm_cmpge_ps(plane(triangle.Edges[1], px), epsilon));
+                    mask = _mm_and_ps(mask, _mm_cmpge_ps(plane(triangle.Edges[2], px), epsilon));
+                    if (_mm_movemask_ps(mask) == 0)
+                    {
+                        continue;
+                    }
+
+                    // D3D12_COMPARISON_FUNC_LESS и дальняя плоскость
+                    size_t index = row + x;
+                    __m128 depth = plane(triangle.Depth, px);
+                    mask = _mm_and_ps(mask, _mm_cmplt_ps(depth, _mm_loadu_ps(&mDepth[index])));
+                    mask = _mm_and_ps(mask, _mm_cmple_ps(depth, one));
+                    if (_mm_movemask_ps(mask) == 0)
+                    {
+                        continue;
+                    }
+
+                    __m128 w = _mm_div_ps(one, plane(attributes[5], px));
+                    blend(&mDepth[index], mask, depth);
+                    blend(&mPixelU[index], mask, _mm_mul_ps(plane(attributes[0], px), w));
+                    blend(&mPixelV[index], mask, _mm_mul_ps(plane(attributes[1], px), w));
+                    blend(&mPixelNormalX[index], mask, _mm_mul_ps(plane(attributes[2], px), w));
+                    blend(&mPixelNormalY[index], mask, _mm_mul_ps(plane(attributes[3], px), w));
+                    blend(&mPixelNormalZ[index], mask, _mm_mul_ps(plane(attributes[4], px), w));
+                    blend(&mPixelLod[index], mask, lod);
+                    blend(reinterpret_cast<float*>(&mPixelSlot[index]), mask, slot);
+                }
+#else
+                auto plane = [&](const ScreenPlane& p, float px)
+                {
+                    return p.A * px + p.B * fy + p.C;
+                };
+
+                for (int32_t x = minX; x <= maxX; x++)
+                {
+                    const float px = (float)x;
+                    if (plane(triangle.Edges[0], px) < -EdgeEpsilon || plane(triangle.Edges[1], px) < -EdgeEpsilon ||
+                        plane(triangle.Edges[2], px) < -EdgeEpsilon)
+                    {
+                        continue;
+                    }
+
+                    size_t index = row + x;
+                    float depth = plane(triangle.Depth, px);
+                    if (!(depth < mDepth[index]) || depth > 1.0f)
+                    {
+                        continue;
+                    }
+
+                    float w = 1.0f / plane(attributes[5], px);
+                    mDepth[index] = depth;
+                    mPixelU[index] = plane(attributes[0], px) * w;
+                    mPixelV[index] = plane(attributes[1], px) * w;
+                    mPixelNormalX[index] = plane(attributes[2], px) * w;
+                    mPixelNormalY[index] = plane(attributes[3], px) * w;
+                    mPixelNormalZ[index] = plane(attributes[4], px) * w;
+                    mPixelLod[index] = triangle.Lod;
+                    mPixelSlot[index] = triangle.Slot;
+                }
+#endif
+            }
+        }
+    }
+}
+
+uint32_t TerrainReferenceRenderer::ResolveRows(uint32_t firstRow, uint32_t rowCount)
+{
+    const float lightLength = sqrtf(LightX * LightX + LightY * LightY + LightZ * LightZ);
+    const float toLightX = -LightX / lightLength;
+    const float toLightY = -LightY / lightLength;
+    const float toLightZ = -LightZ / lightLength;
+
+    uint32_t shaded = 0;
+    for (uint32_t y = firstRow; y < firstRow + rowCount; y++)
+    {
+        for (uint32_t x = 0; x < mWidth; x++)
+        {
+            size_t index = (size_t)y * mPitch + x;
+            uint32_t& output = mColor[(size_t)y * mWidth + x];
+            uint32_t slot = mPixelSlot[index];
+            if (slot == EmptySlot)
+            {
+                output = ToUnorm8(ClearColor[0]) | (ToUnorm8(ClearColor[1]) << 8) |
+                         (ToUnorm8(ClearColor[2]) << 16) | 0xFF000000u;
+                continue;
+            }
+
+            float nx = mPixelNormalX[index];
+            float ny = mPixelNormalY[index];
+            float nz = mPixelNormalZ[index];
+            float length = sqrtf(nx * nx + ny * ny + nz * nz);
+            float diffuse = length > 0.0f ? (nx * toLightX + ny * toLightY + nz * toLightZ) / length : 0.0f;
+            float intensity = Ambient + std::min(std::max(diffuse, 0.0f), 1.0f) * DiffuseWeight;
+
+            float color[4];
+            SampleTexture(slot, mPixelU[index], mPixelV[index], mPixelLod[index], color);
+            output = ToUnorm8(color[0] * intensity) | (ToUnorm8(color[1] * intensity) << 8) |
+                     (ToUnorm8(color[2] * intensity) << 16) | 0xFF000000u;
+            shaded++;
+        }
+    }
+    return shaded;
+}
+
+void TerrainReferenceRenderer::SampleTexture(uint32_t slot, float u, float v, float lod, float* rgba) const
+{
+    if (slot >= MaxSlots || mTextures[slot].empty())
+    {
+        std::copy(PlaceholderColor, PlaceholderColor + 4, rgba);
+        return;
+    }
+
+    // MIN_MAG_MIP_LINEAR, адресация CLAMP
+    const std::vector<MipLevel>& mips = mTextures[slot];
+    lod = std::min(std::max(lod, 0.0f), (float)(mips.size() - 1));
+    uint32_t level = (uint32_t)lod;
+    float levelBlend = lod - level;
+
+    std::fill(rgba, rgba + 4, 0.0f);
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        float weight = i == 0 ? 1.0f - levelBlend : levelBlend;
+        if (weight <= 0.0f)
+        {
+            continue;
+        }
+
+        const MipLevel& mip = mips[level + i];
+        float tx = u * mip.Width - 0.5f;
+        float ty = v * mip.Height - 0.5f;
+        float fx = floorf(tx);
+        float fy = floorf(ty);
+        float wx = tx - fx;
+        float wy = ty - fy;
+        int maxX = (int)mip.Width - 1;
+        int maxY = (int)mip.Height - 1;
+        int x0 = std::min(std::max((int)fx, 0), maxX);
+        int x1 = std::min(std::max((int)fx + 1, 0), maxX);
+        int y0 = std::min(std::max((int)fy, 0), maxY);
+        int y1 = std::min(std::max((int)fy + 1, 0), maxY);
+
+        const uint32_t texels[4] =
+        {
+            mip.Texels[(size_t)y0 * mip.Width + x0], mip.Texels[(size_t)y0 * mip.Width + x1],
+            mip.Texels[(size_t)y1 * mip.Width + x0], mip.Texels[(size_t)y1 * mip.Width + x1]
+        };
+        const float weights[4] = { (1 - wx) * (1 - wy), wx * (1 - wy), (1 - wx) * wy, wx * wy };
+        for (int texel = 0; texel < 4; texel++)
+        {
+            for (int channel = 0; channel < 4; channel++)
+            {
+                rgba[channel] += weight * weights[texel] * ((texels[texel] >> (8 * channel)) & 0xFF) * (1.0f / 255.0f);
+            }
+        }
+    }
+}
+
+bool TerrainReferenceRenderer::WriteBmp(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file || mColor.size() != (size_t)mWidth * mHeight)
+    {
+        return false;
+    }
+
+    // BITMAPFILEHEADER + BITMAPINFOHEADER, строки BGR снизу вверх, выровнены на 4 байта
+    const uint32_t rowSize = (mWidth * 3 + 3) & ~3u;
+    const uint32_t headerSize = 14 + 40;
+    uint8_t header[headerSize] = {};
+    header[0] = 'B';
+    header[1] = 'M';
+    PutLE(header + 2, headerSize + rowSize * mHeight, 4);
+    PutLE(header + 10, headerSize, 4);
+    PutLE(header + 14, 40, 4);
+    PutLE(header + 18, mWidth, 4);
+    PutLE(header + 22, mHeight, 4);
+    PutLE(header + 26, 1, 2);
+    PutLE(header + 28, 24, 2);
+    PutLE(header + 34, rowSize * mHeight, 4);
+    file.write(reinterpret_cast<const char*>(header), headerSize);
+
+    std::vector<uint8_t> row(rowSize, 0);
+    for (uint32_t y = mHeight; y-- > 0;)
+    {
+        for (uint32_t x = 0; x < mWidth; x++)
+        {
+            uint32_t color = mColor[(size_t)y * mWidth + x];
+            row[x * 3 + 0] = (uint8_t)(color >> 16);
+            row[x * 3 + 1] = (uint8_t)(color >> 8);
+            row[x * 3 + 2] = (uint8_t)color;
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), rowSize);
+    }
+    return (bool)file;
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include "TerrainInstanceBuilder.h"
+#include "TerrainTessellation.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+class Heightfield;
+class Bc7Decoder;
+class WorkStealingPool;
+
+// Камера эталонного кадра
+struct TerrainReferenceView
+{
+    DirectX::XMFLOAT4X4 ViewProj;   // Мир -> отсечение для вектора-строки, без транспонирования (view * proj)
+    DirectX::XMFLOAT3 EyePosition;  // gEyePosW - от него считаются факторы тесселяции
+    uint32_t Width;
+    uint32_t Height;
+};
+
+// Счётчики последнего Render
+struct TerrainReferenceStats
+{
+    uint32_t Patches;              // Патчи всех экземпляров
+    uint32_t CulledPatches;        // Патчи целиком вне пирамиды видимости (GPU отбросил бы все их треугольники)
+    uint64_t Triangles;            // Треугольники тесселяции непропущенных патчей
+    uint64_t RasterTriangles;      // Дошедшие до тайлов: в пирамиде и накрывающие хотя бы один центр пикселя
+    uint32_t Waves;                // Проходов подготовка -> растеризация
+    uint32_t ShadedPixels;         // Пиксели, закрытые террейном
+};
+
+// Программный эталон конвейера террейна (vs.hlsl -> hs.hlsl -> ds.hlsl -> ps.hlsl) без графического API:
+// кадры можно снимать и сравнивать на машинах без D3D12.
+//
+// Каждый патч экземпляров TerrainInstanceBuilder тесселируется по факторам ConstantHS
+// (TerrainTessellation), вершины смещаются по Heightfield (та же выборка и gHeightScale, что в ds.hlsl,
+// нормали центральными разностями), пиксели освещаются как в ps.hlsl с трилинейной выборкой
+// цветовой текстуры тайла. Отличие от аппаратного тесселятора: fractional_even не сдвигает точки -
+// внутренняя сетка делится равномерно на чётное число отрезков по внутреннему фактору, каждое ребро -
+// на чётное число по своему, а полоса между ребром и внутренней сеткой сшивается треугольниками, как
+// кольцо аппаратного тесселятора. Точки ребра зависят только от фактора ребра, одинакового у соседних
+// патчей равного размера, поэтому внутри уровня сетка без щелей. Щели на стыке узлов QuadTree разного
+// размера воспроизводятся так же, как на GPU.
+//
+// Треугольники готовятся параллельно пакетами и раскладываются по экранным тайлам, тайлы
+// растеризуются независимо (SSE, по 4 пикселя): тест глубины пишет в буфер атрибутов
+// (текстурные координаты, нормаль, уровень мипа, слот), а освещение и выборка текстуры
+// считаются один раз на пиксель после всех треугольников. Чтобы память не росла с тесселяцией,
+// патчи идут волнами примерно по WaveTaskCount * TrianglesPerTask треугольников.
+class TerrainReferenceRenderer
+{
+public:
+    static const uint32_t TileSize = 64;            // Пикселей на ребро экранного тайла, кратно 4
+    static const uint32_t TrianglesPerTask = 16384;
+    static const uint32_t WaveTaskCount = 16;
+    static const uint32_t MaxSlots = 64;
+
+    TerrainReferenceRenderer();
+
+    // Карта высот не копируется и должна жить, пока используется рендерер. basePatchSize - gBasePatchSize.
+    void SetHeightfield(const Heightfield* heightfield, float basePatchSize);
+
+    // Цветовая текстура слота (TextureSlot экземпляра) из BC7 DDS, все мипы в RGBA8.
+    // Слоты без текстуры рисуются серым, как заглушка TerrainApp.
+    bool LoadTileTexture(uint32_t slot, const std::string& path, const Bc7Decoder& decoder,
+                         WorkStealingPool* pool = nullptr);
+
+    // Экземпляры последнего Build, как их рисует TerrainApp::Draw. pool == nullptr - всё в вызывающем потоке.
+    void Render(const TerrainReferenceView& view, const TerrainInstanceBuilder& instances,
+                WorkStealingPool* pool = nullptr);
+
+    uint32_t GetWidth() const { return mWidth; }
+    uint32_t GetHeight() const { return mHeight; }
+
+    // RGBA8 (R в младшем байте) последнего Render, Width x Height построчно сверху вниз
+    const std::vector<uint32_t>& GetColor() const { return mColor; }
+
+    // Глубина z / w (1 - фон), шаг строки GetDepthPitch()
+    const std::vector<float>& GetDepth() const { return mDepth; }
+    uint32_t GetDepthPitch() const { return mPitch; }
+
+    const TerrainReferenceStats& GetStats() const { return mStats; }
+
+    // Несжатый 24-битный BMP с последним кадром
+    bool WriteBmp(const std::string& path) const;
+
+private:
+    // Вершина в пространстве отсечения с атрибутами для пикселя
+    struct ClipVertex
+    {
+        float X, Y, Z, W;
+        float U, V;                 // localTexCoord
+        float NormalX, NormalY, NormalZ;
+    };
+
+    // Плоскость величины на экране: value = A * x + B * y + C (x, y - центр пикселя)
+    struct ScreenPlane
+    {
+        float A, B, C;
+    };
+
+    static const uint32_t AttributeCount = 6;      // u/w, v/w, nx/w, ny/w, nz/w, 1/w
+
+    // Треугольник после отсечения: рёбра (внутри все >= 0), z / w, атрибуты с перспективой
+    struct ScreenTriangle
+    {
+        ScreenPlane Edges[3];
+        ScreenPlane Depth;
+        ScreenPlane Attributes[AttributeCount];
+        int32_t MinX, MinY, MaxX, MaxY;
+        float Lod;                  // Уровень мипа: log2 шага текстуры (в текселях) на пиксель
+        uint32_t Slot;
+    };
+
+    // Видимый патч и число отрезков его сторон
+    struct PatchJob
+    {
+        uint32_t Instance;
+        uint32_t PatchX, PatchZ;
+        uint32_t PatchesPerEdge;
+        uint32_t Segments;          // Внутренней сетки, чётное
+        uint32_t EdgeSegments[4];   // Рёбер в порядке PatchTessFactors::Edge, чётные
+        uint32_t Triangles;
+    };
+
+    // Треугольники одной задачи волны, их раскладка по тайлам и рабочие массивы
+    struct SetupBatch
+    {
+        std::vector<ScreenTriangle> Triangles;
+        std::vector<std::vector<uint32_t>> Bins;
+        std::vector<float> SampleX, SampleZ, Heights, NormalX, NormalY, NormalZ;
+        std::vector<ClipVertex> Vertices;
+    };
+
+    struct MipLevel
+    {
+        uint32_t Width;
+        uint32_t Height;
+        std::vector<uint32_t> Texels;
+    };
+
+    void CollectPatches(const TerrainReferenceView& view, const TerrainInstanceBuilder& instances);
+    void SetupPatch(const TerrainReferenceView& view, const TerrainInstance& instance, const PatchJob& job,
+                    SetupBatch& batch) const;
+    void AddTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, uint32_t slot,
+                     SetupBatch& batch) const;
+    void SetupScreenTriangle(const ClipVertex* vertices, uint32_t slot, SetupBatch& batch) const;
+    void RasterizeTile(uint32_t tile, uint32_t batchCount);
+    uint32_t ResolveRows(uint32_t firstRow, uint32_t rowCount);
+    void SampleTexture(uint32_t slot, float u, float v, float lod, float* rgba) const;
+
+    const Heightfield* mHeightfield;
+    float mBasePatchSize;
+    std::vector<MipLevel> mTextures[MaxSlots];
+
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mPitch;                // Ширина буферов, кратная TileSize
+    uint32_t mTilesX;
+    uint32_t mTilesY;
+
+    std::vector<PatchJob> mJobs;
+    std::vector<uint32_t> mTaskFirstJob;   // Задача t - задания [mTaskFirstJob[t], mTaskFirstJob[t + 1])
+    SetupBatch mBatches[WaveTaskCount];
+
+    // Буфер атрибутов, шаг строки mPitch
+    std::vector<float> mDepth;
+    std::vector<float> mPixelU, mPixelV;
+    std::vector<float> mPixelNormalX, mPixelNormalY, mPixelNormalZ;
+    std::vector<float> mPixelLod;
+    std::vector<uint32_t> mPixelSlot;      // Слот текстуры, 0xFFFFFFFF - фон
+    std::vector<uint32_t> mColor;
+    TerrainReferenceStats mStats;
+};
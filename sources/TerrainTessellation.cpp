@@ -0,0 +1,273 @@
+#include "TerrainTessellation.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define TERRAIN_TESSELLATION_SSE 1
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+    // EdgeScale: длина ребра по XZ в базовых патчах
+    float EdgeScale(const XMFLOAT3& a, const XMFLOAT3& b, float basePatchSize)
+    {
+        float dx = b.x - a.x;
+        float dz = b.z - a.z;
+        return sqrtf(dx * dx + dz * dz) / basePatchSize;
+    }
+
+    XMFLOAT3 Midpoint(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return XMFLOAT3(0.5f * (a.x + b.x), 0.5f * (a.y + b.y), 0.5f * (a.z + b.z));
+    }
+
+    float EdgeFactor(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& eye, float basePatchSize)
+    {
+        const float maxFactor = TerrainTessellation::MaxFactor;
+        return std::min(CalcTessFactor(Midpoint(a, b), eye) * EdgeScale(a, b, basePatchSize), maxFactor);
+    }
+
+    // Задачи пула или тот же цикл в вызывающем потоке
+    template <typename Task>
+    void RunTasks(WorkStealingPool* pool, uint32_t taskCount, const Task& task)
+    {
+        if (pool == nullptr || pool->GetThreadCount() <= 1)
+        {
+            for (uint32_t i = 0; i < taskCount; i++)
+            {
+                task(i, 0);
+            }
+            return;
+        }
+        pool->Run(taskCount, task);
+    }
+
+    // Сетка экземпляра: patchesPerTile >> grid патчей на ребро
+    uint32_t InstancePatchesPerEdge(const TerrainInstanceBuilder& instances, size_t instance)
+    {
+        int grid = 0;
+        while (grid + 1 < instances.GetGridCount() &&
+               instance >= instances.GetGridFirstInstance(grid) + instances.GetGridInstanceCount(grid))
+        {
+            grid++;
+        }
+        return (uint32_t)instances.GetGridPatchesPerEdge(grid);
+    }
+
+#if TERRAIN_TESSELLATION_SSE
+    // 2^x: x = n + f, |f| <= 0.5, полином exp2f из Cephes. Целые x (концы диапазона CalcTessFactor) точны.
+    __m128 Exp2(__m128 x)
+    {
+        __m128i n = _mm_cvtps_epi32(x);
+        __m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(n));
+        __m128 p = _mm_set1_ps(1.535336188319500e-4f);
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.339887440266574e-3f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(9.618437357674640e-3f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(5.550332471162809e-2f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(2.402264791363012e-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(6.931472028550421e-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+        __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+        return _mm_mul_ps(p, scale);
+    }
+
+    // CalcTessFactor для четырёх точек на нулевой высоте, умноженный на EdgeScale и ограниченный MaxFactor
+    __m128 PatchFactor(__m128 x, __m128 z, const XMFLOAT3& eye, __m128 edgeScale)
+    {
+        const float minDistance = TerrainTessellation::MinDistance;
+        const float maxDistance = TerrainTessellation::MaxDistance;
+        const float minTess = TerrainTessellation::MinTess;
+        const float maxTess = TerrainTessellation::MaxTess;
+
+        __m128 dx = _mm_sub_ps(x, _mm_set1_ps(eye.x));
+        __m128 dy = _mm_set1_ps(0.0f - eye.y);
+        __m128 dz = _mm_sub_ps(z, _mm_set1_ps(eye.z));
+        __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+
+        __m128 s = _mm_div_ps(_mm_sub_ps(d, _mm_set1_ps(minDistance)), _mm_set1_ps(maxDistance - minDistance));
+        s = _mm_min_ps(_mm_max_ps(s, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        __m128 tess = Exp2(_mm_add_ps(_mm_set1_ps(maxTess), _mm_mul_ps(_mm_set1_ps(minTess - maxTess), s)));
+        tess = _mm_max_ps(tess, _mm_set1_ps(1.0f));
+        return _mm_min_ps(_mm_mul_ps(tess, edgeScale), _mm_set1_ps(TerrainTessellation::MaxFactor));
+    }
+
+    // FractionalEvenSegments для четырёх факторов (в float - значения малы и точны)
+    __m128 EvenSegments(__m128 factor)
+    {
+        __m128 half = _mm_mul_ps(_mm_max_ps(factor, _mm_set1_ps(2.0f)), _mm_set1_ps(0.5f));
+        __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(half));
+        __m128 up = _mm_and_ps(_mm_cmplt_ps(truncated, half), _mm_set1_ps(1.0f));
+        return _mm_mul_ps(_mm_add_ps(truncated, up), _mm_set1_ps(2.0f));
+    }
+
+    uint32_t PredictGrid(const XMFLOAT2& origin, float size, uint32_t patchesPerEdge, const XMFLOAT3& eye,
+                         float basePatchSize)
+    {
+        // Углы и середины - те же операции, что в ComputePatchTessFactors, чтобы совпадали побитно
+        const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+        const __m128 patches = _mm_set1_ps((float)patchesPerEdge);
+        const __m128 originX = _mm_set1_ps(origin.x);
+        const __m128 scale = _mm_set1_ps(size);
+        const __m128 base = _mm_set1_ps(basePatchSize);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 quarter = _mm_set1_ps(0.25f);
+
+        uint32_t triangles = 0;
+        for (uint32_t patchZ = 0; patchZ < patchesPerEdge; patchZ++)
+        {
+            float z0 = origin.y + ((float)patchZ / patchesPerEdge) * size;
+            float z1 = origin.y + ((float)(patchZ + 1) / patchesPerEdge) * size;
+            __m128 vz0 = _mm_set1_ps(z0);
+            __m128 vz1 = _mm_set1_ps(z1);
+            __m128 midZ = _mm_set1_ps(0.5f * (z0 + z1));
+            __m128 centerZ = _mm_set1_ps(0.25f * (((z0 + z0) + z1) + z1));
+            __m128 scaleZ = _mm_set1_ps(sqrtf(0.0f * 0.0f + (z1 - z0) * (z1 - z0)) / basePatchSize);
+
+            for (uint32_t patchX = 0; patchX < patchesPerEdge; patchX += 4)
+            {
+                __m128 index = _mm_add_ps(lanes, _mm_set1_ps((float)patchX));
+                __m128 x0 = _mm_add_ps(originX, _mm_mul_ps(_mm_div_ps(index, patches), scale));
+                __m128 x1 = _mm_add_ps(originX, _mm_mul_ps(_mm_div_ps(_mm_add_ps(index, _mm_set1_ps(1.0f)), patches), scale));
+                __m128 dx = _mm_sub_ps(x1, x0);
+                __m128 scaleX = _mm_div_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_setzero_ps())), base);
+                __m128 midX = _mm_mul_ps(half, _mm_add_ps(x0, x1));
+                __m128 centerX = _mm_mul_ps(quarter, _mm_add_ps(_mm_add_ps(_mm_add_ps(x0, x1), x0), x1));
+
+                __m128 edges = EvenSegments(PatchFactor(x0, midZ, eye, scaleZ));
+                edges = _mm_add_ps(edges, EvenSegments(PatchFactor(midX, vz0, eye, scaleX)));
+                edges = _mm_add_ps(edges, EvenSegments(PatchFactor(x1, midZ, eye, scaleZ)));
+                edges = _mm_add_ps(edges, EvenSegments(PatchFactor(midX, vz1, eye, scaleX)));
+                __m128 inner = _mm_sub_ps(EvenSegments(PatchFactor(centerX, centerZ, eye, scaleX)), _mm_set1_ps(2.0f));
+
+                // 2 (N - 2)^2 + sum(Ne) + 4 (N - 2)
+                __m128 count = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.0f), _mm_mul_ps(inner, inner)),
+                                          _mm_add_ps(edges, _mm_mul_ps(_mm_set1_ps(4.0f), inner)));
+                alignas(16) int32_t counts[4];
+                _mm_store_si128((__m128i*)counts, _mm_cvttps_epi32(count));
+
+                uint32_t valid = std::min(patchesPerEdge - patchX, 4u);
+                for (uint32_t lane = 0; lane < valid; lane++)
+                {
+                    triangles += (uint32_t)counts[lane];
+                }
+            }
+        }
+        return triangles;
+    }
+#else
+    uint32_t PredictGrid(const XMFLOAT2& origin, float size, uint32_t patchesPerEdge, const XMFLOAT3& eye,
+                         float basePatchSize)
+    {
+        uint32_t triangles = 0;
+        for (uint32_t patchZ = 0; patchZ < patchesPerEdge; patchZ++)
+        {
+            float z0 = origin.y + ((float)patchZ / patchesPerEdge) * size;
+            float z1 = origin.y + ((float)(patchZ + 1) / patchesPerEdge) * size;
+            for (uint32_t patchX = 0; patchX < patchesPerEdge; patchX++)
+            {
+                float x0 = origin.x + ((float)patchX / patchesPerEdge) * size;
+                float x1 = origin.x + ((float)(patchX + 1) / patchesPerEdge) * size;
+                const XMFLOAT3 corners[4] =
+                {
+                    XMFLOAT3(x0, 0.0f, z0), XMFLOAT3(x1, 0.0f, z0), XMFLOAT3(x0, 0.0f, z1), XMFLOAT3(x1, 0.0f, z1)
+                };
+                triangles += CountPatchTriangles(ComputePatchTessFactors(corners, eye, basePatchSize));
+            }
+        }
+        return triangles;
+    }
+#endif
+}
+
+float CalcTessFactor(const XMFLOAT3& point, const XMFLOAT3& eye)
+{
+    float dx = point.x - eye.x;
+    float dy = point.y - eye.y;
+    float dz = point.z - eye.z;
+    float d = sqrtf(dx * dx + dy * dy + dz * dz);
+
+    const float minDistance = TerrainTessellation::MinDistance;
+    const float maxDistance = TerrainTessellation::MaxDistance;
+    const float minTess = TerrainTessellation::MinTess;
+    const float maxTess = TerrainTessellation::MaxTess;
+    float s = std::min(std::max((d - minDistance) / (maxDistance - minDistance), 0.0f), 1.0f);
+    return std::max(1.0f, exp2f(maxTess + (minTess - maxTess) * s));
+}
+
+PatchTessFactors ComputePatchTessFactors(const XMFLOAT3 corners[4], const XMFLOAT3& eye, float basePatchSize)
+{
+    PatchTessFactors factors;
+    factors.Edge[0] = EdgeFactor(corners[0], corners[2], eye, basePatchSize);
+    factors.Edge[1] = EdgeFactor(corners[0], corners[1], eye, basePatchSize);
+    factors.Edge[2] = EdgeFactor(corners[1], corners[3], eye, basePatchSize);
+    factors.Edge[3] = EdgeFactor(corners[2], corners[3], eye, basePatchSize);
+
+    XMFLOAT3 center(0.25f * (corners[0].x + corners[1].x + corners[2].x + corners[3].x),
+                    0.25f * (corners[0].y + corners[1].y + corners[2].y + corners[3].y),
+                    0.25f * (corners[0].z + corners[1].z + corners[2].z + corners[3].z));
+    const float maxFactor = TerrainTessellation::MaxFactor;
+    factors.Inside = std::min(CalcTessFactor(center, eye) * EdgeScale(corners[0], corners[1], basePatchSize), maxFactor);
+    return factors;
+}
+
+uint32_t FractionalEvenSegments(float factor)
+{
+    const float maxFactor = TerrainTessellation::MaxFactor;
+    float clamped = std::min(std::max(factor, 2.0f), maxFactor);
+    return (uint32_t)ceilf(clamped * 0.5f) * 2u;
+}
+
+uint32_t PredictPatchGridTriangles(const XMFLOAT2& origin, float size, uint32_t patchesPerEdge, const XMFLOAT3& eye,
+                                   float basePatchSize)
+{
+    return PredictGrid(origin, size, patchesPerEdge, eye, basePatchSize);
+}
+
+uint32_t CountPatchTriangles(const PatchTessFactors& factors)
+{
+    uint32_t inner = FractionalEvenSegments(factors.Inside) - 2;
+    uint32_t triangles = 2 * inner * inner;
+    for (int edge = 0; edge < 4; edge++)
+    {
+        triangles += FractionalEvenSegments(factors.Edge[edge]) + inner;
+    }
+    return triangles;
+}
+
+TerrainTrianglePredictor::TerrainTrianglePredictor()
+    : mTotalTriangles(0), mPatchCount(0)
+{
+}
+
+void TerrainTrianglePredictor::Predict(const TerrainInstanceBuilder& instances, const XMFLOAT3& eye,
+                                       float basePatchSize, WorkStealingPool* pool)
+{
+    const std::vector<TerrainInstance>& instanceList = instances.GetInstances();
+    const uint32_t instanceCount = (uint32_t)instanceList.size();
+    mInstanceTriangles.resize(instanceCount);
+
+    const uint32_t instancesPerTask = InstancesPerTask;
+    uint32_t taskCount = (instanceCount + instancesPerTask - 1) / instancesPerTask;
+    RunTasks(pool, taskCount, [&](uint32_t task, uint32_t)
+    {
+        uint32_t end = std::min((task + 1) * instancesPerTask, instanceCount);
+        for (uint32_t i = task * instancesPerTask; i < end; i++)
+        {
+            mInstanceTriangles[i] = PredictGrid(instanceList[i].Origin, instanceList[i].Scale,
+                                                InstancePatchesPerEdge(instances, i), eye, basePatchSize);
+        }
+    });
+
+    mNodeTriangles.assign(instances.GetNodeCount(), 0u);
+    mTotalTriangles = 0;
+    for (uint32_t i = 0; i < instanceCount; i++)
+    {
+        mNodeTriangles[instances.GetInstanceNode(i)] += mInstanceTriangles[i];
+        mTotalTriangles += mInstanceTriangles[i];
+    }
+    mPatchCount = instances.GetPatchCount();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include "TerrainInstanceBuilder.h"
+#include <vector>
+#include <cstdint>
+
+class WorkStealingPool;
+
+// Выбор факторов тесселяции из hs.hlsl на процессоре. Константы и формулы повторяют шейдер
+// (gMinDist, gMaxDist, gMinTess, gMaxTess, CalcTessFactor, EdgeScale, ConstantHS) - при их
+// изменении в шейдере менять и здесь.
+struct TerrainTessellation
+{
+    static constexpr float MinDistance = 500.0f;    // gMinDist: ближе - максимальная детализация
+    static constexpr float MaxDistance = 2500.0f;   // gMaxDist: дальше - минимальная
+    static constexpr float MinTess = 1.0f;          // gMinTess, степень двойки
+    static constexpr float MaxTess = 6.0f;          // gMaxTess, степень двойки
+    static constexpr float MaxFactor = 64.0f;       // [maxtessfactor(64.0f)]
+};
+
+// Факторы патча, как их возвращает ConstantHS. Рёбра в порядке SV_TessFactor:
+// 0 - u = 0 (точки 0-2), 1 - v = 0 (0-1), 2 - u = 1 (1-3), 3 - v = 1 (2-3); оба внутренних равны.
+struct PatchTessFactors
+{
+    float Edge[4];
+    float Inside;
+};
+
+// CalcTessFactor: 2^lerp(MaxTess, MinTess, s) по расстоянию от глаза до точки, не меньше 1
+float CalcTessFactor(const DirectX::XMFLOAT3& point, const DirectX::XMFLOAT3& eye);
+
+// ConstantHS для патча с контрольными точками corners в порядке индексного буфера
+// ((x0, z0), (x1, z0), (x0, z1), (x1, z1)). Вершинный шейдер оставляет y = 0, так что и здесь
+// точки патча берутся на нулевой высоте. basePatchSize - gBasePatchSize.
+PatchTessFactors ComputePatchTessFactors(const DirectX::XMFLOAT3 corners[4], const DirectX::XMFLOAT3& eye,
+                                         float basePatchSize);
+
+// fractional_even: фактор ограничивается [2, MaxFactor] и округляется вверх до чётного числа отрезков
+uint32_t FractionalEvenSegments(float factor);
+
+// Треугольники, которые тесселятор выдаёт для четырёхугольного патча с такими факторами:
+// регулярная внутренняя сетка из (N - 2)^2 ячеек и по кольцевой полосе у каждого ребра
+// (Ne + N - 2 треугольника), N и Ne - отрезки FractionalEvenSegments
+uint32_t CountPatchTriangles(const PatchTessFactors& factors);
+
+// Сумма CountPatchTriangles по сетке patchesPerEdge x patchesPerEdge патчей квадрата со стороной size
+// и углом origin (XZ), углы патчей - как в vs.hlsl. Считается на SSE, см. TerrainTrianglePredictor.
+uint32_t PredictPatchGridTriangles(const DirectX::XMFLOAT2& origin, float size, uint32_t patchesPerEdge,
+                                   const DirectX::XMFLOAT3& eye, float basePatchSize);
+
+// Прогноз нагрузки на тесселятор по экземплярам TerrainInstanceBuilder: факторы ConstantHS считаются
+// для каждого отправленного патча (GPU тесселирует и те, что потом отсекаются), по 4 патча строки
+// за раз на SSE. Суммы по экземплярам, узлам QuadTree и кадру.
+//
+// exp2 на SSE - полином с относительной ошибкой ~1e-7, поэтому фактор, попавший почти точно на
+// чётное число, изредка округляется не так, как в скалярной ComputePatchTessFactors.
+class TerrainTrianglePredictor
+{
+public:
+    static const uint32_t InstancesPerTask = 32;
+
+    TerrainTrianglePredictor();
+
+    // eye - gEyePosW, basePatchSize - gBasePatchSize. pool == nullptr - всё в вызывающем потоке.
+    void Predict(const TerrainInstanceBuilder& instances, const DirectX::XMFLOAT3& eye, float basePatchSize,
+                 WorkStealingPool* pool = nullptr);
+
+    // По экземплярам в порядке GetInstances и по узлам в порядке списка nodes последнего Build
+    const std::vector<uint32_t>& GetInstanceTriangles() const { return mInstanceTriangles; }
+    const std::vector<uint32_t>& GetNodeTriangles() const { return mNodeTriangles; }
+
+    uint64_t GetTotalTriangles() const { return mTotalTriangles; }
+    uint32_t GetPatchCount() const { return mPatchCount; }
+
+private:
+    std::vector<uint32_t> mInstanceTriangles;
+    std::vector<uint32_t> mNodeTriangles;
+    uint64_t mTotalTriangles;
+    uint32_t mPatchCount;
+};
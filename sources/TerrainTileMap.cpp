@@ -0,0 +1,75 @@
+#include "TerrainTileMap.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+TerrainTileMap::TerrainTileMap()
+    : mTileSize(1.0f), mTilesX(1), mTilesY(1)
+{
+}
+
+void TerrainTileMap::Configure(float tileSize, int tilesX, int tilesY)
+{
+    mTileSize = tileSize;
+    mTilesX = tilesX;
+    mTilesY = tilesY;
+
+    size_t tileCount = (size_t)tilesX * tilesY;
+    mVisibleBits.assign((tileCount + 63) / 64, 0);
+    mFinestLOD.assign(tileCount, LODLevel::LOD3);
+    mVisibleTiles.clear();
+}
+
+void TerrainTileMap::Map(const QuadTree& tree, const std::vector<QuadTreeRenderNode>& nodes)
+{
+    std::fill(mVisibleBits.begin(), mVisibleBits.end(), 0ull);
+    mVisibleTiles.clear();
+
+    for (const QuadTreeRenderNode& node : nodes)
+    {
+        BoundingBox bounds = tree.GetNodeBounds(node.NodeIndex);
+
+        float nodeMinX = bounds.Center.x - bounds.Extents.x;
+        float nodeMinZ = bounds.Center.z - bounds.Extents.z;
+        float nodeMaxX = bounds.Center.x + bounds.Extents.x;
+        float nodeMaxZ = bounds.Center.z + bounds.Extents.z;
+
+        int tileMinX = std::max((int)floorf(nodeMinX / mTileSize), 0);
+        int tileMinY = std::max((int)floorf(nodeMinZ / mTileSize), 0);
+        int tileMaxX = std::min((int)ceilf(nodeMaxX / mTileSize) - 1, mTilesX - 1);
+        int tileMaxY = std::min((int)ceilf(nodeMaxZ / mTileSize) - 1, mTilesY - 1);
+
+        for (int tileY = tileMinY; tileY <= tileMaxY; tileY++)
+        {
+            for (int tileX = tileMinX; tileX <= tileMaxX; tileX++)
+            {
+                size_t tile = (size_t)tileY * mTilesX + tileX;
+                uint64_t bit = 1ull << (tile & 63);
+
+                if (!(mVisibleBits[tile >> 6] & bit))
+                {
+                    mVisibleBits[tile >> 6] |= bit;
+                    mFinestLOD[tile] = node.LOD;
+                }
+                else if (node.LOD < mFinestLOD[tile])
+                {
+                    mFinestLOD[tile] = node.LOD;
+                }
+            }
+        }
+    }
+
+    // Видимые тайлы в порядке индексов
+    for (size_t word = 0; word < mVisibleBits.size(); word++)
+    {
+        uint64_t bits = mVisibleBits[word];
+        for (uint32_t i = 0; bits != 0; i++, bits >>= 1)
+        {
+            if (bits & 1)
+            {
+                mVisibleTiles.push_back((uint32_t)(word * 64 + i));
+            }
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "QuadTree.h"
+#include <vector>
+#include <cstdint>
+
+// Тайлы под видимыми узлами Quadtree.
+// Тайлы образуют регулярную сетку tilesX x tilesY, поэтому тайлы под узлом следуют прямо из его
+// XZ границ; дубликаты убирает битовое множество по индексам тайлов. Стоимость O(узлы + тайлы).
+// Не зависит от графического API.
+class TerrainTileMap
+{
+public:
+    TerrainTileMap();
+
+    void Configure(float tileSize, int tilesX, int tilesY);
+
+    // Диапазоны полуоткрытые: узел, лишь касающийся края тайла, соседа не захватывает
+    void Map(const QuadTree& tree, const std::vector<QuadTreeRenderNode>& nodes);
+
+    // Видимые тайлы (tileY * tilesX + tileX) по возрастанию индекса
+    const std::vector<uint32_t>& GetVisibleTiles() const { return mVisibleTiles; }
+
+    // Самый детальный LOD узлов, покрывающих тайл в последнем Map; только для видимых тайлов
+    LODLevel GetFinestLOD(uint32_t tile) const { return mFinestLOD[tile]; }
+
+private:
+    float mTileSize;
+    int mTilesX;
+    int mTilesY;
+
+    std::vector<uint64_t> mVisibleBits;   // Бит на тайл, заново на каждый Map
+    std::vector<LODLevel> mFinestLOD;
+    std::vector<uint32_t> mVisibleTiles;
+};
@@ -0,0 +1,57 @@
+#include "TerrainVertexFormat.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    uint16_t EncodeFixed(float value)
+    {
+        float clamped = std::max(0.0f, std::min(value, 1.0f));
+        return (uint16_t)lroundf(clamped * TerrainVertexFixedOne);
+    }
+
+    float DecodeFixed(uint16_t value)
+    {
+        // Деление на степень двойки точное - как и в шейдере
+        return (float)value * (1.0f / TerrainVertexFixedOne);
+    }
+}
+
+TerrainVertexCompact EncodeTerrainVertex(const TerrainVertex& vertex)
+{
+    TerrainVertexCompact compact;
+    compact.X = EncodeFixed(vertex.GridPos.x);
+    compact.Z = EncodeFixed(vertex.GridPos.y);
+    return compact;
+}
+
+TerrainVertex DecodeTerrainVertex(const TerrainVertexCompact& vertex)
+{
+    TerrainVertex decoded;
+    decoded.GridPos = XMFLOAT2(DecodeFixed(vertex.X), DecodeFixed(vertex.Z));
+    return decoded;
+}
+
+bool IsTerrainVertexRoundTripExact(uint32_t gridResolution)
+{
+    if (gridResolution == 0 || gridResolution > TerrainVertexFixedOne)
+    {
+        return false;
+    }
+
+    // Узлы сетки одинаковы по обеим осям - достаточно проверить одну строку
+    for (uint32_t k = 0; k <= gridResolution; k++)
+    {
+        TerrainVertex vertex;
+        vertex.GridPos = XMFLOAT2((float)k / gridResolution, (float)k / gridResolution);
+
+        TerrainVertex decoded = DecodeTerrainVertex(EncodeTerrainVertex(vertex));
+        if (decoded.GridPos.x != vertex.GridPos.x || decoded.GridPos.y != vertex.GridPos.y)
+        {
+            return false;
+        }
+    }
+    return true;
+}
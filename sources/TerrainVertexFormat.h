@@ -0,0 +1,32 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+
+// Вершина общей единичной сетки патчей (8 байт). Мировая позиция и текстурные
+// координаты восстанавливаются из данных экземпляра, поэтому в вершине только узел сетки.
+struct TerrainVertex
+{
+    DirectX::XMFLOAT2 GridPos;   // (0,0)..(1,1) по экземпляру
+};
+
+// Компактная вершина (4 байта, DXGI_FORMAT_R16G16_UINT): координаты сетки
+// в фиксированной точке 1.15, TerrainVertexFixedOne соответствует 1.0.
+// Для сеток со стороной - степенью двойки до 32768 ячеек кодирование точное.
+struct TerrainVertexCompact
+{
+    uint16_t X;
+    uint16_t Z;
+};
+
+static const uint32_t TerrainVertexFixedOne = 32768;
+
+// Координаты вне [0, 1] зажимаются
+TerrainVertexCompact EncodeTerrainVertex(const TerrainVertex& vertex);
+
+// То же преобразование, что в вершинном шейдере с COMPACT_VERTEX
+TerrainVertex DecodeTerrainVertex(const TerrainVertexCompact& vertex);
+
+// Проверка кодирования: все узлы сетки gridResolution x gridResolution ячеек
+// после кодирования и декодирования должны совпасть бит в бит
+bool IsTerrainVertexRoundTripExact(uint32_t gridResolution);
@@ -0,0 +1,316 @@
+#include "TextureStreamer.h"
+#include <algorithm>
+
+namespace
+{
+    // Готовых тайлов, ожидающих главный поток; рабочие ждут, если очередь заполнена
+    const size_t CompletedQueueCapacity = 64;
+}
+
+TextureStreamer::TextureStreamer()
+    : mMemoryBudget(0), mTailResolution(1), mFrame(0), mStop(false), mCompleted(CompletedQueueCapacity)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    Shutdown();
+}
+
+void TextureStreamer::Initialize(const std::vector<std::string>& tilePaths, uint64_t memoryBudget,
+                                 uint32_t tailResolution, uint32_t threadCount)
+{
+    Shutdown();
+
+    mTilePaths = tilePaths;
+    mTiles.assign(tilePaths.size(), TileRecord());
+    mInFlight.assign(tilePaths.size(), 0);
+    mMemoryBudget = memoryBudget;
+    mTailResolution = std::max(tailResolution, 1u);
+    mFrame = 0;
+    mStats = TextureStreamerStats();
+    mQueue.clear();
+    mStop = false;
+
+    // Чтение упирается в диск, а не в процессор - половины потоков хватает
+    if (threadCount == 0)
+    {
+        threadCount = std::max(std::thread::hardware_concurrency() / 2, 1u);
+    }
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        mWorkers.emplace_back(&TextureStreamer::WorkerLoop, this);
+    }
+}
+
+void TextureStreamer::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        mStop = true;
+        mQueue.clear();
+    }
+    mQueueCondition.notify_all();
+
+    for (std::thread& worker : mWorkers)
+    {
+        worker.join();
+    }
+    mWorkers.clear();
+
+    // Готовые, но не загруженные тайлы
+    TextureTileData* data = nullptr;
+    while (mCompleted.TryPop(data))
+    {
+        delete data;
+    }
+}
+
+bool TextureStreamer::QueueEntryLater(const QueueEntry& a, const QueueEntry& b)
+{
+    if (a.Refine != b.Refine)
+    {
+        return a.Refine;
+    }
+    return a.Priority > b.Priority;
+}
+
+void TextureStreamer::Update(const std::vector<TextureRequest>& requests)
+{
+    mFrame++;
+
+    std::lock_guard<std::mutex> lock(mQueueMutex);
+
+    // Очередь строится заново: приоритеты и нужные разрешения меняются каждый кадр вместе с камерой
+    mQueue.clear();
+    for (const TextureRequest& request : requests)
+    {
+        if (request.Tile >= mTiles.size())
+        {
+            continue;
+        }
+
+        TileRecord& tile = mTiles[request.Tile];
+        tile.LastRequestFrame = mFrame;
+        if (tile.Failed || mInFlight[request.Tile])
+        {
+            continue;
+        }
+
+        // Сначала хвост цепочки мипов, потом сразу нужное разрешение
+        uint32_t resolution = mTailResolution;
+        if (tile.ResidentResolution != 0)
+        {
+            resolution = std::max(request.Resolution, mTailResolution);
+            if (tile.MaxResolution != 0)
+            {
+                resolution = std::min(resolution, tile.MaxResolution);
+            }
+        }
+
+        if (resolution > tile.ResidentResolution)
+        {
+            tile.PendingResolution = resolution;
+            mQueue.push_back({ tile.ResidentResolution != 0, request.Priority, request.Tile, resolution });
+        }
+        else
+        {
+            tile.PendingResolution = 0;
+        }
+    }
+
+    std::make_heap(mQueue.begin(), mQueue.end(), QueueEntryLater);
+
+    // Тайлы из старой очереди, которые больше никто не запросил, отменяются.
+    // Прочитанные и читаемые тайлы доводятся до конца - чтение уже оплачено.
+    uint32_t pending = 0;
+    for (size_t i = 0; i < mTiles.size(); i++)
+    {
+        TileRecord& tile = mTiles[i];
+        if (tile.PendingResolution != 0 && tile.LastRequestFrame != mFrame && !mInFlight[i])
+        {
+            tile.PendingResolution = 0;
+        }
+        if (tile.PendingResolution != 0)
+        {
+            pending++;
+        }
+    }
+    mStats.PendingTiles = pending;
+
+    if (!mQueue.empty())
+    {
+        mQueueCondition.notify_all();
+    }
+}
+
+uint32_t TextureStreamer::ProcessCompletions(ITextureUploader& uploader, uint32_t maxUploads)
+{
+    uint32_t uploaded = 0;
+    TextureTileData* data = nullptr;
+    while (uploaded < maxUploads && mCompleted.TryPop(data))
+    {
+        TileRecord& tile = mTiles[data->Tile];
+        {
+            std::lock_guard<std::mutex> lock(mQueueMutex);
+            mInFlight[data->Tile] = 0;
+        }
+        tile.PendingResolution = 0;
+
+        if (data->Failed)
+        {
+            // Уже резидентный тайл остаётся с тем, что есть, и до выгрузки больше не уточняется
+            if (tile.ResidentResolution == 0)
+            {
+                tile.Failed = true;
+            }
+            else
+            {
+                tile.MaxResolution = tile.ResidentResolution;
+            }
+            mStats.FailedTiles++;
+            delete data;
+            continue;
+        }
+
+        const DdsMipInfo& firstMip = data->Layout.Mips[data->FirstMip];
+        uint32_t resolution = std::max(firstMip.Width, firstMip.Height);
+        tile.MaxResolution = std::max(data->Layout.Width, data->Layout.Height);
+        if (resolution <= tile.ResidentResolution)
+        {
+            mStats.DiscardedTiles++;
+            delete data;
+            continue;
+        }
+
+        size_t bytes = uploader.Upload(*data);
+        if (bytes == 0)
+        {
+            if (tile.ResidentResolution == 0)
+            {
+                tile.Failed = true;
+            }
+            else
+            {
+                tile.MaxResolution = tile.ResidentResolution;
+            }
+            mStats.FailedTiles++;
+        }
+        else
+        {
+            if (tile.ResidentResolution != 0)
+            {
+                mStats.ResidentBytes -= tile.ResidentBytes;
+                mStats.RefinedTiles++;
+            }
+            else
+            {
+                mStats.ResidentTiles++;
+            }
+            tile.ResidentResolution = resolution;
+            tile.ResidentBytes = bytes;
+            mStats.ResidentBytes += bytes;
+            mStats.LoadedTiles++;
+            mStats.BytesRead += GetDdsMipChainSize(data->Layout, data->FirstMip);
+            uploaded++;
+        }
+
+        delete data;
+    }
+
+    EnforceBudget(uploader);
+    return uploaded;
+}
+
+void TextureStreamer::EnforceBudget(ITextureUploader& uploader)
+{
+    if (mStats.ResidentBytes <= mMemoryBudget)
+    {
+        return;
+    }
+
+    // Кандидаты - резидентные тайлы, не запрошенные в этом кадре, от давно не нужных к недавним.
+    // Видимые тайлы не выгружаются, даже если бюджет превышен.
+    std::vector<uint32_t> candidates;
+    for (uint32_t i = 0; i < mTiles.size(); i++)
+    {
+        if (mTiles[i].ResidentResolution != 0 && mTiles[i].LastRequestFrame != mFrame)
+        {
+            candidates.push_back(i);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b)
+    {
+        return mTiles[a].LastRequestFrame < mTiles[b].LastRequestFrame;
+    });
+
+    for (uint32_t index : candidates)
+    {
+        if (mStats.ResidentBytes <= mMemoryBudget)
+        {
+            break;
+        }
+
+        TileRecord& tile = mTiles[index];
+        uploader.Evict(index);
+        mStats.ResidentBytes -= tile.ResidentBytes;
+        mStats.ResidentTiles--;
+        mStats.EvictedTiles++;
+        tile.ResidentBytes = 0;
+        tile.ResidentResolution = 0;
+    }
+}
+
+void TextureStreamer::WorkerLoop()
+{
+    for (;;)
+    {
+        uint32_t tileIndex = 0;
+        uint32_t resolution = 0;
+        {
+            std::unique_lock<std::mutex> lock(mQueueMutex);
+            mQueueCondition.wait(lock, [this] { return mStop || !mQueue.empty(); });
+            if (mStop)
+            {
+                return;
+            }
+
+            std::pop_heap(mQueue.begin(), mQueue.end(), QueueEntryLater);
+            tileIndex = mQueue.back().Tile;
+            resolution = mQueue.back().Resolution;
+            mQueue.pop_back();
+            mInFlight[tileIndex] = 1;
+        }
+
+        TextureTileData* data = new TextureTileData();
+        data->Tile = tileIndex;
+        data->Failed = !MapTile(mTilePaths[tileIndex], resolution, *data);
+
+        // Главный поток разбирает очередь раз в кадр - пока она полна, ждём.
+        // Отметку mInFlight снимает главный поток, забрав тайл из очереди готовых.
+        while (!mCompleted.TryPush(data))
+        {
+            {
+                std::lock_guard<std::mutex> lock(mQueueMutex);
+                if (mStop)
+                {
+                    delete data;
+                    return;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool TextureStreamer::MapTile(const std::string& path, uint32_t resolution, TextureTileData& data)
+{
+    // Без копии в кучу: загрузчик берёт мипы прямо из отображения, и с диска
+    // читаются только страницы выбранных мипов
+    if (!data.File.Open(path) || !ParseDdsLayout(data.File.GetData(), data.File.GetSize(), data.Layout))
+    {
+        return false;
+    }
+    data.FirstMip = SelectDdsFirstMip(data.Layout, resolution);
+    return true;
+}
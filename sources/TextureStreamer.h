@@ -0,0 +1,156 @@
+#pragma once
+
+#include "MpmcQueue.h"
+#include "MappedFile.h"
+#include "DdsFile.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+// Запрос тайла на текущий кадр: чем меньше Priority, тем раньше тайл будет загружен.
+// Resolution - сколько текселей на ребро тайла нужно на экране; загружается самый грубый мип,
+// которого для этого хватает.
+struct TextureRequest
+{
+    uint32_t Tile;
+    float Priority;
+    uint32_t Resolution;
+};
+
+// Отображённый в память и проверенный DDS файл тайла: мипы читаются прямо из отображения,
+// и с диска подгружаются только страницы мипов FirstMip и грубее
+struct TextureTileData
+{
+    uint32_t Tile;
+    uint32_t FirstMip;
+    MappedFile File;
+    DdsLayout Layout;
+    bool Failed;
+};
+
+// Сторона графического API. Методы вызываются только из потока, вызывающего ProcessCompletions.
+class ITextureUploader
+{
+public:
+    virtual ~ITextureUploader() {}
+
+    // Создаёт ресурс тайла из мипов FirstMip и грубее, заменяя прежний, если он был.
+    // Возвращает занятую им память в байтах; 0 - создать не удалось.
+    virtual size_t Upload(const TextureTileData& data) = 0;
+
+    // Освобождает ресурс тайла - до следующей загрузки он рисуется заглушкой
+    virtual void Evict(uint32_t tile) = 0;
+};
+
+// Загрузчик без GPU: тайл "занимает" столько, сколько весят его мипы.
+// Позволяет гонять планировщик и очереди без графического API.
+class NullTextureUploader : public ITextureUploader
+{
+public:
+    size_t Upload(const TextureTileData& data) override { return (size_t)GetDdsMipChainSize(data.Layout, data.FirstMip); }
+    void Evict(uint32_t) override {}
+};
+
+struct TextureStreamerStats
+{
+    uint32_t ResidentTiles = 0;
+    uint32_t PendingTiles = 0;       // В очереди, в работе или ждут загрузки в GPU
+    uint64_t ResidentBytes = 0;
+    uint64_t LoadedTiles = 0;        // Счётчики за всё время
+    uint64_t RefinedTiles = 0;       // Из них - замены резидентного тайла более детальным
+    uint64_t BytesRead = 0;          // Байты мипов, прочитанные из файлов
+    uint64_t EvictedTiles = 0;
+    uint64_t FailedTiles = 0;
+    uint64_t DiscardedTiles = 0;     // Прочитаны, но к моменту загрузки уже не нужны
+};
+
+// Фоновая подгрузка текстур тайлов.
+// Главный поток каждый кадр передаёт запросы видимых тайлов (Update), рабочие потоки
+// отображают и проверяют DDS файлы в порядке приоритета, готовые тайлы возвращаются через
+// lock-free очередь и передаются загрузчику в ProcessCompletions. Тайлы сверх бюджета
+// памяти выгружаются, начиная с давно не запрошенных. Графический API сюда не входит.
+//
+// Загрузка прогрессивная: новый тайл сначала получает хвост цепочки мипов (не больше
+// tailResolution текселей на ребро), и только потом, по мере приближения камеры, -
+// мипы до запрошенного разрешения. Хвосты всех тайлов идут в очереди раньше уточнений.
+// Неудачная первая загрузка исключает тайл навсегда, неудачное уточнение оставляет
+// резидентные мипы и не повторяется, пока тайл не выгрузят.
+class TextureStreamer
+{
+public:
+    TextureStreamer();
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // tilePaths - DDS файл каждого тайла, memoryBudget - байты резидентных тайлов,
+    // tailResolution - ребро первого (грубого) мипа при первой загрузке тайла,
+    // threadCount - рабочие потоки (0 - половина аппаратных, минимум один)
+    void Initialize(const std::vector<std::string>& tilePaths, uint64_t memoryBudget,
+                    uint32_t tailResolution, uint32_t threadCount = 0);
+    void Shutdown();
+
+    // Запросы кадра. Незагруженные и недостаточно детальные тайлы встают в очередь, очередь
+    // пересортировывается по новым приоритетам; тайлы, которые перестали быть нужны
+    // до начала чтения, из неё уходят.
+    void Update(const std::vector<TextureRequest>& requests);
+
+    // Передаёт загрузчику не больше maxUploads готовых тайлов и выгружает лишнее сверх бюджета.
+    // Возвращает число загруженных тайлов.
+    uint32_t ProcessCompletions(ITextureUploader& uploader, uint32_t maxUploads);
+
+    bool IsResident(uint32_t tile) const { return mTiles[tile].ResidentResolution != 0; }
+    uint32_t GetResidentResolution(uint32_t tile) const { return mTiles[tile].ResidentResolution; }
+    uint32_t GetTileCount() const { return (uint32_t)mTiles.size(); }
+    const TextureStreamerStats& GetStats() const { return mStats; }
+
+private:
+    struct TileRecord
+    {
+        uint32_t ResidentResolution = 0;   // Ребро старшего резидентного мипа, 0 - не загружен
+        uint32_t PendingResolution = 0;    // В очереди, читается или ждёт в очереди готовых
+        uint32_t MaxResolution = 0;        // Ребро мипа 0, известно после первой загрузки;
+                                           // после неудачного уточнения - резидентное ребро
+        uint64_t LastRequestFrame = 0;
+        uint64_t ResidentBytes = 0;
+        bool Failed = false;
+    };
+
+    struct QueueEntry
+    {
+        bool Refine;                       // Уточнение резидентного тайла - после всех хвостов
+        float Priority;
+        uint32_t Tile;
+        uint32_t Resolution;
+    };
+
+    void WorkerLoop();
+    void EnforceBudget(ITextureUploader& uploader);
+
+    // Порядок кучи: a уходит позже b
+    static bool QueueEntryLater(const QueueEntry& a, const QueueEntry& b);
+
+    // Отображает файл, проверяет заголовки DDS на месте и выбирает первый мип
+    static bool MapTile(const std::string& path, uint32_t resolution, TextureTileData& data);
+
+    std::vector<std::string> mTilePaths;
+    std::vector<TileRecord> mTiles;        // Только главный поток
+    uint64_t mMemoryBudget;
+    uint32_t mTailResolution;
+    uint64_t mFrame;
+    TextureStreamerStats mStats;
+
+    // Очередь запросов - двоичная куча по приоритету под мьютексом
+    std::mutex mQueueMutex;
+    std::condition_variable mQueueCondition;
+    std::vector<QueueEntry> mQueue;
+    std::vector<uint8_t> mInFlight;        // Тайлы у рабочих или в очереди готовых; под mQueueMutex
+    bool mStop;
+
+    MpmcQueue<TextureTileData*> mCompleted;
+    std::vector<std::thread> mWorkers;
+};
@@ -0,0 +1,205 @@
+#include "TiffReader.h"
+#include <algorithm>
+
+namespace
+{
+    const uint16_t TagImageWidth = 256;
+    const uint16_t TagImageLength = 257;
+    const uint16_t TagBitsPerSample = 258;
+    const uint16_t TagCompression = 259;
+    const uint16_t TagStripOffsets = 273;
+    const uint16_t TagSamplesPerPixel = 277;
+    const uint16_t TagRowsPerStrip = 278;
+    const uint16_t TagStripByteCounts = 279;
+    const uint16_t TypeShort = 3;
+    const uint16_t TypeLong = 4;
+
+    uint16_t ReadU16(const uint8_t* p, bool littleEndian)
+    {
+        return littleEndian ? (uint16_t)(p[0] | (p[1] << 8)) : (uint16_t)((p[0] << 8) | p[1]);
+    }
+
+    uint32_t ReadU32(const uint8_t* p, bool littleEndian)
+    {
+        return littleEndian ? (uint32_t)(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24))
+                            : (uint32_t)(((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+    }
+
+    bool IsHostLittleEndian()
+    {
+        const uint16_t probe = 1;
+        return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+    }
+
+    // Массив SHORT или LONG значений тега: до 4 байт лежат прямо в записи, иначе - по смещению
+    bool ReadTagArray(std::ifstream& file, const uint8_t* entry, bool littleEndian, std::vector<uint32_t>& values)
+    {
+        uint16_t type = ReadU16(entry + 2, littleEndian);
+        uint32_t count = ReadU32(entry + 4, littleEndian);
+        if ((type != TypeShort && type != TypeLong) || count == 0 || count > (1u << 24))
+        {
+            return false;
+        }
+
+        uint32_t elementSize = type == TypeShort ? 2 : 4;
+        std::vector<uint8_t> raw((size_t)count * elementSize);
+        if (raw.size() <= 4)
+        {
+            std::copy(entry + 8, entry + 8 + raw.size(), raw.begin());
+        }
+        else
+        {
+            file.seekg(ReadU32(entry + 8, littleEndian));
+            if (!file.read(reinterpret_cast<char*>(raw.data()), (std::streamsize)raw.size()))
+            {
+                return false;
+            }
+        }
+
+        values.resize(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            values[i] = type == TypeShort ? ReadU16(&raw[i * 2], littleEndian) : ReadU32(&raw[i * 4], littleEndian);
+        }
+        return true;
+    }
+}
+
+TiffStripReader::TiffStripReader()
+    : mLittleEndian(true), mWidth(0), mHeight(0), mRowsPerStrip(0)
+{
+}
+
+bool TiffStripReader::Open(const std::string& path)
+{
+    Close();
+
+    mFile.open(path, std::ios::binary);
+    uint8_t header[8];
+    if (!mFile || !mFile.read(reinterpret_cast<char*>(header), sizeof(header)))
+    {
+        Close();
+        return false;
+    }
+
+    mLittleEndian = header[0] == 'I' && header[1] == 'I';
+    if ((!mLittleEndian && !(header[0] == 'M' && header[1] == 'M')) || ReadU16(header + 2, mLittleEndian) != 42)
+    {
+        Close();
+        return false;
+    }
+
+    // Gaea пишет IFD после данных - читаем только его, а не файл целиком
+    uint8_t countBytes[2];
+    mFile.seekg(ReadU32(header + 4, mLittleEndian));
+    if (!mFile.read(reinterpret_cast<char*>(countBytes), sizeof(countBytes)))
+    {
+        Close();
+        return false;
+    }
+
+    std::vector<uint8_t> entries((size_t)ReadU16(countBytes, mLittleEndian) * 12);
+    if (!mFile.read(reinterpret_cast<char*>(entries.data()), (std::streamsize)entries.size()))
+    {
+        Close();
+        return false;
+    }
+
+    uint32_t bitsPerSample = 0, compression = 1, samplesPerPixel = 1;
+    bool valid = true;
+    for (size_t offset = 0; offset < entries.size() && valid; offset += 12)
+    {
+        const uint8_t* entry = &entries[offset];
+        uint16_t type = ReadU16(entry + 2, mLittleEndian);
+        uint32_t value = (type == TypeShort) ? ReadU16(entry + 8, mLittleEndian) : ReadU32(entry + 8, mLittleEndian);
+
+        switch (ReadU16(entry, mLittleEndian))
+        {
+        case TagImageWidth: mWidth = value; break;
+        case TagImageLength: mHeight = value; break;
+        case TagBitsPerSample: bitsPerSample = value; break;
+        case TagCompression: compression = value; break;
+        case TagSamplesPerPixel: samplesPerPixel = value; break;
+        case TagRowsPerStrip: mRowsPerStrip = value; break;
+        case TagStripOffsets: valid = ReadTagArray(mFile, entry, mLittleEndian, mStripOffsets); break;
+        case TagStripByteCounts: valid = ReadTagArray(mFile, entry, mLittleEndian, mStripByteCounts); break;
+        }
+    }
+
+    if (!valid || mWidth == 0 || mHeight == 0 || bitsPerSample != 16 || compression != 1 || samplesPerPixel != 1 ||
+        mStripOffsets.empty())
+    {
+        Close();
+        return false;
+    }
+    if (mRowsPerStrip == 0 || mRowsPerStrip > mHeight)
+    {
+        mRowsPerStrip = mHeight;
+    }
+
+    // Полосы должны покрывать всё изображение
+    uint64_t stripCount = ((uint64_t)mHeight + mRowsPerStrip - 1) / mRowsPerStrip;
+    if (mStripOffsets.size() < stripCount || (!mStripByteCounts.empty() && mStripByteCounts.size() < stripCount))
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void TiffStripReader::Close()
+{
+    if (mFile.is_open())
+    {
+        mFile.close();
+    }
+    mFile.clear();
+    mWidth = 0;
+    mHeight = 0;
+    mRowsPerStrip = 0;
+    mStripOffsets.clear();
+    mStripByteCounts.clear();
+}
+
+bool TiffStripReader::ReadRows(uint32_t firstRow, uint32_t rowCount, uint16_t* samples)
+{
+    if (!mFile.is_open() || firstRow + rowCount > mHeight || firstRow + rowCount < firstRow)
+    {
+        return false;
+    }
+
+    const size_t rowBytes = (size_t)mWidth * 2;
+    uint32_t row = firstRow;
+    const uint32_t endRow = firstRow + rowCount;
+    while (row < endRow)
+    {
+        // Часть полосы, попадающая в запрошенные строки, читается одним вызовом
+        uint32_t strip = row / mRowsPerStrip;
+        uint32_t rowInStrip = row - strip * mRowsPerStrip;
+        uint32_t rows = std::min(mRowsPerStrip - rowInStrip, endRow - row);
+        if (!mStripByteCounts.empty() && (uint64_t)(rowInStrip + rows) * rowBytes > mStripByteCounts[strip])
+        {
+            return false;
+        }
+
+        uint8_t* destination = reinterpret_cast<uint8_t*>(samples + (size_t)(row - firstRow) * mWidth);
+        mFile.seekg((std::streamoff)mStripOffsets[strip] + (std::streamoff)rowInStrip * (std::streamoff)rowBytes);
+        if (!mFile.read(reinterpret_cast<char*>(destination), (std::streamsize)(rows * rowBytes)))
+        {
+            mFile.clear();
+            return false;
+        }
+        row += rows;
+    }
+
+    // Порядок байт файла отличается от процессорного - переставляем на месте
+    if (mLittleEndian != IsHostLittleEndian())
+    {
+        uint16_t* value = samples;
+        for (size_t i = 0; i < (size_t)rowCount * mWidth; i++, value++)
+        {
+            *value = (uint16_t)((*value << 8) | (*value >> 8));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+
+// Потоковое чтение несжатого 16-битного одноканального TIFF - формата экспорта высот Gaea
+// (полосы без сжатия, IFD обычно в конце файла). Open читает только заголовок и IFD,
+// строки затем читаются порциями прямо в память вызывающего, без копии всего файла.
+class TiffStripReader
+{
+public:
+    TiffStripReader();
+
+    // false - не TIFF, не 16 бит / не один канал, сжатие или повреждённые таблицы полос
+    bool Open(const std::string& path);
+    void Close();
+
+    uint32_t GetWidth() const { return mWidth; }
+    uint32_t GetHeight() const { return mHeight; }
+
+    // Строки [firstRow, firstRow + rowCount) в samples (width * rowCount значений, 0..65535),
+    // в порядке байт процессора
+    bool ReadRows(uint32_t firstRow, uint32_t rowCount, uint16_t* samples);
+
+private:
+    std::ifstream mFile;
+    bool mLittleEndian;
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mRowsPerStrip;
+    std::vector<uint32_t> mStripOffsets;
+    std::vector<uint32_t> mStripByteCounts;
+};
@@ -0,0 +1,150 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(uint32_t threadCount)
+    : mTask(nullptr), mGeneration(0), mBusyWorkers(0), mStop(false)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        mQueues.push_back(std::make_unique<TaskQueue>());
+    }
+
+    // Поток 0 - вызывающий, рабочих на один меньше
+    for (uint32_t i = 1; i < threadCount; i++)
+    {
+        mThreads.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mWakeCondition.notify_all();
+
+    for (std::thread& thread : mThreads)
+    {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::Run(uint32_t taskCount, const std::function<void(uint32_t, uint32_t)>& task)
+{
+    if (taskCount == 0)
+    {
+        return;
+    }
+
+    uint32_t threadCount = GetThreadCount();
+    if (threadCount == 1 || taskCount == 1)
+    {
+        for (uint32_t i = 0; i < taskCount; i++)
+        {
+            task(i, 0);
+        }
+        return;
+    }
+
+    // Соседние задачи обычно соседние поддеревья - отдаём потокам непрерывные отрезки
+    for (uint32_t thread = 0; thread < threadCount; thread++)
+    {
+        uint32_t first = (uint64_t)taskCount * thread / threadCount;
+        uint32_t last = (uint64_t)taskCount * (thread + 1) / threadCount;
+
+        TaskQueue& queue = *mQueues[thread];
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        for (uint32_t i = first; i < last; i++)
+        {
+            queue.Tasks.push_back(i);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTask = &task;
+        mBusyWorkers = (uint32_t)mThreads.size();
+        mGeneration++;
+    }
+    mWakeCondition.notify_all();
+
+    Execute(0);
+
+    // Функция задачи живёт на стеке вызывающего - ждём, пока её не перестанут использовать
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCondition.wait(lock, [this] { return mBusyWorkers == 0; });
+    mTask = nullptr;
+}
+
+void WorkStealingPool::WorkerLoop(uint32_t thread)
+{
+    uint64_t generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWakeCondition.wait(lock, [&] { return mStop || mGeneration != generation; });
+            if (mStop)
+            {
+                return;
+            }
+            generation = mGeneration;
+        }
+
+        Execute(thread);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (--mBusyWorkers == 0)
+            {
+                mDoneCondition.notify_one();
+            }
+        }
+    }
+}
+
+void WorkStealingPool::Execute(uint32_t thread)
+{
+    // Новые задачи во время Run не появляются: если ни своих, ни чужих не осталось - работа окончена
+    uint32_t task;
+    while (Pop(thread, task) || Steal(thread, task))
+    {
+        (*mTask)(task, thread);
+    }
+}
+
+bool WorkStealingPool::Pop(uint32_t thread, uint32_t& task)
+{
+    TaskQueue& queue = *mQueues[thread];
+    std::lock_guard<std::mutex> lock(queue.Mutex);
+    if (queue.Tasks.empty())
+    {
+        return false;
+    }
+    task = queue.Tasks.front();
+    queue.Tasks.pop_front();
+    return true;
+}
+
+bool WorkStealingPool::Steal(uint32_t thread, uint32_t& task)
+{
+    uint32_t threadCount = GetThreadCount();
+    for (uint32_t i = 1; i < threadCount; i++)
+    {
+        TaskQueue& victim = *mQueues[(thread + i) % threadCount];
+        std::lock_guard<std::mutex> lock(victim.Mutex);
+        if (!victim.Tasks.empty())
+        {
+            task = victim.Tasks.back();
+            victim.Tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
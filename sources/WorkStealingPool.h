@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <cstdint>
+
+// Пул потоков с перехватом задач.
+// Задачи одного Run - номера 0..taskCount-1. Каждый поток получает непрерывный отрезок
+// номеров в свою очередь и берёт задачи с её начала; освободившийся поток забирает задачи
+// с конца чужих очередей. Вызывающий поток работает наравне с рабочими.
+class WorkStealingPool
+{
+public:
+    // threadCount - всего потоков вместе с вызывающим; 0 - по числу аппаратных потоков
+    explicit WorkStealingPool(uint32_t threadCount = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    uint32_t GetThreadCount() const { return (uint32_t)mQueues.size(); }
+
+    // Выполняет task(taskIndex, threadIndex) для всех задач и возвращается, когда все завершены.
+    // threadIndex < GetThreadCount(), у вызывающего потока он равен 0.
+    void Run(uint32_t taskCount, const std::function<void(uint32_t, uint32_t)>& task);
+
+private:
+    struct alignas(64) TaskQueue
+    {
+        std::mutex Mutex;
+        std::deque<uint32_t> Tasks;
+    };
+
+    void WorkerLoop(uint32_t thread);
+    void Execute(uint32_t thread);
+    bool Pop(uint32_t thread, uint32_t& task);
+    bool Steal(uint32_t thread, uint32_t& task);
+
+    std::vector<std::unique_ptr<TaskQueue>> mQueues;   // По очереди на поток, 0 - вызывающий
+    std::vector<std::thread> mThreads;
+
+    std::mutex mMutex;
+    std::condition_variable mWakeCondition;            // Новый Run или остановка
+    std::condition_variable mDoneCondition;            // Все рабочие вышли из Execute
+    const std::function<void(uint32_t, uint32_t)>* mTask;
+    uint64_t mGeneration;                              // Номер текущего Run
+    uint32_t mBusyWorkers;                             // Рабочие, ещё не закончившие текущий Run
+    bool mStop;
+};
@@ -0,0 +1,131 @@
+#include "Bc7Decoder.h"
+#include "MappedFile.h"
+#include "WorkStealingPool.h"
+#include "TestCommon.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+// Декодер BC7: SSE4.1 и AVX2 пути бит в бит совпадают со скалярным на случайных блоках всех
+// режимов (и недопустимых), канальные варианты - с каналом RGBA, декодирование пулом - с
+// последовательным, R канал Terrain/003/Height_Out.dds - с 16-битным TIFF в пределах 8 бит
+
+namespace
+{
+    void CheckSimdLevels()
+    {
+        const Bc7Decoder scalar(SimdLevel::Scalar);
+        const Bc7Decoder levels[] = { Bc7Decoder(SimdLevel::Sse41), Bc7Decoder(SimdLevel::Avx2) };
+        std::printf("supported SIMD level %d\n", (int)GetSupportedSimdLevel());
+
+        TestRandom random(7);
+        int mismatches[2] = { 0, 0 };
+        int channelMismatches = 0;
+        alignas(16) uint8_t block[16];
+        uint8_t expected[64], decoded[64], channel[16];
+        for (int i = 0; i < 300000; i++)
+        {
+            for (int b = 0; b < 16; b++)
+            {
+                block[b] = (uint8_t)random.Next();
+            }
+            // Младший установленный бит задаёт режим 0..7; нулевой байт - недопустимый блок
+            int mode = i % 9;
+            block[0] = mode == 8 ? 0 : (uint8_t)((block[0] | 1u) << mode);
+
+            scalar.DecodeBlock(block, expected, 16);
+            for (int l = 0; l < 2; l++)
+            {
+                levels[l].DecodeBlock(block, decoded, 16);
+                mismatches[l] += std::memcmp(expected, decoded, 64) != 0;
+            }
+
+            uint32_t c = (uint32_t)i & 3;
+            levels[1].DecodeBlockChannel(block, c, channel, 4);
+            for (int p = 0; p < 16; p++)
+            {
+                channelMismatches += channel[p] != expected[p * 4 + c];
+            }
+        }
+        TEST_CHECK_MSG(mismatches[0] == 0, "SSE4.1 (level %d): %d blocks differ", (int)levels[0].GetSimdLevel(), mismatches[0]);
+        TEST_CHECK_MSG(mismatches[1] == 0, "AVX2 (level %d): %d blocks differ", (int)levels[1].GetSimdLevel(), mismatches[1]);
+        TEST_CHECK(channelMismatches == 0);
+
+        // Недопустимый блок декодируется в нули
+        std::memset(block, 0, sizeof(block));
+        scalar.DecodeBlock(block, decoded, 16);
+        bool zero = true;
+        for (uint8_t value : decoded)
+        {
+            zero = zero && value == 0;
+        }
+        TEST_CHECK(zero);
+    }
+
+    void CheckHeightmap()
+    {
+        MappedFile file;
+        DdsLayout layout;
+        TEST_CHECK(file.Open("Terrain/003/Height_Out.dds") && ParseDdsLayout(file.GetData(), file.GetSize(), layout));
+        if (!file.IsOpen())
+        {
+            return;
+        }
+        TEST_CHECK(IsBc7Format(layout.DxgiFormat));
+
+        Bc7Decoder decoder;
+        WorkStealingPool pool(4);
+        std::vector<uint8_t> serial, pooled, channel;
+        for (uint32_t mip = 0; mip < layout.Mips.size(); mip++)
+        {
+            TEST_CHECK(decoder.DecodeMip(layout, file.GetData(), mip, serial));
+            TEST_CHECK(decoder.DecodeMip(layout, file.GetData(), mip, pooled, &pool));
+            TEST_CHECK(decoder.DecodeMipChannel(layout, file.GetData(), mip, 0, channel, &pool));
+            TEST_CHECK(serial.size() == (size_t)layout.Mips[mip].Width * layout.Mips[mip].Height * 4);
+            TEST_CHECK_MSG(serial == pooled, "mip %u", mip);
+            bool same = channel.size() * 4 == serial.size();
+            for (size_t i = 0; same && i < channel.size(); i++)
+            {
+                same = channel[i] == serial[i * 4];
+            }
+            TEST_CHECK_MSG(same, "mip %u channel", mip);
+        }
+        TEST_CHECK(!decoder.DecodeMip(layout, file.GetData(), (uint32_t)layout.Mips.size(), serial));
+        DdsLayout other = layout;
+        other.DxgiFormat = 71;
+        TEST_CHECK(!decoder.DecodeMip(other, file.GetData(), 0, serial));
+
+        // R канал - высота, квантованная в 8 бит
+        std::vector<float> heights;
+        uint32_t width = 0, height = 0;
+        TEST_CHECK(LoadTestHeights(heights, width, height));
+        TEST_CHECK(decoder.DecodeMipChannel(layout, file.GetData(), 0, 0, channel));
+        if (width != layout.Width || height != layout.Height || channel.size() != heights.size())
+        {
+            TEST_CHECK(false);
+            return;
+        }
+        double sum = 0.0;
+        int maxError = 0;
+        for (size_t i = 0; i < channel.size(); i++)
+        {
+            int error = std::abs((int)channel[i] - (int)lroundf(heights[i] * 255.0f));
+            sum += error;
+            maxError = std::max(maxError, error);
+        }
+        double meanError = sum / channel.size();
+        std::printf("height R channel vs TIFF: mean error %.4f, max %d (8-bit units)\n", meanError, maxError);
+        TEST_CHECK(meanError < 0.05);
+        TEST_CHECK(maxError <= 2);
+    }
+}
+
+int main()
+{
+    CheckSimdLevels();
+    CheckHeightmap();
+
+    return TestResult("Bc7DecoderTest");
+}
@@ -0,0 +1,401 @@
+#include "DdsFile.h"
+#include "MappedFile.h"
+#include "TestCommon.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+// Разбор DDS: раскладка мипов DX10 и legacy заголовков, отказ для обрезанных, кубических,
+// объёмных файлов, массивов и неизвестных форматов, выбор первого мипа и чтение мипов в staging
+// с выровненным шагом строк против данных из отображения на тайлах Terrain/001
+
+namespace
+{
+    const uint32_t DDSD_DEPTH = 0x800000;
+    const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDPF_RGB = 0x40;
+    const uint32_t DDPF_LUMINANCE = 0x20000;
+
+    uint32_t FourCC(const char* code)
+    {
+        return (uint32_t)(uint8_t)code[0] | ((uint32_t)(uint8_t)code[1] << 8) |
+               ((uint32_t)(uint8_t)code[2] << 16) | ((uint32_t)(uint8_t)code[3] << 24);
+    }
+
+    void Write32(std::vector<uint8_t>& bytes, size_t offset, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            bytes[offset + i] = (uint8_t)(value >> (8 * i));
+        }
+    }
+
+    // Заголовок DDS; поля пиксельного формата и DX10 заполняет вызывающий
+    struct DdsHeaderDesc
+    {
+        uint32_t Width = 256;
+        uint32_t Height = 256;
+        uint32_t MipCount = 1;
+        uint32_t Flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000;
+        uint32_t Caps2 = 0;
+        uint32_t PixelFlags = DDPF_FOURCC;
+        uint32_t FourCC = 0;
+        uint32_t BitCount = 0;
+        uint32_t Masks[4] = { 0, 0, 0, 0 };
+        bool Dx10 = false;
+        uint32_t DxgiFormat = 0;
+        uint32_t Dimension = 3;
+        uint32_t MiscFlags = 0;
+        uint32_t ArraySize = 1;
+    };
+
+    // Байт мипов по формуле, независимой от разбора: блочные форматы - блоки 4x4
+    uint64_t ExpectedDataSize(uint32_t width, uint32_t height, uint32_t mips, uint32_t bytesPerUnit, bool blocks)
+    {
+        uint64_t size = 0;
+        for (uint32_t mip = 0; mip < mips; mip++)
+        {
+            uint32_t w = std::max(width >> mip, 1u);
+            uint32_t h = std::max(height >> mip, 1u);
+            size += blocks ? (uint64_t)((w + 3) / 4) * ((h + 3) / 4) * bytesPerUnit : (uint64_t)w * h * bytesPerUnit;
+        }
+        return size;
+    }
+
+    std::vector<uint8_t> MakeDds(const DdsHeaderDesc& desc, uint64_t dataSize)
+    {
+        size_t headerSize = 4 + 124 + (desc.Dx10 ? 20 : 0);
+        std::vector<uint8_t> bytes(headerSize + (size_t)dataSize, 0);
+        Write32(bytes, 0, FourCC("DDS "));
+        Write32(bytes, 4, 124);
+        Write32(bytes, 8, desc.Flags);
+        Write32(bytes, 12, desc.Height);
+        Write32(bytes, 16, desc.Width);
+        Write32(bytes, 28, desc.MipCount);
+        Write32(bytes, 76, 32);
+        Write32(bytes, 80, desc.Dx10 ? DDPF_FOURCC : desc.PixelFlags);
+        Write32(bytes, 84, desc.Dx10 ? FourCC("DX10") : desc.FourCC);
+        Write32(bytes, 88, desc.BitCount);
+        for (int i = 0; i < 4; i++)
+        {
+            Write32(bytes, 92 + 4 * i, desc.Masks[i]);
+        }
+        Write32(bytes, 108, 0x1000);
+        Write32(bytes, 112, desc.Caps2);
+        if (desc.Dx10)
+        {
+            Write32(bytes, 128, desc.DxgiFormat);
+            Write32(bytes, 132, desc.Dimension);
+            Write32(bytes, 136, desc.MiscFlags);
+            Write32(bytes, 140, desc.ArraySize);
+        }
+        // Узнаваемые данные, чтобы сравнение мипов что-то проверяло
+        for (size_t i = headerSize; i < bytes.size(); i++)
+        {
+            bytes[i] = (uint8_t)(i * 31 + 7);
+        }
+        return bytes;
+    }
+
+    bool Parse(const std::vector<uint8_t>& bytes, DdsLayout& layout)
+    {
+        return ParseDdsLayout(bytes.data(), bytes.size(), layout);
+    }
+
+    DdsHeaderDesc Bc7(uint32_t width, uint32_t height, uint32_t mips)
+    {
+        DdsHeaderDesc desc;
+        desc.Width = width;
+        desc.Height = height;
+        desc.MipCount = mips;
+        desc.Dx10 = true;
+        desc.DxgiFormat = 98;   // BC7_UNORM
+        return desc;
+    }
+
+    void CheckDx10Layout()
+    {
+        DdsHeaderDesc desc = Bc7(512, 512, 10);
+        uint64_t dataSize = ExpectedDataSize(512, 512, 10, 16, true);
+        std::vector<uint8_t> bytes = MakeDds(desc, dataSize);
+
+        DdsLayout layout;
+        TEST_CHECK(Parse(bytes, layout));
+        TEST_CHECK(layout.Width == 512 && layout.Height == 512 && layout.DxgiFormat == 98);
+        TEST_CHECK(layout.BlockCompressed && layout.BytesPerBlock == 16);
+        TEST_CHECK(layout.DataOffset == 148);
+        TEST_CHECK(layout.Mips.size() == 10);
+        TEST_CHECK(GetDdsMipChainSize(layout, 0) == dataSize);
+
+        uint64_t offset = 148;
+        for (uint32_t mip = 0; mip < layout.Mips.size(); mip++)
+        {
+            const DdsMipInfo& info = layout.Mips[mip];
+            uint32_t edge = 512 >> mip;
+            TEST_CHECK(info.Width == edge && info.Height == edge);
+            TEST_CHECK(info.RowPitch == std::max((edge + 3) / 4, 1u) * 16);
+            TEST_CHECK(info.RowCount == std::max((edge + 3) / 4, 1u));
+            TEST_CHECK(info.Offset == offset);
+            offset += info.Size;
+        }
+        TEST_CHECK(offset == bytes.size());
+
+        // Лишние байты в конце допустимы, цепочка длиннее, чем до 1x1, обрезается
+        bytes.resize(bytes.size() + 100);
+        TEST_CHECK(Parse(bytes, layout));
+        desc.MipCount = 14;
+        TEST_CHECK(Parse(MakeDds(desc, dataSize), layout) && layout.Mips.size() == 10);
+
+        // Без мип-цепочки (MipCount 0 - один мип) и неквадратная текстура
+        desc = Bc7(256, 64, 0);
+        TEST_CHECK(Parse(MakeDds(desc, ExpectedDataSize(256, 64, 1, 16, true)), layout) && layout.Mips.size() == 1);
+        desc = Bc7(256, 64, 9);
+        TEST_CHECK(Parse(MakeDds(desc, ExpectedDataSize(256, 64, 9, 16, true)), layout));
+        TEST_CHECK(layout.Mips.size() == 9 && layout.Mips[8].Width == 1 && layout.Mips[8].Height == 1);
+        TEST_CHECK(layout.Mips[7].Width == 2 && layout.Mips[7].RowPitch == 16 && layout.Mips[7].RowCount == 1);
+
+        // Несжатый DX10 формат
+        desc = Bc7(64, 32, 1);
+        desc.DxgiFormat = 28;   // R8G8B8A8_UNORM
+        TEST_CHECK(Parse(MakeDds(desc, 64 * 32 * 4), layout));
+        TEST_CHECK(!layout.BlockCompressed && layout.Mips[0].RowPitch == 256 && layout.Mips[0].RowCount == 32);
+    }
+
+    void CheckTruncated()
+    {
+        DdsHeaderDesc desc = Bc7(128, 128, 8);
+        std::vector<uint8_t> bytes = MakeDds(desc, ExpectedDataSize(128, 128, 8, 16, true));
+        DdsLayout layout;
+        TEST_CHECK(Parse(bytes, layout));
+
+        // Любое обрезание - внутри магии, заголовка, DX10 расширения или данных последнего мипа - отказ
+        int accepted = 0;
+        for (size_t size = 0; size < bytes.size(); size++)
+        {
+            accepted += ParseDdsLayout(bytes.data(), size, layout);
+        }
+        TEST_CHECK_MSG(accepted == 0, "%d truncated sizes accepted", accepted);
+        TEST_CHECK(!ParseDdsLayout(nullptr, 0, layout));
+
+        // Повреждённые размеры структур и магия
+        std::vector<uint8_t> broken = bytes;
+        Write32(broken, 0, FourCC("DDX "));
+        TEST_CHECK(!Parse(broken, layout));
+        broken = bytes;
+        Write32(broken, 4, 120);
+        TEST_CHECK(!Parse(broken, layout));
+        broken = bytes;
+        Write32(broken, 76, 24);
+        TEST_CHECK(!Parse(broken, layout));
+
+        // Нулевые размеры и слишком длинная цепочка
+        desc.Width = 0;
+        TEST_CHECK(!Parse(MakeDds(desc, 4096), layout));
+        desc = Bc7(128, 128, 33);
+        TEST_CHECK(!Parse(MakeDds(desc, ExpectedDataSize(128, 128, 8, 16, true)), layout));
+
+        // Тот же файл на диске, обрезанный посередине данных: ReadDdsLayout сверяет размер файла
+        std::filesystem::path path = std::filesystem::temp_directory_path() / "DdsFileTest_truncated.dds";
+        std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)(bytes.size() / 2));
+        TEST_CHECK(!ReadDdsLayout(path.string(), layout));
+        std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+        TEST_CHECK(ReadDdsLayout(path.string(), layout));
+        std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), 100);
+        TEST_CHECK(!ReadDdsLayout(path.string(), layout));
+        std::filesystem::remove(path);
+        TEST_CHECK(!ReadDdsLayout(path.string(), layout));
+    }
+
+    void CheckUnsupportedKinds()
+    {
+        const uint64_t dataSize = ExpectedDataSize(64, 64, 1, 16, true) * 6;
+        DdsLayout layout;
+
+        // Кубические: legacy caps2 и DX10 флаг TEXTURECUBE
+        DdsHeaderDesc desc = Bc7(64, 64, 1);
+        desc.Caps2 = DDSCAPS2_CUBEMAP | 0xFC00;
+        TEST_CHECK(!Parse(MakeDds(desc, dataSize), layout));
+        desc = Bc7(64, 64, 1);
+        desc.MiscFlags = 0x4;
+        TEST_CHECK(!Parse(MakeDds(desc, dataSize), layout));
+
+        // Объёмные: флаг глубины и DX10 TEXTURE3D; одномерная текстура тоже отвергается
+        desc = Bc7(64, 64, 1);
+        desc.Flags |= DDSD_DEPTH;
+        TEST_CHECK(!Parse(MakeDds(desc, dataSize), layout));
+        desc = Bc7(64, 64, 1);
+        desc.Dimension = 4;
+        TEST_CHECK(!Parse(MakeDds(desc, dataSize), layout));
+        desc.Dimension = 2;
+        TEST_CHECK(!Parse(MakeDds(desc, dataSize), layout));
+
+        // Массивы
+        desc = Bc7(64, 64, 1);
+        desc.ArraySize = 2;
+        TEST_CHECK(!Parse(MakeDds(desc, dataSize), layout));
+
+        // Неизвестные форматы
+        desc = Bc7(64, 64, 1);
+        desc.DxgiFormat = 0;
+        TEST_CHECK(!Parse(MakeDds(desc, dataSize), layout));
+        desc.DxgiFormat = 115;  // B4G4R4A4
+        TEST_CHECK(!Parse(MakeDds(desc, dataSize), layout));
+    }
+
+    void CheckLegacyFormats()
+    {
+        struct FourCCCase
+        {
+            const char* Code;
+            uint32_t Format;
+            uint32_t BlockBytes;
+        };
+        const FourCCCase cases[] =
+        {
+            { "DXT1", 71, 8 }, { "DXT2", 74, 16 }, { "DXT3", 74, 16 }, { "DXT4", 77, 16 }, { "DXT5", 77, 16 },
+            { "ATI1", 80, 8 }, { "BC4U", 80, 8 }, { "ATI2", 83, 16 }, { "BC5U", 83, 16 },
+        };
+
+        DdsLayout layout;
+        for (const FourCCCase& c : cases)
+        {
+            DdsHeaderDesc desc;
+            desc.Width = 64;
+            desc.Height = 64;
+            desc.MipCount = 7;
+            desc.FourCC = FourCC(c.Code);
+            uint64_t dataSize = ExpectedDataSize(64, 64, 7, c.BlockBytes, true);
+            bool parsed = Parse(MakeDds(desc, dataSize), layout);
+            TEST_CHECK_MSG(parsed && layout.DxgiFormat == c.Format && layout.BytesPerBlock == c.BlockBytes &&
+                           layout.BlockCompressed && layout.DataOffset == 128 && GetDdsMipChainSize(layout, 0) == dataSize,
+                           "FourCC %s", c.Code);
+            // Обрезанный на один байт - отказ
+            TEST_CHECK(!Parse(MakeDds(desc, dataSize - 1), layout));
+        }
+
+        // Неизвестный FourCC и FourCC формата, который поддерживается только через DX10
+        DdsHeaderDesc desc;
+        desc.FourCC = FourCC("RXGB");
+        TEST_CHECK(!Parse(MakeDds(desc, 1 << 20), layout));
+        desc.FourCC = FourCC("BC7U");
+        TEST_CHECK(!Parse(MakeDds(desc, 1 << 20), layout));
+
+        // Несжатые legacy: RGBA и BGRA по маскам, 24-битный RGB не поддерживается, яркость 8 и 16 бит
+        desc = DdsHeaderDesc();
+        desc.Width = 32;
+        desc.Height = 16;
+        desc.PixelFlags = DDPF_RGB;
+        desc.BitCount = 32;
+        uint32_t rgba[4] = { 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000 };
+        std::memcpy(desc.Masks, rgba, sizeof(rgba));
+        TEST_CHECK(Parse(MakeDds(desc, 32 * 16 * 4), layout) && layout.DxgiFormat == 28 && layout.Mips[0].RowPitch == 128);
+        uint32_t bgra[4] = { 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000 };
+        std::memcpy(desc.Masks, bgra, sizeof(bgra));
+        TEST_CHECK(Parse(MakeDds(desc, 32 * 16 * 4), layout) && layout.DxgiFormat == 87);
+        desc.BitCount = 24;
+        TEST_CHECK(!Parse(MakeDds(desc, 32 * 16 * 4), layout));
+
+        desc = DdsHeaderDesc();
+        desc.Width = 32;
+        desc.Height = 16;
+        desc.PixelFlags = DDPF_LUMINANCE;
+        desc.BitCount = 8;
+        TEST_CHECK(Parse(MakeDds(desc, 32 * 16), layout) && layout.DxgiFormat == 61 && !layout.BlockCompressed);
+        desc.BitCount = 16;
+        TEST_CHECK(Parse(MakeDds(desc, 32 * 16 * 2), layout) && layout.DxgiFormat == 56);
+        TEST_CHECK(!Parse(MakeDds(desc, 32 * 16 * 2 - 1), layout));
+    }
+
+    void CheckFirstMip()
+    {
+        DdsLayout layout;
+        TEST_CHECK(Parse(MakeDds(Bc7(512, 512, 10), ExpectedDataSize(512, 512, 10, 16, true)), layout));
+        TEST_CHECK(SelectDdsFirstMip(layout, 512) == 0);
+        TEST_CHECK(SelectDdsFirstMip(layout, 500) == 0);
+        TEST_CHECK(SelectDdsFirstMip(layout, 256) == 1);
+        TEST_CHECK(SelectDdsFirstMip(layout, 64) == 3);
+        TEST_CHECK(SelectDdsFirstMip(layout, 4096) == 0);
+        // Старший мип блочного ресурса должен делиться на 4: 2x2 и 1x1 не годятся
+        TEST_CHECK(SelectDdsFirstMip(layout, 1) == 7);
+        TEST_CHECK(GetDdsMipChainSize(layout, 9) == 16);
+
+        // У несжатых ограничения нет
+        DdsHeaderDesc desc = Bc7(16, 16, 5);
+        desc.DxgiFormat = 28;
+        TEST_CHECK(Parse(MakeDds(desc, ExpectedDataSize(16, 16, 5, 4, false)), layout));
+        TEST_CHECK(SelectDdsFirstMip(layout, 1) == 4);
+    }
+
+    // Тайлы приложения: ReadDdsLayout по заголовку совпадает с разбором отображения, ReadDdsMips
+    // с выровненным шагом строк даёт те же байты, что GetDdsSubresource
+    void CheckShippedTiles()
+    {
+        int checkedTiles = 0;
+        for (int y = 0; y < TestWorld::TilesY; y++)
+        {
+            for (int x = 0; x < TestWorld::TilesX; x++)
+            {
+                std::string path = "Terrain/001/Weathering/Weathering_Out_y" + std::to_string(y) + "_x" + std::to_string(x) + ".dds";
+                MappedFile file;
+                DdsLayout mapped, read;
+                if (!file.Open(path))
+                {
+                    continue;
+                }
+                TEST_CHECK(ParseDdsLayout(file.GetData(), file.GetSize(), mapped));
+                TEST_CHECK(ReadDdsLayout(path, read));
+                TEST_CHECK(mapped.Mips.size() == read.Mips.size() && mapped.DxgiFormat == read.DxgiFormat);
+
+                uint32_t firstMip = SelectDdsFirstMip(mapped, 64);
+                uint32_t mipCount = (uint32_t)mapped.Mips.size() - firstMip;
+                std::vector<DdsStagingFootprint> footprints(mipCount);
+                uint64_t offset = 0;
+                for (uint32_t i = 0; i < mipCount; i++)
+                {
+                    const DdsMipInfo& info = mapped.Mips[firstMip + i];
+                    footprints[i].Offset = offset;
+                    footprints[i].RowPitch = (info.RowPitch + 255) & ~255u;
+                    offset = (offset + (uint64_t)footprints[i].RowPitch * info.RowCount + 511) & ~511ull;
+                }
+                std::vector<uint8_t> staging((size_t)offset, 0);
+                TEST_CHECK(ReadDdsMips(path, mapped, firstMip, mipCount, footprints.data(), staging.data()));
+
+                bool same = true;
+                for (uint32_t i = 0; i < mipCount; i++)
+                {
+                    DdsSubresource source = GetDdsSubresource(mapped, file.GetData(), firstMip + i);
+                    for (uint32_t row = 0; row < source.RowCount; row++)
+                    {
+                        same = same && std::memcmp(staging.data() + footprints[i].Offset + (size_t)row * footprints[i].RowPitch,
+                                                   source.Data + (size_t)row * source.RowPitch, source.RowPitch) == 0;
+                    }
+                }
+                TEST_CHECK_MSG(same, "%s", path.c_str());
+
+                // Мипов больше, чем в файле, и шаг строк меньше исходного - отказ
+                TEST_CHECK(!ReadDdsMips(path, mapped, firstMip, mipCount + 1, footprints.data(), staging.data()));
+                footprints[0].RowPitch = mapped.Mips[firstMip].RowPitch - 1;
+                TEST_CHECK(!ReadDdsMips(path, mapped, firstMip, mipCount, footprints.data(), staging.data()));
+                checkedTiles++;
+            }
+        }
+        TEST_CHECK_MSG(checkedTiles == TestWorld::TilesX * TestWorld::TilesY, "%d tiles found", checkedTiles);
+    }
+}
+
+int main()
+{
+    CheckDx10Layout();
+    CheckTruncated();
+    CheckUnsupportedKinds();
+    CheckLegacyFormats();
+    CheckFirstMip();
+    CheckShippedTiles();
+
+    return TestResult("DdsFileTest");
+}
@@ -0,0 +1,193 @@
+#include "FrustumCulling.h"
+#include "TestCommon.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+
+// ClassifyBoxes4 и ClassifyBox против BoundingFrustum::Contains(BoundingBox) на случайных
+// камерах и боксах. Ядро считает те же плоскости тем же тестом центр/радиус, но другим
+// порядком сложений, поэтому расхождение допустимо только у боксов, касающихся плоскости
+// с точностью до округления float; такие боксы считаются отдельно и не проверяются.
+
+namespace
+{
+    const int CameraCount = 200;
+    const int GroupsPerCamera = 256;
+
+    // Плоскость plane действительно отбрасывает бокс
+    bool PlaneRejects(const FrustumPlanes& planes, int plane, float cx, float cy, float cz,
+                      float ex, float ey, float ez)
+    {
+        float dist = cx * planes.NormalX[plane] + cy * planes.NormalY[plane] + cz * planes.NormalZ[plane] +
+                     planes.Distance[plane];
+        float radius = ex * std::fabs(planes.NormalX[plane]) + ey * std::fabs(planes.NormalY[plane]) +
+                       ez * std::fabs(planes.NormalZ[plane]);
+        return dist > radius;
+    }
+
+    // Бокс лежит на границе хотя бы одной плоскости в пределах погрешности float
+    bool IsBoundaryBox(const FrustumPlanes& planes, const BoundingBox& box)
+    {
+        for (int i = 0; i < FrustumPlanes::PlaneCount; i++)
+        {
+            double nx = planes.NormalX[i], ny = planes.NormalY[i], nz = planes.NormalZ[i];
+            double dist = box.Center.x * nx + box.Center.y * ny + box.Center.z * nz + planes.Distance[i];
+            double radius = box.Extents.x * std::fabs(nx) + box.Extents.y * std::fabs(ny) + box.Extents.z * std::fabs(nz);
+            double scale = std::fabs(box.Center.x) + std::fabs(box.Center.y) + std::fabs(box.Center.z) +
+                           std::fabs(planes.Distance[i]) + radius + 1.0;
+            double tolerance = scale * 1e-5;
+            if (std::fabs(dist - radius) < tolerance || std::fabs(dist + radius) < tolerance)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    TestCameraPose RandomPose(TestRandom& random)
+    {
+        TestCameraPose pose;
+        pose.X = random.Uniform(-500.0f, 2500.0f);
+        pose.Y = random.Uniform(0.0f, 2000.0f);
+        pose.Z = random.Uniform(-500.0f, 2500.0f);
+        pose.Pitch = random.Uniform(-89.0f, 89.0f);
+        pose.Yaw = random.Uniform(-180.0f, 180.0f);
+        return pose;
+    }
+
+    void RandomBox(TestRandom& random, const TestCameraPose& pose, float& cx, float& cy, float& cz,
+                   float& ex, float& ey, float& ez)
+    {
+        // От пылинок до узлов размером с весь террейн, вокруг камеры и за дальней плоскостью
+        float size = std::pow(2.0f, random.Uniform(-2.0f, 11.0f));
+        float reach = random.Uniform(0.0f, 1.0f) < 0.9f ? 3000.0f : 12000.0f;
+        cx = pose.X + random.Uniform(-reach, reach);
+        cy = pose.Y + random.Uniform(-reach, reach) * 0.5f;
+        cz = pose.Z + random.Uniform(-reach, reach);
+        ex = size * random.Uniform(0.1f, 1.0f);
+        ey = size * random.Uniform(0.01f, 1.0f);
+        ez = size * random.Uniform(0.1f, 1.0f);
+    }
+}
+
+int main()
+{
+    TestRandom random(12345);
+    int compared = 0;
+    int boundary = 0;
+    int counts[3] = { 0, 0, 0 };
+
+    for (int c = 0; c < CameraCount; c++)
+    {
+        TestCameraPose pose = RandomPose(random);
+        Camera camera = MakeTestCamera(pose);
+        BoundingFrustum frustum = camera.GetFrustum();
+
+        FrustumPlanes planes;
+        planes.Build(frustum);
+
+        for (int g = 0; g < GroupsPerCamera; g++)
+        {
+            alignas(16) float cx[4], cy[4], cz[4], ex[4], ey[4], ez[4];
+            uint8_t hint[4];
+            for (int lane = 0; lane < 4; lane++)
+            {
+                RandomBox(random, pose, cx[lane], cy[lane], cz[lane], ex[lane], ey[lane], ez[lane]);
+                hint[lane] = (uint8_t)(random.Next() % FrustumPlanes::PlaneCount);
+            }
+
+            BoxCullResult4 result;
+            ClassifyBoxes4(planes, FrustumPlanes::AllPlanesMask, hint, cx, cy, cz, ex, ey, ez, result);
+
+            for (int lane = 0; lane < 4; lane++)
+            {
+                BoundingBox box(XMFLOAT3(cx[lane], cy[lane], cz[lane]), XMFLOAT3(ex[lane], ey[lane], ez[lane]));
+
+                ContainmentType containment;
+                uint8_t straddle;
+                uint8_t reject = hint[lane];
+                float margin, insideMargin;
+                ClassifyBox(planes, FrustumPlanes::AllPlanesMask, cx[lane], cy[lane], cz[lane],
+                            ex[lane], ey[lane], ez[lane], containment, straddle, reject, margin, insideMargin);
+
+                // SIMD и скалярный путь считают одно и то же одинаково; отбросившая плоскость
+                // может отличаться (пути обходят плоскости в разном порядке), но обязана отбрасывать
+                TEST_CHECK(containment == result.Containment[lane]);
+                TEST_CHECK(containment == DISJOINT || straddle == result.PlaneMask[lane]);
+                TEST_CHECK(containment != DISJOINT ||
+                           (PlaneRejects(planes, reject, cx[lane], cy[lane], cz[lane], ex[lane], ey[lane], ez[lane]) &&
+                            PlaneRejects(planes, result.RejectPlane[lane], cx[lane], cy[lane], cz[lane],
+                                         ex[lane], ey[lane], ez[lane])));
+                TEST_CHECK((containment == INTERSECTS) == (result.PlaneMask[lane] != 0));
+
+                if (IsBoundaryBox(planes, box))
+                {
+                    boundary++;
+                    continue;
+                }
+
+                ContainmentType expected = frustum.Contains(box);
+                TEST_CHECK_MSG(result.Containment[lane] == expected,
+                               "camera %d box (%g %g %g)+-(%g %g %g): kernel %d, DirectXCollision %d",
+                               c, cx[lane], cy[lane], cz[lane], ex[lane], ey[lane], ez[lane],
+                               (int)result.Containment[lane], (int)expected);
+                counts[expected]++;
+                compared++;
+            }
+        }
+    }
+
+    // Все три исхода должны реально встречаться, иначе сравнение ничего не доказывает
+    TEST_CHECK(counts[DISJOINT] > 1000);
+    TEST_CHECK(counts[INTERSECTS] > 1000);
+    TEST_CHECK(counts[CONTAINS] > 1000);
+
+    // Маска плоскостей: дети, проверяемые только по плоскостям, которые пересекает родитель,
+    // получают тот же результат, что и при полной проверке
+    for (int c = 0; c < CameraCount; c++)
+    {
+        TestCameraPose pose = RandomPose(random);
+        Camera camera = MakeTestCamera(pose);
+        FrustumPlanes planes;
+        planes.Build(camera.GetFrustum());
+
+        float pcx, pcy, pcz, pex, pey, pez;
+        RandomBox(random, pose, pcx, pcy, pcz, pex, pey, pez);
+
+        ContainmentType parent;
+        uint8_t parentMask, reject = 0;
+        float margin, insideMargin;
+        ClassifyBox(planes, FrustumPlanes::AllPlanesMask, pcx, pcy, pcz, pex, pey, pez,
+                    parent, parentMask, reject, margin, insideMargin);
+        if (parent != INTERSECTS)
+        {
+            continue;
+        }
+
+        alignas(16) float cx[4], cy[4], cz[4], ex[4], ey[4], ez[4];
+        const uint8_t hint[4] = { 0, 0, 0, 0 };
+        for (int lane = 0; lane < 4; lane++)
+        {
+            cx[lane] = pcx + ((lane & 1) ? 0.5f : -0.5f) * pex;
+            cy[lane] = pcy;
+            cz[lane] = pcz + ((lane & 2) ? 0.5f : -0.5f) * pez;
+            ex[lane] = pex * 0.5f;
+            ey[lane] = pey;
+            ez[lane] = pez * 0.5f;
+        }
+
+        BoxCullResult4 full, masked;
+        ClassifyBoxes4(planes, FrustumPlanes::AllPlanesMask, hint, cx, cy, cz, ex, ey, ez, full);
+        ClassifyBoxes4(planes, parentMask, hint, cx, cy, cz, ex, ey, ez, masked);
+        for (int lane = 0; lane < 4; lane++)
+        {
+            TEST_CHECK(full.Containment[lane] == masked.Containment[lane]);
+        }
+    }
+
+    std::printf("compared %d boxes against DirectXCollision (disjoint %d, intersects %d, contains %d), "
+                "%d boundary boxes skipped\n",
+                compared, counts[DISJOINT], counts[INTERSECTS], counts[CONTAINS], boundary);
+    return TestResult("FrustumCullingTest");
+}
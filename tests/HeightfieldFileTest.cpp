@@ -0,0 +1,419 @@
+#include "HeightfieldFile.h"
+#include "TiffReader.h"
+#include "TestCommon.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+// TIFF -> .hfd: TiffStripReader на синтетических файлах обоих порядков байт с полосами любой
+// высоты, отказ для обрезанных и неподдерживаемых TIFF, заголовок, min/max и значения .hfd
+// против исходных, раскладка тайлов ConvertGaeaHeightTiles и конвертация Terrain/003/Height_Out.tif
+
+namespace
+{
+    const std::filesystem::path TempDirectory = std::filesystem::temp_directory_path() / "HeightfieldFileTest";
+
+    // Описание синтетического TIFF; значения - width * height, построчно
+    struct TiffDesc
+    {
+        uint32_t Width = 37;
+        uint32_t Height = 29;
+        uint32_t RowsPerStrip = 8;
+        uint32_t BitsPerSample = 16;
+        uint32_t Compression = 1;
+        uint32_t SamplesPerPixel = 1;
+        bool LittleEndian = true;
+        bool IfdFirst = false;          // Gaea пишет IFD после данных
+        bool ByteCounts = true;
+    };
+
+    struct TiffWriter
+    {
+        std::vector<uint8_t> Bytes;
+        bool LittleEndian;
+
+        void U16(size_t offset, uint32_t value)
+        {
+            Bytes[offset + (LittleEndian ? 0 : 1)] = (uint8_t)value;
+            Bytes[offset + (LittleEndian ? 1 : 0)] = (uint8_t)(value >> 8);
+        }
+
+        void U32(size_t offset, uint32_t value)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                Bytes[offset + (LittleEndian ? i : 3 - i)] = (uint8_t)(value >> (8 * i));
+            }
+        }
+    };
+
+    std::vector<uint16_t> MakeSamples(uint32_t width, uint32_t height, uint32_t seed)
+    {
+        TestRandom random(seed);
+        std::vector<uint16_t> samples((size_t)width * height);
+        for (uint16_t& sample : samples)
+        {
+            sample = (uint16_t)(1000 + random.Next() % 60000);
+        }
+        return samples;
+    }
+
+    std::vector<uint8_t> MakeTiff(const TiffDesc& desc, const std::vector<uint16_t>& samples)
+    {
+        const uint32_t stripCount = (desc.Height + desc.RowsPerStrip - 1) / desc.RowsPerStrip;
+        const uint32_t rowBytes = desc.Width * 2;
+        const uint32_t entryCount = desc.ByteCounts ? 8 : 7;
+        const uint32_t ifdSize = 2 + entryCount * 12 + 4;
+        const uint32_t arraysSize = stripCount > 1 ? stripCount * 4 * 2 : 0;
+        const uint32_t dataSize = desc.Height * rowBytes;
+
+        uint32_t ifdOffset = desc.IfdFirst ? 8 : 8 + dataSize;
+        uint32_t arraysOffset = ifdOffset + ifdSize;
+        uint32_t dataOffset = desc.IfdFirst ? arraysOffset + arraysSize : 8;
+
+        TiffWriter writer;
+        writer.LittleEndian = desc.LittleEndian;
+        writer.Bytes.assign(8 + dataSize + ifdSize + arraysSize, 0);
+        writer.Bytes[0] = writer.Bytes[1] = desc.LittleEndian ? 'I' : 'M';
+        writer.U16(2, 42);
+        writer.U32(4, ifdOffset);
+
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            writer.U16(dataOffset + i * 2, samples[i]);
+        }
+
+        // Записи IFD по возрастанию тегов; массивы полос - сразу за IFD
+        size_t entry = ifdOffset + 2;
+        writer.U16(ifdOffset, entryCount);
+        auto addEntry = [&](uint32_t tag, uint32_t type, uint32_t count, uint32_t value)
+        {
+            writer.U16(entry, tag);
+            writer.U16(entry + 2, type);
+            writer.U32(entry + 4, count);
+            if (type == 3 && count == 1)
+            {
+                writer.U16(entry + 8, value);
+            }
+            else
+            {
+                writer.U32(entry + 8, value);
+            }
+            entry += 12;
+        };
+        addEntry(256, 4, 1, desc.Width);
+        addEntry(257, 4, 1, desc.Height);
+        addEntry(258, 3, 1, desc.BitsPerSample);
+        addEntry(259, 3, 1, desc.Compression);
+        addEntry(273, 4, stripCount, stripCount > 1 ? arraysOffset : dataOffset);
+        addEntry(277, 3, 1, desc.SamplesPerPixel);
+        addEntry(278, 4, 1, desc.RowsPerStrip);
+        if (desc.ByteCounts)
+        {
+            addEntry(279, 4, stripCount, stripCount > 1 ? arraysOffset + stripCount * 4 : rowBytes * desc.Height);
+        }
+        writer.U32(entry, 0);
+
+        if (stripCount > 1)
+        {
+            for (uint32_t strip = 0; strip < stripCount; strip++)
+            {
+                uint32_t rows = std::min(desc.RowsPerStrip, desc.Height - strip * desc.RowsPerStrip);
+                writer.U32(arraysOffset + strip * 4, dataOffset + strip * desc.RowsPerStrip * rowBytes);
+                writer.U32(arraysOffset + (stripCount + strip) * 4, rows * rowBytes);
+            }
+        }
+        return writer.Bytes;
+    }
+
+    std::string WriteFile(const std::string& name, const std::vector<uint8_t>& bytes, size_t size)
+    {
+        std::filesystem::path path = TempDirectory / name;
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(reinterpret_cast<const char*>(bytes.data()),
+                                                                     (std::streamsize)size);
+        return path.string();
+    }
+
+    std::string WriteFile(const std::string& name, const std::vector<uint8_t>& bytes)
+    {
+        return WriteFile(name, bytes, bytes.size());
+    }
+
+    // .hfd против исходных значений: заголовок, min/max и каждое значение
+    void CheckHeightfield(const std::string& path, const std::vector<uint16_t>& samples, uint32_t width, uint32_t height,
+                          int32_t tileX, int32_t tileY, float heightScale)
+    {
+        HeightfieldFile file;
+        if (!file.Open(path))
+        {
+            TEST_CHECK_MSG(false, "%s does not open", path.c_str());
+            return;
+        }
+
+        const HeightfieldHeader& header = file.GetHeader();
+        auto range = std::minmax_element(samples.begin(), samples.end());
+        TEST_CHECK(header.Magic == HeightfieldMagic && header.Version == HeightfieldVersion);
+        TEST_CHECK_MSG(header.Width == width && header.Height == height, "%s: %ux%u", path.c_str(), header.Width, header.Height);
+        TEST_CHECK_MSG(header.TileX == tileX && header.TileY == tileY, "%s: tile %d,%d", path.c_str(), header.TileX, header.TileY);
+        TEST_CHECK_MSG(header.MinSample == *range.first && header.MaxSample == *range.second,
+                       "%s: range %u..%u, expected %u..%u", path.c_str(), header.MinSample, header.MaxSample,
+                       *range.first, *range.second);
+        TEST_CHECK(header.HeightScale == heightScale);
+        TEST_CHECK(header.DataOffset == sizeof(HeightfieldHeader) && header.DataOffset % 64 == 0);
+        TEST_CHECK(file.GetSampleScale() == heightScale / 65535.0f);
+        TEST_CHECK_MSG(std::memcmp(file.GetSamples(), samples.data(), samples.size() * sizeof(uint16_t)) == 0,
+                       "%s: samples differ from the source", path.c_str());
+        TEST_CHECK(file.GetSample(width - 1, height - 1) == samples.back());
+    }
+
+    void CheckStripReader()
+    {
+        // Порядок байт, положение IFD, высота полосы (не делит высоту, одна полоса, без StripByteCounts)
+        const uint32_t rowsPerStrip[] = { 1, 8, 29, 64 };
+        int index = 0;
+        for (bool littleEndian : { true, false })
+        {
+            for (bool ifdFirst : { false, true })
+            {
+                for (uint32_t rows : rowsPerStrip)
+                {
+                    TiffDesc desc;
+                    desc.LittleEndian = littleEndian;
+                    desc.IfdFirst = ifdFirst;
+                    desc.RowsPerStrip = rows;
+                    desc.ByteCounts = index % 3 != 2;
+                    std::vector<uint16_t> samples = MakeSamples(desc.Width, desc.Height, 10 + index);
+                    std::string path = WriteFile("strips_" + std::to_string(index++) + ".tif", MakeTiff(desc, samples));
+
+                    TiffStripReader reader;
+                    if (!reader.Open(path))
+                    {
+                        TEST_CHECK_MSG(false, "%s: %s endian, %u rows per strip does not open",
+                                       path.c_str(), littleEndian ? "little" : "big", rows);
+                        continue;
+                    }
+                    TEST_CHECK(reader.GetWidth() == desc.Width && reader.GetHeight() == desc.Height);
+
+                    // Порции строк через границы полос
+                    std::vector<uint16_t> read(samples.size(), 0);
+                    const uint32_t chunks[] = { 3, 7, 11, 8 };
+                    uint32_t row = 0;
+                    for (int i = 0; row < desc.Height; i++)
+                    {
+                        uint32_t count = std::min(chunks[i % 4], desc.Height - row);
+                        TEST_CHECK(reader.ReadRows(row, count, read.data() + (size_t)row * desc.Width));
+                        row += count;
+                    }
+                    TEST_CHECK_MSG(read == samples, "%s: rows differ", path.c_str());
+
+                    // Выход за последнюю строку
+                    TEST_CHECK(!reader.ReadRows(desc.Height - 2, 3, read.data()));
+                    TEST_CHECK(!reader.ReadRows(UINT32_MAX, 2, read.data()));
+                }
+            }
+        }
+    }
+
+    void CheckRoundTrip()
+    {
+        for (bool littleEndian : { true, false })
+        {
+            // 200 строк - больше одной порции конвертации, последняя порция неполная
+            TiffDesc desc;
+            desc.Width = 53;
+            desc.Height = 200;
+            desc.RowsPerStrip = 24;
+            desc.LittleEndian = littleEndian;
+            std::vector<uint16_t> samples = MakeSamples(desc.Width, desc.Height, littleEndian ? 1 : 2);
+            samples[777] = 0;
+            samples[4321] = 65535;
+            std::string tiff = WriteFile("roundtrip.tif", MakeTiff(desc, samples));
+            std::string hfd = (TempDirectory / "roundtrip.hfd").string();
+
+            TEST_CHECK(ConvertTiffToHeightfield(tiff, hfd, -1, -1, 500.0f));
+            CheckHeightfield(hfd, samples, desc.Width, desc.Height, -1, -1, 500.0f);
+        }
+
+        // Повторная конвертация перезаписывает файл, а не дописывает
+        TiffDesc desc;
+        std::vector<uint16_t> samples = MakeSamples(desc.Width, desc.Height, 3);
+        std::string tiff = WriteFile("small.tif", MakeTiff(desc, samples));
+        std::string hfd = (TempDirectory / "roundtrip.hfd").string();
+        TEST_CHECK(ConvertTiffToHeightfield(tiff, hfd, 2, 1, 250.0f));
+        CheckHeightfield(hfd, samples, desc.Width, desc.Height, 2, 1, 250.0f);
+        TEST_CHECK(std::filesystem::file_size(hfd) == sizeof(HeightfieldHeader) + samples.size() * sizeof(uint16_t));
+    }
+
+    void CheckRejectedTiffs()
+    {
+        TiffDesc desc;
+        std::vector<uint16_t> samples = MakeSamples(desc.Width, desc.Height, 4);
+        std::string hfd = (TempDirectory / "rejected.hfd").string();
+        TiffStripReader reader;
+
+        // Обрезанные: IFD в конце пропадает, при IFD в начале пропадают строки
+        std::vector<uint8_t> bytes = MakeTiff(desc, samples);
+        int accepted = 0;
+        for (size_t size : { (size_t)0, (size_t)4, (size_t)8, bytes.size() / 2, bytes.size() - 1 })
+        {
+            accepted += reader.Open(WriteFile("truncated.tif", bytes, size));
+        }
+        TEST_CHECK_MSG(accepted == 0, "%d truncated TIFFs with a trailing IFD accepted", accepted);
+
+        desc.IfdFirst = true;
+        bytes = MakeTiff(desc, samples);
+        std::string truncated = WriteFile("truncated.tif", bytes, bytes.size() - desc.Width);
+        TEST_CHECK(reader.Open(truncated));
+        std::vector<uint16_t> read(samples.size());
+        TEST_CHECK(reader.ReadRows(0, desc.RowsPerStrip, read.data()));
+        TEST_CHECK(!reader.ReadRows(0, desc.Height, read.data()));
+        reader.Close();
+        TEST_CHECK(!ConvertTiffToHeightfield(truncated, hfd, -1, -1, 500.0f));
+        TEST_CHECK(!HeightfieldFile().Open(hfd));
+
+        // Неподдерживаемые: 8 и 32 бита, сжатие LZW, RGB, не TIFF, BigTIFF, нет файла
+        auto rejected = [&](const TiffDesc& unsupported)
+        {
+            std::string path = WriteFile("unsupported.tif", MakeTiff(unsupported, samples));
+            return !reader.Open(path) && !ConvertTiffToHeightfield(path, hfd, -1, -1, 500.0f);
+        };
+        desc = TiffDesc();
+        desc.BitsPerSample = 8;
+        TEST_CHECK(rejected(desc));
+        desc.BitsPerSample = 32;
+        TEST_CHECK(rejected(desc));
+        desc = TiffDesc();
+        desc.Compression = 5;
+        TEST_CHECK(rejected(desc));
+        desc = TiffDesc();
+        desc.SamplesPerPixel = 3;
+        TEST_CHECK(rejected(desc));
+
+        bytes = MakeTiff(TiffDesc(), samples);
+        bytes[0] = 'X';
+        TEST_CHECK(!reader.Open(WriteFile("unsupported.tif", bytes)));
+        bytes[0] = 'I';
+        bytes[2] = 43;
+        TEST_CHECK(!reader.Open(WriteFile("unsupported.tif", bytes)));
+        TEST_CHECK(!reader.Open((TempDirectory / "missing.tif").string()));
+        TEST_CHECK(!ConvertTiffToHeightfield((TempDirectory / "missing.tif").string(), hfd, -1, -1, 500.0f));
+    }
+
+    void CheckRejectedHeightfields()
+    {
+        TiffDesc desc;
+        std::vector<uint16_t> samples = MakeSamples(desc.Width, desc.Height, 5);
+        std::string hfd = (TempDirectory / "valid.hfd").string();
+        TEST_CHECK(ConvertTiffToHeightfield(WriteFile("valid.tif", MakeTiff(desc, samples)), hfd, -1, -1, 500.0f));
+
+        std::vector<uint8_t> bytes(std::filesystem::file_size(hfd));
+        std::ifstream(hfd, std::ios::binary).read(reinterpret_cast<char*>(bytes.data()), (std::streamsize)bytes.size());
+        HeightfieldFile file;
+        TEST_CHECK(file.Open(WriteFile("copy.hfd", bytes)));
+        file.Close();
+        TEST_CHECK(!file.IsOpen());
+
+        // Обрезанные: без части заголовка и без последнего значения
+        TEST_CHECK(!file.Open(WriteFile("broken.hfd", bytes, sizeof(HeightfieldHeader) - 1)));
+        TEST_CHECK(!file.Open(WriteFile("broken.hfd", bytes, bytes.size() - 1)));
+
+        // Другая магия, версия, нулевой размер, невыровненное или слишком большое смещение данных
+        auto broken = [&](size_t offset, uint32_t value)
+        {
+            std::vector<uint8_t> copy = bytes;
+            std::memcpy(&copy[offset], &value, sizeof(value));
+            return !file.Open(WriteFile("broken.hfd", copy));
+        };
+        TEST_CHECK(broken(offsetof(HeightfieldHeader, Magic), 0x46464948));
+        TEST_CHECK(broken(offsetof(HeightfieldHeader, Version), HeightfieldVersion + 1));
+        TEST_CHECK(broken(offsetof(HeightfieldHeader, Width), 0));
+        TEST_CHECK(broken(offsetof(HeightfieldHeader, Height), desc.Height + 1));
+        TEST_CHECK(broken(offsetof(HeightfieldHeader, DataOffset), 65));
+        TEST_CHECK(broken(offsetof(HeightfieldHeader, DataOffset), 32));
+        TEST_CHECK(broken(offsetof(HeightfieldHeader, DataOffset), 128));
+        TEST_CHECK(!file.Open((TempDirectory / "missing.hfd").string()));
+    }
+
+    void CheckGaeaTiles()
+    {
+        // Сетка 3x2 с пропущенным тайлом: каждый .hfd знает свою позицию и несёт свои значения
+        const uint32_t tilesX = 3;
+        const uint32_t tilesY = 2;
+        std::vector<std::vector<uint16_t>> tiles(tilesX * tilesY);
+        TiffDesc desc;
+        desc.Width = 16;
+        desc.Height = 16;
+        for (uint32_t y = 0; y < tilesY; y++)
+        {
+            for (uint32_t x = 0; x < tilesX; x++)
+            {
+                std::string name = "Height_Out_y" + std::to_string(y) + "_x" + std::to_string(x);
+                std::filesystem::remove(TempDirectory / (name + ".hfd"));
+                if (x == 1 && y == 1)
+                {
+                    std::filesystem::remove(TempDirectory / (name + ".tif"));
+                    continue;
+                }
+                tiles[y * tilesX + x] = MakeSamples(desc.Width, desc.Height, 100 + y * tilesX + x);
+                WriteFile(name + ".tif", MakeTiff(desc, tiles[y * tilesX + x]));
+            }
+        }
+
+        uint32_t converted = ConvertGaeaHeightTiles(TempDirectory.string(), "Height_Out", tilesX, tilesY, 500.0f);
+        TEST_CHECK_MSG(converted == tilesX * tilesY - 1, "%u tiles converted", converted);
+        for (uint32_t y = 0; y < tilesY; y++)
+        {
+            for (uint32_t x = 0; x < tilesX; x++)
+            {
+                std::string path = (TempDirectory / ("Height_Out_y" + std::to_string(y) + "_x" + std::to_string(x) + ".hfd")).string();
+                if (tiles[y * tilesX + x].empty())
+                {
+                    TEST_CHECK(!std::filesystem::exists(path));
+                    continue;
+                }
+                CheckHeightfield(path, tiles[y * tilesX + x], desc.Width, desc.Height, (int32_t)x, (int32_t)y, 500.0f);
+            }
+        }
+    }
+
+    // Экспорт Gaea целиком: .hfd совпадает с чтением TIFF полосами
+    void CheckShippedHeightmap()
+    {
+        const std::string tiff = "Terrain/003/Height_Out.tif";
+        TiffStripReader reader;
+        if (!reader.Open(tiff))
+        {
+            TEST_CHECK_MSG(false, "cannot open %s", tiff.c_str());
+            return;
+        }
+        uint32_t width = reader.GetWidth();
+        uint32_t height = reader.GetHeight();
+        std::vector<uint16_t> samples((size_t)width * height);
+        TEST_CHECK(reader.ReadRows(0, height, samples.data()));
+        reader.Close();
+
+        std::string hfd = (TempDirectory / "Height_Out.hfd").string();
+        TEST_CHECK(ConvertTiffToHeightfield(tiff, hfd, -1, -1, TestWorld::HeightScale));
+        CheckHeightfield(hfd, samples, width, height, -1, -1, TestWorld::HeightScale);
+    }
+}
+
+int main()
+{
+    std::filesystem::create_directories(TempDirectory);
+
+    CheckStripReader();
+    CheckRoundTrip();
+    CheckRejectedTiffs();
+    CheckRejectedHeightfields();
+    CheckGaeaTiles();
+    CheckShippedHeightmap();
+
+    std::error_code error;
+    std::filesystem::remove_all(TempDirectory, error);
+    return TestResult("HeightfieldFileTest");
+}
@@ -0,0 +1,154 @@
+#include "HeightfieldRaycast.h"
+#include "Heightfield.h"
+#include "WorkStealingPool.h"
+#include "RaycastReference.h"
+#include "TestCommon.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+
+// HeightfieldRaycaster против наивного DDA по всем ячейкам в double: лучи пикинга, прямая
+// видимость у самой земли, лучи вдоль границ ячеек и крайние случаи. Попадание/промах
+// должны совпадать, расстояние - в пределах MaxDistanceError; пул - бит в бит с одним потоком.
+
+namespace
+{
+    const float MaxDistanceError = 0.01f;
+
+    void CompareWithReference(const char* name, const HeightfieldRaycaster& raycaster, const Heightfield& heightfield,
+                              const std::vector<TerrainRay>& rays)
+    {
+        std::vector<float> distances(rays.size());
+        raycaster.RaycastBatch(rays.data(), distances.data(), rays.size());
+
+        size_t hits = 0;
+        size_t disagreements = 0;
+        double worstError = 0.0;
+        for (size_t i = 0; i < rays.size(); i++)
+        {
+            double expected;
+            bool expectedHit = DdaRaycast<double>(heightfield, rays[i], expected);
+            if ((distances[i] >= 0.0f) != expectedHit)
+            {
+                if (disagreements++ < 5)
+                {
+                    std::printf("%s ray %zu: distance %g, reference %s %g\n", name, i, distances[i],
+                                expectedHit ? "hit at" : "miss", expectedHit ? expected : -1.0);
+                }
+                continue;
+            }
+            if (expectedHit)
+            {
+                hits++;
+                worstError = std::max(worstError, std::fabs(distances[i] - expected));
+            }
+        }
+        std::printf("%s: %zu rays, %zu hits, max distance error %.2g\n", name, rays.size(), hits, worstError);
+        TEST_CHECK_MSG(disagreements == 0, "%s: %zu hit/miss disagreements", name, disagreements);
+        TEST_CHECK_MSG(worstError < MaxDistanceError, "%s: distance off by %g", name, worstError);
+        TEST_CHECK_MSG(hits > 0 && hits < rays.size(), "%s: %zu of %zu rays hit, the set tests nothing", name, hits, rays.size());
+
+        WorkStealingPool pool(4);
+        std::vector<float> pooled(rays.size(), -2.0f);
+        raycaster.RaycastBatch(rays.data(), pooled.data(), rays.size(), &pool);
+        TEST_CHECK_MSG(std::memcmp(pooled.data(), distances.data(), distances.size() * sizeof(float)) == 0,
+                       "%s: pooled results differ", name);
+    }
+
+    // Начало на линиях центров текселей (границы ячеек), направления вдоль осей и диагоналей:
+    // самые неудобные случаи для выбора ребёнка и шага к соседнему узлу
+    std::vector<TerrainRay> MakeBoundaryRays(const Heightfield& heightfield, size_t count)
+    {
+        const float texel = TestWorld::TerrainSize / heightfield.GetWidth();
+        const float directions[6][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { -1, -1 } };
+        TestRandom random(5);
+        std::vector<TerrainRay> rays(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            TerrainRay& ray = rays[i];
+            ray.OriginX = (random.Next() % heightfield.GetWidth() + 0.5f) * texel;
+            ray.OriginZ = (random.Next() % heightfield.GetHeight() + 0.5f) * texel;
+            if (i % 3 == 0)
+            {
+                ray.OriginX = random.Uniform(0.0f, TestWorld::TerrainSize);
+            }
+            ray.OriginY = heightfield.SampleHeight(ray.OriginX, ray.OriginZ) + random.Uniform(0.5f, 50.5f);
+            float dx = directions[i % 6][0];
+            float dy = -random.Uniform(0.0f, 0.05f);
+            float dz = directions[i % 6][1];
+            float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+            ray.DirectionX = dx / length;
+            ray.DirectionY = dy / length;
+            ray.DirectionZ = dz / length;
+            ray.MaxDistance = 3000.0f;
+        }
+        return rays;
+    }
+
+    void CheckEdgeCases(const HeightfieldRaycaster& raycaster, const Heightfield& heightfield)
+    {
+        float distance;
+
+        // Прямо вниз над картой - попадание ровно в высоту под точкой
+        TerrainRay down = { 1000.0f, 1000.0f, 1000.0f, 0.0f, -1.0f, 0.0f, 5000.0f };
+        TEST_CHECK(raycaster.Raycast(down, distance));
+        TEST_CHECK_MSG(std::fabs(1000.0f - distance - heightfield.SampleHeight(1000.0f, 1000.0f)) < MaxDistanceError,
+                       "straight down: distance %g", distance);
+
+        // Начало под поверхностью - пересечение на 0
+        TerrainRay below = { 1000.0f, -10.0f, 1000.0f, 0.0f, 1.0f, 0.0f, 5000.0f };
+        TEST_CHECK(raycaster.Raycast(below, distance) && distance == 0.0f);
+
+        // Вне карты поверхности нет
+        TerrainRay outside = { 3000.0f, 100.0f, 3000.0f, 0.0f, -1.0f, 0.0f, 5000.0f };
+        TEST_CHECK(!raycaster.Raycast(outside, distance));
+
+        // Луч заходит на карту снаружи, горизонтально ниже вершин
+        TerrainRay fromOutside = { -100.0f, 200.0f, 1024.0f, 1.0f, 0.0f, 0.0f, 5000.0f };
+        double expected;
+        bool expectedHit = DdaRaycast<double>(heightfield, fromOutside, expected);
+        bool hit = raycaster.Raycast(fromOutside, distance);
+        TEST_CHECK(hit == expectedHit && (!hit || std::fabs(distance - expected) < MaxDistanceError));
+
+        // Короткий луч не дотягивается до земли
+        TerrainRay shortRay = down;
+        shortRay.MaxDistance = 1000.0f - heightfield.SampleHeight(1000.0f, 1000.0f) - 1.0f;
+        TEST_CHECK(!raycaster.Raycast(shortRay, distance));
+
+        // Прямая видимость согласована с Raycast по отрезку
+        float groundA = heightfield.SampleHeight(300.0f, 300.0f);
+        TEST_CHECK(raycaster.HasLineOfSight(300.0f, groundA + 5.0f, 300.0f, 300.0f, groundA + 500.0f, 300.0f));
+        TEST_CHECK(!raycaster.HasLineOfSight(300.0f, groundA + 5.0f, 300.0f, 300.0f, groundA - 5.0f, 300.0f));
+        TEST_CHECK(raycaster.HasLineOfSight(10.0f, 10.0f, 10.0f, 10.0f, 10.0f, 10.0f));
+
+        // Без карты пересечений нет
+        HeightfieldRaycaster empty;
+        TEST_CHECK(empty.IsEmpty());
+        TEST_CHECK(!empty.Raycast(down, distance));
+    }
+}
+
+int main()
+{
+    std::vector<float> values;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    if (!LoadTestHeights(values, width, height))
+    {
+        std::printf("cannot load Terrain/003/Height_Out.tif\n");
+        return 1;
+    }
+
+    Heightfield heightfield;
+    heightfield.Build(values, width, height, TestWorld::TerrainSize, TestWorld::TerrainSize, TestWorld::HeightScale);
+    HeightfieldRaycaster raycaster;
+    raycaster.Build(heightfield);
+    TEST_CHECK(!raycaster.IsEmpty());
+
+    CompareWithReference("picking", raycaster, heightfield, MakePickingRays(heightfield, 40000, 11));
+    CompareWithReference("line of sight", raycaster, heightfield, MakeSightRays(heightfield, 40000, 13));
+    CompareWithReference("cell boundaries", raycaster, heightfield, MakeBoundaryRays(heightfield, 60000));
+    CheckEdgeCases(raycaster, heightfield);
+    return TestResult("HeightfieldRaycastTest");
+}
@@ -0,0 +1,259 @@
+#include "Heightfield.h"
+#include "WorkStealingPool.h"
+#include "TestCommon.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+
+// Heightfield: выборка из тайлов Мортона бит в бит совпадает с той же билинейной формулой
+// над построчной картой (на всех уровнях SIMD, для любой длины пачки и точек за краями),
+// нормали векторных путей и пула - со скалярными, пустая карта - плоская земля
+
+namespace
+{
+    // Построчная карта с той же арифметикой, что у Heightfield
+    struct RowMajorHeights
+    {
+        std::vector<float> Values;
+        uint32_t Width;
+        uint32_t Height;
+        float ScaleX, OffsetX, ScaleZ, OffsetZ, HeightScale;
+
+        void Build(const std::vector<float>& values, uint32_t width, uint32_t height,
+                   float sizeX, float sizeZ, float heightScale)
+        {
+            Values = values;
+            Width = width;
+            Height = height;
+            ScaleX = width / sizeX;
+            OffsetX = -0.5f;
+            ScaleZ = -(height / sizeZ);
+            OffsetZ = height - 0.5f;
+            HeightScale = heightScale;
+        }
+
+        float Sample(float x, float z) const
+        {
+            float tx = std::min(std::max(x * ScaleX + OffsetX, -1.0f), (float)Width);
+            float ty = std::min(std::max(z * ScaleZ + OffsetZ, -1.0f), (float)Height);
+            float floorX = std::floor(tx);
+            float floorY = std::floor(ty);
+            float fx = tx - floorX;
+            float fy = ty - floorY;
+            int x0 = std::max(0, std::min((int)floorX, (int)Width - 1));
+            int x1 = std::max(0, std::min((int)floorX + 1, (int)Width - 1));
+            int y0 = std::max(0, std::min((int)floorY, (int)Height - 1));
+            int y1 = std::max(0, std::min((int)floorY + 1, (int)Height - 1));
+            float h00 = Values[(size_t)y0 * Width + x0];
+            float h01 = Values[(size_t)y0 * Width + x1];
+            float h10 = Values[(size_t)y1 * Width + x0];
+            float h11 = Values[(size_t)y1 * Width + x1];
+            float top = h00 + (h01 - h00) * fx;
+            float bottom = h10 + (h11 - h10) * fx;
+            return (top + (bottom - top) * fy) * HeightScale;
+        }
+    };
+
+    const SimdLevel Levels[] = { SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2 };
+
+    void CheckAgainstRowMajor(const char* name, const std::vector<float>& values, uint32_t width, uint32_t height)
+    {
+        RowMajorHeights reference;
+        reference.Build(values, width, height, TestWorld::TerrainSize, TestWorld::TerrainSize, TestWorld::HeightScale);
+        Heightfield heightfield;
+        heightfield.Build(values, width, height, TestWorld::TerrainSize, TestWorld::TerrainSize, TestWorld::HeightScale);
+        TEST_CHECK(heightfield.GetWidth() == width && heightfield.GetHeight() == height);
+
+        // Тексели на своих местах
+        int texelMismatches = 0;
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                texelMismatches += heightfield.GetSample((int)x, (int)y) != values[(size_t)y * width + x];
+            }
+        }
+        TEST_CHECK_MSG(texelMismatches == 0, "%s: %d texels misplaced", name, texelMismatches);
+
+        // Случайные точки с запасом за краями карты, плюс крайние значения
+        const size_t count = 100000;
+        std::vector<float> x(count), z(count), expected(count), heights(count);
+        TestRandom random(11);
+        for (size_t i = 0; i < count; i++)
+        {
+            x[i] = random.Uniform(-100.0f, TestWorld::TerrainSize + 100.0f);
+            z[i] = random.Uniform(-100.0f, TestWorld::TerrainSize + 100.0f);
+        }
+        const float edgeX[] = { -1e30f, 1e30f, 0.0f, TestWorld::TerrainSize, -0.0f, TestWorld::TerrainSize - 0.0001f, 1024.0f, 0.25f };
+        const float edgeZ[] = { 0.0f, TestWorld::TerrainSize, -1e30f, 1e30f, TestWorld::TerrainSize, 0.25f, -0.0f, TestWorld::TerrainSize - 0.0001f };
+        std::copy(std::begin(edgeX), std::end(edgeX), x.begin());
+        std::copy(std::begin(edgeZ), std::end(edgeZ), z.begin());
+        for (size_t i = 0; i < count; i++)
+        {
+            expected[i] = reference.Sample(x[i], z[i]);
+        }
+
+        for (SimdLevel level : Levels)
+        {
+            heightfield.SetSimdLevel(level);
+            heightfield.SampleHeights(x.data(), z.data(), heights.data(), count);
+            size_t mismatches = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                mismatches += std::memcmp(&heights[i], &expected[i], sizeof(float)) != 0;
+            }
+            TEST_CHECK_MSG(mismatches == 0, "%s, level %d: %zu of %zu heights differ",
+                           name, (int)heightfield.GetSimdLevel(), mismatches, count);
+
+            // Пачки любой длины: векторная часть плюс скалярный остаток
+            for (size_t batch = 1; batch <= 17; batch++)
+            {
+                std::fill(heights.begin(), heights.begin() + batch, -1.0f);
+                heightfield.SampleHeights(x.data() + 3, z.data() + 3, heights.data(), batch);
+                TEST_CHECK_MSG(std::memcmp(heights.data(), expected.data() + 3, batch * sizeof(float)) == 0,
+                               "%s, level %d: batch of %zu differs", name, (int)heightfield.GetSimdLevel(), batch);
+            }
+        }
+
+        heightfield.SetSimdLevel(SimdLevel::Scalar);
+        TEST_CHECK(heightfield.SampleHeight(x[100], z[100]) == expected[100]);
+
+        // NaN не должен приводить к чтению за пределами карты
+        const float nanX[8] = { NAN, 0.0f, NAN, 5.0f, 1.0f, NAN, 2.0f, 3.0f };
+        const float nanZ[8] = { 0.0f, NAN, NAN, 5.0f, NAN, 1.0f, 2.0f, 3.0f };
+        float nanHeights[8];
+        for (SimdLevel level : Levels)
+        {
+            heightfield.SetSimdLevel(level);
+            heightfield.SampleHeights(nanX, nanZ, nanHeights, 8);
+        }
+    }
+
+    void CheckNormals(const std::vector<float>& values, uint32_t width, uint32_t height)
+    {
+        Heightfield heightfield(SimdLevel::Scalar);
+        heightfield.Build(values, width, height, TestWorld::TerrainSize, TestWorld::TerrainSize, TestWorld::HeightScale);
+
+        // Больше ParallelQueryThreshold, чтобы пул действительно делил пачку
+        const size_t count = 40000;
+        std::vector<float> x(count), z(count);
+        TestRandom random(23);
+        for (size_t i = 0; i < count; i++)
+        {
+            x[i] = random.Uniform(-10.0f, TestWorld::TerrainSize + 10.0f);
+            z[i] = random.Uniform(-10.0f, TestWorld::TerrainSize + 10.0f);
+        }
+
+        std::vector<float> expected(count * 4);
+        HeightfieldSamples reference = { &expected[0], &expected[count], &expected[count * 2], &expected[count * 3] };
+        heightfield.SampleHeightsAndNormals(x.data(), z.data(), reference, count);
+
+        std::vector<float> heightsOnly(count);
+        heightfield.SampleHeights(x.data(), z.data(), heightsOnly.data(), count);
+        TEST_CHECK(std::memcmp(heightsOnly.data(), reference.Heights, count * sizeof(float)) == 0);
+
+        float worstLength = 0.0f;
+        float lowestY = 1.0f;
+        for (size_t i = 0; i < count; i++)
+        {
+            float length = std::sqrt(reference.NormalX[i] * reference.NormalX[i] + reference.NormalY[i] * reference.NormalY[i] +
+                                     reference.NormalZ[i] * reference.NormalZ[i]);
+            worstLength = std::max(worstLength, std::fabs(length - 1.0f));
+            lowestY = std::min(lowestY, reference.NormalY[i]);
+        }
+        TEST_CHECK_MSG(worstLength < 1e-5f, "normal length off by %g", worstLength);
+        TEST_CHECK_MSG(lowestY > 0.0f, "normal pointing down: y = %g", lowestY);
+
+        WorkStealingPool pool(4);
+        std::vector<float> actual(count * 4);
+        HeightfieldSamples output = { &actual[0], &actual[count], &actual[count * 2], &actual[count * 3] };
+        for (SimdLevel level : Levels)
+        {
+            heightfield.SetSimdLevel(level);
+            for (WorkStealingPool* p : { (WorkStealingPool*)nullptr, &pool })
+            {
+                std::fill(actual.begin(), actual.end(), -1.0f);
+                heightfield.SampleHeightsAndNormals(x.data(), z.data(), output, count, p);
+                TEST_CHECK_MSG(std::memcmp(actual.data(), expected.data(), actual.size() * sizeof(float)) == 0,
+                               "level %d%s: normals differ from scalar", (int)heightfield.GetSimdLevel(), p ? " on the pool" : "");
+
+                std::fill(heightsOnly.begin(), heightsOnly.end(), -1.0f);
+                heightfield.SampleHeights(x.data(), z.data(), heightsOnly.data(), count, p);
+                TEST_CHECK(std::memcmp(heightsOnly.data(), reference.Heights, count * sizeof(float)) == 0);
+            }
+        }
+    }
+
+    void CheckSlopeAndEmpty()
+    {
+        // Наклон по x: 64 тексела на 2048 единиц, значение растёт на 1/64 на тексель.
+        // x = 1024 - тексель 31.5, нормаль - normalize(hL - hR, 2, 0) в мировых единицах высоты
+        const uint32_t size = 64;
+        std::vector<float> ramp(size * size);
+        for (uint32_t y = 0; y < size; y++)
+        {
+            for (uint32_t x = 0; x < size; x++)
+            {
+                ramp[y * size + x] = (float)x / size;
+            }
+        }
+        Heightfield heightfield;
+        heightfield.Build(ramp, size, size, TestWorld::TerrainSize, TestWorld::TerrainSize, TestWorld::HeightScale);
+
+        float x = 1024.0f;
+        float z = 700.0f;
+        float h, nx, ny, nz;
+        HeightfieldSamples output = { &h, &nx, &ny, &nz };
+        heightfield.SampleHeightsAndNormals(&x, &z, output, 1);
+        float slope = -2.0f * TestWorld::HeightScale / size;
+        float length = std::sqrt(slope * slope + 4.0f);
+        TEST_CHECK_MSG(std::fabs(h - 31.5f / size * TestWorld::HeightScale) < 1e-3f, "ramp height %g", h);
+        TEST_CHECK_MSG(std::fabs(nx - slope / length) < 1e-6f && std::fabs(ny - 2.0f / length) < 1e-6f && nz == 0.0f,
+                       "ramp normal (%g, %g, %g)", nx, ny, nz);
+
+        // Пустая карта - высота 0 и нормаль вверх
+        Heightfield empty;
+        empty.Build(std::vector<float>(), 0, 0, TestWorld::TerrainSize, TestWorld::TerrainSize, TestWorld::HeightScale);
+        TEST_CHECK(empty.IsEmpty());
+        TEST_CHECK(empty.SampleHeight(10.0f, 10.0f) == 0.0f);
+        h = -1.0f;
+        empty.SampleHeights(&x, &z, &h, 1);
+        TEST_CHECK(h == 0.0f);
+        empty.SampleHeightsAndNormals(&x, &z, output, 1);
+        TEST_CHECK(h == 0.0f && nx == 0.0f && ny == 1.0f && nz == 0.0f);
+
+        // Данных меньше, чем width * height - карта остаётся пустой
+        heightfield.Build(ramp, size + 1, size, TestWorld::TerrainSize, TestWorld::TerrainSize, TestWorld::HeightScale);
+        TEST_CHECK(heightfield.IsEmpty());
+    }
+}
+
+int main()
+{
+    std::vector<float> values;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    if (!LoadTestHeights(values, width, height))
+    {
+        std::printf("cannot load Terrain/003/Height_Out.tif\n");
+        return 1;
+    }
+    std::printf("supported SIMD level %d\n", (int)GetSupportedSimdLevel());
+
+    CheckAgainstRowMajor("height map", values, width, height);
+
+    // Размеры не кратны тайлу 8x8 и не квадратные
+    const uint32_t oddWidth = std::min(width, 509u);
+    const uint32_t oddHeight = std::min(height, 300u);
+    std::vector<float> odd((size_t)oddWidth * oddHeight);
+    for (uint32_t y = 0; y < oddHeight; y++)
+    {
+        std::copy_n(&values[(size_t)y * width], oddWidth, &odd[(size_t)y * oddWidth]);
+    }
+    CheckAgainstRowMajor("509x300 crop", odd, oddWidth, oddHeight);
+
+    CheckNormals(values, width, height);
+    CheckSlopeAndEmpty();
+    return TestResult("HeightfieldTest");
+}
@@ -0,0 +1,228 @@
+#include "QuadTree.h"
+#include "HeightPyramid.h"
+#include "Heightfield.h"
+#include "HeightfieldRaycast.h"
+#include "WorkStealingPool.h"
+#include "TestCommon.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+
+// Отсечение перекрытых узлов консервативно: эталонное изображение трассируется через пирамиду
+// камеры по Heightfield (HeightfieldRaycaster), и узел, в который попал хоть один пиксель,
+// обязан остаться в списке после горизонта (SetOcclusionCulling), буфера глубины
+// (SetDepthOcclusion) и обоих вместе. Камеры случайные, на 10, 50 и 200 единицах над землёй,
+// наклон -20..20 градусов - у земли отсекается больше всего и ошибиться проще всего.
+
+namespace
+{
+    const uint32_t ImageWidth = 320;
+    const uint32_t ImageHeight = 180;
+    const float Clearances[] = { 10.0f, 50.0f, 200.0f };
+
+    struct World
+    {
+        Heightfield Field;
+        HeightfieldRaycaster Raycaster;
+        HeightPyramid Pyramid;
+    };
+
+    void SetUpTree(QuadTree& tree, const World& world, int depth)
+    {
+        tree.Initialize(TestWorld::TerrainSize, depth, { 200.0f, 500.0f, 1000.0f });
+        tree.RefitHeights(world.Pyramid, TestWorld::HeightBoundsMargin);
+        tree.SetScreenSpaceErrorParams(TestWorld::CameraFovDegrees * 3.14159265f / 180.0f,
+                                       TestWorld::ViewportHeight, TestWorld::LodPixelTolerance);
+        tree.ComputeGeometricErrors(world.Pyramid, TestWorld::LodErrorGridResolution);
+        tree.SetSelectionMode(LODSelectionMode::ScreenSpaceError);
+    }
+
+    // Узлы списка видимых не перекрываются; сетка самого мелкого уровня переводит точку
+    // попадания в позицию узла в списке
+    class NodeLookup
+    {
+    public:
+        NodeLookup(const QuadTree& tree, int depth, const std::vector<QuadTreeRenderNode>& nodes)
+            : mResolution(1u << depth), mCellSize(TestWorld::TerrainSize / mResolution),
+              mCells((size_t)mResolution * mResolution, -1)
+        {
+            for (size_t i = 0; i < nodes.size(); i++)
+            {
+                BoundingBox bounds = tree.GetNodeBounds(nodes[i].NodeIndex);
+                int x0 = (int)std::lround((bounds.Center.x - bounds.Extents.x) / mCellSize);
+                int x1 = (int)std::lround((bounds.Center.x + bounds.Extents.x) / mCellSize);
+                int z0 = (int)std::lround((bounds.Center.z - bounds.Extents.z) / mCellSize);
+                int z1 = (int)std::lround((bounds.Center.z + bounds.Extents.z) / mCellSize);
+                for (int z = std::max(z0, 0); z < std::min(z1, (int)mResolution); z++)
+                {
+                    for (int x = std::max(x0, 0); x < std::min(x1, (int)mResolution); x++)
+                    {
+                        mCells[(size_t)z * mResolution + x] = (int)i;
+                    }
+                }
+            }
+        }
+
+        int Find(float x, float z) const
+        {
+            int cellX = (int)std::floor(x / mCellSize);
+            int cellZ = (int)std::floor(z / mCellSize);
+            if (cellX < 0 || cellZ < 0 || cellX >= (int)mResolution || cellZ >= (int)mResolution)
+            {
+                return -1;
+            }
+            return mCells[(size_t)cellZ * mResolution + cellX];
+        }
+
+    private:
+        uint32_t mResolution;
+        float mCellSize;
+        std::vector<int> mCells;
+    };
+
+    // Режимы отсечения в порядке проверки
+    const char* const ModeNames[] = { "horizon", "depth buffer", "both" };
+    const int ModeCount = 3;
+
+    void CheckConservative(const World& world, int depth, int cameraCount, WorkStealingPool& pool)
+    {
+        QuadTree frustumOnly;
+        QuadTree culled[ModeCount];
+        SetUpTree(frustumOnly, world, depth);
+        for (int m = 0; m < ModeCount; m++)
+        {
+            SetUpTree(culled[m], world, depth);
+            culled[m].SetOcclusionCulling(m != 1);
+            culled[m].SetDepthOcclusion(m != 0);
+            culled[m].SetParallelUpdate(&pool);
+        }
+
+        TestRandom random(7);
+        uint64_t violations[ModeCount] = {};
+        uint64_t removed[ModeCount][3] = {};
+        uint64_t visible[3] = {};
+        uint64_t unseenNodes = 0;
+        uint64_t statMismatches = 0;
+        std::vector<char> kept;
+        std::vector<char> seen;
+        for (int c = 0; c < cameraCount; c++)
+        {
+            TestCameraPose pose;
+            pose.X = random.Uniform(40.0f, TestWorld::TerrainSize - 40.0f);
+            pose.Z = random.Uniform(40.0f, TestWorld::TerrainSize - 40.0f);
+            pose.Y = world.Field.SampleHeight(pose.X, pose.Z) + Clearances[c % 3];
+            pose.Pitch = random.Uniform(-20.0f, 20.0f);
+            pose.Yaw = random.Uniform(0.0f, 360.0f);
+            Camera camera = MakeTestCamera(pose);
+
+            frustumOnly.Update(camera.GetPosition(), camera.GetFrustum());
+            const std::vector<QuadTreeRenderNode>& all = frustumOnly.GetVisibleNodes();
+            visible[c % 3] += all.size();
+
+            // Бит m - узел остался после режима m
+            kept.assign(frustumOnly.GetNodeSlotCount(), 0);
+            for (int m = 0; m < ModeCount; m++)
+            {
+                culled[m].Update(camera.GetPosition(), camera.GetFrustum());
+                const std::vector<QuadTreeRenderNode>& survivors = culled[m].GetVisibleNodes();
+                removed[m][c % 3] += all.size() - survivors.size();
+                for (const QuadTreeRenderNode& node : survivors)
+                {
+                    kept[node.NodeIndex] |= (char)(1 << m);
+                }
+                const QuadTreeCullStats& stats = culled[m].GetCullStats();
+                statMismatches += stats.OccludedNodes + stats.DepthOccludedNodes != all.size() - survivors.size();
+            }
+            NodeLookup lookup(frustumOnly, depth, all);
+            seen.assign(all.size(), 0);
+
+            for (uint32_t py = 0; py < ImageHeight; py++)
+            {
+                for (uint32_t px = 0; px < ImageWidth; px++)
+                {
+                    XMFLOAT3 origin, direction;
+                    camera.GetPickRay(px + 0.5f, py + 0.5f, (float)ImageWidth, (float)ImageHeight, origin, direction);
+                    TerrainRay ray = { origin.x, origin.y, origin.z, direction.x, direction.y, direction.z, 10000.0f };
+                    float distance;
+                    if (!world.Raycaster.Raycast(ray, distance))
+                    {
+                        continue;
+                    }
+
+                    // Точка на границе узлов видна обоим соседям
+                    float hitX = origin.x + direction.x * distance;
+                    float hitZ = origin.z + direction.z * distance;
+                    const float epsilon = 1e-3f;
+                    for (int corner = 0; corner < 4; corner++)
+                    {
+                        int i = lookup.Find(hitX + (corner & 1 ? epsilon : -epsilon), hitZ + (corner & 2 ? epsilon : -epsilon));
+                        if (i < 0 || seen[i])
+                        {
+                            continue;
+                        }
+                        seen[i] = 1;
+                        for (int m = 0; m < ModeCount; m++)
+                        {
+                            if (!(kept[all[i].NodeIndex] & (1 << m)) && violations[m]++ < 5)
+                            {
+                                std::printf("depth %d camera %d, %s: node %u culled, but pixel (%u, %u) hits it\n",
+                                            depth, c, ModeNames[m], all[i].NodeIndex, px, py);
+                            }
+                        }
+                    }
+                }
+            }
+            for (char s : seen)
+            {
+                unseenNodes += !s;
+            }
+        }
+
+        uint64_t totalVisible = visible[0] + visible[1] + visible[2];
+        std::printf("depth %d, %d cameras: %.1f nodes/frame, %.1f%% with no pixel\n",
+                    depth, cameraCount, (double)totalVisible / cameraCount, 100.0 * unseenNodes / totalVisible);
+        for (int m = 0; m < ModeCount; m++)
+        {
+            uint64_t totalRemoved = removed[m][0] + removed[m][1] + removed[m][2];
+            std::printf("  %-12s removes %.1f%% (%.1f%% / %.1f%% / %.1f%% at 10 / 50 / 200 above ground)\n",
+                        ModeNames[m], 100.0 * totalRemoved / totalVisible, 100.0 * removed[m][0] / visible[0],
+                        100.0 * removed[m][1] / visible[1], 100.0 * removed[m][2] / visible[2]);
+            TEST_CHECK_MSG(violations[m] == 0, "depth %d, %s: %llu visible nodes culled",
+                           depth, ModeNames[m], (unsigned long long)violations[m]);
+            // Отсечение вообще работает, иначе проверка выше ничего не значит
+            TEST_CHECK_MSG(totalRemoved > 0, "depth %d, %s: nothing culled", depth, ModeNames[m]);
+            TEST_CHECK(totalRemoved <= unseenNodes);
+        }
+        TEST_CHECK(statMismatches == 0);
+    }
+}
+
+int main()
+{
+    std::vector<float> values;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    if (!LoadTestHeights(values, width, height))
+    {
+        std::printf("cannot load Terrain/003/Height_Out.tif\n");
+        return 1;
+    }
+
+    World world;
+    world.Field.Build(values, width, height, TestWorld::TerrainSize, TestWorld::TerrainSize, TestWorld::HeightScale);
+    world.Raycaster.Build(world.Field);
+    for (float& value : values)
+    {
+        value *= TestWorld::HeightScale;
+    }
+    world.Pyramid.Build(values, width, height);
+
+    // Глубина 4 - как в приложении, 6 - мелкие узлы загораживают своими боксами
+    // Растеризатор всегда работает на пуле, как в приложении
+    WorkStealingPool pool(4);
+    CheckConservative(world, 4, 90, pool);
+    CheckConservative(world, 6, 60, pool);
+    return TestResult("OcclusionCullingTest");
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "QuadTree.h"
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <memory>
+#include <vector>
+#include <cmath>
+
+// Прежняя реализация Quadtree (до пула узлов): каждый узел выделяется отдельно,
+// дети - std::unique_ptr, обход рекурсивный, BoundingFrustum::Contains на каждый узел.
+// Оставлена как эталон для теста раскладки и бенчмарка обхода.
+class PointerQuadTree
+{
+public:
+    struct Node
+    {
+        DirectX::BoundingBox Bounds;
+        DirectX::XMFLOAT3 Center;
+        float Size;
+        int Depth;
+        LODLevel CurrentLOD;
+        bool IsLeaf;
+        std::unique_ptr<Node> Children[4];
+        uint32_t VertexOffset;
+        uint32_t IndexOffset;
+        uint32_t IndexCount;
+        DirectX::XMFLOAT2 TexCoordMin;
+        DirectX::XMFLOAT2 TexCoordMax;
+
+        Node() : Size(0), Depth(0), CurrentLOD(LODLevel::LOD0), IsLeaf(true),
+                 VertexOffset(0), IndexOffset(0), IndexCount(0) {}
+    };
+
+    struct RenderNode
+    {
+        PointerQuadTree::Node* Node;
+        LODLevel LOD;
+        float DistanceToCamera;
+    };
+
+    void Initialize(float terrainSize, int maxDepth, const std::vector<float>& lodDistances)
+    {
+        mTerrainSize = terrainSize;
+        mMaxDepth = maxDepth;
+        mLodDistances = lodDistances;
+        mRoot = std::make_unique<Node>();
+        BuildTree(mRoot.get(), 0, 0, terrainSize, 0);
+    }
+
+    void Update(const DirectX::XMFLOAT3& cameraPos, const DirectX::BoundingFrustum& frustum)
+    {
+        mVisibleNodes.clear();
+        if (mRoot)
+        {
+            UpdateNode(mRoot.get(), cameraPos, frustum);
+        }
+    }
+
+    const std::vector<RenderNode>& GetVisibleNodes() const { return mVisibleNodes; }
+
+private:
+    void BuildTree(Node* node, float x, float z, float size, int depth)
+    {
+        node->Size = size;
+        node->Depth = depth;
+        node->Center = DirectX::XMFLOAT3(x + size * 0.5f, 0, z + size * 0.5f);
+        node->Bounds = DirectX::BoundingBox(DirectX::XMFLOAT3(x + size * 0.5f, 250.0f, z + size * 0.5f),
+                                            DirectX::XMFLOAT3(size * 0.5f, 250.0f, size * 0.5f));
+        node->TexCoordMin = DirectX::XMFLOAT2(x / mTerrainSize, 1.0f - (z + size) / mTerrainSize);
+        node->TexCoordMax = DirectX::XMFLOAT2((x + size) / mTerrainSize, 1.0f - z / mTerrainSize);
+
+        if (depth >= mMaxDepth)
+        {
+            node->IsLeaf = true;
+            return;
+        }
+
+        node->IsLeaf = false;
+        float halfSize = size * 0.5f;
+        for (int i = 0; i < 4; i++)
+        {
+            node->Children[i] = std::make_unique<Node>();
+        }
+        BuildTree(node->Children[0].get(), x, z, halfSize, depth + 1);
+        BuildTree(node->Children[1].get(), x + halfSize, z, halfSize, depth + 1);
+        BuildTree(node->Children[2].get(), x, z + halfSize, halfSize, depth + 1);
+        BuildTree(node->Children[3].get(), x + halfSize, z + halfSize, halfSize, depth + 1);
+    }
+
+    void UpdateNode(Node* node, const DirectX::XMFLOAT3& cameraPos, const DirectX::BoundingFrustum& frustum)
+    {
+        if (frustum.Contains(node->Bounds) == DirectX::DISJOINT)
+        {
+            return;
+        }
+
+        float dx = node->Center.x - cameraPos.x;
+        float dy = node->Center.y - cameraPos.y;
+        float dz = node->Center.z - cameraPos.z;
+        float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+        LODLevel lod = CalculateLOD(distance);
+        node->CurrentLOD = lod;
+
+        int requiredDepth = static_cast<int>(lod);
+        bool shouldSubdivide = !node->IsLeaf && (mMaxDepth - node->Depth) > requiredDepth;
+        if (shouldSubdivide)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                if (node->Children[i])
+                {
+                    UpdateNode(node->Children[i].get(), cameraPos, frustum);
+                }
+            }
+        }
+        else
+        {
+            mVisibleNodes.push_back({ node, lod, distance });
+        }
+    }
+
+    LODLevel CalculateLOD(float distance) const
+    {
+        for (size_t i = 0; i < mLodDistances.size(); i++)
+        {
+            if (distance < mLodDistances[i])
+            {
+                return static_cast<LODLevel>(i);
+            }
+        }
+        return static_cast<LODLevel>(mLodDistances.size());
+    }
+
+    std::unique_ptr<Node> mRoot;
+    std::vector<RenderNode> mVisibleNodes;
+    std::vector<float> mLodDistances;
+    float mTerrainSize = 0.0f;
+    int mMaxDepth = 0;
+};
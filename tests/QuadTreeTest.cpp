@@ -0,0 +1,325 @@
+#include "QuadTree.h"
+#include "PointerQuadTree.h"
+#include "HeightPyramid.h"
+#include "Heightfield.h"
+#include "TerrainInstanceBuilder.h"
+#include "TerrainTessellation.h"
+#include "TestCommon.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+
+// Плотная раскладка пула узлов, совпадение обхода с прежним деревом на указателях,
+// переключение режимов выбора LOD и выбор узлов под бюджет треугольников
+
+namespace
+{
+    void CheckLayout(int maxDepth)
+    {
+        QuadTree tree;
+        tree.Initialize(TestWorld::TerrainSize, maxDepth, { 200.0f, 500.0f, 1000.0f });
+
+        uint32_t expectedNodes = 0;
+        for (int depth = 0; depth <= maxDepth; depth++)
+        {
+            expectedNodes += 1u << (2 * depth);
+        }
+        TEST_CHECK(tree.GetNodeCount() == expectedNodes);
+        // Пустуют только три слота блока корня
+        TEST_CHECK_MSG(tree.GetNodeSlotCount() == expectedNodes + 3, "depth %d: %u slots for %u nodes",
+                       maxDepth, tree.GetNodeSlotCount(), expectedNodes);
+
+        std::vector<int> seen(tree.GetNodeSlotCount(), 0);
+        for (int depth = 0; depth <= maxDepth; depth++)
+        {
+            uint32_t levelStart = tree.GetLevelStart(depth);
+            uint32_t levelCount = 1u << (2 * depth);
+            TEST_CHECK(depth == 0 || levelStart % 4 == 0);
+
+            for (uint32_t index = levelStart; index < levelStart + levelCount; index++)
+            {
+                seen[index]++;
+                TEST_CHECK(tree.GetNodeDepth(index) == depth);
+                if (depth == maxDepth)
+                {
+                    continue;
+                }
+
+                // Дети - целый блок, квадранты родителя в порядке NW, NE, SW, SE
+                uint32_t child = tree.FirstChild(index, depth);
+                TEST_CHECK(child % 4 == 0);
+                BoundingBox parent = tree.GetNodeBounds(index);
+                for (uint32_t i = 0; i < 4; i++)
+                {
+                    TEST_CHECK(tree.Parent(child + i, depth + 1) == index);
+                    BoundingBox bounds = tree.GetNodeBounds(child + i);
+                    float expectedX = parent.Center.x + ((i & 1) ? 0.5f : -0.5f) * parent.Extents.x;
+                    float expectedZ = parent.Center.z + ((i & 2) ? 0.5f : -0.5f) * parent.Extents.z;
+                    TEST_CHECK(bounds.Center.x == expectedX && bounds.Center.z == expectedZ);
+                    TEST_CHECK(bounds.Extents.x == parent.Extents.x * 0.5f);
+                }
+            }
+        }
+
+        // Каждый узел ровно в одном слоте, пустые - только 1..3
+        for (uint32_t index = 0; index < tree.GetNodeSlotCount(); index++)
+        {
+            TEST_CHECK(seen[index] == ((index >= 1 && index <= 3) ? 0 : 1));
+        }
+    }
+
+    void CheckTraversal(int maxDepth, uint32_t frames)
+    {
+        const std::vector<float> lodDistances = { 200.0f, 500.0f, 1000.0f };
+        QuadTree tree;
+        tree.Initialize(TestWorld::TerrainSize, maxDepth, lodDistances);
+        PointerQuadTree reference;
+        reference.Initialize(TestWorld::TerrainSize, maxDepth, lodDistances);
+
+        int mismatchedFrames = 0;
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            Camera camera = MakeTestCamera(FlightPathPose(frame, frames));
+            BoundingFrustum frustum = camera.GetFrustum();
+            tree.Update(camera.GetPosition(), frustum);
+            reference.Update(camera.GetPosition(), frustum);
+
+            const auto& nodes = tree.GetVisibleNodes();
+            const auto& expected = reference.GetVisibleNodes();
+            bool same = nodes.size() == expected.size();
+            for (size_t i = 0; same && i < nodes.size(); i++)
+            {
+                BoundingBox bounds = tree.GetNodeBounds(nodes[i].NodeIndex);
+                const BoundingBox& expectedBounds = expected[i].Node->Bounds;
+                same = bounds.Center.x == expectedBounds.Center.x && bounds.Center.z == expectedBounds.Center.z &&
+                       bounds.Extents.x == expectedBounds.Extents.x && nodes[i].LOD == expected[i].LOD;
+            }
+            if (!same)
+            {
+                mismatchedFrames++;
+                std::printf("depth %d frame %u: %zu nodes, pointer tree %zu\n",
+                            maxDepth, frame, nodes.size(), expected.size());
+            }
+        }
+        TEST_CHECK_MSG(mismatchedFrames == 0, "depth %d: %d of %u frames differ", maxDepth, mismatchedFrames, frames);
+    }
+
+    // Режим меняют только SetSelectionMode и SetTriangleBudget; ComputeGeometricErrors лишь считает ошибки
+    void CheckSelectionMode()
+    {
+        const uint32_t mapSize = 257;
+        std::vector<float> heights(mapSize * mapSize);
+        for (uint32_t y = 0; y < mapSize; y++)
+        {
+            for (uint32_t x = 0; x < mapSize; x++)
+            {
+                heights[y * mapSize + x] = 200.0f + 150.0f * std::sin(x * 0.07f) * std::cos(y * 0.05f);
+            }
+        }
+        HeightPyramid pyramid;
+        pyramid.Build(heights, mapSize, mapSize);
+
+        QuadTree tree;
+        tree.Initialize(TestWorld::TerrainSize, 4, { 200.0f, 500.0f, 1000.0f });
+        TEST_CHECK(tree.GetSelectionMode() == LODSelectionMode::Distance);
+
+        tree.SetScreenSpaceErrorParams(TestWorld::CameraFovDegrees * 3.14159265f / 180.0f,
+                                       TestWorld::ViewportHeight, TestWorld::LodPixelTolerance);
+        tree.ComputeGeometricErrors(pyramid, TestWorld::LodErrorGridResolution);
+        TEST_CHECK(tree.GetSelectionMode() == LODSelectionMode::Distance);
+        TEST_CHECK(tree.GetNodeGeometricError(QuadTree::RootIndex) > 0.0f);
+
+        tree.SetSelectionMode(LODSelectionMode::ScreenSpaceError);
+        TEST_CHECK(tree.GetSelectionMode() == LODSelectionMode::ScreenSpaceError);
+        tree.ComputeGeometricErrors(pyramid, TestWorld::LodErrorGridResolution);
+        TEST_CHECK(tree.GetSelectionMode() == LODSelectionMode::ScreenSpaceError);
+
+        tree.SetTriangleBudget(100000, 4096, TestWorld::BasePatchSize);
+        TEST_CHECK(tree.GetSelectionMode() == LODSelectionMode::TriangleBudget);
+        tree.ComputeGeometricErrors(pyramid, TestWorld::LodErrorGridResolution);
+        TEST_CHECK(tree.GetSelectionMode() == LODSelectionMode::TriangleBudget);
+    }
+
+    bool SameNodes(const std::vector<QuadTreeRenderNode>& a, const std::vector<QuadTreeRenderNode>& b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (a[i].NodeIndex != b[i].NodeIndex || a[i].LOD != b[i].LOD)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Инкрементальный Update с нулевыми порогами против полного обхода вдоль облёта с дрожанием
+    // камеры: переиспользованные поддеревья должны давать тот же список узлов кадр в кадр
+    void CheckIncrementalUpdate(int maxDepth, uint32_t frames)
+    {
+        std::vector<float> heights;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        if (!LoadTestWorldHeights(heights, width, height))
+        {
+            TEST_CHECK_MSG(false, "cannot load Terrain/003/Height_Out.tif");
+            return;
+        }
+        HeightPyramid pyramid;
+        pyramid.Build(heights, width, height);
+
+        QuadTree full;
+        QuadTree incremental;
+        for (QuadTree* tree : { &full, &incremental })
+        {
+            tree->Initialize(TestWorld::TerrainSize, maxDepth, { 200.0f, 500.0f, 1000.0f });
+            tree->RefitHeights(pyramid, TestWorld::HeightBoundsMargin);
+            tree->SetScreenSpaceErrorParams(TestWorld::CameraFovDegrees * 3.14159265f / 180.0f,
+                                            TestWorld::ViewportHeight, TestWorld::LodPixelTolerance);
+            tree->ComputeGeometricErrors(pyramid, TestWorld::LodErrorGridResolution);
+            tree->SetSelectionMode(LODSelectionMode::ScreenSpaceError);
+        }
+        incremental.SetIncrementalUpdate(true, 0.0f, 0.0f);
+
+        TestRandom random(7);
+        uint32_t mismatches = 0;
+        uint64_t reusedNodes = 0;
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            TestCameraPose pose = FlightPathPose(frame, frames);
+            pose.X += random.Uniform(-0.5f, 0.5f);
+            pose.Y += random.Uniform(-0.5f, 0.5f);
+            pose.Z += random.Uniform(-0.5f, 0.5f);
+            pose.Pitch += random.Uniform(-0.1f, 0.1f);
+            pose.Yaw += random.Uniform(-0.1f, 0.1f);
+            Camera camera = MakeTestCamera(pose);
+
+            full.Update(camera.GetPosition(), camera.GetFrustum());
+            incremental.Update(camera.GetPosition(), camera.GetFrustum());
+            reusedNodes += incremental.GetCullStats().ReusedNodes;
+            if (!SameNodes(full.GetVisibleNodes(), incremental.GetVisibleNodes()) && mismatches++ < 5)
+            {
+                std::printf("depth %d frame %u: incremental %zu nodes, full traversal %zu\n", maxDepth, frame,
+                            incremental.GetVisibleNodes().size(), full.GetVisibleNodes().size());
+            }
+        }
+        TEST_CHECK_MSG(mismatches == 0, "depth %d: %u of %u frames differ from the full traversal",
+                       maxDepth, mismatches, frames);
+        // Без переиспользования проверка ничего не значит
+        TEST_CHECK_MSG(reusedNodes > 0, "depth %d: no subtree was reused", maxDepth);
+    }
+
+    // TriangleBudget на реальной карте высот: без ограничений выбор совпадает с ScreenSpaceError,
+    // с бюджетом - не выходит за него, а счётчики выбора совпадают с TerrainTrianglePredictor
+    // на построенных экземплярах, то есть с тем, что реально уйдёт на GPU
+    void CheckTriangleBudget()
+    {
+        std::vector<float> heights;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        if (!LoadTestWorldHeights(heights, width, height))
+        {
+            TEST_CHECK_MSG(false, "cannot load Terrain/003/Height_Out.tif");
+            return;
+        }
+        HeightPyramid pyramid;
+        pyramid.Build(heights, width, height);
+        Heightfield heightfield;
+        heightfield.Build(heights, width, height, TestWorld::TerrainSize, TestWorld::TerrainSize, 1.0f);
+
+        auto setUp = [&](QuadTree& tree)
+        {
+            tree.Initialize(TestWorld::TerrainSize, 4, { 200.0f, 500.0f, 1000.0f });
+            tree.RefitHeights(pyramid, TestWorld::HeightBoundsMargin);
+            tree.SetScreenSpaceErrorParams(TestWorld::CameraFovDegrees * 3.14159265f / 180.0f,
+                                           TestWorld::ViewportHeight, TestWorld::LodPixelTolerance);
+            tree.ComputeGeometricErrors(pyramid, TestWorld::LodErrorGridResolution);
+        };
+        QuadTree screenSpace;
+        QuadTree budgeted;
+        setUp(screenSpace);
+        setUp(budgeted);
+        screenSpace.SetSelectionMode(LODSelectionMode::ScreenSpaceError);
+
+        TerrainInstanceBuilder instances;
+        instances.Configure((float)TestWorld::TileSize, TestWorld::TilesX, TestWorld::TilesY, TestWorld::PatchesPerTile);
+        TerrainTrianglePredictor predictor;
+
+        // Низкие облёты с наклоном вниз: здесь ScreenSpaceError и выходит далеко за бюджет
+        TestRandom random(1);
+        auto randomPose = [&]()
+        {
+            TestCameraPose pose;
+            pose.X = random.Uniform(24.0f, TestWorld::TerrainSize - 24.0f);
+            pose.Z = random.Uniform(24.0f, TestWorld::TerrainSize - 24.0f);
+            pose.Y = heightfield.SampleHeight(pose.X, pose.Z) + 5.0f + random.Uniform(0.0f, 1.0f) * random.Uniform(0.0f, 800.0f);
+            pose.Pitch = random.Uniform(-10.0f, 30.0f);
+            pose.Yaw = random.Uniform(0.0f, 360.0f);
+            return pose;
+        };
+
+        budgeted.SetTriangleBudget(UINT32_MAX, UINT32_MAX, TestWorld::BasePatchSize);
+        int differentViews = 0;
+        for (int view = 0; view < 100; view++)
+        {
+            Camera camera = MakeTestCamera(randomPose());
+            screenSpace.Update(camera.GetPosition(), camera.GetFrustum());
+            budgeted.Update(camera.GetPosition(), camera.GetFrustum());
+            differentViews += !SameNodes(screenSpace.GetVisibleNodes(), budgeted.GetVisibleNodes());
+        }
+        TEST_CHECK_MSG(differentViews == 0, "unlimited budget differs from ScreenSpaceError in %d views", differentViews);
+
+        const uint32_t budgets[][2] = { { 1500000, UINT32_MAX }, { 500000, UINT32_MAX }, { UINT32_MAX, 600 } };
+        for (const auto& budget : budgets)
+        {
+            budgeted.SetTriangleBudget(budget[0], budget[1], TestWorld::BasePatchSize);
+            int overBudget = 0;
+            int countMismatches = 0;
+            int limitedViews = 0;
+            for (int view = 0; view < 100; view++)
+            {
+                Camera camera = MakeTestCamera(randomPose());
+                XMFLOAT3 eye = camera.GetPosition();
+                budgeted.Update(eye, camera.GetFrustum());
+                const QuadTreeCullStats& stats = budgeted.GetCullStats();
+
+                instances.Build(budgeted, budgeted.GetVisibleNodes());
+                predictor.Predict(instances, eye, TestWorld::BasePatchSize);
+                // Грубее корней выбрать нечего: превышение допустимо только если не было ни одного разбиения
+                bool over = predictor.GetTotalTriangles() > budget[0] || predictor.GetPatchCount() > budget[1];
+                overBudget += over && stats.BudgetSplits > 0;
+                countMismatches += predictor.GetTotalTriangles() != stats.BudgetTriangles ||
+                                   predictor.GetPatchCount() != stats.BudgetPatches;
+                limitedViews += stats.BudgetExhausted;
+            }
+            TEST_CHECK_MSG(overBudget == 0, "budget %u triangles / %u patches: %d views over", budget[0], budget[1], overBudget);
+            TEST_CHECK_MSG(countMismatches == 0, "budget %u / %u: %d views disagree with the predictor",
+                           budget[0], budget[1], countMismatches);
+            // Бюджет должен хоть где-то ограничивать, иначе проверки выше ничего не значат
+            TEST_CHECK_MSG(limitedViews > 0, "budget %u / %u never limits refinement", budget[0], budget[1]);
+        }
+    }
+}
+
+int main()
+{
+    for (int depth = 0; depth <= 8; depth++)
+    {
+        CheckLayout(depth);
+    }
+
+    CheckTraversal(4, 200);
+    CheckTraversal(6, 100);
+    CheckTraversal(8, 20);
+
+    CheckSelectionMode();
+    CheckIncrementalUpdate(4, 2000);
+    CheckIncrementalUpdate(6, 3000);
+    CheckTriangleBudget();
+
+    return TestResult("QuadTreeTest");
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "Heightfield.h"
+#include "HeightfieldRaycast.h"
+#include "TestCommon.h"
+#include <algorithm>
+#include <vector>
+#include <cmath>
+
+// Эталонное пересечение и наборы лучей для теста и бенчмарка HeightfieldRaycaster.
+
+// Наивное пересечение луча с поверхностью Heightfield: DDA по всем билинейным ячейкам,
+// которые пересекает луч, в каждой - то же квадратное уравнение луч - патч, что у
+// HeightfieldRaycaster, без иерархии. Real = double - эталон для теста, float - базовая
+// линия бенчмарка. cellBounds - пропуск ячейки, над максимумом углов которой луч проходит
+// целиком (иерархия из одного уровня).
+template <typename Real>
+bool DdaRaycast(const Heightfield& heightfield, const TerrainRay& ray, Real& distance, bool cellBounds = false)
+{
+    const HeightfieldLayout& layout = heightfield.GetLayout();
+    const int width = (int)layout.Width;
+    const int height = (int)layout.Height;
+
+    // Луч в пространстве текселей, как у HeightfieldRaycaster
+    const Real x = ray.OriginX * (Real)layout.ScaleX + layout.OffsetX;
+    const Real y = ray.OriginZ * (Real)layout.ScaleZ + layout.OffsetZ;
+    const Real h = ray.OriginY / (Real)layout.HeightScale;
+    const Real dx = ray.DirectionX * (Real)layout.ScaleX;
+    const Real dy = ray.DirectionZ * (Real)layout.ScaleZ;
+    const Real dh = ray.DirectionY / (Real)layout.HeightScale;
+
+    // Отсечение по прямоугольнику центров текселей: вне его поверхности нет
+    Real t0 = 0;
+    Real t1 = ray.MaxDistance;
+    auto clip = [&](Real origin, Real direction, Real lo, Real hi)
+    {
+        if (direction == 0)
+        {
+            return origin >= lo && origin <= hi;
+        }
+        Real a = (lo - origin) / direction;
+        Real b = (hi - origin) / direction;
+        if (a > b)
+        {
+            std::swap(a, b);
+        }
+        t0 = std::max(t0, a);
+        t1 = std::min(t1, b);
+        return t0 <= t1;
+    };
+    if (!clip(x, dx, -0.5, width - 0.5) || !clip(y, dy, -0.5, height - 0.5))
+    {
+        return false;
+    }
+    if (t0 == 0 && ray.OriginY <= heightfield.SampleHeight(ray.OriginX, ray.OriginZ))
+    {
+        distance = 0;
+        return true;
+    }
+
+    // Ячейка (cx, cy) - патч между текселями cx..cx+1 и cy..cy+1
+    const Real nudge = t0 + (Real)1e-6 * (t1 - t0);
+    int cx = (int)std::floor(x + dx * nudge);
+    int cy = (int)std::floor(y + dy * nudge);
+    const int stepX = dx > 0 ? 1 : -1;
+    const int stepY = dy > 0 ? 1 : -1;
+    const Real deltaX = dx != 0 ? std::fabs(1 / dx) : (Real)1e30;
+    const Real deltaY = dy != 0 ? std::fabs(1 / dy) : (Real)1e30;
+    Real nextX = dx != 0 ? ((dx > 0 ? cx + 1 : cx) - x) / dx : (Real)1e30;
+    Real nextY = dy != 0 ? ((dy > 0 ? cy + 1 : cy) - y) / dy : (Real)1e30;
+
+    Real t = t0;
+    while (t < t1)
+    {
+        const Real exit = std::min(std::min(nextX, nextY), t1);
+        const Real a = heightfield.GetSample(cx, cy);
+        const Real b = heightfield.GetSample(cx + 1, cy);
+        const Real c = heightfield.GetSample(cx, cy + 1);
+        const Real d = heightfield.GetSample(cx + 1, cy + 1);
+
+        bool above = false;
+        if (cellBounds)
+        {
+            Real cellMax = std::max(std::max(a, b), std::max(c, d));
+            above = std::min(h + dh * t, h + dh * exit) > cellMax;
+        }
+        if (!above)
+        {
+            // Зазор луча над патчем qc - qb s - qa s^2, s = 0..exit - t от входа в ячейку
+            const Real e1 = b - a;
+            const Real e2 = c - a;
+            const Real e3 = a - b - c + d;
+            const Real u0 = x + dx * t - cx;
+            const Real v0 = y + dy * t - cy;
+            const Real qa = e3 * dx * dy;
+            const Real qb = e1 * dx + e2 * dy + e3 * (u0 * dy + v0 * dx) - dh;
+            const Real qc = h + dh * t - (a + e1 * u0 + e2 * v0 + e3 * u0 * v0);
+            if (qc <= 0)
+            {
+                distance = t;
+                return true;
+            }
+            Real root = -1;
+            if (std::fabs(qa) < (Real)1e-18)
+            {
+                if (qb > 0)
+                {
+                    root = qc / qb;
+                }
+            }
+            else
+            {
+                Real discriminant = qb * qb + 4 * qa * qc;
+                if (discriminant >= 0)
+                {
+                    Real s = std::sqrt(discriminant);
+                    Real r0 = (-qb - s) / (2 * qa);
+                    Real r1 = (-qb + s) / (2 * qa);
+                    if (r0 > r1)
+                    {
+                        std::swap(r0, r1);
+                    }
+                    root = r0 >= 0 ? r0 : r1;
+                }
+            }
+            if (root >= 0 && root <= exit - t)
+            {
+                distance = t + root;
+                return true;
+            }
+        }
+
+        t = exit;
+        if (nextX < nextY)
+        {
+            cx += stepX;
+            nextX += deltaX;
+        }
+        else
+        {
+            cy += stepY;
+            nextY += deltaY;
+        }
+    }
+    return false;
+}
+
+// Лучи пикинга: камера в 10-310 единицах над землёй смотрит вниз под случайным углом
+inline std::vector<TerrainRay> MakePickingRays(const Heightfield& heightfield, size_t count, uint32_t seed)
+{
+    TestRandom random(seed);
+    std::vector<TerrainRay> rays(count);
+    for (TerrainRay& ray : rays)
+    {
+        ray.OriginX = random.Uniform(0.0f, TestWorld::TerrainSize);
+        ray.OriginZ = random.Uniform(0.0f, TestWorld::TerrainSize);
+        ray.OriginY = heightfield.SampleHeight(ray.OriginX, ray.OriginZ) + random.Uniform(10.0f, 310.0f);
+        float yaw = random.Uniform(0.0f, 6.2831853f);
+        float pitch = -random.Uniform(0.02f, 1.22f);
+        ray.DirectionX = std::cos(yaw) * std::cos(pitch);
+        ray.DirectionY = std::sin(pitch);
+        ray.DirectionZ = std::sin(yaw) * std::cos(pitch);
+        ray.MaxDistance = 10000.0f;
+    }
+    return rays;
+}
+
+// Прямая видимость между случайными точками в 2 единицах над землёй
+inline std::vector<TerrainRay> MakeSightRays(const Heightfield& heightfield, size_t count, uint32_t seed)
+{
+    TestRandom random(seed);
+    std::vector<TerrainRay> rays(count);
+    for (TerrainRay& ray : rays)
+    {
+        float x0 = random.Uniform(0.0f, TestWorld::TerrainSize);
+        float z0 = random.Uniform(0.0f, TestWorld::TerrainSize);
+        float x1 = random.Uniform(0.0f, TestWorld::TerrainSize);
+        float z1 = random.Uniform(0.0f, TestWorld::TerrainSize);
+        float y0 = heightfield.SampleHeight(x0, z0) + 2.0f;
+        float y1 = heightfield.SampleHeight(x1, z1) + 2.0f;
+        float dx = x1 - x0;
+        float dy = y1 - y0;
+        float dz = z1 - z0;
+        float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+        ray = { x0, y0, z0, dx / length, dy / length, dz / length, length };
+    }
+    return rays;
+}
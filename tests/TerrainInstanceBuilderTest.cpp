@@ -0,0 +1,194 @@
+#include "TerrainInstanceBuilder.h"
+#include "QuadTree.h"
+#include "TestCommon.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+
+// Поток экземпляров TerrainInstanceBuilder: выбор сетки, нарезка больших узлов по тайлам,
+// покрытие узлов экземплярами, группировка по сетке и обратная ссылка на узел
+
+namespace
+{
+    const std::vector<float> LodDistances = { 200.0f, 500.0f, 1000.0f };
+
+    void ConfigureBuilder(TerrainInstanceBuilder& builder)
+    {
+        builder.Configure((float)TestWorld::TileSize, TestWorld::TilesX, TestWorld::TilesY, TestWorld::PatchesPerTile);
+    }
+
+    void CheckGrids()
+    {
+        TerrainInstanceBuilder builder;
+        ConfigureBuilder(builder);
+
+        // 16, 8, 4, 2 и 1 патч на ребро
+        TEST_CHECK(builder.GetGridCount() == 5);
+        for (int grid = 0; grid < builder.GetGridCount(); grid++)
+        {
+            TEST_CHECK(builder.GetGridPatchesPerEdge(grid) == (TestWorld::PatchesPerTile >> grid));
+        }
+
+        TEST_CHECK(builder.SelectGrid(16, LODLevel::LOD0) == 0);
+        TEST_CHECK(builder.SelectGrid(16, LODLevel::LOD1) == 1);
+        TEST_CHECK(builder.SelectGrid(16, LODLevel::LOD3) == 3);
+        TEST_CHECK(builder.SelectGrid(8, LODLevel::LOD0) == 1);
+        TEST_CHECK(builder.SelectGrid(4, LODLevel::LOD1) == 3);
+        // Не грубее одного патча на экземпляр
+        TEST_CHECK(builder.SelectGrid(2, LODLevel::LOD3) == 4);
+        TEST_CHECK(builder.SelectGrid(1, LODLevel::LOD0) == 4);
+    }
+
+    void CheckRootSplit()
+    {
+        QuadTree tree;
+        tree.Initialize(TestWorld::TerrainSize, 4, LodDistances);
+        TerrainInstanceBuilder builder;
+        ConfigureBuilder(builder);
+
+        std::vector<QuadTreeRenderNode> nodes = { { QuadTree::RootIndex, LODLevel::LOD3, 0.0f } };
+        builder.Build(tree, nodes);
+
+        // Корень 2048 режется на 16 тайлов 512, у каждого своя текстура
+        const auto& instances = builder.GetInstances();
+        TEST_CHECK(instances.size() == 16);
+        TEST_CHECK(builder.GetNodeCount() == 1);
+        uint32_t slots = 0;
+        for (size_t i = 0; i < instances.size(); i++)
+        {
+            const TerrainInstance& instance = instances[i];
+            TEST_CHECK(instance.Scale == (float)TestWorld::TileSize);
+            int tileX = (int)(instance.Origin.x / TestWorld::TileSize);
+            int tileY = (int)(instance.Origin.y / TestWorld::TileSize);
+            TEST_CHECK(instance.TextureSlot == (uint32_t)(tileY * TestWorld::TilesX + tileX));
+            TEST_CHECK(instance.ColorTexRect.x == 0.0f && instance.ColorTexRect.y == 1.0f);
+            TEST_CHECK(instance.ColorTexRect.z == 1.0f && instance.ColorTexRect.w == -1.0f);
+            TEST_CHECK(builder.GetInstanceNode(i) == 0);
+            slots |= 1u << instance.TextureSlot;
+        }
+        TEST_CHECK(slots == 0xFFFFu);
+
+        // 16 патчей тайла на LOD3 - сетка 2x2
+        TEST_CHECK(builder.GetGridInstanceCount(3) == 16);
+        TEST_CHECK(builder.GetPatchCount() == 16 * 4);
+    }
+
+    // Экземпляры узлов одного уровня покрывают террейн ровно один раз
+    void CheckLevelCoverage(int depth)
+    {
+        QuadTree tree;
+        tree.Initialize(TestWorld::TerrainSize, 4, LodDistances);
+        TerrainInstanceBuilder builder;
+        ConfigureBuilder(builder);
+
+        std::vector<QuadTreeRenderNode> nodes;
+        uint32_t levelStart = tree.GetLevelStart(depth);
+        for (uint32_t i = 0; i < (1u << (2 * depth)); i++)
+        {
+            nodes.push_back({ levelStart + i, (LODLevel)(i % 4), 0.0f });
+        }
+        builder.Build(tree, nodes);
+
+        // Покрытие на сетке ячеек размером с самый мелкий узел
+        const float cellSize = TestWorld::TerrainSize / 16.0f;
+        std::vector<int> coverage(16 * 16, 0);
+        for (const TerrainInstance& instance : builder.GetInstances())
+        {
+            int x0 = (int)(instance.Origin.x / cellSize);
+            int z0 = (int)(instance.Origin.y / cellSize);
+            int cells = (int)(instance.Scale / cellSize);
+            for (int z = z0; z < z0 + cells; z++)
+            {
+                for (int x = x0; x < x0 + cells; x++)
+                {
+                    coverage[z * 16 + x]++;
+                }
+            }
+        }
+        int badCells = 0;
+        for (int count : coverage)
+        {
+            badCells += count != 1;
+        }
+        TEST_CHECK_MSG(badCells == 0, "depth %d: %d cells covered not exactly once", depth, badCells);
+    }
+
+    // Кадры облёта: каждый экземпляр лежит внутри своего узла и одного тайла, текстурные
+    // прямоугольники согласованы с положением, группы по сетке идут подряд в порядке обхода
+    void CheckFlightPath(uint32_t frames)
+    {
+        QuadTree tree;
+        tree.Initialize(TestWorld::TerrainSize, 4, LodDistances);
+        TerrainInstanceBuilder builder;
+        ConfigureBuilder(builder);
+
+        const float tileSize = (float)TestWorld::TileSize;
+        const float patchSize = TestWorld::BasePatchSize;
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            Camera camera = MakeTestCamera(FlightPathPose(frame, frames));
+            tree.Update(camera.GetPosition(), camera.GetFrustum());
+            const auto& nodes = tree.GetVisibleNodes();
+            builder.Build(tree, nodes);
+
+            const auto& instances = builder.GetInstances();
+            TEST_CHECK(builder.GetNodeCount() == nodes.size());
+
+            uint32_t expected = 0;
+            uint32_t patches = 0;
+            for (int grid = 0; grid < builder.GetGridCount(); grid++)
+            {
+                TEST_CHECK(builder.GetGridFirstInstance(grid) == expected);
+                uint32_t first = builder.GetGridFirstInstance(grid);
+                uint32_t count = builder.GetGridInstanceCount(grid);
+                expected += count;
+
+                for (uint32_t i = first; i < first + count; i++)
+                {
+                    const TerrainInstance& instance = instances[i];
+                    uint32_t node = builder.GetInstanceNode(i);
+                    TEST_CHECK(node < nodes.size());
+                    // Внутри группы - порядок обхода
+                    TEST_CHECK(i == first || builder.GetInstanceNode(i - 1) <= node);
+
+                    BoundingBox bounds = tree.GetNodeBounds(nodes[node].NodeIndex);
+                    float nodeMinX = bounds.Center.x - bounds.Extents.x;
+                    float nodeMinZ = bounds.Center.z - bounds.Extents.z;
+                    TEST_CHECK(instance.Origin.x >= nodeMinX && instance.Origin.y >= nodeMinZ);
+                    TEST_CHECK(instance.Origin.x + instance.Scale <= nodeMinX + 2.0f * bounds.Extents.x);
+                    TEST_CHECK(instance.Origin.y + instance.Scale <= nodeMinZ + 2.0f * bounds.Extents.z);
+                    TEST_CHECK(instance.Scale <= tileSize);
+
+                    int tileX = (int)(instance.Origin.x / tileSize);
+                    int tileY = (int)(instance.Origin.y / tileSize);
+                    TEST_CHECK(instance.TextureSlot == (uint32_t)(tileY * TestWorld::TilesX + tileX));
+                    TEST_CHECK(instance.Origin.x + instance.Scale <= (tileX + 1) * tileSize);
+                    TEST_CHECK(instance.Origin.y + instance.Scale <= (tileY + 1) * tileSize);
+                    TEST_CHECK(std::fabs(instance.HeightTexRect.x - instance.Origin.x / TestWorld::TerrainSize) < 1e-6f);
+                    TEST_CHECK(std::fabs(instance.HeightTexRect.y - (1.0f - instance.Origin.y / TestWorld::TerrainSize)) < 1e-6f);
+
+                    uint32_t patchesPerEdge = (uint32_t)lroundf(instance.Scale / patchSize);
+                    TEST_CHECK(builder.SelectGrid(patchesPerEdge, nodes[node].LOD) == grid);
+                    uint32_t gridPatches = (uint32_t)builder.GetGridPatchesPerEdge(grid);
+                    patches += gridPatches * gridPatches;
+                }
+            }
+            TEST_CHECK(expected == instances.size());
+            TEST_CHECK(patches == builder.GetPatchCount());
+        }
+    }
+}
+
+int main()
+{
+    CheckGrids();
+    CheckRootSplit();
+    for (int depth = 0; depth <= 4; depth++)
+    {
+        CheckLevelCoverage(depth);
+    }
+    CheckFlightPath(200);
+
+    return TestResult("TerrainInstanceBuilderTest");
+}
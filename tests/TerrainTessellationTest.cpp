@@ -0,0 +1,245 @@
+#include "TerrainTessellation.h"
+#include "TerrainInstanceBuilder.h"
+#include "QuadTree.h"
+#include "HeightPyramid.h"
+#include "WorkStealingPool.h"
+#include "TessellationReference.h"
+#include "TestCommon.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+
+// Прогноз треугольников тесселяции: факторы и счёт треугольников для известных случаев,
+// PredictPatchGridTriangles (SSE, полиномиальный exp2) против скалярных ComputePatchTessFactors +
+// CountPatchTriangles на случайных сетках и камерах, TerrainTrianglePredictor на экземплярах
+// эталонных камер против того же скалярного счёта, пул - бит в бит с одним потоком.
+
+namespace
+{
+    // Допуск SSE против скалярного пути. Фактор почти точно на чётном числе может округлиться
+    // в соседнее: ребро - на 2 треугольника, внутренний - до 8 * MaxFactor. На сетку допускается
+    // относительное расхождение MaxGridError, по всем сеткам - MaxTotalError, а доля сеток
+    // с любым расхождением - не больше MaxMismatchedGrids.
+    const double MaxGridError = 1e-3;
+    const double MaxTotalError = 1e-5;
+    const double MaxMismatchedGrids = 0.01;
+
+    void CheckKnownFactors()
+    {
+        // Ближе MinDistance - 2^MaxTess, дальше MaxDistance - 2^MinTess, посередине - 2^((Max + Min) / 2)
+        XMFLOAT3 eye(0.0f, 0.0f, 0.0f);
+        TEST_CHECK(CalcTessFactor(XMFLOAT3(100.0f, 0.0f, 0.0f), eye) == 64.0f);
+        TEST_CHECK(CalcTessFactor(XMFLOAT3(0.0f, 0.0f, 5000.0f), eye) == 2.0f);
+        float middle = CalcTessFactor(XMFLOAT3(1500.0f, 0.0f, 0.0f), eye);
+        TEST_CHECK_MSG(std::fabs(middle - std::exp2(3.5f)) < 1e-4f, "factor at 1500: %g", middle);
+
+        TEST_CHECK(FractionalEvenSegments(0.5f) == 2 && FractionalEvenSegments(2.0f) == 2);
+        TEST_CHECK(FractionalEvenSegments(2.001f) == 4 && FractionalEvenSegments(4.0f) == 4);
+        TEST_CHECK(FractionalEvenSegments(63.5f) == 64 && FractionalEvenSegments(1000.0f) == 64);
+
+        // Все факторы 64 - полная сетка 64x64 (2 * 64^2), все 2 - по 2 треугольника у ребра
+        PatchTessFactors full = { { 64.0f, 64.0f, 64.0f, 64.0f }, 64.0f };
+        TEST_CHECK(CountPatchTriangles(full) == 2 * 64 * 64);
+        PatchTessFactors coarse = { { 1.0f, 1.0f, 1.0f, 1.0f }, 1.0f };
+        TEST_CHECK(CountPatchTriangles(coarse) == 8);
+        PatchTessFactors mixed = { { 2.0f, 8.0f, 16.0f, 64.0f }, 6.0f };
+        TEST_CHECK(CountPatchTriangles(mixed) == 2 * 4 * 4 + (2 + 8 + 16 + 64) + 4 * 4);
+
+        // Патч базового размера под самой камерой: все факторы 64
+        const XMFLOAT3 corners[4] =
+        {
+            XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(32.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 32.0f), XMFLOAT3(32.0f, 0.0f, 32.0f)
+        };
+        PatchTessFactors factors = ComputePatchTessFactors(corners, XMFLOAT3(16.0f, 50.0f, 16.0f), 32.0f);
+        TEST_CHECK(factors.Edge[0] == 64.0f && factors.Edge[3] == 64.0f && factors.Inside == 64.0f);
+        TEST_CHECK(PredictPatchGridTriangles(XMFLOAT2(0.0f, 0.0f), 32.0f, 1, XMFLOAT3(16.0f, 50.0f, 16.0f), 32.0f) ==
+                   2 * 64 * 64);
+    }
+
+    void CheckRandomGrids()
+    {
+        // Сетки любой ширины (и не кратной 4 - проверка хвостовых дорожек), узлы от патча до всей карты,
+        // камеры от самой земли до высоты, где всё на MinTess
+        const uint32_t patchCounts[] = { 1, 2, 3, 4, 5, 7, 8, 13, 16, 32, 64 };
+        TestRandom random(17);
+        uint32_t mismatchedGrids = 0;
+        double worstGridError = 0.0;
+        uint64_t scalarTotal = 0;
+        int64_t differenceTotal = 0;
+        const uint32_t gridCount = 20000;
+        for (uint32_t i = 0; i < gridCount; i++)
+        {
+            uint32_t patchesPerEdge = patchCounts[random.Next() % (sizeof(patchCounts) / sizeof(patchCounts[0]))];
+            float size = TestWorld::BasePatchSize * (float)(1u << (random.Next() % 7)) * (i % 5 == 0 ? random.Uniform(0.5f, 1.5f) : 1.0f);
+            XMFLOAT2 origin(random.Uniform(-200.0f, TestWorld::TerrainSize), random.Uniform(-200.0f, TestWorld::TerrainSize));
+            XMFLOAT3 eye(random.Uniform(-500.0f, TestWorld::TerrainSize + 500.0f),
+                         random.Uniform(0.0f, 1.0f) * random.Uniform(0.0f, 3000.0f),
+                         random.Uniform(-500.0f, TestWorld::TerrainSize + 500.0f));
+
+            uint64_t expected = ScalarGridTriangles(origin, size, patchesPerEdge, eye, TestWorld::BasePatchSize);
+            uint64_t predicted = PredictPatchGridTriangles(origin, size, patchesPerEdge, eye, TestWorld::BasePatchSize);
+            scalarTotal += expected;
+            differenceTotal += (int64_t)predicted - (int64_t)expected;
+            if (predicted != expected)
+            {
+                mismatchedGrids++;
+                worstGridError = std::max(worstGridError, std::fabs((double)predicted - (double)expected) / expected);
+            }
+        }
+
+        double totalError = std::fabs((double)differenceTotal) / scalarTotal;
+        std::printf("%u random grids, %llu triangles: %u grids differ, worst %.2g, total %.2g\n", gridCount,
+                    (unsigned long long)scalarTotal, mismatchedGrids, worstGridError, totalError);
+        TEST_CHECK_MSG(worstGridError <= MaxGridError, "grid off by %g", worstGridError);
+        TEST_CHECK_MSG(totalError <= MaxTotalError, "total off by %g", totalError);
+        TEST_CHECK_MSG(mismatchedGrids <= gridCount * MaxMismatchedGrids, "%u of %u grids differ", mismatchedGrids, gridCount);
+    }
+
+    // Камера прямо над центром патча на расстоянии, где фактор внутреннего деления равен чётному k,
+    // и соседние float-расстояния: здесь SSE exp2 и exp2f могут округлить фактор в разные стороны.
+    // Расхождение на патч не больше одного шага FractionalEvenSegments на каждом факторе.
+    void CheckEvenBoundaries()
+    {
+        const uint32_t edgeStep = 2;
+        const uint32_t maxSegments = (uint32_t)TerrainTessellation::MaxFactor;
+        const uint32_t insideStep = 2 * (maxSegments - 2) * (maxSegments - 2) - 2 * (maxSegments - 4) * (maxSegments - 4) + 4 * 2;
+        const uint32_t maxPatchDifference = 4 * edgeStep + insideStep;
+
+        uint32_t probes = 0;
+        uint32_t mismatches = 0;
+        uint32_t worst = 0;
+        const float sizes[] = { 32.0f, 16.0f, 8.0f };
+        for (float size : sizes)
+        {
+            float edgeScale = size / TestWorld::BasePatchSize;
+            for (uint32_t k = 4; k < maxSegments; k += 2)
+            {
+                float exponent = std::log2((float)k / edgeScale);
+                if (exponent <= TerrainTessellation::MinTess || exponent >= TerrainTessellation::MaxTess)
+                {
+                    continue;
+                }
+                float s = (TerrainTessellation::MaxTess - exponent) / (TerrainTessellation::MaxTess - TerrainTessellation::MinTess);
+                float distance = TerrainTessellation::MinDistance + s * (TerrainTessellation::MaxDistance - TerrainTessellation::MinDistance);
+                for (int step = -64; step <= 64; step++)
+                {
+                    float y = distance;
+                    for (int i = 0; i < std::abs(step); i++)
+                    {
+                        y = std::nextafter(y, step < 0 ? 0.0f : 1e9f);
+                    }
+                    XMFLOAT3 eye(100.0f + 0.5f * size, y, 100.0f + 0.5f * size);
+                    uint64_t expected = ScalarGridTriangles(XMFLOAT2(100.0f, 100.0f), size, 1, eye, TestWorld::BasePatchSize);
+                    uint64_t predicted = PredictPatchGridTriangles(XMFLOAT2(100.0f, 100.0f), size, 1, eye, TestWorld::BasePatchSize);
+                    uint32_t difference = (uint32_t)(predicted > expected ? predicted - expected : expected - predicted);
+                    probes++;
+                    mismatches += difference != 0;
+                    worst = std::max(worst, difference);
+                }
+            }
+        }
+        std::printf("%u probes at even factors: %u differ, worst %u triangles (bound %u)\n",
+                    probes, mismatches, worst, maxPatchDifference);
+        TEST_CHECK_MSG(worst <= maxPatchDifference, "patch off by %u triangles", worst);
+    }
+
+    // Экземпляры эталонных камер и облёта: прогноз по экземплярам против скалярного счёта,
+    // суммы по узлам и кадру, пул против одного потока
+    void CheckPredictor()
+    {
+        std::vector<float> heights;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        if (!LoadTestWorldHeights(heights, width, height))
+        {
+            TEST_CHECK_MSG(false, "cannot load Terrain/003/Height_Out.tif");
+            return;
+        }
+        HeightPyramid pyramid;
+        pyramid.Build(heights, width, height);
+
+        QuadTree tree;
+        tree.Initialize(TestWorld::TerrainSize, 4, { 200.0f, 500.0f, 1000.0f });
+        tree.RefitHeights(pyramid, TestWorld::HeightBoundsMargin);
+        tree.SetScreenSpaceErrorParams(TestWorld::CameraFovDegrees * 3.14159265f / 180.0f,
+                                       TestWorld::ViewportHeight, TestWorld::LodPixelTolerance);
+        tree.ComputeGeometricErrors(pyramid, TestWorld::LodErrorGridResolution);
+        tree.SetSelectionMode(LODSelectionMode::ScreenSpaceError);
+
+        TerrainInstanceBuilder instances;
+        instances.Configure((float)TestWorld::TileSize, TestWorld::TilesX, TestWorld::TilesY, TestWorld::PatchesPerTile);
+        TerrainTrianglePredictor predictor;
+        TerrainTrianglePredictor pooled;
+        WorkStealingPool pool(4);
+
+        std::vector<TestCameraPose> poses(std::begin(ReferenceCameraPoses), std::end(ReferenceCameraPoses));
+        for (uint32_t frame = 0; frame < 40; frame++)
+        {
+            poses.push_back(FlightPathPose(frame * 25, 1000));
+        }
+
+        uint64_t scalarTotal = 0;
+        int64_t differenceTotal = 0;
+        uint32_t mismatchedInstances = 0;
+        uint32_t instanceTotal = 0;
+        for (const TestCameraPose& pose : poses)
+        {
+            Camera camera = MakeTestCamera(pose);
+            XMFLOAT3 eye = camera.GetPosition();
+            tree.Update(eye, camera.GetFrustum());
+            instances.Build(tree, tree.GetVisibleNodes());
+            predictor.Predict(instances, eye, TestWorld::BasePatchSize);
+            pooled.Predict(instances, eye, TestWorld::BasePatchSize, &pool);
+
+            const std::vector<TerrainInstance>& list = instances.GetInstances();
+            std::vector<uint64_t> nodeTriangles(instances.GetNodeCount(), 0);
+            uint64_t frameTotal = 0;
+            for (int grid = 0; grid < instances.GetGridCount(); grid++)
+            {
+                uint32_t first = instances.GetGridFirstInstance(grid);
+                for (uint32_t i = first; i < first + instances.GetGridInstanceCount(grid); i++)
+                {
+                    uint64_t expected = ScalarGridTriangles(list[i].Origin, list[i].Scale,
+                                                            (uint32_t)instances.GetGridPatchesPerEdge(grid), eye,
+                                                            TestWorld::BasePatchSize);
+                    uint32_t predicted = predictor.GetInstanceTriangles()[i];
+                    scalarTotal += expected;
+                    differenceTotal += (int64_t)predicted - (int64_t)expected;
+                    mismatchedInstances += predicted != expected;
+                    nodeTriangles[instances.GetInstanceNode(i)] += predicted;
+                    frameTotal += predicted;
+                }
+            }
+            instanceTotal += (uint32_t)list.size();
+
+            bool nodesMatch = nodeTriangles.size() == predictor.GetNodeTriangles().size();
+            for (size_t i = 0; nodesMatch && i < nodeTriangles.size(); i++)
+            {
+                nodesMatch = nodeTriangles[i] == predictor.GetNodeTriangles()[i];
+            }
+            TEST_CHECK(nodesMatch);
+            TEST_CHECK(frameTotal == predictor.GetTotalTriangles());
+            TEST_CHECK(predictor.GetPatchCount() == instances.GetPatchCount());
+            TEST_CHECK(pooled.GetInstanceTriangles() == predictor.GetInstanceTriangles() &&
+                       pooled.GetTotalTriangles() == predictor.GetTotalTriangles());
+        }
+
+        double totalError = std::fabs((double)differenceTotal) / std::max<uint64_t>(scalarTotal, 1);
+        std::printf("%zu views, %u instances, %llu triangles: %u instances differ, total %.2g\n", poses.size(),
+                    instanceTotal, (unsigned long long)scalarTotal, mismatchedInstances, totalError);
+        TEST_CHECK_MSG(totalError <= MaxTotalError, "predictor total off by %g", totalError);
+        TEST_CHECK_MSG(mismatchedInstances <= instanceTotal * MaxMismatchedGrids, "%u of %u instances differ",
+                       mismatchedInstances, instanceTotal);
+    }
+}
+
+int main()
+{
+    CheckKnownFactors();
+    CheckRandomGrids();
+    CheckEvenBoundaries();
+    CheckPredictor();
+    return TestResult("TerrainTessellationTest");
+}
@@ -0,0 +1,136 @@
+#include "TerrainTileMap.h"
+#include "QuadTree.h"
+#include "TestCommon.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+
+// TerrainTileMap против перебора всех тайлов с полуоткрытым пересечением на облёте
+// террейнов от 4x4 до 16x16 тайлов
+
+namespace
+{
+    const std::vector<float> LodDistances = { 200.0f, 500.0f, 1000.0f };
+
+    // Перебор: тайл видим, если его внутренность пересекается с квадратом узла
+    void MapBruteForce(const QuadTree& tree, const std::vector<QuadTreeRenderNode>& nodes, float tileSize,
+                       int tilesX, int tilesY, std::vector<uint32_t>& visible, std::vector<int>& finest)
+    {
+        finest.assign((size_t)tilesX * tilesY, -1);
+        for (const QuadTreeRenderNode& node : nodes)
+        {
+            BoundingBox bounds = tree.GetNodeBounds(node.NodeIndex);
+            for (int tileY = 0; tileY < tilesY; tileY++)
+            {
+                for (int tileX = 0; tileX < tilesX; tileX++)
+                {
+                    bool overlaps = bounds.Center.x - bounds.Extents.x < (tileX + 1) * tileSize &&
+                                    bounds.Center.x + bounds.Extents.x > tileX * tileSize &&
+                                    bounds.Center.z - bounds.Extents.z < (tileY + 1) * tileSize &&
+                                    bounds.Center.z + bounds.Extents.z > tileY * tileSize;
+                    int& lod = finest[(size_t)tileY * tilesX + tileX];
+                    if (overlaps && (lod < 0 || (int)node.LOD < lod))
+                    {
+                        lod = (int)node.LOD;
+                    }
+                }
+            }
+        }
+
+        visible.clear();
+        for (size_t tile = 0; tile < finest.size(); tile++)
+        {
+            if (finest[tile] >= 0)
+            {
+                visible.push_back((uint32_t)tile);
+            }
+        }
+    }
+
+    void CheckFlightPath(int tilesPerEdge, uint32_t frames)
+    {
+        const float tileSize = (float)TestWorld::TileSize;
+        const float terrainSize = tileSize * tilesPerEdge;
+        // Листья по 128 единиц, как у дерева приложения над 4x4 тайлами
+        int depth = 0;
+        while ((terrainSize / (float)(1 << depth)) > 128.0f)
+        {
+            depth++;
+        }
+
+        QuadTree tree;
+        tree.Initialize(terrainSize, depth, LodDistances);
+        TerrainTileMap map;
+        map.Configure(tileSize, tilesPerEdge, tilesPerEdge);
+
+        std::vector<uint32_t> expected;
+        std::vector<int> finest;
+        int mismatchedFrames = 0;
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            TestCameraPose pose = FlightPathPose(frame, frames);
+            pose.X *= terrainSize / TestWorld::TerrainSize;
+            pose.Z *= terrainSize / TestWorld::TerrainSize;
+            Camera camera = MakeTestCamera(pose);
+            tree.Update(camera.GetPosition(), camera.GetFrustum());
+
+            map.Map(tree, tree.GetVisibleNodes());
+            MapBruteForce(tree, tree.GetVisibleNodes(), tileSize, tilesPerEdge, tilesPerEdge, expected, finest);
+
+            bool same = map.GetVisibleTiles() == expected;
+            for (size_t i = 0; same && i < expected.size(); i++)
+            {
+                same = (int)map.GetFinestLOD(expected[i]) == finest[expected[i]];
+            }
+            mismatchedFrames += !same;
+        }
+        TEST_CHECK_MSG(mismatchedFrames == 0, "%dx%d tiles: %d of %u frames differ",
+                       tilesPerEdge, tilesPerEdge, mismatchedFrames, frames);
+    }
+
+    // Узел ровно в тайл не захватывает соседей, узел больше тайла - все тайлы под собой
+    void CheckEdges()
+    {
+        QuadTree tree;
+        tree.Initialize(TestWorld::TerrainSize, 4, LodDistances);
+        TerrainTileMap map;
+        map.Configure((float)TestWorld::TileSize, TestWorld::TilesX, TestWorld::TilesY);
+
+        // Уровень 2 - узлы размером с тайл; узел 5 уровня - тайл (1, 1)
+        uint32_t tileNode = tree.GetLevelStart(2) + 5;
+        map.Map(tree, { { tileNode, LODLevel::LOD2, 0.0f } });
+        TEST_CHECK(map.GetVisibleTiles().size() == 1);
+        BoundingBox bounds = tree.GetNodeBounds(tileNode);
+        uint32_t tileX = (uint32_t)(bounds.Center.x / TestWorld::TileSize);
+        uint32_t tileY = (uint32_t)(bounds.Center.z / TestWorld::TileSize);
+        TEST_CHECK(!map.GetVisibleTiles().empty() && map.GetVisibleTiles()[0] == tileY * TestWorld::TilesX + tileX);
+
+        // Корень - все 16 тайлов, мелкий узел в одном из них уточняет LOD только своего тайла
+        uint32_t leaf = tree.GetLevelStart(4);
+        map.Map(tree, { { QuadTree::RootIndex, LODLevel::LOD3, 0.0f }, { leaf, LODLevel::LOD0, 0.0f } });
+        TEST_CHECK(map.GetVisibleTiles().size() == 16);
+        int fine = 0;
+        for (uint32_t tile : map.GetVisibleTiles())
+        {
+            fine += map.GetFinestLOD(tile) == LODLevel::LOD0;
+        }
+        TEST_CHECK(fine == 1);
+
+        // Пустой кадр очищает прошлый результат
+        map.Map(tree, {});
+        TEST_CHECK(map.GetVisibleTiles().empty());
+    }
+}
+
+int main()
+{
+    CheckEdges();
+    for (int tilesPerEdge : { 4, 8, 16 })
+    {
+        CheckFlightPath(tilesPerEdge, 64);
+    }
+
+    return TestResult("TerrainTileMapTest");
+}
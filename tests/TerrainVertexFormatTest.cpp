@@ -0,0 +1,43 @@
+#include "TerrainVertexFormat.h"
+#include "TestCommon.h"
+#include <cstdio>
+
+using namespace DirectX;
+
+// Кодирование компактной вершины: точность для сеток - степеней двойки, отказ для остальных,
+// взаимная однозначность кодов 0..TerrainVertexFixedOne и зажим координат вне [0, 1]
+
+int main()
+{
+    // Сетка приложения и все степени двойки до предела формата
+    TEST_CHECK(IsTerrainVertexRoundTripExact(TestWorld::PatchesPerTile));
+    for (uint32_t resolution = 1; resolution <= TerrainVertexFixedOne; resolution *= 2)
+    {
+        TEST_CHECK_MSG(IsTerrainVertexRoundTripExact(resolution), "resolution %u", resolution);
+    }
+
+    // Ноль, слишком мелкие ячейки и сетки, чьи узлы не ложатся на шаг 1/32768
+    TEST_CHECK(!IsTerrainVertexRoundTripExact(0));
+    TEST_CHECK(!IsTerrainVertexRoundTripExact(TerrainVertexFixedOne * 2));
+    TEST_CHECK(!IsTerrainVertexRoundTripExact(3));
+    TEST_CHECK(!IsTerrainVertexRoundTripExact(10));
+    TEST_CHECK(!IsTerrainVertexRoundTripExact(17));
+
+    // Каждый код декодируется в значение, которое кодируется обратно в тот же код
+    int mismatches = 0;
+    for (uint32_t code = 0; code <= TerrainVertexFixedOne; code++)
+    {
+        TerrainVertexCompact compact = { (uint16_t)code, (uint16_t)(TerrainVertexFixedOne - code) };
+        TerrainVertexCompact again = EncodeTerrainVertex(DecodeTerrainVertex(compact));
+        mismatches += again.X != compact.X || again.Z != compact.Z;
+    }
+    TEST_CHECK_MSG(mismatches == 0, "%d codes do not round-trip", mismatches);
+
+    // Координаты вне [0, 1] зажимаются
+    TerrainVertex outside;
+    outside.GridPos = XMFLOAT2(-0.25f, 1.5f);
+    TerrainVertexCompact clamped = EncodeTerrainVertex(outside);
+    TEST_CHECK(clamped.X == 0 && clamped.Z == TerrainVertexFixedOne);
+
+    return TestResult("TerrainVertexFormatTest");
+}
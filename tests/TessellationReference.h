@@ -0,0 +1,32 @@
+#pragma once
+
+#include "TerrainTessellation.h"
+#include <cstdint>
+
+// Скалярный эталон прогноза треугольников для теста и бенчмарка TerrainTrianglePredictor.
+
+// Сумма CountPatchTriangles(ComputePatchTessFactors) по сетке patchesPerEdge x patchesPerEdge
+// патчей квадрата со стороной size и углом origin; углы патчей - как в vs.hlsl.
+// То же, что PredictPatchGridTriangles, но по одному патчу и с exp2f вместо полинома на SSE.
+inline uint64_t ScalarGridTriangles(const DirectX::XMFLOAT2& origin, float size, uint32_t patchesPerEdge,
+                                    const DirectX::XMFLOAT3& eye, float basePatchSize)
+{
+    uint64_t triangles = 0;
+    for (uint32_t patchZ = 0; patchZ < patchesPerEdge; patchZ++)
+    {
+        float z0 = origin.y + ((float)patchZ / patchesPerEdge) * size;
+        float z1 = origin.y + ((float)(patchZ + 1) / patchesPerEdge) * size;
+        for (uint32_t patchX = 0; patchX < patchesPerEdge; patchX++)
+        {
+            float x0 = origin.x + ((float)patchX / patchesPerEdge) * size;
+            float x1 = origin.x + ((float)(patchX + 1) / patchesPerEdge) * size;
+            const DirectX::XMFLOAT3 corners[4] =
+            {
+                DirectX::XMFLOAT3(x0, 0.0f, z0), DirectX::XMFLOAT3(x1, 0.0f, z0),
+                DirectX::XMFLOAT3(x0, 0.0f, z1), DirectX::XMFLOAT3(x1, 0.0f, z1)
+            };
+            triangles += CountPatchTriangles(ComputePatchTessFactors(corners, eye, basePatchSize));
+        }
+    }
+    return triangles;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "Camera.h"
+#include "TiffReader.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <cstdint>
+
+// Общие помощники headless-тестов и бенчмарков.
+// Запускаются из корня репозитория (ctest задаёт рабочий каталог сам), поэтому
+// пути к Terrain/ те же, что у приложения.
+
+// Число проваленных проверок текущего теста
+inline int gTestFailures = 0;
+
+#define TEST_CHECK(condition) \
+    do { if (!(condition)) { gTestFailures++; std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); } } while (0)
+
+#define TEST_CHECK_MSG(condition, ...) \
+    do { if (!(condition)) { gTestFailures++; std::printf("%s:%d: check failed: %s: ", __FILE__, __LINE__, #condition); \
+         std::printf(__VA_ARGS__); std::printf("\n"); } } while (0)
+
+// Итог теста - код возврата main
+inline int TestResult(const char* name)
+{
+    std::printf("%s: %s (%d failed checks)\n", name, gTestFailures ? "FAILED" : "passed", gTestFailures);
+    return gTestFailures ? 1 : 0;
+}
+
+// Параметры мира, как в TerrainApp.h
+namespace TestWorld
+{
+    const int TilesX = 4;
+    const int TilesY = 4;
+    const int TileSize = 512;
+    const int PatchesPerTile = 16;
+    const float TerrainSize = (float)(TilesX * TileSize);
+    const float BasePatchSize = (float)TileSize / PatchesPerTile;
+    const float HeightScale = 500.0f;
+    const float HeightBoundsMargin = 8.0f;
+    const float CameraFovDegrees = 45.0f;
+    const float AspectRatio = 16.0f / 9.0f;
+    const float ViewportHeight = 720.0f;
+    const float LodPixelTolerance = 4.0f;
+    const int LodErrorGridResolution = 16;
+}
+
+struct TestCameraPose
+{
+    float X, Y, Z, Pitch, Yaw;
+};
+
+// Те же камеры, что в TerrainApp::ReportReferenceCameras
+const TestCameraPose ReferenceCameraPoses[] =
+{
+    { 1024.0f,  300.0f,  200.0f,  0.0f,   0.0f }, // Start position
+    { 1024.0f,  120.0f, 1024.0f,  5.0f,  90.0f }, // Low, terrain center
+    {  200.0f,   80.0f,  200.0f, 10.0f,  45.0f }, // Near ground, corner
+    { 1024.0f, 1500.0f, -600.0f, 35.0f,   0.0f }, // Overview
+    { 1024.0f, 2000.0f, 1024.0f, 89.0f,   0.0f }, // Top down
+};
+
+inline Camera MakeTestCamera(const TestCameraPose& pose)
+{
+    Camera camera;
+    camera.SetProjectionValues(TestWorld::CameraFovDegrees, TestWorld::AspectRatio, 1.0f, 10000.0f);
+    camera.SetPosition(pose.X, pose.Y, pose.Z);
+    camera.SetRotation(pose.Pitch, pose.Yaw);
+    return camera;
+}
+
+// Записанный облёт: низкий круг над центром с наклонами и подъёмами, кадр frame из frameCount.
+// Соседние кадры близки, как при реальном полёте (важно для временной когерентности).
+inline TestCameraPose FlightPathPose(uint32_t frame, uint32_t frameCount)
+{
+    float t = (float)frame / (float)frameCount;
+    float angle = t * 6.2831853f;
+    float radius = 650.0f + 250.0f * std::sin(3.0f * angle);
+    TestCameraPose pose;
+    pose.X = 1024.0f + radius * std::sin(angle);
+    pose.Z = 1024.0f - radius * std::cos(angle);
+    pose.Y = 180.0f + 140.0f * std::sin(2.0f * angle + 1.0f);
+    pose.Pitch = 12.0f + 8.0f * std::sin(5.0f * angle);
+    // Вдоль касательной к кругу, с покачиванием
+    pose.Yaw = angle * 57.29578f + 90.0f + 20.0f * std::sin(7.0f * angle);
+    return pose;
+}
+
+// Нормированные высоты 0..1 из 16-битного TIFF рядом с Terrain/003/Height_Out.dds,
+// как их получает TerrainApp::LoadHeightData
+inline bool LoadTestHeights(std::vector<float>& values, uint32_t& width, uint32_t& height)
+{
+    TiffStripReader reader;
+    if (!reader.Open("Terrain/003/Height_Out.tif"))
+    {
+        return false;
+    }
+
+    width = reader.GetWidth();
+    height = reader.GetHeight();
+    std::vector<uint16_t> samples((size_t)width * height);
+    if (!reader.ReadRows(0, height, samples.data()))
+    {
+        return false;
+    }
+
+    values.resize(samples.size());
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        values[i] = samples[i] / 65535.0f;
+    }
+    return true;
+}
+
+// Высоты в мировых единицах для HeightPyramid::Build
+inline bool LoadTestWorldHeights(std::vector<float>& heights, uint32_t& width, uint32_t& height)
+{
+    if (!LoadTestHeights(heights, width, height))
+    {
+        return false;
+    }
+    for (float& h : heights)
+    {
+        h *= TestWorld::HeightScale;
+    }
+    return true;
+}
+
+// Детерминированный генератор для рандомизированных тестов (xorshift32)
+class TestRandom
+{
+public:
+    explicit TestRandom(uint32_t seed) : mState(seed ? seed : 1u) {}
+
+    uint32_t Next()
+    {
+        mState ^= mState << 13;
+        mState ^= mState >> 17;
+        mState ^= mState << 5;
+        return mState;
+    }
+
+    // Равномерно в [lo, hi)
+    float Uniform(float lo, float hi) { return lo + (hi - lo) * (float)(Next() >> 8) * (1.0f / 16777216.0f); }
+
+private:
+    uint32_t mState;
+};
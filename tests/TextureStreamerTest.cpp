@@ -0,0 +1,299 @@
+#include "TextureStreamer.h"
+#include "TestCommon.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+// TextureStreamer без GPU на тайлах Terrain/001: порядок загрузки по приоритету (хвосты раньше
+// уточнений), бюджет и выгрузка давно не запрошенных, прогрессивное уточнение, отказ загрузки
+// и отказ уточнения.
+// Один рабочий поток - порядок чтения тогда определяется только кучей приоритетов.
+
+namespace
+{
+    const uint32_t TailResolution = 64;
+    const uint32_t FullResolution = 512;
+
+    // NullTextureUploader, записывающий вызовы; тайлы из FailUploads загрузить "не удаётся"
+    class RecordingUploader : public NullTextureUploader
+    {
+    public:
+        struct UploadRecord
+        {
+            uint32_t Tile;
+            uint32_t FirstMip;
+        };
+
+        size_t Upload(const TextureTileData& data) override
+        {
+            if (FailUploads.count(data.Tile))
+            {
+                return 0;
+            }
+            Uploads.push_back({ data.Tile, data.FirstMip });
+            return NullTextureUploader::Upload(data);
+        }
+
+        void Evict(uint32_t tile) override { Evictions.push_back(tile); }
+
+        std::vector<UploadRecord> Uploads;
+        std::vector<uint32_t> Evictions;
+        std::set<uint32_t> FailUploads;
+    };
+
+    std::vector<std::string> TilePaths()
+    {
+        std::vector<std::string> paths;
+        for (int y = 0; y < TestWorld::TilesY; y++)
+        {
+            for (int x = 0; x < TestWorld::TilesX; x++)
+            {
+                paths.push_back("Terrain/001/Weathering/Weathering_Out_y" + std::to_string(y) +
+                                "_x" + std::to_string(x) + ".dds");
+            }
+        }
+        return paths;
+    }
+
+    std::vector<TextureRequest> Requests(const std::vector<uint32_t>& tiles, uint32_t resolution)
+    {
+        std::vector<TextureRequest> requests;
+        for (uint32_t tile : tiles)
+        {
+            requests.push_back({ tile, (float)tile, resolution });
+        }
+        return requests;
+    }
+
+    // Кадры с одними и теми же запросами, пока в очереди что-то есть
+    bool Pump(TextureStreamer& streamer, ITextureUploader& uploader, const std::vector<TextureRequest>& requests)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+        for (;;)
+        {
+            streamer.Update(requests);
+            if (streamer.GetStats().PendingTiles == 0)
+            {
+                // Ещё один кадр: бюджет проверяется в ProcessCompletions
+                streamer.ProcessCompletions(uploader, 64);
+                return true;
+            }
+            if (std::chrono::steady_clock::now() > deadline)
+            {
+                return false;
+            }
+            streamer.ProcessCompletions(uploader, 64);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    uint64_t TailBytes(const std::string& path)
+    {
+        DdsLayout layout;
+        if (!ReadDdsLayout(path, layout))
+        {
+            return 0;
+        }
+        return GetDdsMipChainSize(layout, SelectDdsFirstMip(layout, TailResolution));
+    }
+
+    void CheckPriorities()
+    {
+        TextureStreamer streamer;
+        RecordingUploader uploader;
+        streamer.Initialize(TilePaths(), 1ull << 30, TailResolution, 1);
+
+        // Тайлы 0..7 уже резидентны хвостами, 8..15 - новые, но с худшим приоритетом
+        std::vector<uint32_t> firstHalf = { 0, 1, 2, 3, 4, 5, 6, 7 };
+        TEST_CHECK(Pump(streamer, uploader, Requests(firstHalf, TailResolution)));
+        TEST_CHECK(uploader.Uploads.size() == 8);
+        for (uint32_t tile : firstHalf)
+        {
+            TEST_CHECK(streamer.GetResidentResolution(tile) == TailResolution);
+        }
+
+        // Порядок запросов перемешан: значение имеет только Priority
+        uploader.Uploads.clear();
+        std::vector<TextureRequest> requests;
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            uint32_t tile = (i * 7) % 16;
+            requests.push_back({ tile, (float)tile, FullResolution });
+        }
+        TEST_CHECK(Pump(streamer, uploader, requests));
+
+        // Сначала хвосты новых тайлов по приоритету, потом уточнения всех шестнадцати по приоритету
+        TEST_CHECK_MSG(uploader.Uploads.size() == 8 + 16, "%zu uploads", uploader.Uploads.size());
+        bool ordered = uploader.Uploads.size() == 24;
+        for (size_t i = 0; ordered && i < 8; i++)
+        {
+            ordered = uploader.Uploads[i].Tile == 8 + i && uploader.Uploads[i].FirstMip > 0;
+        }
+        for (size_t i = 8; ordered && i < 24; i++)
+        {
+            ordered = uploader.Uploads[i].Tile == i - 8 && uploader.Uploads[i].FirstMip == 0;
+        }
+        TEST_CHECK(ordered);
+
+        const TextureStreamerStats& stats = streamer.GetStats();
+        TEST_CHECK(stats.ResidentTiles == 16);
+        TEST_CHECK(stats.RefinedTiles == 16);
+        TEST_CHECK(stats.FailedTiles == 0);
+        for (uint32_t tile = 0; tile < 16; tile++)
+        {
+            TEST_CHECK(streamer.GetResidentResolution(tile) == FullResolution);
+        }
+    }
+
+    void CheckBudget()
+    {
+        std::vector<std::string> paths = TilePaths();
+        uint64_t tailBytes = TailBytes(paths[0]);
+        TEST_CHECK(tailBytes > 0);
+
+        // Бюджет на десять хвостов
+        TextureStreamer streamer;
+        RecordingUploader uploader;
+        streamer.Initialize(paths, tailBytes * 10, TailResolution, 1);
+
+        // Тайлы 0..7 по одному в кадр - у каждого свой кадр последнего запроса
+        for (uint32_t tile = 0; tile < 8; tile++)
+        {
+            TEST_CHECK(Pump(streamer, uploader, Requests({ tile }, TailResolution)));
+        }
+        TEST_CHECK(streamer.GetStats().ResidentTiles == 8);
+        TEST_CHECK(uploader.Evictions.empty());
+
+        // Двенадцать хвостов больше бюджета: уходят два самых давно запрошенных
+        TEST_CHECK(Pump(streamer, uploader, Requests({ 8, 9, 10, 11 }, TailResolution)));
+        TEST_CHECK_MSG(uploader.Evictions == std::vector<uint32_t>({ 0, 1 }), "%zu evictions",
+                       uploader.Evictions.size());
+        TEST_CHECK(!streamer.IsResident(0) && !streamer.IsResident(1) && streamer.IsResident(2));
+        TEST_CHECK(streamer.GetStats().ResidentBytes <= tailBytes * 10);
+        TEST_CHECK(streamer.GetStats().EvictedTiles == 2);
+
+        // Запрошенные в кадре тайлы не выгружаются, даже если бюджет превышен
+        uploader.Evictions.clear();
+        std::vector<uint32_t> all;
+        for (uint32_t tile = 0; tile < 16; tile++)
+        {
+            all.push_back(tile);
+        }
+        TEST_CHECK(Pump(streamer, uploader, Requests(all, TailResolution)));
+        TEST_CHECK(streamer.GetStats().ResidentTiles == 16);
+        TEST_CHECK(uploader.Evictions.empty());
+        TEST_CHECK(streamer.GetStats().ResidentBytes == tailBytes * 16);
+    }
+
+    // Прогрессивная загрузка: сначала только хвост, потом мипы по мере роста запрошенного разрешения
+    void CheckProgressiveRefinement()
+    {
+        std::vector<std::string> paths = TilePaths();
+        TextureStreamer streamer;
+        RecordingUploader uploader;
+        streamer.Initialize(paths, 1ull << 30, TailResolution, 1);
+
+        // Первый запрос сразу на полное разрешение всё равно начинается с хвоста
+        streamer.Update(Requests({ 5 }, FullResolution));
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+        while (uploader.Uploads.empty() && std::chrono::steady_clock::now() < deadline)
+        {
+            streamer.ProcessCompletions(uploader, 1);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        TEST_CHECK(streamer.GetResidentResolution(5) == TailResolution);
+        TEST_CHECK(streamer.GetStats().BytesRead == TailBytes(paths[5]));
+
+        for (uint32_t resolution : { 128u, 200u, 256u, 512u, 1024u })
+        {
+            TEST_CHECK(Pump(streamer, uploader, Requests({ 5 }, resolution)));
+            // Ребро - самый грубый мип, которого хватает; больше мипа 0 не бывает
+            uint32_t expected = 64;
+            while (expected < resolution && expected < FullResolution)
+            {
+                expected *= 2;
+            }
+            TEST_CHECK_MSG(streamer.GetResidentResolution(5) == expected, "requested %u, resident %u",
+                           resolution, streamer.GetResidentResolution(5));
+        }
+        TEST_CHECK(streamer.GetStats().RefinedTiles == 3);
+        TEST_CHECK(uploader.Uploads.size() == 4);
+    }
+
+    void CheckFailures()
+    {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "TextureStreamerTest";
+        std::filesystem::create_directories(dir);
+
+        std::vector<std::string> sources = TilePaths();
+        std::ifstream input(sources[0], std::ios::binary);
+        std::vector<char> bytes((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        TEST_CHECK(bytes.size() > 4096);
+
+        // 0 - нет файла, 1 - обрезанный файл, 2 - копия, которая обрежется после загрузки хвоста,
+        // 3 - настоящий тайл, уточнение которого не удастся загрузить в "GPU"
+        std::string truncated = (dir / "truncated.dds").string();
+        std::string shrinking = (dir / "shrinking.dds").string();
+        std::ofstream(truncated, std::ios::binary).write(bytes.data(), 1000);
+        std::ofstream(shrinking, std::ios::binary).write(bytes.data(), (std::streamsize)bytes.size());
+        std::vector<std::string> paths = { (dir / "missing.dds").string(), truncated, shrinking, sources[1] };
+
+        TextureStreamer streamer;
+        RecordingUploader uploader;
+        streamer.Initialize(paths, 1ull << 30, TailResolution, 1);
+
+        TEST_CHECK(Pump(streamer, uploader, Requests({ 0, 1, 2, 3 }, TailResolution)));
+        TEST_CHECK(!streamer.IsResident(0) && !streamer.IsResident(1));
+        TEST_CHECK(streamer.GetResidentResolution(2) == TailResolution);
+        TEST_CHECK(streamer.GetResidentResolution(3) == TailResolution);
+        TEST_CHECK(streamer.GetStats().FailedTiles == 2);
+
+        // Неудачные тайлы больше не запрашиваются
+        size_t uploadsBefore = uploader.Uploads.size();
+        TEST_CHECK(Pump(streamer, uploader, Requests({ 0, 1 }, FullResolution)));
+        TEST_CHECK(uploader.Uploads.size() == uploadsBefore);
+        TEST_CHECK(streamer.GetStats().FailedTiles == 2);
+
+        // Отказ уточнения: файл испорчен после хвоста, загрузчик отказывает - резидентный хвост остаётся
+        uint64_t residentBytes = streamer.GetStats().ResidentBytes;
+        std::ofstream(shrinking, std::ios::binary | std::ios::trunc).write(bytes.data(), 1000);
+        uploader.FailUploads.insert(3);
+        TEST_CHECK(Pump(streamer, uploader, Requests({ 2 }, FullResolution)));
+        TEST_CHECK(Pump(streamer, uploader, Requests({ 3 }, FullResolution)));
+        TEST_CHECK(streamer.GetResidentResolution(2) == TailResolution);
+        TEST_CHECK(streamer.GetResidentResolution(3) == TailResolution);
+        TEST_CHECK(streamer.GetStats().FailedTiles == 4);
+        TEST_CHECK(streamer.GetStats().ResidentTiles == 2);
+        TEST_CHECK(streamer.GetStats().ResidentBytes == residentBytes);
+        TEST_CHECK(streamer.GetStats().RefinedTiles == 0);
+
+        // Неудачное уточнение не повторяется каждый кадр, даже когда загрузчик снова может
+        uploader.FailUploads.clear();
+        uploadsBefore = uploader.Uploads.size();
+        TEST_CHECK(Pump(streamer, uploader, Requests({ 2, 3 }, FullResolution)));
+        TEST_CHECK(uploader.Uploads.size() == uploadsBefore);
+        TEST_CHECK(streamer.GetResidentResolution(3) == TailResolution);
+        TEST_CHECK(streamer.GetStats().FailedTiles == 4);
+
+        streamer.Shutdown();
+        std::error_code error;
+        std::filesystem::remove_all(dir, error);
+    }
+}
+
+int main()
+{
+    CheckPriorities();
+    CheckBudget();
+    CheckProgressiveRefinement();
+    CheckFailures();
+
+    return TestResult("TextureStreamerTest");
+}
@@ -0,0 +1,173 @@
+#include "Bc7Decoder.h"
+#include "HeightPyramid.h"
+#include "Heightfield.h"
+#include "QuadTree.h"
+#include "TerrainInstanceBuilder.h"
+#include "TerrainReferenceRenderer.h"
+#include "WorkStealingPool.h"
+#include "TestCommon.h"
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+using namespace DirectX;
+
+// Снимает эталонные кадры TerrainReferenceRenderer с камер TerrainApp::ReportReferenceCameras
+// без D3D12: reference_<n>.bmp в выходном каталоге. Дерево настроено как в TerrainApp::Initialize
+// (глубина 4, высоты из пирамиды, выбор по экранной ошибке, горизонт и буфер глубины), экземпляры
+// строятся как в BuildInstances, текстуры - полные цепочки мипов тайлов Terrain/001/Weathering.
+// Запускается из корня репозитория:
+//   RenderReferenceCameras [--output <dir>] [--width <px>] [--height <px>] [--threads <n>]
+
+namespace
+{
+    struct Options
+    {
+        std::string Output = ".";
+        uint32_t Width = 1280;
+        uint32_t Height = 720;
+        uint32_t Threads = 0;       // 0 - по числу аппаратных потоков
+    };
+
+    bool ParseOptions(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            if (i + 1 >= argc)
+            {
+                return false;
+            }
+            if (std::strcmp(argv[i], "--output") == 0)
+            {
+                options.Output = argv[++i];
+            }
+            else if (std::strcmp(argv[i], "--width") == 0)
+            {
+                options.Width = (uint32_t)std::atoi(argv[++i]);
+            }
+            else if (std::strcmp(argv[i], "--height") == 0)
+            {
+                options.Height = (uint32_t)std::atoi(argv[++i]);
+            }
+            else if (std::strcmp(argv[i], "--threads") == 0)
+            {
+                options.Threads = (uint32_t)std::atoi(argv[++i]);
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return options.Width > 0 && options.Height > 0;
+    }
+
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        std::printf("usage: RenderReferenceCameras [--output <dir>] [--width <px>] [--height <px>] [--threads <n>]\n");
+        return 1;
+    }
+
+    std::vector<float> values;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    if (!LoadTestHeights(values, width, height))
+    {
+        std::printf("cannot load Terrain/003/Height_Out.tif\n");
+        return 1;
+    }
+    Heightfield heightfield;
+    heightfield.Build(values, width, height, TestWorld::TerrainSize, TestWorld::TerrainSize, TestWorld::HeightScale);
+    for (float& value : values)
+    {
+        value *= TestWorld::HeightScale;
+    }
+    HeightPyramid pyramid;
+    pyramid.Build(values, width, height);
+
+    WorkStealingPool pool(options.Threads);
+    const float aspectRatio = (float)options.Width / options.Height;
+
+    QuadTree tree;
+    tree.Initialize(TestWorld::TerrainSize, 4, { 200.0f, 500.0f, 1000.0f });
+    tree.RefitHeights(pyramid, TestWorld::HeightBoundsMargin);
+    tree.SetScreenSpaceErrorParams(TestWorld::CameraFovDegrees * 3.14159265f / 180.0f, (float)options.Height,
+                                   TestWorld::LodPixelTolerance);
+    tree.ComputeGeometricErrors(pyramid, TestWorld::LodErrorGridResolution);
+    tree.SetSelectionMode(LODSelectionMode::ScreenSpaceError);
+    tree.SetOcclusionCulling(true);
+    tree.SetDepthOcclusion(true);
+    tree.SetParallelUpdate(&pool);
+
+    TerrainInstanceBuilder instances;
+    instances.Configure((float)TestWorld::TileSize, TestWorld::TilesX, TestWorld::TilesY, TestWorld::PatchesPerTile);
+
+    TerrainReferenceRenderer renderer;
+    renderer.SetHeightfield(&heightfield, TestWorld::BasePatchSize);
+
+    // Слот тайла (x, y) - файл с инвертированным y, как в TerrainApp::BuildTerrainGeometry
+    auto start = std::chrono::steady_clock::now();
+    Bc7Decoder decoder;
+    for (int y = 0; y < TestWorld::TilesY; y++)
+    {
+        for (int x = 0; x < TestWorld::TilesX; x++)
+        {
+            std::string path = "Terrain/001/Weathering/Weathering_Out_y" + std::to_string(TestWorld::TilesY - 1 - y) +
+                               "_x" + std::to_string(x) + ".dds";
+            if (!renderer.LoadTileTexture((uint32_t)(y * TestWorld::TilesX + x), path, decoder, &pool))
+            {
+                std::printf("cannot load %s\n", path.c_str());
+                return 1;
+            }
+        }
+    }
+    std::printf("%ux%u, %u threads, textures decoded in %.1f ms\n",
+                options.Width, options.Height, pool.GetThreadCount(), MillisecondsSince(start));
+
+    int failures = 0;
+    const size_t cameraCount = sizeof(ReferenceCameraPoses) / sizeof(ReferenceCameraPoses[0]);
+    for (size_t i = 0; i < cameraCount; i++)
+    {
+        const TestCameraPose& pose = ReferenceCameraPoses[i];
+        Camera camera;
+        camera.SetProjectionValues(TestWorld::CameraFovDegrees, aspectRatio, 1.0f, 10000.0f);
+        camera.SetPosition(pose.X, pose.Y, pose.Z);
+        camera.SetRotation(pose.Pitch, pose.Yaw);
+
+        tree.Update(camera.GetPosition(), camera.GetFrustum());
+        instances.Build(tree, tree.GetVisibleNodes());
+
+        // Как в TerrainApp::RenderReferenceFrame: матрицы камеры хранятся транспонированными для шейдеров
+        TerrainReferenceView view;
+        XMStoreFloat4x4(&view.ViewProj,
+                        XMMatrixTranspose(XMMatrixMultiply(camera.GetProjectionMatrix(), camera.GetViewMatrix())));
+        view.EyePosition = camera.GetPosition();
+        view.Width = options.Width;
+        view.Height = options.Height;
+
+        start = std::chrono::steady_clock::now();
+        renderer.Render(view, instances, &pool);
+        double renderMs = MillisecondsSince(start);
+
+        std::string path = options.Output + "/reference_" + std::to_string(i) + ".bmp";
+        bool written = renderer.WriteBmp(path);
+        const TerrainReferenceStats& stats = renderer.GetStats();
+        std::printf("%s%s: %.1f ms, nodes %zu, patches %u, culled %u, triangles %llu, rasterized %llu, shaded %u\n",
+                    path.c_str(), written ? "" : " (not written)", renderMs, tree.GetVisibleNodes().size(),
+                    stats.Patches, stats.CulledPatches, (unsigned long long)stats.Triangles,
+                    (unsigned long long)stats.RasterTriangles, stats.ShadedPixels);
+        failures += !written || stats.ShadedPixels == 0;
+    }
+    return failures ? 1 : 0;
+}